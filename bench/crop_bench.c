@@ -0,0 +1,92 @@
+/**
+ * crop_bench.c
+ * Microbenchmark of the border detection kernel against the original column scan
+ *
+ * Usage: crop_bench [width height [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL3/SDL.h>
+
+#include "crop_detect.h"
+
+// Page with white margins around noisy grey content, like a scan
+static SDL_Surface* make_page(int width, int height) {
+    SDL_Surface *surface = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+    if (!surface) {
+        return NULL;
+    }
+
+    int margin_x = width / 12;
+    int margin_y = height / 15;
+    srand(1234);
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = (uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        for (int x = 0; x < width; x++) {
+            bool content = x >= margin_x && x < width - margin_x && y >= margin_y && y < height - margin_y;
+            uint8_t value = content ? (uint8_t)(rand() % 200) : (uint8_t)(245 + rand() % 11);
+            row[x * 4 + 0] = value;
+            row[x * 4 + 1] = value;
+            row[x * 4 + 2] = value;
+            row[x * 4 + 3] = 255;
+        }
+    }
+
+    return surface;
+}
+
+// Average milliseconds per call
+static double time_detector(SDL_FRect (*detect)(SDL_Surface*, const CropDetectOptions*),
+                            SDL_Surface *surface, int iterations, SDL_FRect *out_rect) {
+    CropDetectOptions options = { CROP_DEFAULT_THRESHOLD, CROP_DEFAULT_MIN_COUNT };
+
+    // Warm up caches and page in the counts
+    *out_rect = detect(surface, &options);
+
+    Uint64 start = SDL_GetTicksNS();
+    for (int i = 0; i < iterations; i++) {
+        *out_rect = detect(surface, &options);
+    }
+    Uint64 elapsed = SDL_GetTicksNS() - start;
+
+    return (double)elapsed / iterations / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    int width = argc > 2 ? atoi(argv[1]) : 3500;
+    int height = argc > 2 ? atoi(argv[2]) : 5000;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20;
+    if (width <= 0 || height <= 0 || iterations <= 0) {
+        fprintf(stderr, "Usage: %s [width height [iterations]]\n", argv[0]);
+        return 1;
+    }
+
+    SDL_Surface *surface = make_page(width, height);
+    if (!surface) {
+        fprintf(stderr, "Failed to create surface: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SDL_FRect reference_rect, kernel_rect;
+    double reference_ms = time_detector(crop_detect_rect_reference, surface, iterations, &reference_rect);
+    double kernel_ms = time_detector(crop_detect_rect, surface, iterations, &kernel_rect);
+
+    printf("Page %dx%d, %d iterations\n", width, height, iterations);
+    printf("  reference : %8.3f ms  crop %.0f,%.0f %.0fx%.0f\n", reference_ms,
+           reference_rect.x, reference_rect.y, reference_rect.w, reference_rect.h);
+    printf("  %-9s : %8.3f ms  crop %.0f,%.0f %.0fx%.0f\n", crop_detect_kernel_name(), kernel_ms,
+           kernel_rect.x, kernel_rect.y, kernel_rect.w, kernel_rect.h);
+    printf("  speedup   : %8.2fx\n", kernel_ms > 0 ? reference_ms / kernel_ms : 0.0);
+
+    bool same = reference_rect.x == kernel_rect.x && reference_rect.y == kernel_rect.y &&
+                reference_rect.w == kernel_rect.w && reference_rect.h == kernel_rect.h;
+    if (!same) {
+        fprintf(stderr, "Warning: kernel and reference crops differ\n");
+    }
+
+    SDL_DestroySurface(surface);
+    return same ? 0 : 1;
+}
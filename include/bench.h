@@ -0,0 +1,55 @@
+/**
+ * bench.h
+ * Per-stage timings for the headless benchmark mode (--bench)
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL3/SDL.h>
+
+typedef enum {
+    BENCH_OPEN,        // Enumerating the archive, document or directory
+    BENCH_EXTRACT,     // Reading a page out of the archive
+    BENCH_DECODE,      // Decoding (or rasterizing) a page to a surface
+    BENCH_ENHANCE,     // Enhancement statistics and pass
+    BENCH_CROP,        // White border scan
+    BENCH_UPLOAD,      // Surface to texture
+    BENCH_PRESENT,     // Drawing and presenting a frame
+    BENCH_STAGE_COUNT
+} BenchStage;
+
+// A running measurement; stages timed inside it are subtracted, so every stage reports
+// its own time even when one calls another (upload includes the enhancement pass)
+typedef struct {
+    Uint64 start;
+    Uint64 nested_at_start;
+} BenchTimer;
+
+// Start collecting samples, timers are no-ops until then
+bool bench_init(void);
+
+bool bench_active(void);
+
+BenchTimer bench_start(void);
+
+void bench_stop(BenchTimer *timer, BenchStage stage);
+
+// Record a sample measured elsewhere
+void bench_add_sample(BenchStage stage, Uint64 ns);
+
+// Write a JSON object of the stages with count, mean, p50, p95, p99 and max in milliseconds
+void bench_write_stages(FILE *file, const char *indent);
+
+// Write a JSON string literal
+void bench_write_string(FILE *file, const char *text);
+
+// Peak resident set size of the process, in kilobytes
+long bench_peak_rss_kb(void);
+
+// Free the samples
+void bench_shutdown(void);
+
+#endif // BENCH_H
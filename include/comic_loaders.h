@@ -7,6 +7,7 @@
 #define COMIC_LOADERS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <SDL3/SDL.h>
 
 // Include comic viewer types
@@ -18,8 +19,12 @@ typedef void (*ProgressCallback)(float progress, const char *message);
 // Function to check if a file is a supported image
 bool is_image_file(const char *filename);
 
-// Load images from a directory
-bool load_directory(const char *path, ImageEntry *images, int *image_count, int max_images, ProgressCallback progress_cb);
+// Load images from a directory into a newly allocated, sorted array of entries
+bool load_directory(const char *path, ImageEntry **images, int *image_count, ProgressCallback progress_cb);
+
+// Archive type of a file name from its extension (the first length characters of name),
+// ARCHIVE_TYPE_NONE if it is not a comic archive or document
+ArchiveType archive_type_from_name(const char *name, size_t length);
 
 // Open an archive and prepare for image loading
 ArchiveHandle* archive_open(const char *path, ArchiveType type, int *total_images, ProgressCallback progress_cb);
@@ -27,6 +32,22 @@ ArchiveHandle* archive_open(const char *path, ArchiveType type, int *total_image
 // Get an image from the archive at the given index
 bool archive_get_image(ArchiveHandle *handle, int index, char **out_path);
 
+// Get the encoded bytes of an image without writing it to disk; returns false if the archive
+// type has no memory path
+// The caller frees *out_data when *out_owned is set, otherwise it points into the archive's
+// mapping and stays valid until archive_close
+bool archive_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size, bool *out_owned);
+
+// Rasterize a page straight into a surface about target_height pixels tall
+// Does not take the handle lock; returns false if the archive type has no render path
+bool archive_render_page(ArchiveHandle *handle, int index, int target_height, SDL_Surface **out_surface);
+
+// Width and height of a page read from its header, without decoding it (safe from any thread)
+bool archive_get_page_size(ArchiveHandle *handle, int index, int *width, int *height);
+
+// Hint that a page will be read soon so its bytes are fetched ahead (no-op without page ranges)
+void archive_readahead(ArchiveHandle *handle, int index);
+
 // Close an archive handle and free resources
 void archive_close(ArchiveHandle *handle);
 
@@ -36,19 +57,38 @@ bool extract_temp_file(const char *archive_path, const char *entry_name, const c
 // Escape a string for shell argument
 char* escape_shell_arg(const char *str);
 
+// Create a directory and its missing parents (like mkdir -p)
+bool make_directories(const char *path);
+
+// Recursively delete a directory tree (like rm -rf)
+bool remove_directory(const char *path);
+
+// Build handle->temp_dir/entry_name, creating the temp directory and subdirectories on first use
+bool temp_file_path(ArchiveHandle *handle, const char *entry_name, char *out_path, size_t out_size);
+
+// Write a buffer to handle->temp_dir/entry_name, creating the temp directory on first use
+bool write_temp_file(ArchiveHandle *handle, const char *entry_name, const void *data, size_t size, char **out_path);
+
 // CBZ specific functions
 ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback progress_cb);
 bool cbz_get_image(ArchiveHandle *handle, int index, char **out_path);
+bool cbz_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size);
+bool cbz_map_image_data(ArchiveHandle *handle, int index, const void **out_data, size_t *out_size);
+bool cbz_get_page_size(ArchiveHandle *handle, int index, int *width, int *height);
 void cbz_close(ArchiveHandle *handle);
 
 // CBR specific functions
 ArchiveHandle* cbr_open(const char *path, int *total_images, ProgressCallback progress_cb);
 bool cbr_get_image(ArchiveHandle *handle, int index, char **out_path);
+bool cbr_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size);
+bool cbr_get_page_size(ArchiveHandle *handle, int index, int *width, int *height);
 void cbr_close(ArchiveHandle *handle);
 
 // PDF specific functions
 ArchiveHandle* pdf_open(const char *path, int *total_images, ProgressCallback progress_cb);
 bool pdf_get_image(ArchiveHandle *handle, int index, char **out_path);
+bool pdf_render_page(ArchiveHandle *handle, int index, int target_height, SDL_Surface **out_surface);
+bool pdf_get_page_size(ArchiveHandle *handle, int index, int *width, int *height);
 void pdf_close(ArchiveHandle *handle);
 
 #endif // COMIC_LOADERS_H
\ No newline at end of file
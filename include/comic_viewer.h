@@ -10,8 +10,9 @@
 #include <SDL3_ttf/SDL_ttf.h>
 #include <stdbool.h>
 
-// Maximum number of images we can handle
-#define MAX_IMAGES 1000
+#include "crop_detect.h"
+#include "view_list.h"
+#include "image_processor.h"
 
 // Image entry structure used by loaders
 typedef struct {
@@ -21,6 +22,12 @@ typedef struct {
     float width;                // Original image width
     float height;               // Original image height
     SDL_FRect crop_rect;       // Crop rectangle for the image
+    SDL_Color left_color;      // Dominant color of the left edge, for the side gradient
+    SDL_Color right_color;     // Dominant color of the right edge, for the side gradient
+    bool decode_pending;       // Whether a decode job is queued or running
+    int reduced_height;        // Display height the page was decoded for, 0 at full resolution
+    EnhanceStats enhance;      // Color statistics of the unenhanced surface
+    Uint64 last_used;          // Page cache recency, higher is more recent
 } ImageEntry;
 
 
@@ -50,25 +57,30 @@ typedef struct ArchiveHandle {
     void *archive_ptr;          // Pointer to the archive-specific handle
     char **entry_names;         // Array of entry names (for CBZ/CBR)
     int *page_indices;          // Array of page indices (for PDF)
+    SDL_Mutex *lock;            // Serializes access from the decode workers
+    struct SourceMap *source;   // The archive file, for readahead hints (CBZ, may be NULL)
+    struct HttpSource *remote;  // The archive file when it is read over HTTP (CBZ, may be NULL)
+    struct SourceSpan *page_spans; // Byte range of each page in source or remote (may be NULL)
+    struct ZipPageEntry *page_entries; // How each page is compressed, next to page_spans (CBZ, may be NULL)
 } ArchiveHandle;
 
-#define MAX_IMAGES_PER_VIEW 4
-
-typedef struct ImageView {
-    int image_indices[MAX_IMAGES_PER_VIEW];     // Indices of images in this view
-    int count;                                  // Number of images in this view
-    int total_width;                            // Total width of the view
-    int max_height;                             // Max height of the view
-    SDL_FRect crop_rect;                        // Crop rectangle for the view
-    struct ImageView *next;                     // Pointer to next view in linked list
-    struct ImageView *prev;                     // Pointer to previous view in linked list
-} ImageView;
+// Where the time of the last page turn went, for the performance overlay
+typedef struct {
+    Uint64 start_ns;          // When the view changed
+    int image_index;          // First image of the new view
+    bool pending;             // Still waiting for the view to be presented
+    bool cached;              // The page already had a texture
+    Uint64 queue_ns;          // Decode job waiting for a worker
+    Uint64 decode_ns;         // Extraction, decode, enhancement and crop scan on the worker
+    Uint64 upload_ns;         // Surface to texture
+    Uint64 total_ns;          // Until the view was presented
+} PageTurnTiming;
 
 // Define the ViewerState struct
 struct ViewerState {
     SourceType type;          // Type of source (CBZ, CBR, directory)
     char *source_path;        // Path to the source
-    ImageEntry images[MAX_IMAGES];  // Array of image entries
+    ImageEntry *images;       // Image entries, allocated once the page count is known
     int image_count;          // Number of images
     SDL_Window *window;       // Main SDL window
     SDL_Renderer *renderer;   // SDL renderer
@@ -89,16 +101,18 @@ struct ViewerState {
     int target_view;         // The target view index for the page turn
     int direction;          // Direction of the page turn (1 for next, -1 for previous)
 
+    // Navigation events of a frame only move the target, the view changes once per frame
+    int pending_view_index;        // View the events of this frame lead to, -1 when none
+    bool scrubbing;                // Views are turned faster than they can be decoded
+
     // Progress indicator display timer
     Uint64 last_page_change_time;  // Time when the last page change occurred
     bool show_progress_indicator;  // Whether to show the progress indicator
 
     // Multi-image display settings
     bool multiple_images_mode;     // Whether to display multiple images
-    ImageView *first_view;         // Pointer to first view in linked list
-    ImageView *current_view_node;  // Pointer to current view node
-    int current_view_index;        // Current view index (for compatibility)
-    int view_count;                // Total number of views
+    ViewList views;                // Views in reading order
+    int current_view_index;        // Index of the displayed view
     bool right_to_left;            // Reading direction (for manga)
 
     // Zoom settings
@@ -107,11 +121,70 @@ struct ViewerState {
     int zoom_center_x;             // X-coordinate center of zoom (in window coordinates)
     int zoom_center_y;             // Y-coordinate center of zoom (in window coordinates)
     float max_zoom;                // Maximum zoom level (e.g., 3.0 = 300%)
+
+    // Background decoding
+    int decode_threads;            // Number of decode worker threads
+    int prefetch_ahead;            // Views decoded ahead in the reading direction
+    int prefetch_behind;           // Views kept decoded behind the reading direction
+    unsigned decode_generation;    // Bumped to discard in-flight decodes
+    int surface_cache_mb;          // Budget for decoded surfaces kept in memory
+    int texture_cache_mb;          // Budget for uploaded textures
+    int disk_cache_mb;             // Size cap of the on-disk page cache, 0 disables it
+    CropDetectOptions crop_options; // White border detection settings
+
+    // Series mode: reading continues into the next volume in the directory
+    bool series_mode;
+    int series_preopen_pages;      // Pages before the end at which the next volume is opened
+    bool series_switch_pending;    // The last view was passed while the next volume was opening
+
+    // Redraw on demand
+    bool needs_redraw;             // Set by anything that changes what is on screen
+    bool vsync;                    // Whether presents are paced by the display
+
+    // Performance overlay (F3)
+    bool show_perf_overlay;
+    Uint64 frame_ns;               // Time to draw and present the last frame
+    double frame_ns_avg;           // Moving average of frame_ns
+    PageTurnTiming last_turn;
 };
 
 // Declare viewer as an extern variable of this struct type
 extern struct ViewerState viewer;
 
+// Default background decoding settings
+#define DEFAULT_PREFETCH_AHEAD 3
+#define DEFAULT_PREFETCH_BEHIND 1
+
+// Default pages left in a volume when series mode starts opening the next one
+#define DEFAULT_SERIES_PREOPEN_PAGES 8
+
+// Turns closer together than this count as scrubbing: only the view landed on is decoded,
+// at a fraction of the display height, until input has stopped for as long
+#define SCRUB_INTERVAL_MS 150
+
+// Display height divisor of the previews decoded while scrubbing
+#define SCRUB_PREVIEW_DIVISOR 4
+
+// How long the page indicator stays on screen after a page change
+#define PROGRESS_INDICATOR_DURATION_MS 2000
+
+// Longest the main loop sleeps with nothing to do
+#define IDLE_WAIT_MS 1000
+
+// Redraw interval of the performance overlay when nothing else changes
+#define PERF_OVERLAY_REFRESH_MS 250
+
+// Page orders walked by the benchmark, the random one is seeded for repeatable runs
+#define BENCH_ORDER_COUNT 3
+#define BENCH_RANDOM_SEED 1234
+
+// Longest the benchmark waits for a screen of the overview grid to fill in
+#define BENCH_GRID_TIMEOUT_MS 30000
+
+// How often the main thread checks on the open thread, the progress bar itself is
+// redrawn at most once per display refresh
+#define OPEN_WAIT_MS 4
+
 // Initialize the comic viewer subsystems
 // monitor_index: Index of the monitor to use (-1 for default)
 bool comic_viewer_init(int monitor_index);
@@ -122,6 +195,10 @@ bool comic_viewer_load(const char *path);
 // Run the main viewer loop
 void comic_viewer_run(void);
 
+// Open a source, then decode, upload and present every page in sequential, reverse and
+// random order without input, writing per-stage timings as JSON to output_path ("-" for stdout)
+bool comic_viewer_bench(const char *path, const char *output_path);
+
 // Clean up resources
 void comic_viewer_cleanup(void);
 
@@ -0,0 +1,34 @@
+/**
+ * crop_detect.h
+ * Detection of the white borders around a scanned page
+ */
+
+#ifndef CROP_DETECT_H
+#define CROP_DETECT_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+// Default detection settings
+#define CROP_DEFAULT_THRESHOLD 240
+#define CROP_DEFAULT_MIN_COUNT 3
+
+// Edges never move closer than this to each other
+#define CROP_MIN_CONTENT_SIZE 100
+
+typedef struct {
+    int threshold;      // A pixel is "white" when the average of R, G and B is at least this (0-255)
+    int min_count;      // Non-white pixels a row or column needs to count as content
+} CropDetectOptions;
+
+// Content rectangle of the surface, using the vectorized row scan for 32-bit RGB formats and a
+// plain row scan for 8-bit gray ones (a ramp palette)
+SDL_FRect crop_detect_rect(SDL_Surface *surface, const CropDetectOptions *options);
+
+// Original column-by-column scan through SDL_GetRGBA, used for other formats and as a benchmark baseline
+SDL_FRect crop_detect_rect_reference(SDL_Surface *surface, const CropDetectOptions *options);
+
+// Name of the counting kernel selected for this CPU ("avx2", "sse2", "neon" or "scalar")
+const char* crop_detect_kernel_name(void);
+
+#endif // CROP_DETECT_H
@@ -0,0 +1,85 @@
+/**
+ * decode_pool.h
+ * Background worker threads that decode pages off the render thread
+ */
+
+#ifndef DECODE_POOL_H
+#define DECODE_POOL_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+#include "image_processor.h"
+
+// Upper bound on the number of decode worker threads
+#define MAX_DECODE_THREADS 16
+
+// Tile value of a job that decodes the whole page, other values are owned by the tile cache
+#define DECODE_WHOLE_PAGE -1
+
+// Tile value of a job that decodes a page at a fraction of the display height, shown while
+// the reader flips through pages faster than they can be decoded
+#define DECODE_PAGE_PREVIEW -2
+
+// Result of a decode job, handed back to the main thread
+typedef struct {
+    int index;                // Image index the job was submitted for
+    int tile;                 // Tile the job was submitted for, DECODE_WHOLE_PAGE for the page
+    unsigned generation;      // Generation the job was submitted with
+    SDL_Surface *surface;     // Decoded surface (NULL on failure)
+    SDL_FRect crop_rect;      // Crop rectangle detected on the surface
+    SDL_Color left_color;     // Dominant color of the left edge
+    SDL_Color right_color;    // Dominant color of the right edge
+    int reduced_height;       // Display height the surface was reduced for, 0 at full resolution
+    EnhanceStats enhance;     // Statistics the enhancement is computed from at upload
+    char *path;               // Extracted file path (archives only, may be NULL)
+    Uint64 queue_ns;          // Time the job waited for a worker
+    Uint64 decode_ns;         // Time the worker spent on it
+} DecodeResult;
+
+// Decode function run on the worker threads; fills result (index and tile are set) and returns success
+typedef bool (*DecodeFunction)(int index, DecodeResult *result);
+
+// Predicate and callback used to cancel queued jobs
+typedef bool (*DecodeJobFilter)(int index, int tile);
+typedef void (*DecodeCancelCallback)(int index, int tile);
+
+// Start thread_count workers running decode_fn
+bool decode_pool_init(int thread_count, DecodeFunction decode_fn);
+
+// Queue a job, lower priority values run first; re-submitting a queued index and tile updates it
+void decode_pool_submit(int index, int tile, int priority, unsigned generation);
+
+// Drop queued (not yet running) jobs matching filter, calling on_cancel for each
+void decode_pool_cancel(DecodeJobFilter filter, DecodeCancelCallback on_cancel);
+
+// Fetch the next finished job, returns false when none are ready
+bool decode_pool_poll(DecodeResult *result);
+
+// SDL event type pushed whenever a result becomes ready, 0 if none could be registered
+Uint32 decode_pool_event_type(void);
+
+// Number of jobs queued or running
+int decode_pool_queue_depth(void);
+
+// Renumber queued, running and finished jobs after pages were inserted, page i of the
+// old_count before is page remap[i] now
+void decode_pool_remap(const int *remap, int old_count);
+
+// Runs on a decode worker: the index its job has now, which differs from the one it was
+// started with once decode_pool_remap moved the page; other threads get index back
+int decode_pool_job_index(int index);
+
+// Block until no job is queued or running (returns at once during shutdown)
+void decode_pool_wait_idle(void);
+
+// Let only the first count workers take jobs, the others finish their job and wait
+void decode_pool_set_active_threads(int count);
+
+// Workers allowed to take jobs
+int decode_pool_active_threads(void);
+
+// Stop the workers and free any undelivered results
+void decode_pool_shutdown(void);
+
+#endif // DECODE_POOL_H
@@ -0,0 +1,49 @@
+/**
+ * directory_index.h
+ * Sorted index of a directory of images that keeps growing as files are added
+ *
+ * Opening reads the directory for a short while and returns what it found, so the first
+ * page can be shown; a thread reads the rest, then follows the directory with inotify.
+ * Names are ordered like archive entries (image_name_compare), so a directory and the
+ * same pages zipped read in the same order; each name is turned into a sort key once, so
+ * sorting and merging are plain strcmp.
+ */
+
+#ifndef DIRECTORY_INDEX_H
+#define DIRECTORY_INDEX_H
+
+#include <stdbool.h>
+
+// Time spent reading the directory before the first pages are handed out, on local disks
+// the whole directory is read well within it
+#define DIRECTORY_INDEX_FIRST_MS 100
+
+// Names the thread reads before handing them over, while the rest of the directory streams in
+#define DIRECTORY_INDEX_BATCH 256
+
+// Pages found since the last directory_index_take
+typedef struct {
+    int count;
+    int *positions;           // Ascending index of each new page among all pages, once inserted
+    char **paths;             // Full paths, set to NULL by the caller for the ones it keeps
+    int *widths;              // Sizes from the file headers, 0 when unknown
+    int *heights;
+} DirectoryBatch;
+
+// Read the first names of path and start the thread; out_paths gets the full paths of the
+// pages found so far in reading order (owned by the caller), false if there are none
+bool directory_index_open(const char *path, char ***out_paths, int *out_count);
+
+// Take the pages found since the last call, false when there are none (main thread)
+bool directory_index_take(DirectoryBatch *batch);
+
+// Free a batch and the paths left in it
+void directory_index_free_batch(DirectoryBatch *batch);
+
+// Block until the whole directory has been read, e.g. before a benchmark
+void directory_index_wait_scan(void);
+
+// Stop the thread and stop watching the directory
+void directory_index_close(void);
+
+#endif // DIRECTORY_INDEX_H
@@ -0,0 +1,37 @@
+/**
+ * disk_cache.h
+ * Persistent cache of decoded, display-sized pages and their metadata
+ */
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+#include "decode_pool.h"
+
+// Default size cap of the cache directory
+#define DEFAULT_DISK_CACHE_MB 1024
+
+// Open (creating it if needed) $XDG_CACHE_HOME/ic and prune it to budget bytes
+// A budget of 0 disables the cache
+bool disk_cache_init(size_t budget);
+
+// Key of a page: the file it comes from (path, size and mtime), the entry or page inside it
+// (entry_name may be NULL, page is -1 for plain image files), the decode height and the
+// settings that shape the pixels; returns 0 when the source cannot be stat'ed
+Uint64 disk_cache_key(const char *source_path, const char *entry_name, int page, int target_height,
+                      const void *settings, size_t settings_size);
+
+// Fill result's surface, crop rectangle, edge colors, color statistics and reduced height from the cache
+bool disk_cache_load(Uint64 key, DecodeResult *result);
+
+// Write a decoded page to the cache, pruning the oldest pages when over budget
+bool disk_cache_store(Uint64 key, const DecodeResult *result);
+
+// Release the cache lock
+void disk_cache_shutdown(void);
+
+#endif // DISK_CACHE_H
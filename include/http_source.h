@@ -0,0 +1,55 @@
+/**
+ * http_source.h
+ * Random access to a remote archive or document over HTTP(S) range requests
+ *
+ * Only the bytes that are read get fetched, in HTTP_BLOCK_SIZE blocks kept in a memory
+ * cache, over keep-alive connections that are reused between requests. Needs a build
+ * with libcurl (make CURL=1), otherwise opening a URL fails with a message.
+ */
+
+#ifndef HTTP_SOURCE_H
+#define HTTP_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+#include "source_io.h"
+
+// Granularity of the range requests and of the cache
+#define HTTP_BLOCK_SIZE (256 << 10)
+
+// Blocks kept in memory, 64 MiB
+#define HTTP_CACHE_BLOCKS 256
+
+// Idle connections kept open for reuse
+#define HTTP_MAX_CONNECTIONS 4
+
+// Readahead ranges waiting to be fetched, hints past this are dropped
+#define HTTP_READAHEAD_QUEUE 16
+
+typedef struct HttpSource HttpSource;
+
+// Whether a path is an http:// or https:// URL
+bool http_source_is_url(const char *path);
+
+// Check that the resource exists and get its size (one HEAD request)
+HttpSource* http_source_open(const char *url);
+
+Uint64 http_source_size(const HttpSource *source);
+
+// Read length bytes at offset through the block cache, fetching the missing blocks in one
+// request; safe from any thread, concurrent reads of the same blocks wait for one fetch
+bool http_source_read(HttpSource *source, Uint64 offset, void *buffer, size_t length);
+
+// Fetch a range into the cache and wait for it, e.g. a whole entry before it is read in
+// small pieces; ranges larger than a quarter of the cache are only fetched in part
+bool http_source_load(HttpSource *source, SourceSpan span);
+
+// Like http_source_load, in the background; returns immediately
+void http_source_readahead(HttpSource *source, SourceSpan span);
+
+// Stop the readahead, close the connections and free the cache
+void http_source_close(HttpSource *source);
+
+#endif // HTTP_SOURCE_H
@@ -0,0 +1,45 @@
+/**
+ * image_codecs.h
+ * Direct decoders for the common page formats, picked from the magic bytes
+ *
+ * Each backend is compiled in with its library (make JPEGTURBO=1 WEBP=1 SPNG=1) and writes
+ * top-down rows straight into a pooled surface, without FreeImage's bottom-up copy. Formats
+ * without a backend, and files a backend rejects, are decoded by FreeImage.
+ */
+
+#ifndef IMAGE_CODECS_H
+#define IMAGE_CODECS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+#include "image_probe.h"
+
+// Decode a whole image for target_height, NULL when the codec cannot handle this file
+// Returns an 8-bit gray surface or a 32-bit color one; out_reduced is set when the codec
+// scaled the image down itself (0 target_height decodes at full resolution)
+typedef SDL_Surface* (*ImageCodecDecode)(const void *data, size_t size, int target_height, bool *out_reduced);
+
+typedef struct {
+    const char *name;         // Library name, for the logs and the benchmark results
+    ImageFormat format;
+    ImageCodecDecode decode;
+} ImageCodec;
+
+// The backend decoding format, NULL for FreeImage (none built in, or direct decoding is off)
+const ImageCodec* image_codec_find(ImageFormat format);
+
+// Switch between the direct backends (the default) and FreeImage for everything, e.g. to
+// compare both with --bench
+void image_codecs_set_enabled(bool enabled);
+
+bool image_codecs_enabled(void);
+
+// Fill out with up to max backends in use, returns how many; 0 when FreeImage decodes everything
+int image_codecs_active(const ImageCodec **out, int max);
+
+// Largest power-of-two reduction (up to 1/8) that keeps height at or above target_height
+int image_codec_reduction(int height, int target_height);
+
+#endif // IMAGE_CODECS_H
@@ -0,0 +1,41 @@
+/**
+ * image_probe.h
+ * Image dimensions read from file headers, without decoding any pixels
+ */
+
+#ifndef IMAGE_PROBE_H
+#define IMAGE_PROBE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Bytes read from the start of an image for probing, enough to get past typical EXIF blocks
+#define IMAGE_PROBE_HEADER_SIZE (64 * 1024)
+
+// Formats recognized from their magic bytes
+typedef enum {
+    IMAGE_FORMAT_UNKNOWN,     // No signature, e.g. TGA, left to FreeImage
+    IMAGE_FORMAT_JPEG,
+    IMAGE_FORMAT_PNG,
+    IMAGE_FORMAT_GIF,
+    IMAGE_FORMAT_BMP,
+    IMAGE_FORMAT_WEBP,
+    IMAGE_FORMAT_TIFF,
+    IMAGE_FORMAT_PSD,
+    IMAGE_FORMAT_ICO,
+    IMAGE_FORMAT_COUNT
+} ImageFormat;
+
+// Identify an image from its first bytes, whatever its name says
+ImageFormat image_format_detect(const void *data, size_t size);
+
+const char* image_format_name(ImageFormat format);
+
+// Parse the width and height out of the first bytes of a JPEG, PNG, GIF, BMP or WebP image
+// Returns false for other formats or when the size is not within the given bytes
+bool image_probe_size(const void *data, size_t size, int *width, int *height);
+
+// Read the head of a file and probe it
+bool image_probe_file(const char *path, int *width, int *height);
+
+#endif // IMAGE_PROBE_H
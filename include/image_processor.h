@@ -2,11 +2,11 @@
 #define IMAGE_PROCESSOR_H
 
 #include <SDL3/SDL.h>
-#include <FreeImage.h>
 #include <stdbool.h>
 
 // Color correction options
 typedef struct {
+    bool enhancement_enabled;
     double gamma;           // 0.1 - 3.0 (1.0 = no change)
     double brightness;      // -100 to 100 (0 = no change)
     double contrast;        // -100 to 100 (0 = no change)
@@ -14,22 +14,34 @@ typedef struct {
     bool auto_levels;       // Auto contrast/brightness
     bool color_balance;     // Auto color balance
     bool sharpen;          // Apply unsharp mask
+    double sharpen_amount;  // 0.0 - 2.0, strength of the unsharp mask
 } ImageProcessingOptions;
 
-// Apply color corrections to an image
-FIBITMAP* process_image_quality(FIBITMAP* bitmap, const ImageProcessingOptions* options);
+// Per-page statistics, gathered once on the decode workers and applied with whatever
+// options are current when the page is uploaded
+typedef struct {
+    float balance[3];       // Gray world factors for red, green and blue
+    Uint8 black;            // Darkest and brightest luma after clipping the extremes,
+    Uint8 white;            // the auto levels input range
+} EnhanceStats;
+
+// Surfaces are 32-bit color or 8-bit gray (SDL_PIXELFORMAT_INDEX8 with a ramp palette)
+
+// Gather the statistics of a surface from a subsample of its pixels
+// Returns false (and neutral statistics) for unsupported formats
+bool enhance_analyze(SDL_Surface *surface, EnhanceStats *stats);
 
-// Auto-detect and apply optimal corrections
-FIBITMAP* auto_enhance_image(FIBITMAP* bitmap);
+// Write the enhanced surface to dst (a locked texture, or the surface's own pixels), which
+// has the surface's layout: 4 bytes per pixel, or 1 for gray surfaces
+// Color balance, levels, gamma, brightness and contrast are folded into one lookup table
+// per channel; saturation and the unsharp mask are applied in the same pass
+bool enhance_copy(SDL_Surface *surface, void *dst, int dst_pitch, const EnhanceStats *stats,
+                  const ImageProcessingOptions *options);
 
-// Specific enhancement functions
-FIBITMAP* adjust_gamma(FIBITMAP* bitmap, double gamma);
-FIBITMAP* adjust_brightness_contrast(FIBITMAP* bitmap, double brightness, double contrast);
-FIBITMAP* adjust_saturation(FIBITMAP* bitmap, double saturation);
-FIBITMAP* auto_color_balance(FIBITMAP* bitmap);
-FIBITMAP* sharpen_image(FIBITMAP* bitmap, double amount);
+// Analyze and enhance a surface in place
+bool enhance_surface(SDL_Surface *surface, const ImageProcessingOptions *options);
 
 // Get default processing options
-ImageProcessingOptions get_default_processing_options(void);
+ImageProcessingOptions* get_default_processing_options(void);
 
 #endif // IMAGE_PROCESSOR_H
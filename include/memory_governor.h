@@ -0,0 +1,80 @@
+/**
+ * memory_governor.h
+ * Shrinks the caches, the prefetch window and the decode threads under memory pressure
+ *
+ * Pressure is read from the cgroup the viewer runs in (memory.max and memory.high of it
+ * and its parents, memory.pressure), from /proc when there is no limit, and signalled by
+ * SDL_EVENT_LOW_MEMORY and failed texture creations. Budgets drop as soon as pressure is
+ * seen and come back one level at a time once it has been gone for a while.
+ */
+
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+// How often the limits and pressure are read
+#define GOVERNOR_POLL_MS 1000
+
+// Time without pressure before budgets grow back a level
+#define GOVERNOR_RECOVER_MS 10000
+
+// Share of the memory limit in use (file cache that can be reclaimed excluded) per level
+#define GOVERNOR_MODERATE_USAGE 0.85
+#define GOVERNOR_CRITICAL_USAGE 0.95
+
+// Share of the last 10 s some task waited on memory, from PSI, per level
+#define GOVERNOR_MODERATE_PSI 5.0
+#define GOVERNOR_CRITICAL_PSI 20.0
+
+// The texture budget learned from creation failures never goes below this
+#define GOVERNOR_MIN_TEXTURE_MB 32
+
+typedef enum {
+    MEMORY_PRESSURE_NONE,
+    MEMORY_PRESSURE_MODERATE,
+    MEMORY_PRESSURE_CRITICAL
+} MemoryPressure;
+
+// What the viewer may use
+typedef struct {
+    size_t surface_budget;
+    size_t texture_budget;
+    int prefetch_ahead;
+    int prefetch_behind;
+    int decode_threads;
+} MemoryBudgets;
+
+typedef struct {
+    MemoryPressure level;
+    size_t limit;             // Tightest memory limit found, 0 when unknown
+    size_t usage;             // Memory in use against that limit
+    bool cgroup;              // The limit comes from a cgroup rather than the machine's RAM
+    double psi_some;          // PSI some avg10, negative when unavailable
+    size_t texture_cap;       // Texture budget after creation failures, 0 when none failed
+    Uint64 low_memory_events;
+    Uint64 texture_failures;
+} MemoryGovernorStats;
+
+// Find the cgroup and start from the budgets the viewer is configured with
+void memory_governor_init(const MemoryBudgets *configured);
+
+// Main loop: re-read the pressure when it is time, true when out holds new budgets
+bool memory_governor_poll(MemoryBudgets *out);
+
+// SDL_EVENT_LOW_MEMORY: go to the critical level right away
+void memory_governor_low_memory(void);
+
+// A texture could not be created with texture_bytes resident, cap the texture budget below that
+void memory_governor_texture_failed(size_t texture_bytes);
+
+MemoryGovernorStats memory_governor_get_stats(void);
+
+// Budgets currently in force
+MemoryBudgets memory_governor_budgets(void);
+
+const char* memory_pressure_name(MemoryPressure level);
+
+#endif // MEMORY_GOVERNOR_H
@@ -0,0 +1,62 @@
+/**
+ * page_cache.h
+ * Byte-bounded LRU accounting for decoded surfaces and uploaded textures
+ */
+
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+#include "comic_viewer.h"
+
+// Default budgets for the two cache tiers
+#define DEFAULT_SURFACE_CACHE_MB 512
+#define DEFAULT_TEXTURE_CACHE_MB 256
+
+// Cache counters, a lookup is a hit when the page did not have to be decoded again
+typedef struct {
+    Uint64 texture_hits;      // Texture already resident
+    Uint64 surface_hits;      // Texture re-uploaded from a cached surface
+    Uint64 misses;            // Page had to be extracted and decoded
+    Uint64 evictions;         // Surfaces and textures dropped to stay within budget
+    size_t surface_bytes;     // Bytes held by cached surfaces
+    size_t texture_bytes;     // Estimated bytes held by cached textures
+    size_t surface_budget;
+    size_t texture_budget;
+} PageCacheStats;
+
+// Predicate for images that must never be evicted (current and prefetched views)
+typedef bool (*PageCachePinned)(int index);
+
+// Set the tier budgets in bytes and the pin predicate, resets the counters
+void page_cache_init(size_t surface_budget, size_t texture_budget, PageCachePinned pinned);
+
+// Change the tier budgets in bytes, page_cache_trim applies them
+void page_cache_set_budgets(size_t surface_budget, size_t texture_budget);
+
+// Mark an image as most recently used
+void page_cache_touch(ImageEntry *image);
+
+// Account for a surface or texture installed on an image
+void page_cache_add_surface(ImageEntry *image);
+void page_cache_add_texture(ImageEntry *image);
+
+// Destroy an image's surface or texture and release its bytes
+void page_cache_drop_surface(ImageEntry *image);
+void page_cache_drop_texture(ImageEntry *image);
+
+// Record the outcome of a page lookup
+void page_cache_record_texture_hit(void);
+void page_cache_record_surface_hit(void);
+void page_cache_record_miss(void);
+
+// Evict least recently used, unpinned entries until both tiers fit their budget
+void page_cache_trim(ImageEntry *images, int count);
+
+// Current counters
+PageCacheStats page_cache_get_stats(void);
+
+#endif // PAGE_CACHE_H
@@ -0,0 +1,66 @@
+/**
+ * page_pool.h
+ * Reuse of page-sized surfaces and textures across page turns
+ *
+ * Pages of a book nearly always share their size, so a released surface or texture is
+ * kept and handed to the next page of the same width, height and format instead of being
+ * freed and allocated again.
+ *
+ * Grayscale pages are kept as 8-bit surfaces and uploaded as IYUV textures with neutral
+ * chroma: a quarter of the memory of a 32-bit surface and 1.5 bytes per pixel on the GPU.
+ */
+
+#ifndef PAGE_POOL_H
+#define PAGE_POOL_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+// Released surfaces and textures kept for reuse, the oldest is freed past this
+#define SURFACE_POOL_SIZE 4
+#define TEXTURE_POOL_SIZE 4
+
+typedef struct {
+    Uint64 surface_reuses;
+    Uint64 surface_allocations;
+    Uint64 texture_reuses;
+    Uint64 texture_allocations;
+} PagePoolStats;
+
+// Textures are created on renderer, surfaces work without init (no pooling then)
+bool page_pool_init(SDL_Renderer *renderer);
+
+// A surface of the given size and format, contents are undefined (any thread)
+SDL_Surface* page_pool_acquire_surface(int width, int height, SDL_PixelFormat format);
+
+// An 8-bit surface with a gray ramp palette, the format grayscale pages are kept in (any thread)
+SDL_Surface* page_pool_acquire_gray_surface(int width, int height);
+
+// Whether surface is one of those gray surfaces, its values are luma
+bool page_pool_is_gray(const SDL_Surface *surface);
+
+// Give a surface back, NULL is ignored and shared surfaces are only destroyed (any thread)
+void page_pool_release_surface(SDL_Surface *surface);
+
+// A streaming texture of the given size and format, contents are undefined (main thread)
+// IYUV textures use the full range JPEG colorspace, so a gray page's values can be its Y plane
+SDL_Texture* page_pool_acquire_texture(int width, int height, SDL_PixelFormat format);
+
+// Set the chroma planes of a locked IYUV texture to neutral, after its Y plane was written
+void page_pool_neutral_chroma(void *pixels, int pitch, int height);
+
+// A streaming texture holding a copy of surface, gray surfaces become IYUV textures (main thread)
+SDL_Texture* page_pool_upload(SDL_Surface *surface);
+
+// Give a texture from page_pool_upload back (main thread)
+void page_pool_release_texture(SDL_Texture *texture);
+
+PagePoolStats page_pool_get_stats(void);
+
+// Free everything pooled but keep pooling, under memory pressure (main thread)
+void page_pool_trim(void);
+
+// Free everything pooled, before the renderer is destroyed
+void page_pool_shutdown(void);
+
+#endif // PAGE_POOL_H
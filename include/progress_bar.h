@@ -12,9 +12,13 @@
 // Initialize the progress bar
 bool progress_bar_init(SDL_Renderer *renderer);
 
-// Update the progress bar with a new value
+// Update the progress bar with a new value, safe to call from any thread
+// On the main thread it is redrawn at most once per display refresh
 void progress_bar_update(float progress, const char *message);
 
+// Main thread: redraw when the state changed and a refresh has passed, and handle events
+void progress_bar_refresh(void);
+
 // Render the progress bar
 void progress_bar_render(void);
 
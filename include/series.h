@@ -0,0 +1,58 @@
+/**
+ * series.h
+ * Series mode: the volume after the current one is opened and its first pages decoded in
+ * the background, so reading continues into it without a load
+ */
+
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+#include "comic_viewer.h"
+#include "decode_pool.h"
+
+// Pages of the next volume decoded ahead, the cover and the first spread
+#define SERIES_PREDECODE_PAGES 3
+
+typedef enum {
+    SERIES_IDLE,      // Nothing opened yet
+    SERIES_OPENING,   // The next volume is being opened on the background thread
+    SERIES_READY,     // Opened, waiting for series_take
+    SERIES_NONE       // The current volume is the last one, or the next failed to open
+} SeriesState;
+
+// Decodes a whole page of archive for target_height, on the background thread
+typedef bool (*SeriesDecodeFunction)(ArchiveHandle *archive, int index, int target_height, DecodeResult *result);
+
+// An opened volume, owned by the caller once taken
+typedef struct {
+    char *path;
+    ArchiveType type;
+    ArchiveHandle *archive;
+    int image_count;
+    DecodeResult pages[SERIES_PREDECODE_PAGES];   // The first page_count pages, decoded
+    int page_count;
+    int *widths;              // Page sizes from the headers, 0 when unknown (may be NULL)
+    int *heights;
+} SeriesVolume;
+
+// The comic file after path in its directory in natural order, NULL if there is none
+char* series_next_path(const char *path);
+
+// Start opening the volume after path; the state goes to SERIES_NONE if there is none
+void series_preopen(const char *path, SeriesDecodeFunction decode_fn, int target_height);
+
+SeriesState series_state(void);
+
+// The opened volume once SERIES_READY, NULL otherwise; the state goes back to SERIES_IDLE
+SeriesVolume* series_take(void);
+
+// Close the archive and free the decoded pages of a volume
+void series_free_volume(SeriesVolume *volume);
+
+// Stop the background thread and free a volume nobody took
+void series_shutdown(void);
+
+#endif // SERIES_H
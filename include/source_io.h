@@ -0,0 +1,62 @@
+/**
+ * source_io.h
+ * Memory-mapped access to archives and page files, with readahead hints for the pages
+ * about to be decoded
+ *
+ * On network shares latency dominates, so sources are mapped (or read in large blocks when
+ * the file system cannot map them) and the kernel is asked to fetch upcoming byte ranges
+ * while the workers are still busy with the current pages.
+ */
+
+#ifndef SOURCE_IO_H
+#define SOURCE_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+// Block size of the reads used when a file cannot be mapped, and of buffered archive reads
+#define SOURCE_READ_BLOCK (1 << 20)
+
+// Page files waiting for a readahead hint, hints past this are dropped
+#define SOURCE_READAHEAD_QUEUE 32
+
+// A whole file, mapped read-only or copied to an aligned buffer
+// Mapped sources must not be truncated while open (reads past the new end fault)
+typedef struct SourceMap {
+    void *data;               // File contents, NULL when only the descriptor is open
+    size_t size;
+    int fd;                   // Kept open for positioned reads and readahead hints, -1 if none
+    bool mapped;              // Unmapped on close, otherwise data is freed
+} SourceMap;
+
+// Byte range of a page inside a source
+typedef struct SourceSpan {
+    Uint64 offset;
+    Uint64 length;            // 0 when unknown
+} SourceSpan;
+
+// Start the thread that issues readahead hints for page files
+bool source_io_init(void);
+
+// Drop pending hints and stop the thread
+void source_io_shutdown(void);
+
+// Map a file read-only; when mapping fails the descriptor stays open in map (fd >= 0) so
+// hints and positioned reads still work, and false is returned
+bool source_map_open(const char *path, SourceMap *map);
+
+// Get a whole file in memory, mapped or, when that fails, read in SOURCE_READ_BLOCK reads
+bool source_load(const char *path, SourceMap *map);
+
+// Unmap or free the contents and close the descriptor
+void source_close(SourceMap *map);
+
+// Ask the kernel to start reading a byte range of an open source, returns immediately
+void source_readahead(const SourceMap *map, SourceSpan span);
+
+// Queue a hint for a whole page file; opening files on a share can stall, so the hint is
+// issued from the readahead thread (no-op if it is not running)
+void source_readahead_path(const char *path);
+
+#endif // SOURCE_IO_H
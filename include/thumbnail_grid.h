@@ -0,0 +1,82 @@
+/**
+ * thumbnail_grid.h
+ * Overview of every page as a grid of thumbnails, to jump anywhere in a volume
+ *
+ * Thumbnails are decoded by the decode workers at a reduced resolution and copied into a
+ * few large atlas textures, so a screen of them is drawn with one geometry call per atlas.
+ */
+
+#ifndef THUMBNAIL_GRID_H
+#define THUMBNAIL_GRID_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+// Cell a thumbnail is fitted into, pages keep their aspect ratio inside it
+#define THUMBNAIL_WIDTH 128
+#define THUMBNAIL_HEIGHT 192
+
+// Space between cells on screen
+#define THUMBNAIL_GAP 16
+
+// Edge of the square atlas textures thumbnails are packed into (160 thumbnails each)
+#define THUMBNAIL_ATLAS_SIZE 2048
+
+// Rows queued past the visible ones on each side, so scrolling finds them decoded
+#define THUMBNAIL_PREFETCH_ROWS 2
+
+// Tile value of a thumbnail decode job
+#define DECODE_THUMBNAIL -3
+
+// Pixel format of thumbnails and atlases
+#define THUMBNAIL_FORMAT SDL_PIXELFORMAT_XRGB8888
+
+// Set up the grid for renderer, nothing is allocated until a volume is set
+bool thumbnail_grid_init(SDL_Renderer *renderer);
+
+// Free the atlases, the decode workers must be stopped first
+void thumbnail_grid_shutdown(void);
+
+// Drop every thumbnail for a volume of image_count pages, results of older generations are discarded
+void thumbnail_grid_reset(int image_count, unsigned generation);
+
+// Move the thumbnails along when pages are inserted, page i of the old_count before is
+// page remap[i] of the image_count now; the new pages start empty
+void thumbnail_grid_remap(const int *remap, int old_count, int image_count);
+
+// Show the grid with page selected under the cursor
+void thumbnail_grid_open(int selected);
+
+// Hide the grid and cancel the thumbnails still queued
+void thumbnail_grid_close(void);
+
+bool thumbnail_grid_is_open(void);
+
+// Page under the cursor
+int thumbnail_grid_selected(void);
+
+// Move the cursor by columns and rows, scrolling it into view
+void thumbnail_grid_move(int columns, int rows);
+
+// Put the cursor on page index, scrolling it into view
+void thumbnail_grid_select(int index);
+
+// Scroll by a number of rows (mouse wheel), the cursor stays where it is
+void thumbnail_grid_scroll(float rows);
+
+// Page drawn at window coordinates x, y, -1 if none
+int thumbnail_grid_hit(float x, float y);
+
+// Runs on a decode worker: page fitted into a thumbnail cell, page is left to the caller
+SDL_Surface* thumbnail_grid_scale(SDL_Surface *page);
+
+// Copy a finished thumbnail into its atlas, takes ownership of surface (NULL when the job failed)
+void thumbnail_grid_install(int index, SDL_Surface *surface, unsigned generation);
+
+// Draw the visible part of the grid in a window of width x height, queueing the missing thumbnails
+void thumbnail_grid_render(int width, int height);
+
+// Pages the last frame drew that still wait for a thumbnail (failed ones count as done)
+int thumbnail_grid_missing(void);
+
+#endif // THUMBNAIL_GRID_H
@@ -0,0 +1,71 @@
+/**
+ * tile_cache.h
+ * Tiled, on-demand high-resolution rendering of zoomed pages
+ */
+
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL.h>
+
+#include "image_processor.h"
+
+// Tiles are square, edge tiles are cropped to the page
+#define TILE_SIZE 512
+
+// Coarsest level of detail, level n averages 2^n x 2^n source pixels
+#define TILE_MAX_LEVEL 7
+
+// Full resolution pages kept for cutting tiles (enough for a double-page spread)
+#define TILE_MAX_SOURCES 2
+
+// Default budget for uploaded tile textures
+#define DEFAULT_TILE_CACHE_MB 128
+
+// Tile value of the job that only loads a page's full resolution source
+#define TILE_SOURCE_JOB 0x7fffffff
+
+// Enhancement a source is decoded with, captured on the main thread when it is queued
+typedef struct {
+    ImageProcessingOptions options;
+    EnhanceStats stats;       // The page's own statistics, so tiles match the page around them
+} TileEnhancement;
+
+// Decodes page index at full resolution with enhancement applied, runs on the decode workers
+typedef bool (*TileSourceFunction)(int index, const TileEnhancement *enhancement, SDL_Surface **out_surface);
+
+// Set up the cache for renderer, texture_budget is in bytes
+bool tile_cache_init(SDL_Renderer *renderer, size_t texture_budget, TileSourceFunction source_fn);
+
+// Free every tile and source, the decode workers must be stopped first
+void tile_cache_shutdown(void);
+
+// Drop the full resolution sources, tiles already uploaded stay cached
+void tile_cache_release_sources(void);
+
+// Drop sources and tiles, used when the decoded pixels change (enhancement toggle)
+void tile_cache_clear(void);
+
+// Renumber sources and tiles after pages were inserted, page i of the old_count before is
+// page remap[i] now; the decode pool's jobs are renumbered too (decode_pool_remap), under
+// the cache lock, so a worker looking up its source sees both renumbered or neither
+void tile_cache_remap(const int *remap, int old_count);
+
+// Runs on a decode worker: cut and downscale a tile of page index from its source
+bool tile_cache_decode(int index, int tile, SDL_Surface **out_surface);
+
+// Upload a finished tile, takes ownership of surface (NULL when the job failed or is stale)
+void tile_cache_install(int index, int tile, SDL_Surface *surface);
+
+// Draw the tiles of page index visible in viewport, queueing the missing ones
+// crop_rect is in the coordinates of the displayed page of width image_width,
+// dest_rect is where that crop is drawn; enhancement is copied if the source has to be queued
+void tile_cache_render(int index, float image_width, SDL_FRect crop_rect, SDL_FRect dest_rect,
+                       SDL_FRect viewport, unsigned generation, const TileEnhancement *enhancement);
+
+// Cancel queued tiles that were not drawn this frame and evict down to the budget
+void tile_cache_end_frame(void);
+
+#endif // TILE_CACHE_H
@@ -0,0 +1,34 @@
+/**
+ * trace.h
+ * Timed zones around the hot paths, recorded per thread and written as a Chrome trace
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+// Zones kept per thread, older ones are overwritten
+#define TRACE_RING_SIZE 16384
+
+// An open zone, name must be a string literal (only the pointer is stored)
+typedef struct {
+    const char *name;
+    Uint64 start;
+} TraceZone;
+
+// Start recording, output_path gets the trace (chrome://tracing or ui.perfetto.dev) on shutdown
+bool trace_init(const char *output_path);
+
+bool trace_enabled(void);
+
+// Zones are free apart from the enabled check when not recording
+TraceZone trace_begin(const char *name);
+
+void trace_end(TraceZone *zone);
+
+// Write the trace file and free the rings, every recording thread must have stopped
+void trace_shutdown(void);
+
+#endif // TRACE_H
@@ -0,0 +1,55 @@
+/**
+ * view_list.h
+ * Indexed, growable list of the views (one page or a spread) of the open comic
+ */
+
+#ifndef VIEW_LIST_H
+#define VIEW_LIST_H
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+#define MAX_IMAGES_PER_VIEW 4
+
+typedef struct ImageView {
+    int image_indices[MAX_IMAGES_PER_VIEW];     // Indices of images in this view
+    int count;                                  // Number of images in this view
+    int total_width;                            // Total width of the view
+    int max_height;                             // Max height of the view
+    SDL_FRect crop_rect;                        // Crop rectangle for the view
+} ImageView;
+
+// Views in one array with a gap kept where the last insert or removal happened, so lookups
+// by index are constant time and splitting or merging spreads around the current view
+// only moves the gap by a slot
+typedef struct {
+    ImageView *items;         // capacity slots, [gap_start, gap_end) is unused
+    int capacity;
+    int gap_start;
+    int gap_end;
+} ViewList;
+
+void view_list_init(ViewList *list);
+
+void view_list_free(ViewList *list);
+
+// Remove all views, keeping the storage
+void view_list_clear(ViewList *list);
+
+int view_list_count(const ViewList *list);
+
+// View at an index, NULL when out of range
+// The pointer is invalidated by the next insert or removal
+ImageView* view_list_get(ViewList *list, int index);
+
+// Insert a copy of view before index (index == count appends)
+bool view_list_insert(ViewList *list, int index, const ImageView *view);
+
+bool view_list_append(ViewList *list, const ImageView *view);
+
+void view_list_remove(ViewList *list, int index);
+
+// A one-image view with no other images set
+ImageView view_make_single(int image_index);
+
+#endif // VIEW_LIST_H
@@ -0,0 +1,159 @@
+/**
+ * bench.c
+ * Implementation of the benchmark sample collection and its JSON summary
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "bench.h"
+
+static const char *stage_names[BENCH_STAGE_COUNT] = {
+    "open", "extract", "decode", "enhance", "crop", "upload", "present"
+};
+
+typedef struct {
+    Uint64 *samples;
+    int count;
+    int capacity;
+} StageSamples;
+
+static struct {
+    StageSamples stages[BENCH_STAGE_COUNT];
+    SDL_Mutex *lock;          // Samples may come from decode workers
+    bool active;
+} bench = {0};
+
+// Time recorded by the timers stopped so far on this thread
+static _Thread_local Uint64 nested_ns;
+
+bool bench_init(void) {
+    bench.lock = SDL_CreateMutex();
+    if (!bench.lock) {
+        fprintf(stderr, "Failed to create benchmark lock: %s\n", SDL_GetError());
+        return false;
+    }
+    bench.active = true;
+    return true;
+}
+
+bool bench_active(void) {
+    return bench.active;
+}
+
+BenchTimer bench_start(void) {
+    BenchTimer timer = {0, 0};
+    if (bench.active) {
+        timer.start = SDL_GetTicksNS();
+        timer.nested_at_start = nested_ns;
+    }
+    return timer;
+}
+
+void bench_stop(BenchTimer *timer, BenchStage stage) {
+    if (!bench.active || timer->start == 0) return;
+
+    Uint64 elapsed = SDL_GetTicksNS() - timer->start;
+    Uint64 inner = nested_ns - timer->nested_at_start;
+    Uint64 own = elapsed > inner ? elapsed - inner : 0;
+
+    // Enclosing timers subtract this one's time in turn
+    nested_ns += own;
+    bench_add_sample(stage, own);
+}
+
+void bench_add_sample(BenchStage stage, Uint64 ns) {
+    if (!bench.active || (int)stage < 0 || stage >= BENCH_STAGE_COUNT) return;
+
+    SDL_LockMutex(bench.lock);
+    StageSamples *samples = &bench.stages[stage];
+    if (samples->count >= samples->capacity) {
+        int capacity = samples->capacity ? samples->capacity * 2 : 256;
+        Uint64 *grown = realloc(samples->samples, capacity * sizeof(Uint64));
+        if (!grown) {
+            SDL_UnlockMutex(bench.lock);
+            return;
+        }
+        samples->samples = grown;
+        samples->capacity = capacity;
+    }
+    samples->samples[samples->count++] = ns;
+    SDL_UnlockMutex(bench.lock);
+}
+
+static int compare_samples(const void *a, const void *b) {
+    Uint64 sa = *(const Uint64*)a;
+    Uint64 sb = *(const Uint64*)b;
+    return (sa > sb) - (sa < sb);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile_ms(const Uint64 *sorted, int count, int percent) {
+    int rank = (int)((Sint64)count * percent / 100);
+    if ((Sint64)rank * 100 < (Sint64)count * percent) rank++;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1] / 1e6;
+}
+
+void bench_write_stages(FILE *file, const char *indent) {
+    fprintf(file, "{\n");
+
+    SDL_LockMutex(bench.lock);
+    for (int stage = 0; stage < BENCH_STAGE_COUNT; stage++) {
+        StageSamples *samples = &bench.stages[stage];
+        fprintf(file, "%s  \"%s\": {\"count\": %d", indent, stage_names[stage], samples->count);
+
+        if (samples->count > 0) {
+            qsort(samples->samples, samples->count, sizeof(Uint64), compare_samples);
+            double total = 0;
+            for (int i = 0; i < samples->count; i++) {
+                total += samples->samples[i];
+            }
+            fprintf(file, ", \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f",
+                    total / samples->count / 1e6,
+                    percentile_ms(samples->samples, samples->count, 50),
+                    percentile_ms(samples->samples, samples->count, 95),
+                    percentile_ms(samples->samples, samples->count, 99),
+                    samples->samples[samples->count - 1] / 1e6);
+        }
+        fprintf(file, "}%s\n", stage + 1 < BENCH_STAGE_COUNT ? "," : "");
+    }
+    SDL_UnlockMutex(bench.lock);
+
+    fprintf(file, "%s}", indent);
+}
+
+void bench_write_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char*)(text ? text : ""); *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+long bench_peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in kilobytes on Linux
+    return usage.ru_maxrss;
+}
+
+void bench_shutdown(void) {
+    for (int stage = 0; stage < BENCH_STAGE_COUNT; stage++) {
+        free(bench.stages[stage].samples);
+    }
+    if (bench.lock) {
+        SDL_DestroyMutex(bench.lock);
+    }
+    memset(&bench, 0, sizeof(bench));
+}
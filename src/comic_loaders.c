@@ -12,11 +12,30 @@
 #include <unistd.h>
 #include <zip.h>
 #include "comic_loaders.h"
+#include "source_io.h"
+#include "http_source.h"
+#include "trace.h"
 
 // External functions from comic_loaders_utils.c
 extern const char* get_filename_from_path(const char* path);
 extern bool is_image_file(const char *filename);
 
+ArchiveType archive_type_from_name(const char *name, size_t length) {
+    if (!name || length <= 4) {
+        return ARCHIVE_TYPE_NONE;
+    }
+    
+    const char *ext = name + length - 4;
+    if (strncasecmp(ext, ".cbz", 4) == 0 || strncasecmp(ext, ".zip", 4) == 0) {
+        return ARCHIVE_TYPE_CBZ;
+    } else if (strncasecmp(ext, ".cbr", 4) == 0 || strncasecmp(ext, ".rar", 4) == 0) {
+        return ARCHIVE_TYPE_CBR;
+    } else if (strncasecmp(ext, ".pdf", 4) == 0) {
+        return ARCHIVE_TYPE_PDF;
+    }
+    return ARCHIVE_TYPE_NONE;
+}
+
 // Common functions for on-demand loading
 ArchiveHandle* archive_open(const char *path, ArchiveType type, int *total_images, ProgressCallback progress_cb) {
     if (!path || !total_images) {
@@ -28,8 +47,8 @@ ArchiveHandle* archive_open(const char *path, ArchiveType type, int *total_image
     switch (type) {
         case ARCHIVE_TYPE_CBZ:
             handle = cbz_open(path, total_images, progress_cb);
-            // If CBZ loading fails, try as CBR (some files are misnamed)
-            if (!handle) {
+            // If CBZ loading fails, try as CBR (some files are misnamed, URLs cannot be CBR)
+            if (!handle && !http_source_is_url(path)) {
                 fprintf(stderr, "CBZ loading failed, attempting to load as CBR...\n");
                 handle = cbr_open(path, total_images, progress_cb);
                 if (handle) {
@@ -60,6 +79,16 @@ ArchiveHandle* archive_open(const char *path, ArchiveType type, int *total_image
             return NULL;
     }
     
+    if (handle) {
+        // Pages are extracted from the decode worker threads
+        handle->lock = SDL_CreateMutex();
+        if (!handle->lock) {
+            fprintf(stderr, "Failed to create archive lock: %s\n", SDL_GetError());
+            archive_close(handle);
+            return NULL;
+        }
+    }
+    
     return handle;
 }
 
@@ -68,23 +97,143 @@ bool archive_get_image(ArchiveHandle *handle, int index, char **out_path) {
         return false;
     }
     
+    bool result = false;
+    
+    // Includes the wait for the handle lock, which other workers may hold
+    TraceZone zone = trace_begin("archive_get_image");
+    if (handle->type == ARCHIVE_TYPE_CBZ && handle->remote && handle->page_spans) {
+        http_source_load(handle->remote, handle->page_spans[index]);
+    }
+    SDL_LockMutex(handle->lock);
     switch (handle->type) {
         case ARCHIVE_TYPE_CBZ:
-            return cbz_get_image(handle, index, out_path);
+            result = cbz_get_image(handle, index, out_path);
+            break;
         case ARCHIVE_TYPE_CBR:
-            return cbr_get_image(handle, index, out_path);
+            result = cbr_get_image(handle, index, out_path);
+            break;
         case ARCHIVE_TYPE_PDF:
-            return pdf_get_image(handle, index, out_path);
+            result = pdf_get_image(handle, index, out_path);
+            break;
+        default:
+            break;
+    }
+    SDL_UnlockMutex(handle->lock);
+    trace_end(&zone);
+    
+    return result;
+}
+
+bool archive_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size, bool *out_owned) {
+    if (!handle || !out_data || !out_size || !out_owned || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+    
+    bool result = false;
+    *out_owned = true;
+    
+    TraceZone zone = trace_begin("archive_get_image_data");
+    
+    // Stored CBZ pages are used in place in the mapping, without the lock or a copy
+    const void *mapped = NULL;
+    if (handle->type == ARCHIVE_TYPE_CBZ && cbz_map_image_data(handle, index, &mapped, out_size)) {
+        *out_data = (void*)mapped;
+        *out_owned = false;
+        trace_end(&zone);
+        return true;
+    }
+    
+    // Remote CBZ entries are fetched whole in one request before the lock is taken, so one
+    // worker's round trip does not hold up the others; libzip then reads the block cache
+    if (handle->type == ARCHIVE_TYPE_CBZ && handle->remote && handle->page_spans) {
+        http_source_load(handle->remote, handle->page_spans[index]);
+    }
+    
+    SDL_LockMutex(handle->lock);
+    switch (handle->type) {
+        case ARCHIVE_TYPE_CBZ:
+            result = cbz_get_image_data(handle, index, out_data, out_size);
+            break;
+        case ARCHIVE_TYPE_CBR:
+            result = cbr_get_image_data(handle, index, out_data, out_size);
+            break;
+        default:
+            break;
+    }
+    SDL_UnlockMutex(handle->lock);
+    trace_end(&zone);
+    
+    return result;
+}
+
+bool archive_render_page(ArchiveHandle *handle, int index, int target_height, SDL_Surface **out_surface) {
+    if (!handle || !out_surface || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+    
+    // Rendering backends keep one session per worker, so no handle lock here
+    switch (handle->type) {
+        case ARCHIVE_TYPE_PDF: {
+            TraceZone zone = trace_begin("archive_render_page");
+            bool result = pdf_render_page(handle, index, target_height, out_surface);
+            trace_end(&zone);
+            return result;
+        }
         default:
             return false;
     }
 }
 
+bool archive_get_page_size(ArchiveHandle *handle, int index, int *width, int *height) {
+    if (!handle || !width || !height || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+    
+    bool result = false;
+    
+    switch (handle->type) {
+        case ARCHIVE_TYPE_CBZ:
+            // Headers are read around libzip, the lock is only taken when that is not possible
+            result = cbz_get_page_size(handle, index, width, height);
+            break;
+        case ARCHIVE_TYPE_CBR:
+            // Sizes were recorded while listing the archive, nothing to read
+            result = cbr_get_page_size(handle, index, width, height);
+            break;
+        case ARCHIVE_TYPE_PDF:
+            // Uses the per-thread sessions like rendering does
+            result = pdf_get_page_size(handle, index, width, height);
+            break;
+        default:
+            break;
+    }
+    
+    return result;
+}
+
+void archive_readahead(ArchiveHandle *handle, int index) {
+    if (!handle || !handle->page_spans || index < 0 || index >= handle->total_images) {
+        return;
+    }
+    
+    // The mapping and ranges are read-only once open, no handle lock needed
+    if (handle->remote) {
+        http_source_readahead(handle->remote, handle->page_spans[index]);
+    } else if (handle->source) {
+        source_readahead(handle->source, handle->page_spans[index]);
+    }
+}
+
 void archive_close(ArchiveHandle *handle) {
     if (!handle) {
         return;
     }
     
+    if (handle->lock) {
+        SDL_DestroyMutex(handle->lock);
+        handle->lock = NULL;
+    }
+    
     switch (handle->type) {
         case ARCHIVE_TYPE_CBZ:
             cbz_close(handle);
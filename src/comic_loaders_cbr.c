@@ -1,6 +1,18 @@
 /**
  * comic_loaders_cbr.c
- * Implementation of CBR/RAR comic loading using unrar command-line tool
+ * Implementation of CBR/RAR comic loading using libarchive
+ *
+ * libarchive only reads RAR archives sequentially, and solid archives have to be
+ * decompressed from the start to reach any entry. The listing pass already decompresses
+ * everything, so it keeps the encoded pages that sort first, up to CBR_CACHE_LIMIT: a
+ * volume that fits is never decompressed again. Past that we keep a reader open and move
+ * it forward only, caching the pages we pass close to the one requested, so reading in
+ * order costs one more decompression pass for the whole volume.
+ *
+ * A page before the reader that is not cached restarts it from the beginning of the
+ * stream. The window kept behind the requested page is wider than the one ahead, so
+ * reading a large volume backwards restarts once per CBR_CACHE_BEHIND pages rather than
+ * on every page, but that is still a pass per window.
  */
 
 #include <stdio.h>
@@ -9,7 +21,10 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <archive.h>
+#include <archive_entry.h>
 #include "comic_loaders.h"
+#include "image_probe.h"
 
 // External functions from comic_loaders_utils.c
 extern int image_name_compare(const void *a, const void *b);
@@ -21,224 +36,491 @@ typedef struct ArchiveHandle ArchiveHandle;
 // Forward declarations of CBR functions
 void cbr_close(ArchiveHandle *handle);
 
-// Helper function to check if unrar is installed
-static bool check_unrar_available() {
-    FILE *fp = popen("which unrar", "r");
-    if (fp == NULL) {
+// Pages passed within this many pages before or after the requested one are kept in memory
+#define CBR_CACHE_BEHIND 64
+#define CBR_CACHE_AHEAD 8
+
+// Upper bound for the encoded page cache
+#define CBR_CACHE_LIMIT (256 * 1024 * 1024)
+
+#define CBR_READ_BLOCK_SIZE (64 * 1024)
+
+// Image entry found while listing the archive
+typedef struct {
+    char *name;             // Entry path inside the archive
+    int stream_position;    // Ordinal of the entry header in the archive stream
+    int width;              // Size read from the image header, 0 when unknown
+    int height;
+    void *data;             // Encoded page kept from the listing pass, NULL when not kept
+    size_t size;
+} CbrEntry;
+
+// State stored in ArchiveHandle::archive_ptr
+typedef struct {
+    struct archive *reader;     // Sequential reader, NULL until the first page request
+    int stream_position;        // Number of headers already consumed by reader
+    int *page_by_position;      // Stream ordinal -> page index (-1 for non-image entries)
+    int *position_by_page;      // Page index -> stream ordinal
+    int stream_entries;         // Number of headers in the archive
+    void **page_data;           // Cached encoded pages (NULL when not cached)
+    size_t *page_size;
+    size_t cached_bytes;
+    int *page_width;            // Page sizes probed while listing, 0 when unknown
+    int *page_height;
+} CbrArchive;
+
+static struct archive* open_reader(const char *path) {
+    struct archive *reader = archive_read_new();
+    if (!reader) {
+        return NULL;
+    }
+
+    archive_read_support_format_rar(reader);
+    archive_read_support_format_rar5(reader);
+
+    if (archive_read_open_filename(reader, path, CBR_READ_BLOCK_SIZE) != ARCHIVE_OK) {
+        fprintf(stderr, "Failed to open RAR archive %s: %s\n", path, archive_error_string(reader));
+        archive_read_free(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+// Sort entries by name, keeping their stream position attached
+static int cbr_entry_compare(const void *a, const void *b) {
+    const CbrEntry *e1 = (const CbrEntry*)a;
+    const CbrEntry *e2 = (const CbrEntry*)b;
+    return image_name_compare(&e1->name, &e2->name);
+}
+
+// Free listed entries that were not handed over to the handle
+static void free_listed_entries(CbrEntry *entries, int count) {
+    for (int i = 0; i < count; i++) {
+        free(entries[i].name);
+        free(entries[i].data);
+    }
+    free(entries);
+}
+
+// Read the data of the current entry into a newly allocated buffer
+static bool read_entry_data(struct archive *reader, struct archive_entry *entry, void **out_data, size_t *out_size) {
+    size_t capacity = archive_entry_size_is_set(entry) && archive_entry_size(entry) > 0
+                          ? (size_t)archive_entry_size(entry) : CBR_READ_BLOCK_SIZE;
+    size_t size = 0;
+    char *data = malloc(capacity);
+    if (!data) {
         return false;
     }
-    
-    char path[512];
-    bool found = (fgets(path, sizeof(path), fp) != NULL);
-    pclose(fp);
-    
-    return found;
+
+    while (true) {
+        if (size == capacity) {
+            // Size was not recorded in the header, grow as we go
+            char *grown = realloc(data, capacity * 2);
+            if (!grown) {
+                free(data);
+                return false;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        la_ssize_t bytes_read = archive_read_data(reader, data + size, capacity - size);
+        if (bytes_read < 0) {
+            fprintf(stderr, "Error reading from RAR archive: %s\n", archive_error_string(reader));
+            free(data);
+            return false;
+        }
+        if (bytes_read == 0) {
+            break;
+        }
+        size += bytes_read;
+    }
+
+    *out_data = data;
+    *out_size = size;
+    return true;
+}
+
+// Drop listed pages whose names sort last until the cache fits its limit, returns the
+// entry sorting last of those kept (-1 if none)
+static int trim_listed_entries(CbrEntry *entries, int count, size_t *cached_bytes) {
+    while (true) {
+        int last = -1;
+        for (int i = 0; i < count; i++) {
+            if (entries[i].data && (last < 0 || cbr_entry_compare(&entries[i], &entries[last]) > 0)) {
+                last = i;
+            }
+        }
+        if (last < 0 || *cached_bytes <= CBR_CACHE_LIMIT) {
+            return last;
+        }
+
+        *cached_bytes -= entries[last].size;
+        free(entries[last].data);
+        entries[last].data = NULL;
+        entries[last].size = 0;
+    }
+}
+
+// Whether page is kept when the reader passes it on the way to index
+static bool in_cache_window(int page, int index) {
+    return page >= index - CBR_CACHE_BEHIND && page <= index + CBR_CACHE_AHEAD;
+}
+
+// Drop cached pages farthest from keep_index until the cache fits its limit, pages
+// ahead count as farther in proportion to the narrower window there
+static void trim_page_cache(CbrArchive *rar, int total_images, int keep_index) {
+    while (rar->cached_bytes > CBR_CACHE_LIMIT) {
+        int farthest = -1;
+        int farthest_distance = -1;
+        for (int i = 0; i < total_images; i++) {
+            if (!rar->page_data[i] || i == keep_index) continue;
+            int distance = i < keep_index ? keep_index - i : (i - keep_index) * CBR_CACHE_BEHIND / CBR_CACHE_AHEAD;
+            if (distance > farthest_distance) {
+                farthest = i;
+                farthest_distance = distance;
+            }
+        }
+        if (farthest < 0) {
+            break;
+        }
+
+        rar->cached_bytes -= rar->page_size[farthest];
+        free(rar->page_data[farthest]);
+        rar->page_data[farthest] = NULL;
+        rar->page_size[farthest] = 0;
+    }
 }
 
 ArchiveHandle* cbr_open(const char *path, int *total_images, ProgressCallback progress_cb) {
     if (progress_cb) {
         progress_cb(0.0f, "Opening RAR archive...");
     }
-    
-    // Check if unrar is available
-    if (!check_unrar_available()) {
-        fprintf(stderr, "unrar command not found. Please install unrar.\n");
+
+    struct archive *reader = open_reader(path);
+    if (!reader) {
         if (progress_cb) {
-            progress_cb(1.0f, "unrar command not found. Please install unrar.");
+            progress_cb(1.0f, "Failed to open RAR archive");
         }
         return NULL;
     }
-    
-    // Create a temporary directory for extraction
-    char temp_dir[256];
-    snprintf(temp_dir, sizeof(temp_dir), "/tmp/ic_viewer_XXXXXX");
-    if (mkdtemp(temp_dir) == NULL) {
-        fprintf(stderr, "Failed to create temporary directory\n");
-        return NULL;
-    }
-    
+
     if (progress_cb) {
         progress_cb(0.1f, "Reading archive contents...");
     }
-    
+
     // Allocate handle
     ArchiveHandle *handle = (ArchiveHandle*)malloc(sizeof(ArchiveHandle));
-    if (!handle) {
+    CbrArchive *rar = (CbrArchive*)calloc(1, sizeof(CbrArchive));
+    if (!handle || !rar) {
+        free(handle);
+        free(rar);
+        archive_read_free(reader);
         return NULL;
     }
-    
+
     // Initialize handle
     handle->type = ARCHIVE_TYPE_CBR;
     handle->path = strdup(path);
-    handle->temp_dir = strdup(temp_dir);
+    handle->temp_dir = NULL;  // Only created if a page is requested as a file
     handle->total_images = 0;
-    handle->archive_ptr = NULL;  // Not needed for command-line approach
+    handle->archive_ptr = rar;
     handle->entry_names = NULL;
     handle->page_indices = NULL;
-    
-    // Use unrar command to list files in the archive
-    char *escaped_path = escape_shell_arg(path);
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd), "unrar lb %s", escaped_path);
-    
-    FILE *fp = popen(cmd, "r");
-    if (fp == NULL) {
-        fprintf(stderr, "Failed to run unrar command to list files\n");
-        free(escaped_path);
-        cbr_close(handle);
-        return NULL;
-    }
-    
-    // Read list of files from unrar output
-    char line[512];
+    handle->lock = NULL;
+    handle->source = NULL;
+    handle->remote = NULL;
+    handle->page_spans = NULL;
+    handle->page_entries = NULL;
+
+    // List the headers and keep the images while the cache has room, then only those that
+    // sort before the last one kept; of the others just enough is read to get their size
+    // and the rest of the data is skipped (solid archives still decompress it)
     int capacity = 100;  // Initial capacity
-    char **image_entries = (char**)malloc(capacity * sizeof(char*));
+    CbrEntry *image_entries = (CbrEntry*)malloc(capacity * sizeof(CbrEntry));
+    char *header = (char*)malloc(IMAGE_PROBE_HEADER_SIZE);
     int count = 0;
-    
-    if (!image_entries) {
+    int position = 0;
+    size_t cached_bytes = 0;
+    int last_cached = -1;     // Kept entry sorting last
+
+    if (!image_entries || !header) {
         fprintf(stderr, "Memory allocation failed\n");
-        pclose(fp);
-        free(escaped_path);
+        free(image_entries);
+        free(header);
+        archive_read_free(reader);
         cbr_close(handle);
         return NULL;
     }
 
-    if (progress_cb) {
-        progress_cb(0.4f, "Creating list of images...");
-    }    
-    
-    while (fgets(line, sizeof(line), fp)) {
-        // Remove trailing newline
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-        }
-        
-        // Get the actual filename (last part of path)
-        const char* filename = get_filename_from_path(line);
-        
+    struct archive_entry *entry;
+    int status;
+    while ((status = archive_read_next_header(reader, &entry)) == ARCHIVE_OK) {
+        const char *name = archive_entry_pathname(entry);
+
         // Check if it's an image file
-        if (is_image_file(filename)) {
+        if (name && archive_entry_filetype(entry) == AE_IFREG && is_image_file(get_filename_from_path(name))) {
             // Resize array if needed
             if (count >= capacity) {
                 capacity *= 2;
-                char **new_entries = (char**)realloc(image_entries, capacity * sizeof(char*));
+                CbrEntry *new_entries = (CbrEntry*)realloc(image_entries, capacity * sizeof(CbrEntry));
                 if (!new_entries) {
                     fprintf(stderr, "Memory allocation failed\n");
-                    for (int i = 0; i < count; i++) {
-                        free(image_entries[i]);
-                    }
-                    free(image_entries);
-                    pclose(fp);
-                    free(escaped_path);
+                    free_listed_entries(image_entries, count);
+                    free(header);
+                    archive_read_free(reader);
                     cbr_close(handle);
                     return NULL;
                 }
                 image_entries = new_entries;
             }
-            
-            // Store entry name
-            image_entries[count++] = strdup(line);
+
+            CbrEntry *image = &image_entries[count];
+            image->name = strdup(name);
+            image->stream_position = position;
+            image->width = 0;
+            image->height = 0;
+            image->data = NULL;
+            image->size = 0;
+
+            bool keep = cached_bytes < CBR_CACHE_LIMIT ||
+                        (last_cached >= 0 && cbr_entry_compare(image, &image_entries[last_cached]) < 0);
+            if (keep && read_entry_data(reader, entry, &image->data, &image->size)) {
+                image_probe_size(image->data, image->size, &image->width, &image->height);
+                cached_bytes += image->size;
+                if (last_cached < 0 || cbr_entry_compare(image, &image_entries[last_cached]) > 0) {
+                    last_cached = count;
+                }
+                if (cached_bytes > CBR_CACHE_LIMIT) {
+                    last_cached = trim_listed_entries(image_entries, count + 1, &cached_bytes);
+                }
+            } else if (!keep) {
+                size_t header_size = 0;
+                while (header_size < IMAGE_PROBE_HEADER_SIZE) {
+                    la_ssize_t bytes_read = archive_read_data(reader, header + header_size,
+                                                              IMAGE_PROBE_HEADER_SIZE - header_size);
+                    if (bytes_read <= 0) {
+                        break;
+                    }
+                    header_size += bytes_read;
+                }
+                image_probe_size(header, header_size, &image->width, &image->height);
+            }
+            count++;
+        }
+        position++;
+
+        if (progress_cb && position % 10 == 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Reading archive contents (%d entries)...", position);
+            progress_cb(0.4f, msg);
         }
     }
-    
-    pclose(fp);
-    free(escaped_path);
-    
+
+    if (status != ARCHIVE_EOF) {
+        fprintf(stderr, "Error listing RAR archive: %s\n", archive_error_string(reader));
+    }
+    archive_read_free(reader);
+    free(header);
+
     if (count == 0) {
         fprintf(stderr, "No images found in RAR archive\n");
-        free(image_entries);
+        free_listed_entries(image_entries, count);
         cbr_close(handle);
         return NULL;
     }
-    
+
     if (progress_cb) {
         progress_cb(0.8f, "Sorting images...");
     }
-    
+
     // Sort entries by name
-    qsort(image_entries, count, sizeof(char*), image_name_compare);
-    
-    // Store the count and entries in the handle
+    qsort(image_entries, count, sizeof(CbrEntry), cbr_entry_compare);
+
+    // Build the page <-> stream position maps and the page cache
+    rar->stream_entries = position;
+    handle->entry_names = (char**)malloc(count * sizeof(char*));
+    rar->position_by_page = (int*)malloc(count * sizeof(int));
+    rar->page_by_position = (int*)malloc(position * sizeof(int));
+    rar->page_data = (void**)calloc(count, sizeof(void*));
+    rar->page_size = (size_t*)calloc(count, sizeof(size_t));
+    rar->page_width = (int*)malloc(count * sizeof(int));
+    rar->page_height = (int*)malloc(count * sizeof(int));
+    if (!handle->entry_names || !rar->position_by_page || !rar->page_by_position ||
+        !rar->page_data || !rar->page_size || !rar->page_width || !rar->page_height) {
+        fprintf(stderr, "Memory allocation failed\n");
+        free_listed_entries(image_entries, count);
+        cbr_close(handle);
+        return NULL;
+    }
+
+    for (int i = 0; i < position; i++) {
+        rar->page_by_position[i] = -1;
+    }
+    for (int i = 0; i < count; i++) {
+        handle->entry_names[i] = image_entries[i].name;
+        rar->position_by_page[i] = image_entries[i].stream_position;
+        rar->page_by_position[image_entries[i].stream_position] = i;
+        rar->page_width[i] = image_entries[i].width;
+        rar->page_height[i] = image_entries[i].height;
+        rar->page_data[i] = image_entries[i].data;
+        rar->page_size[i] = image_entries[i].size;
+    }
+    rar->cached_bytes = cached_bytes;
+    free(image_entries);
+
+    // Store the count in the handle
     handle->total_images = count;
-    handle->entry_names = image_entries;
-    
+
     *total_images = count;
-    
+
     if (progress_cb) {
         progress_cb(1.0f, "Archive ready");
     }
-    
+
     return handle;
 }
 
+bool cbr_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size) {
+    if (!handle || !out_data || !out_size || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+
+    CbrArchive *rar = (CbrArchive*)handle->archive_ptr;
+    int target = rar->position_by_page[index];
+
+    // The reader cannot go backwards, restart from the beginning of the stream
+    if (!rar->page_data[index] && (!rar->reader || rar->stream_position > target)) {
+        if (rar->reader) {
+            archive_read_free(rar->reader);
+        }
+        rar->reader = open_reader(handle->path);
+        rar->stream_position = 0;
+        if (!rar->reader) {
+            return false;
+        }
+    }
+
+    // Move forward to the target, caching the neighbouring pages on the way
+    while (!rar->page_data[index] && rar->stream_position <= target) {
+        struct archive_entry *entry;
+        if (archive_read_next_header(rar->reader, &entry) != ARCHIVE_OK) {
+            fprintf(stderr, "Failed to reach entry in RAR archive: %s\n", handle->entry_names[index]);
+            archive_read_free(rar->reader);
+            rar->reader = NULL;
+            return false;
+        }
+
+        int page = rar->page_by_position[rar->stream_position];
+        rar->stream_position++;
+
+        if (page < 0 || rar->page_data[page] || !in_cache_window(page, index)) {
+            archive_read_data_skip(rar->reader);
+            continue;
+        }
+
+        void *data = NULL;
+        size_t size = 0;
+        if (!read_entry_data(rar->reader, entry, &data, &size)) {
+            // The stream is unusable after a failed read
+            archive_read_free(rar->reader);
+            rar->reader = NULL;
+            return false;
+        }
+
+        rar->page_data[page] = data;
+        rar->page_size[page] = size;
+        rar->cached_bytes += size;
+        trim_page_cache(rar, handle->total_images, index);
+    }
+
+    if (!rar->page_data[index]) {
+        return false;
+    }
+
+    // Hand out a copy, the cached page stays available for the next request
+    void *copy = malloc(rar->page_size[index] > 0 ? rar->page_size[index] : 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, rar->page_data[index], rar->page_size[index]);
+
+    *out_data = copy;
+    *out_size = rar->page_size[index];
+
+    return true;
+}
+
+bool cbr_get_page_size(ArchiveHandle *handle, int index, int *width, int *height) {
+    if (!handle || !width || !height || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+
+    CbrArchive *rar = (CbrArchive*)handle->archive_ptr;
+    if (rar->page_width[index] <= 0 || rar->page_height[index] <= 0) {
+        return false;
+    }
+
+    *width = rar->page_width[index];
+    *height = rar->page_height[index];
+    return true;
+}
+
 bool cbr_get_image(ArchiveHandle *handle, int index, char **out_path) {
     if (!handle || !out_path || index < 0 || index >= handle->total_images) {
         return false;
     }
-    
+
     const char *entry_name = handle->entry_names[index];
 
-    // Construct the output path
-    char output_path[512];
-    snprintf(output_path, sizeof(output_path), "%s/%s", handle->temp_dir, entry_name);
-    
-    // Check if the file already exists
-    if (access(output_path, F_OK) == 0) {
-        // File already exists, no need to extract again
-        *out_path = strdup(output_path);
-        
-        return true;
-    }
-    
-    // Create subdirectories if needed
-    char *dir_part = strdup(output_path);
-    char *last_slash = strrchr(dir_part, '/');
-    if (last_slash) {
-        *last_slash = '\0';
-        char command[1024];
-        snprintf(command, sizeof(command), "mkdir -p \"%s\"", dir_part);
-        system(command);
-    }
-    free(dir_part);
-    
-    // Extract only the requested file using unrar command
-    char *escaped_path = escape_shell_arg(handle->path);
-    char *escaped_temp_dir = escape_shell_arg(handle->temp_dir);
-    char *escaped_entry = escape_shell_arg(entry_name);
-    
-    char cmd[2048];
-    snprintf(cmd, sizeof(cmd), "unrar x -o+ %s %s %s", 
-             escaped_path, escaped_entry, escaped_temp_dir);
-    
-    int extract_result = system(cmd);
-    
-    free(escaped_path);
-    free(escaped_temp_dir);
-    free(escaped_entry);
-    
-    if (extract_result != 0) {
-        fprintf(stderr, "Failed to extract file from RAR archive: %s\n", entry_name);       
-        return false;
+    // Check if the file was already extracted
+    if (handle->temp_dir) {
+        char output_path[512];
+        snprintf(output_path, sizeof(output_path), "%s/%s", handle->temp_dir, entry_name);
+        if (access(output_path, F_OK) == 0) {
+            *out_path = strdup(output_path);
+            return true;
+        }
     }
-    
-    // Check if the file exists after extraction
-    if (access(output_path, F_OK) != 0) {
-        fprintf(stderr, "File not found after extraction: %s\n", entry_name);
-        
+
+    void *data = NULL;
+    size_t size = 0;
+    if (!cbr_get_image_data(handle, index, &data, &size)) {
         return false;
     }
-    
-    *out_path = strdup(output_path);
-    
-    return true;
+
+    bool result = write_temp_file(handle, entry_name, data, size, out_path);
+    free(data);
+
+    return result;
 }
 
 void cbr_close(ArchiveHandle *handle) {
     if (!handle) {
         return;
     }
-    
+
+    // Close the reader and free the page cache
+    CbrArchive *rar = (CbrArchive*)handle->archive_ptr;
+    if (rar) {
+        if (rar->reader) {
+            archive_read_free(rar->reader);
+        }
+        if (rar->page_data) {
+            for (int i = 0; i < handle->total_images; i++) {
+                free(rar->page_data[i]);
+            }
+        }
+        free(rar->page_data);
+        free(rar->page_size);
+        free(rar->page_width);
+        free(rar->page_height);
+        free(rar->position_by_page);
+        free(rar->page_by_position);
+        free(rar);
+    }
+
     // Free entry names
     if (handle->entry_names) {
         for (int i = 0; i < handle->total_images; i++) {
@@ -246,16 +528,13 @@ void cbr_close(ArchiveHandle *handle) {
         }
         free(handle->entry_names);
     }
-    
-    // Clean up temporary directory (if needed)
+
+    // Remove any pages that were extracted to disk
     if (handle->temp_dir) {
-        // Optionally remove temp files
-        // char cmd[512];
-        // snprintf(cmd, sizeof(cmd), "rm -rf \"%s\"", handle->temp_dir);
-        // system(cmd);
+        remove_directory(handle->temp_dir);
         free(handle->temp_dir);
     }
-    
+
     free(handle->path);
     free(handle);
-}
\ No newline at end of file
+}
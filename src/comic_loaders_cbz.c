@@ -10,7 +10,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <zip.h>
+#include <zlib.h>
 #include "comic_loaders.h"
+#include "image_probe.h"
+#include "source_io.h"
+#include "http_source.h"
 
 // External functions from comic_loaders_utils.c
 extern int image_name_compare(const void *a, const void *b);
@@ -19,18 +23,343 @@ extern const char* get_filename_from_path(const char* path);
 // Forward declaration of the ArchiveHandle struct defined in comic_loaders.c
 typedef struct ArchiveHandle ArchiveHandle;
 
+// ZIP record layouts used to find the pages' byte ranges, see PKWARE's APPNOTE.TXT
+#define ZIP_EOCD_SIGNATURE 0x06054b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP_EOCD_SEARCH (ZIP_EOCD_SIZE + 0xFFFF)   // The record ends with a comment of up to 64 KiB
+#define ZIP_CENTRAL_SIGNATURE 0x02014b50
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_LOCAL_SIGNATURE 0x04034b50
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_METHOD_DEFLATE 8
+
+// Compressed bytes read at a time when inflating a page header from an unmapped source
+#define PROBE_READ_CHUNK (16 * 1024)
+
+// Central directory fields of a page, to read it without libzip
+typedef struct ZipPageEntry {
+    Uint32 size;              // Uncompressed
+    Uint32 compressed_size;
+    Uint16 method;            // ZIP_CM_STORE entries can be used in place
+    Uint16 flags;             // General purpose bits
+} ZipPageEntry;
+
+static Uint16 read_le16(const unsigned char *p) {
+    return (Uint16)(p[0] | p[1] << 8);
+}
+
+static Uint32 read_le32(const unsigned char *p) {
+    return (Uint32)p[0] | (Uint32)p[1] << 8 | (Uint32)p[2] << 16 | (Uint32)p[3] << 24;
+}
+
+// libzip source state for an archive read over HTTP
+typedef struct {
+    HttpSource *remote;
+    Uint64 offset;
+    zip_error_t error;
+} RemoteZip;
+
+// Seekable libzip source over the HTTP block cache, libzip then only reads the end of
+// central directory, the central directory and the entries that are opened
+static zip_int64_t remote_zip_callback(void *user, void *data, zip_uint64_t length, zip_source_cmd_t command) {
+    RemoteZip *state = (RemoteZip*)user;
+    Uint64 size = http_source_size(state->remote);
+    
+    switch (command) {
+        case ZIP_SOURCE_OPEN:
+            state->offset = 0;
+            return 0;
+        case ZIP_SOURCE_READ:
+            if (length > size - state->offset) {
+                length = size - state->offset;
+            }
+            if (!http_source_read(state->remote, state->offset, data, (size_t)length)) {
+                zip_error_set(&state->error, ZIP_ER_READ, 0);
+                return -1;
+            }
+            state->offset += length;
+            return (zip_int64_t)length;
+        case ZIP_SOURCE_CLOSE:
+            return 0;
+        case ZIP_SOURCE_STAT: {
+            if (length < sizeof(zip_stat_t)) {
+                zip_error_set(&state->error, ZIP_ER_INVAL, 0);
+                return -1;
+            }
+            zip_stat_t *st = (zip_stat_t*)data;
+            zip_stat_init(st);
+            st->size = size;
+            st->valid |= ZIP_STAT_SIZE;
+            return sizeof(zip_stat_t);
+        }
+        case ZIP_SOURCE_ERROR:
+            return zip_error_to_data(&state->error, data, length);
+        case ZIP_SOURCE_SEEK: {
+            zip_int64_t offset = zip_source_seek_compute_offset(state->offset, size, data, length, &state->error);
+            if (offset < 0) {
+                return -1;
+            }
+            state->offset = (Uint64)offset;
+            return 0;
+        }
+        case ZIP_SOURCE_TELL:
+            return (zip_int64_t)state->offset;
+        case ZIP_SOURCE_FREE:
+            zip_error_fini(&state->error);
+            free(state);
+            return 0;
+        case ZIP_SOURCE_SUPPORTS:
+            return zip_source_make_command_bitmap(ZIP_SOURCE_OPEN, ZIP_SOURCE_READ, ZIP_SOURCE_CLOSE,
+                                                  ZIP_SOURCE_STAT, ZIP_SOURCE_ERROR, ZIP_SOURCE_FREE,
+                                                  ZIP_SOURCE_SEEK, ZIP_SOURCE_TELL, ZIP_SOURCE_SUPPORTS, -1);
+        default:
+            zip_error_set(&state->error, ZIP_ER_OPNOTSUPP, 0);
+            return -1;
+    }
+}
+
+static zip_source_t* remote_zip_source(HttpSource *remote, zip_error_t *error) {
+    RemoteZip *state = calloc(1, sizeof(RemoteZip));
+    if (!state) {
+        zip_error_set(error, ZIP_ER_MEMORY, 0);
+        return NULL;
+    }
+    state->remote = remote;
+    zip_error_init(&state->error);
+    
+    zip_source_t *zip_source = zip_source_function_create(remote_zip_callback, state, error);
+    if (!zip_source) {
+        zip_error_fini(&state->error);
+        free(state);
+    }
+    return zip_source;
+}
+
+// Open the archive through a buffer source over its mapping; file systems that cannot map
+// get a stream with a large buffer instead of libzip's small reads, URLs the HTTP source
+static struct zip* open_zip(const char *path, SourceMap *source, HttpSource *remote) {
+    zip_error_t error;
+    zip_error_init(&error);
+    
+    zip_source_t *zip_source = NULL;
+    if (remote) {
+        zip_source = remote_zip_source(remote, &error);
+    } else if (source_map_open(path, source)) {
+        zip_source = zip_source_buffer_create(source->data, source->size, 0, &error);
+    } else if (source->fd >= 0) {
+        // The stream gets its own descriptor, libzip closes it
+        int fd = dup(source->fd);
+        FILE *stream = fd >= 0 ? fdopen(fd, "rb") : NULL;
+        if (stream) {
+            setvbuf(stream, NULL, _IOFBF, SOURCE_READ_BLOCK);
+            zip_source = zip_source_filep_create(stream, 0, -1, &error);
+            if (!zip_source) fclose(stream);
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    } else {
+        fprintf(stderr, "Failed to open zip file: %s\n", path);
+        zip_error_fini(&error);
+        return NULL;
+    }
+    
+    struct zip *archive = NULL;
+    if (zip_source) {
+        archive = zip_open_from_source(zip_source, ZIP_RDONLY, &error);
+        if (!archive) zip_source_free(zip_source);
+    }
+    if (!archive) {
+        fprintf(stderr, "Failed to open zip file: %s (%s)\n", path, zip_error_strerror(&error));
+    }
+    zip_error_fini(&error);
+    return archive;
+}
+
+// Read from the archive file, mapped or remote
+static bool read_archive(const SourceMap *source, HttpSource *remote, Uint64 offset, void *buffer, size_t length) {
+    if (remote) {
+        return http_source_read(remote, offset, buffer, length);
+    }
+    return source->fd >= 0 && pread(source->fd, buffer, length, (off_t)offset) == (ssize_t)length;
+}
+
+static void close_archive_file(SourceMap *source, HttpSource *remote) {
+    if (source) {
+        source_close(source);
+        free(source);
+    }
+    http_source_close(remote);
+}
+
+// Byte range and storage of every entry from the central directory, in directory order
+// (libzip's index order); NULL when it cannot be read, entries with ZIP64 sizes or offsets
+// get no range (libzip read both already, so for remote archives they come from the block cache)
+static SourceSpan* read_entry_spans(const SourceMap *source, HttpSource *remote, zip_int64_t num_entries,
+                                    ZipPageEntry **out_entries) {
+    Uint64 size = remote ? http_source_size(remote) : source->size;
+    if (size < ZIP_EOCD_SIZE) {
+        return NULL;
+    }
+    
+    size_t tail_size = size < ZIP_EOCD_SEARCH ? (size_t)size : ZIP_EOCD_SEARCH;
+    unsigned char *tail = malloc(tail_size);
+    if (!tail) {
+        return NULL;
+    }
+    if (!read_archive(source, remote, size - tail_size, tail, tail_size)) {
+        free(tail);
+        return NULL;
+    }
+    
+    // The end record is the last signature with room for the record after it
+    const unsigned char *eocd = NULL;
+    for (size_t i = tail_size - ZIP_EOCD_SIZE + 1; i-- > 0;) {
+        if (read_le32(tail + i) == ZIP_EOCD_SIGNATURE) {
+            eocd = tail + i;
+            break;
+        }
+    }
+    if (!eocd) {
+        free(tail);
+        return NULL;
+    }
+    Uint16 entries = read_le16(eocd + 10);
+    Uint32 directory_size = read_le32(eocd + 12);
+    Uint32 directory_offset = read_le32(eocd + 16);
+    free(tail);
+    
+    if (entries != num_entries || (Uint64)directory_offset + directory_size > size) {
+        return NULL;
+    }
+    
+    unsigned char *directory = malloc(directory_size > 0 ? directory_size : 1);
+    SourceSpan *spans = calloc(num_entries, sizeof(SourceSpan));
+    ZipPageEntry *zip_entries = calloc(num_entries, sizeof(ZipPageEntry));
+    if (!directory || !spans || !zip_entries ||
+        !read_archive(source, remote, directory_offset, directory, directory_size)) {
+        free(directory);
+        free(spans);
+        free(zip_entries);
+        return NULL;
+    }
+    
+    size_t pos = 0;
+    for (zip_int64_t i = 0; i < num_entries; i++) {
+        const unsigned char *record = directory + pos;
+        if (pos + ZIP_CENTRAL_SIZE > directory_size || read_le32(record) != ZIP_CENTRAL_SIGNATURE) {
+            free(spans);
+            free(zip_entries);
+            spans = NULL;
+            zip_entries = NULL;
+            break;
+        }
+        
+        Uint32 compressed_size = read_le32(record + 20);
+        Uint16 name_length = read_le16(record + 28);
+        Uint16 extra_length = read_le16(record + 30);
+        Uint16 comment_length = read_le16(record + 32);
+        Uint32 local_offset = read_le32(record + 42);
+        
+        // The local header repeats the name, its extra field is usually the central one
+        if (compressed_size != 0xFFFFFFFF && local_offset != 0xFFFFFFFF) {
+            spans[i].offset = local_offset;
+            spans[i].length = (Uint64)ZIP_LOCAL_SIZE + name_length + extra_length + compressed_size;
+            zip_entries[i].flags = read_le16(record + 8);
+            zip_entries[i].method = read_le16(record + 10);
+            zip_entries[i].compressed_size = compressed_size;
+            zip_entries[i].size = read_le32(record + 24);
+        }
+        pos += ZIP_CENTRAL_SIZE + name_length + extra_length + comment_length;
+    }
+    
+    free(directory);
+    *out_entries = zip_entries;
+    return spans;
+}
+
+// Byte range and storage of each sorted page, for the readahead hints and reading pages in place
+static void read_page_layout(ArchiveHandle *handle, struct zip *zip_file, int count) {
+    zip_int64_t num_entries = zip_get_num_entries(zip_file, 0);
+    ZipPageEntry *entry_info = NULL;
+    SourceSpan *entry_spans = read_entry_spans(handle->source, handle->remote, num_entries, &entry_info);
+    if (!entry_spans) {
+        return;
+    }
+    
+    SourceSpan *spans = calloc(count, sizeof(SourceSpan));
+    ZipPageEntry *entries = calloc(count, sizeof(ZipPageEntry));
+    if (spans && entries) {
+        for (int i = 0; i < count; i++) {
+            zip_int64_t entry = zip_name_locate(zip_file, handle->entry_names[i], 0);
+            if (entry >= 0 && entry < num_entries) {
+                spans[i] = entry_spans[entry];
+                entries[i] = entry_info[entry];
+            }
+        }
+        handle->page_spans = spans;
+        handle->page_entries = entries;
+    } else {
+        free(spans);
+        free(entries);
+    }
+    free(entry_spans);
+    free(entry_info);
+}
+
+// Offset of a page's data, past the local header whose extra field may differ from the central one
+static bool page_data_offset(ArchiveHandle *handle, int index, Uint64 *out_offset) {
+    SourceSpan span = handle->page_spans[index];
+    if (span.length == 0) {
+        return false;
+    }
+    
+    Uint64 size = handle->remote ? http_source_size(handle->remote) : handle->source->size;
+    unsigned char local[ZIP_LOCAL_SIZE];
+    if (span.offset + ZIP_LOCAL_SIZE > size) {
+        return false;
+    }
+    if (handle->source && handle->source->data) {
+        memcpy(local, (const unsigned char*)handle->source->data + span.offset, ZIP_LOCAL_SIZE);
+    } else if (!read_archive(handle->source, handle->remote, span.offset, local, ZIP_LOCAL_SIZE)) {
+        return false;
+    }
+    if (read_le32(local) != ZIP_LOCAL_SIGNATURE) {
+        return false;
+    }
+    
+    Uint64 offset = span.offset + ZIP_LOCAL_SIZE + read_le16(local + 26) + read_le16(local + 28);
+    if (offset + handle->page_entries[index].compressed_size > size) {
+        return false;
+    }
+    *out_offset = offset;
+    return true;
+}
+
 ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback progress_cb) {
     if (progress_cb) {
         progress_cb(0.0f, "Opening ZIP archive...");
     }
     
-    struct zip *zip_file;
-    int err;
+    // Local archives are mapped, URLs read with range requests
+    SourceMap *source = NULL;
+    HttpSource *remote = NULL;
+    if (http_source_is_url(path)) {
+        remote = http_source_open(path);
+        if (!remote) {
+            return NULL;
+        }
+    } else {
+        source = malloc(sizeof(SourceMap));
+        if (!source) {
+            return NULL;
+        }
+    }
     
     // Open the zip file
-    zip_file = zip_open(path, 0, &err);
+    struct zip *zip_file = open_zip(path, source, remote);
     if (!zip_file) {
-        fprintf(stderr, "Failed to open zip file: %s (error %d)\n", path, err);
+        close_archive_file(source, remote);
         return NULL;
     }
     
@@ -38,19 +367,7 @@ ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback pr
     zip_int64_t num_entries = zip_get_num_entries(zip_file, 0);
     if (num_entries <= 0) {
         zip_close(zip_file);
-        return NULL;
-    }
-    
-    if (progress_cb) {
-        progress_cb(0.1f, "Creating temporary directory...");
-    }
-    
-    // Create a temporary directory for extraction
-    char temp_dir[256];
-    snprintf(temp_dir, sizeof(temp_dir), "/tmp/ic_viewer_XXXXXX");
-    if (mkdtemp(temp_dir) == NULL) {
-        fprintf(stderr, "Failed to create temporary directory\n");
-        zip_close(zip_file);
+        close_archive_file(source, remote);
         return NULL;
     }
     
@@ -63,6 +380,7 @@ ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback pr
     ArchiveHandle *handle = (ArchiveHandle*)malloc(sizeof(ArchiveHandle));
     if (!handle) {
         zip_close(zip_file);
+        close_archive_file(source, remote);
         return NULL;
     }
     
@@ -70,10 +388,15 @@ ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback pr
     handle->type = ARCHIVE_TYPE_CBZ;
     handle->path = strdup(path);
     handle->archive_ptr = zip_file;
-    handle->temp_dir = strdup(temp_dir);
+    handle->temp_dir = NULL;  // Only created if a page is requested as a file
     handle->total_images = 0;
     handle->entry_names = NULL;
     handle->page_indices = NULL;
+    handle->lock = NULL;
+    handle->source = source;
+    handle->remote = remote;
+    handle->page_spans = NULL;
+    handle->page_entries = NULL;
     
     // First pass - count image files and collect names
     char **image_entries = (char**)malloc(num_entries * sizeof(char*));
@@ -113,6 +436,7 @@ ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback pr
     // Store the count and entries in the handle
     handle->total_images = count;
     handle->entry_names = image_entries;
+    read_page_layout(handle, zip_file, count);
     
     *total_images = count;
     
@@ -123,77 +447,217 @@ ArchiveHandle* cbz_open(const char *path, int *total_images, ProgressCallback pr
     return handle;
 }
 
-bool cbz_get_image(ArchiveHandle *handle, int index, char **out_path) {
-    if (!handle || !out_path || index < 0 || index >= handle->total_images) {
+bool cbz_map_image_data(ArchiveHandle *handle, int index, const void **out_data, size_t *out_size) {
+    if (!handle || !out_data || !out_size || index < 0 || index >= handle->total_images ||
+        !handle->source || !handle->source->data || !handle->page_entries) {
+        return false;
+    }
+    
+    // Only stored, unencrypted entries are the image bytes as they are in the archive
+    const ZipPageEntry *entry = &handle->page_entries[index];
+    Uint64 offset;
+    if (entry->method != ZIP_CM_STORE || (entry->flags & ZIP_FLAG_ENCRYPTED) ||
+        entry->size != entry->compressed_size || !page_data_offset(handle, index, &offset)) {
+        return false;
+    }
+    
+    *out_data = (const char*)handle->source->data + offset;
+    *out_size = entry->size;
+    return true;
+}
+
+bool cbz_get_image_data(ArchiveHandle *handle, int index, void **out_data, size_t *out_size) {
+    if (!handle || !out_data || !out_size || index < 0 || index >= handle->total_images) {
         return false;
     }
     
     // Get the ZIP handle from the archive handle
     struct zip *zip_archive = (struct zip*)handle->archive_ptr;
     const char *entry_name = handle->entry_names[index];
-     
-    // Construct the output path
-    char output_path[512];
-    snprintf(output_path, sizeof(output_path), "%s/%s", handle->temp_dir, entry_name);
-    
-    // Check if the file already exists
-    if (access(output_path, F_OK) == 0) {
-        // File already exists, no need to extract again
-        *out_path = strdup(output_path);
-        
-        return true;
+    
+    // The uncompressed size lets us read the entry in one call into its final buffer
+    struct zip_stat st;
+    if (zip_stat(zip_archive, entry_name, 0, &st) != 0 || !(st.valid & ZIP_STAT_SIZE)) {
+        fprintf(stderr, "Failed to stat file in ZIP archive: %s\n", entry_name);
+        return false;
     }
     
-    // Create subdirectories if needed
-    char *dir_part = strdup(output_path);
-    char *last_slash = strrchr(dir_part, '/');
-    if (last_slash) {
-        *last_slash = '\0';
-        char command[1024];
-        snprintf(command, sizeof(command), "mkdir -p \"%s\"", dir_part);
-        system(command);
+    void *data = malloc(st.size > 0 ? st.size : 1);
+    if (!data) {
+        fprintf(stderr, "Failed to allocate %llu bytes for %s\n", (unsigned long long)st.size, entry_name);
+        return false;
     }
-    free(dir_part);
     
     // Open the file in the archive
     struct zip_file *zip_file = zip_fopen(zip_archive, entry_name, 0);
     if (!zip_file) {
         fprintf(stderr, "Failed to open file in ZIP archive: %s\n", entry_name);
-        
+        free(data);
         return false;
     }
     
-    // Create the output file
-    FILE *out_file = fopen(output_path, "wb");
-    if (!out_file) {
-        fprintf(stderr, "Failed to create output file: %s\n", output_path);
-        zip_fclose(zip_file);
-        
+    // Read into the final buffer in as few calls as libzip allows
+    zip_uint64_t total = 0;
+    while (total < st.size) {
+        zip_int64_t bytes_read = zip_fread(zip_file, (char*)data + total, st.size - total);
+        if (bytes_read <= 0) {
+            break;
+        }
+        total += bytes_read;
+    }
+    zip_fclose(zip_file);
+    
+    if (total != st.size) {
+        fprintf(stderr, "Error reading from ZIP archive: %s\n", entry_name);
+        free(data);
         return false;
     }
     
-    // Copy data from zip to file
-    char buffer[8192];
-    zip_int64_t bytes_read;
+    *out_data = data;
+    *out_size = st.size;
     
-    while ((bytes_read = zip_fread(zip_file, buffer, sizeof(buffer))) > 0) {
-        fwrite(buffer, 1, bytes_read, out_file);
+    return true;
+}
+
+// Inflate the start of a deflated page into header, reading the archive directly
+static bool inflate_page_header(ArchiveHandle *handle, Uint64 offset, Uint32 compressed_size,
+                                unsigned char *header, size_t *out_length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
     }
     
-    // Close files
-    fclose(out_file);
-    zip_fclose(zip_file);
+    const unsigned char *mapped = handle->source && handle->source->data
+        ? (const unsigned char*)handle->source->data + offset : NULL;
+    unsigned char chunk[PROBE_READ_CHUNK];
+    stream.next_out = header;
+    stream.avail_out = IMAGE_PROBE_HEADER_SIZE;
     
-    // Check for read errors
-    if (bytes_read < 0) {
-        fprintf(stderr, "Error reading from ZIP archive\n");
-        
+    // Only as much input is read as the header needs
+    Uint32 consumed = 0;
+    int status = Z_OK;
+    while (status == Z_OK && stream.avail_out > 0 && consumed < compressed_size) {
+        Uint32 length = compressed_size - consumed;
+        if (mapped) {
+            stream.next_in = (Bytef*)(mapped + consumed);
+        } else {
+            if (length > PROBE_READ_CHUNK) length = PROBE_READ_CHUNK;
+            if (!read_archive(handle->source, handle->remote, offset + consumed, chunk, length)) {
+                status = Z_DATA_ERROR;
+                break;
+            }
+            stream.next_in = chunk;
+        }
+        stream.avail_in = length;
+        status = inflate(&stream, Z_NO_FLUSH);
+        consumed += length - stream.avail_in;
+    }
+    
+    *out_length = IMAGE_PROBE_HEADER_SIZE - stream.avail_out;
+    inflateEnd(&stream);
+    return status == Z_OK || status == Z_STREAM_END;
+}
+
+// First IMAGE_PROBE_HEADER_SIZE bytes of a page without libzip, from the central directory
+// fields and the local header; false when the page has to go through libzip
+static bool read_page_header(ArchiveHandle *handle, int index, unsigned char *header, size_t *out_length) {
+    if (!handle->page_entries) {
         return false;
     }
     
-    *out_path = strdup(output_path);
+    const ZipPageEntry *entry = &handle->page_entries[index];
+    Uint64 offset;
+    if ((entry->flags & ZIP_FLAG_ENCRYPTED) || !page_data_offset(handle, index, &offset)) {
+        return false;
+    }
     
-    return true;
+    if (entry->method == ZIP_CM_STORE) {
+        size_t length = entry->compressed_size < IMAGE_PROBE_HEADER_SIZE ? entry->compressed_size : IMAGE_PROBE_HEADER_SIZE;
+        if (handle->source && handle->source->data) {
+            memcpy(header, (const char*)handle->source->data + offset, length);
+        } else if (!read_archive(handle->source, handle->remote, offset, header, length)) {
+            return false;
+        }
+        *out_length = length;
+        return true;
+    }
+    if (entry->method == ZIP_METHOD_DEFLATE) {
+        return inflate_page_header(handle, offset, entry->compressed_size, header, out_length);
+    }
+    return false;
+}
+
+bool cbz_get_page_size(ArchiveHandle *handle, int index, int *width, int *height) {
+    if (!handle || !width || !height || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+    
+    unsigned char *header = malloc(IMAGE_PROBE_HEADER_SIZE);
+    if (!header) {
+        return false;
+    }
+    
+    // Probes run on low priority threads, so they only take the handle lock (and wait behind
+    // page decodes holding it) for pages the archive cannot be read around libzip for
+    size_t total = 0;
+    if (!read_page_header(handle, index, header, &total)) {
+        total = 0;
+        SDL_LockMutex(handle->lock);
+        struct zip_file *zip_file = zip_fopen((struct zip*)handle->archive_ptr, handle->entry_names[index], 0);
+        if (zip_file) {
+            // Only the first bytes are inflated, the size is in the image header
+            while (total < IMAGE_PROBE_HEADER_SIZE) {
+                zip_int64_t bytes_read = zip_fread(zip_file, header + total, IMAGE_PROBE_HEADER_SIZE - total);
+                if (bytes_read <= 0) {
+                    break;
+                }
+                total += (size_t)bytes_read;
+            }
+            zip_fclose(zip_file);
+        }
+        SDL_UnlockMutex(handle->lock);
+    }
+    
+    bool found = total > 0 && image_probe_size(header, total, width, height);
+    free(header);
+    
+    return found;
+}
+
+bool cbz_get_image(ArchiveHandle *handle, int index, char **out_path) {
+    if (!handle || !out_path || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+    
+    const char *entry_name = handle->entry_names[index];
+    
+    // Check if the file was already extracted
+    if (handle->temp_dir) {
+        char output_path[512];
+        snprintf(output_path, sizeof(output_path), "%s/%s", handle->temp_dir, entry_name);
+        if (access(output_path, F_OK) == 0) {
+            *out_path = strdup(output_path);
+            return true;
+        }
+    }
+    
+    // Stored pages are written straight from the mapping
+    const void *mapped = NULL;
+    size_t size = 0;
+    if (cbz_map_image_data(handle, index, &mapped, &size)) {
+        return write_temp_file(handle, entry_name, mapped, size, out_path);
+    }
+    
+    void *data = NULL;
+    if (!cbz_get_image_data(handle, index, &data, &size)) {
+        return false;
+    }
+    
+    bool result = write_temp_file(handle, entry_name, data, size, out_path);
+    free(data);
+    
+    return result;
 }
 
 void cbz_close(ArchiveHandle *handle) {
@@ -207,6 +671,11 @@ void cbz_close(ArchiveHandle *handle) {
         zip_close(zip_file);
     }
     
+    // Neither the buffer nor the remote source own the file they read
+    close_archive_file(handle->source, handle->remote);
+    free(handle->page_spans);
+    free(handle->page_entries);
+    
     // Free entry names
     if (handle->entry_names) {
         for (int i = 0; i < handle->total_images; i++) {
@@ -215,12 +684,9 @@ void cbz_close(ArchiveHandle *handle) {
         free(handle->entry_names);
     }
     
-    // Clean up temporary directory (if needed)
+    // Remove any pages that were extracted to disk
     if (handle->temp_dir) {
-        // Optionally remove temp files
-        // char cmd[512];
-        // snprintf(cmd, sizeof(cmd), "rm -rf \"%s\"", handle->temp_dir);
-        // system(cmd);
+        remove_directory(handle->temp_dir);
         free(handle->temp_dir);
     }
     
@@ -6,53 +6,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include "comic_loaders.h"
+#include "directory_index.h"
 
-// External functions from comic_loaders_utils.c
-extern int image_name_compare(const void *a, const void *b);
-extern const char* get_filename_from_path(const char* path);
-
-bool load_directory(const char *path, ImageEntry *images, int *image_count, int max_images, ProgressCallback progress_cb) {
+bool load_directory(const char *path, ImageEntry **images, int *image_count, ProgressCallback progress_cb) {
     if (progress_cb) {
         progress_cb(0.0f, "Scanning directory...");
     }
     
-    DIR *dir;
-    struct dirent *entry;
-    char *image_paths[max_images];
+    // The index reads the start of the directory, the rest streams in after the first page
+    char **image_paths = NULL;
     int count = 0;
-    
-    // Open the directory
-    dir = opendir(path);
-    if (!dir) {
-        fprintf(stderr, "Failed to open directory: %s\n", path);
-        return false;
-    }
-    
-    // First pass: collect image paths
-    while ((entry = readdir(dir)) != NULL && count < max_images) {
-        if (entry->d_type == DT_REG && is_image_file(entry->d_name)) {
-            char *full_path = malloc(strlen(path) + strlen(entry->d_name) + 2); // +2 for '/' and null terminator
-            if (!full_path) continue;
-            
-            sprintf(full_path, "%s/%s", path, entry->d_name);
-            image_paths[count++] = full_path;
-            
-            // Update progress while scanning
-            if (progress_cb && count % 5 == 0) {  // Update every 5 images to avoid too frequent updates
-                char msg[256];
-                snprintf(msg, sizeof(msg), "Found %d images...", count);
-                progress_cb(0.5f, msg);  // Use 0.5 as we're in the scanning phase
-            }
-        }
-    }
-    
-    closedir(dir);
-    
-    if (count == 0) {
+    if (!directory_index_open(path, &image_paths, &count)) {
         if (progress_cb) {
             progress_cb(1.0f, "No images found");
         }
@@ -60,23 +25,27 @@ bool load_directory(const char *path, ImageEntry *images, int *image_count, int
     }
     
     if (progress_cb) {
-        progress_cb(0.7f, "Sorting images...");
+        progress_cb(0.9f, "Preparing image data...");
     }
     
-    // Sort images by name
-    qsort(image_paths, count, sizeof(char *), image_name_compare);
-    
-    if (progress_cb) {
-        progress_cb(0.9f, "Preparing image data...");
+    ImageEntry *entries = calloc(count, sizeof(ImageEntry));
+    if (!entries) {
+        fprintf(stderr, "Failed to allocate memory for %d images\n", count);
+        for (int i = 0; i < count; i++) {
+            free(image_paths[i]);
+        }
+        free(image_paths);
+        directory_index_close();
+        return false;
     }
     
-    // Store sorted images
+    // Store sorted images, the other fields start zeroed
     for (int i = 0; i < count; i++) {
-        images[i].path = image_paths[i];
-        images[i].surface = NULL;  // Initialize surface to NULL
-        images[i].texture = NULL;
+        entries[i].path = image_paths[i];
     }
+    free(image_paths);
     
+    *images = entries;
     *image_count = count;
     
     if (progress_cb) {
@@ -84,4 +53,4 @@ bool load_directory(const char *path, ImageEntry *images, int *image_count, int
     }
     
     return count > 0;
-}
\ No newline at end of file
+}
@@ -1,120 +1,311 @@
 /**
  * comic_loaders_pdf.c
- * Implementation of PDF comic loading using pdfimages command-line tool
- * Simple version without threading - loads pages sequentially
+ * Implementation of PDF comic loading using MuPDF
+ *
+ * The document stays open for the lifetime of the handle. MuPDF documents are not
+ * thread safe, so each decode worker borrows its own session (a cloned context with
+ * its own open document) and pages are rasterized straight into SDL surfaces.
+ * URLs are read through one HTTP source whose block cache the sessions share.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include <unistd.h>
-#include <dirent.h>
+#include <mupdf/fitz.h>
 #include "comic_loaders.h"
+#include "decode_pool.h"
+#include "page_pool.h"
+#include "http_source.h"
 
-// External functions from comic_loaders_utils.c
-extern int image_name_compare(const void *a, const void *b);
-extern const char* get_filename_from_path(const char* path);
-
-const int PDF_PIXEL_DENSITY = 120; // DPI for PDF rendering
-
-// Get PDF page count using pdfinfo (part of poppler-utils)
-static int get_pdf_page_count(const char *path) {
-    char *escaped_path = escape_shell_arg(path);
-    char cmd[1024];
-    
-    // Use pdfinfo to get page count
-    snprintf(cmd, sizeof(cmd), "pdfinfo %s | grep Pages | awk '{print $2}'", escaped_path);
-    
-    FILE *fp = popen(cmd, "r");
-    if (fp == NULL) {
-        free(escaped_path);
-        return -1;
-    }
-    
-    char line[128];
-    int n_pages = 0;
-    
-    if (fgets(line, sizeof(line), fp)) {
-        sscanf(line, "%d", &n_pages);
-    }
-    
-    pclose(fp);
-    free(escaped_path);
-    
-    return n_pages;
+// Height used when a page is requested as a file instead of a surface
+#define PDF_FALLBACK_HEIGHT 2048
+
+// Upper bound on rendered page height, protects against absurd page boxes
+#define PDF_MAX_RENDER_HEIGHT 16384
+
+#define PDF_MAX_SESSIONS MAX_DECODE_THREADS
+
+// Bytes a remote document stream asks the HTTP source for at a time
+#define PDF_STREAM_BUFFER (64 << 10)
+
+// A context and document pair usable by one thread at a time
+typedef struct {
+    fz_context *ctx;
+    fz_document *doc;
+    bool busy;
+} PdfSession;
+
+// State stored in ArchiveHandle::archive_ptr
+typedef struct {
+    fz_context *ctx;                        // Base context, only used to clone sessions
+    SDL_Mutex *fz_locks[FZ_LOCK_MAX];       // Locks MuPDF uses for its shared caches
+    SDL_Mutex *session_lock;
+    SDL_Condition *session_available;
+    PdfSession sessions[PDF_MAX_SESSIONS];
+    int session_count;
+    int sessions_opening;                   // Reserved slots being opened outside session_lock
+    HttpSource *remote;                     // Document read over HTTP, NULL for local files
+} PdfDocument;
+
+// MuPDF stream over a remote document, one per session
+typedef struct {
+    HttpSource *remote;
+    unsigned char buffer[PDF_STREAM_BUFFER];
+} RemoteStream;
+
+static void pdf_lock(void *user, int lock) {
+    PdfDocument *pdf = (PdfDocument*)user;
+    SDL_LockMutex(pdf->fz_locks[lock]);
 }
 
-// Extract a single page from PDF using pdfimages
-static char* extract_pdf_page(const char *pdf_path, int page_index, const char *output_prefix, const char *expected_path, bool *success) {
-    char *escaped_pdf_path = escape_shell_arg(pdf_path);
-    char *escaped_output_prefix = escape_shell_arg(output_prefix);
-
-    char cmd[2048];
-
-    // old version
-    // snprintf(cmd, sizeof(cmd),
-    //          "pdfimages -all -f %d -l %d \"%s\" %s",
-    //          page_index + 1, page_index + 1,
-    //          pdf_path, output_prefix);
-    // new version
-    // Create command to render a single page using pdftoppm
-    snprintf(cmd, sizeof(cmd), 
-             "pdftoppm -r %d -f %d -l %d -jpeg \"%s\" %s",
-             PDF_PIXEL_DENSITY, page_index + 1, page_index + 1,
-             pdf_path, output_prefix);
-
-    // Execute the command
-    int result = system(cmd);
-
-    free(escaped_pdf_path);
-    free(escaped_output_prefix);
-   
-    // Check if the file exists
-    if (access(expected_path, F_OK) != 0) {
-        *success = false;
-        return NULL;
+static void pdf_unlock(void *user, int lock) {
+    PdfDocument *pdf = (PdfDocument*)user;
+    SDL_UnlockMutex(pdf->fz_locks[lock]);
+}
+
+static int remote_next(fz_context *ctx, fz_stream *stm, size_t max) {
+    (void)max;
+    RemoteStream *state = (RemoteStream*)stm->state;
+    Uint64 size = http_source_size(state->remote);
+    if ((Uint64)stm->pos >= size) {
+        return EOF;
+    }
+
+    size_t length = size - stm->pos < PDF_STREAM_BUFFER ? (size_t)(size - stm->pos) : PDF_STREAM_BUFFER;
+    if (!http_source_read(state->remote, (Uint64)stm->pos, state->buffer, length)) {
+        fz_throw(ctx, FZ_ERROR_GENERIC, "cannot read remote document");
+    }
+    stm->rp = state->buffer;
+    stm->wp = state->buffer + length;
+    stm->pos += length;
+    return *stm->rp++;
+}
+
+// MuPDF turns SEEK_CUR into SEEK_SET before calling this
+static void remote_seek(fz_context *ctx, fz_stream *stm, int64_t offset, int whence) {
+    (void)ctx;
+    RemoteStream *state = (RemoteStream*)stm->state;
+    int64_t size = (int64_t)http_source_size(state->remote);
+    int64_t target = whence == SEEK_END ? size + offset : offset;
+    if (target < 0) target = 0;
+    if (target > size) target = size;
+
+    stm->pos = target;
+    stm->rp = stm->wp = state->buffer;
+}
+
+static void remote_drop(fz_context *ctx, void *state) {
+    fz_free(ctx, state);
+}
+
+// Open a document from the HTTP source, throws on failure
+static fz_document* open_remote_document(fz_context *ctx, HttpSource *remote) {
+    RemoteStream *state = fz_malloc_struct(ctx, RemoteStream);
+    state->remote = remote;
+
+    // The stream drops the state if it cannot be created
+    fz_stream *stream = fz_new_stream(ctx, state, remote_next, remote_drop);
+    stream->seek = remote_seek;
+
+    fz_document *doc = NULL;
+    fz_var(doc);
+    fz_try(ctx) {
+        doc = fz_open_document_with_stream(ctx, "application/pdf", stream);
+    }
+    fz_always(ctx) {
+        fz_drop_stream(ctx, stream);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+    return doc;
+}
+
+// Open a new session on the document, returns false on failure
+static bool open_session(PdfDocument *pdf, const char *path, PdfSession *session) {
+    fz_context *ctx = fz_clone_context(pdf->ctx);
+    if (!ctx) {
+        return false;
     }
 
-    *success = true;
-    return strdup(expected_path);
+    fz_document *doc = NULL;
+    fz_var(doc);
+    fz_try(ctx) {
+        doc = pdf->remote ? open_remote_document(ctx, pdf->remote) : fz_open_document(ctx, path);
+    }
+    fz_catch(ctx) {
+        fprintf(stderr, "Failed to open PDF document %s: %s\n", path, fz_caught_message(ctx));
+        fz_drop_context(ctx);
+        return false;
+    }
+
+    session->ctx = ctx;
+    session->doc = doc;
+    session->busy = false;
+    return true;
+}
+
+// Borrow an idle session, opening a new one if every session is busy
+// Opening clones the context and reopens the document, so it runs without session_lock; when
+// it fails the worker waits for a session to be released, NULL only if there is none at all
+static PdfSession* acquire_session(ArchiveHandle *handle) {
+    PdfDocument *pdf = (PdfDocument*)handle->archive_ptr;
+    PdfSession *session = NULL;
+    bool open_failed = false;
+
+    SDL_LockMutex(pdf->session_lock);
+    while (!session) {
+        for (int i = 0; i < pdf->session_count; i++) {
+            if (!pdf->sessions[i].busy) {
+                session = &pdf->sessions[i];
+                break;
+            }
+        }
+        if (session) {
+            break;
+        }
+
+        if (!open_failed && pdf->session_count + pdf->sessions_opening < PDF_MAX_SESSIONS) {
+            pdf->sessions_opening++;
+            SDL_UnlockMutex(pdf->session_lock);
+            PdfSession opened;
+            bool ok = open_session(pdf, handle->path, &opened);
+            SDL_LockMutex(pdf->session_lock);
+            pdf->sessions_opening--;
+
+            // Sessions are only appended, so the ones lent out keep their address
+            if (ok) {
+                session = &pdf->sessions[pdf->session_count++];
+                *session = opened;
+            } else {
+                open_failed = true;
+                SDL_BroadcastCondition(pdf->session_available);
+            }
+            continue;
+        }
+
+        // Nobody holds or is opening a session that could be released to us
+        if (pdf->session_count == 0 && pdf->sessions_opening == 0) {
+            break;
+        }
+        SDL_WaitCondition(pdf->session_available, pdf->session_lock);
+    }
+    if (session) {
+        session->busy = true;
+    }
+    SDL_UnlockMutex(pdf->session_lock);
+
+    return session;
+}
+
+static void release_session(ArchiveHandle *handle, PdfSession *session) {
+    PdfDocument *pdf = (PdfDocument*)handle->archive_ptr;
+
+    SDL_LockMutex(pdf->session_lock);
+    session->busy = false;
+    SDL_SignalCondition(pdf->session_available);
+    SDL_UnlockMutex(pdf->session_lock);
+}
+
+// Free the sessions, locks and base context of a document
+static void free_pdf_document(PdfDocument *pdf) {
+    if (!pdf) {
+        return;
+    }
+
+    for (int i = 0; i < pdf->session_count; i++) {
+        fz_drop_document(pdf->sessions[i].ctx, pdf->sessions[i].doc);
+        fz_drop_context(pdf->sessions[i].ctx);
+    }
+    if (pdf->ctx) {
+        fz_drop_context(pdf->ctx);
+    }
+    http_source_close(pdf->remote);
+    for (int i = 0; i < FZ_LOCK_MAX; i++) {
+        if (pdf->fz_locks[i]) {
+            SDL_DestroyMutex(pdf->fz_locks[i]);
+        }
+    }
+    if (pdf->session_available) {
+        SDL_DestroyCondition(pdf->session_available);
+    }
+    if (pdf->session_lock) {
+        SDL_DestroyMutex(pdf->session_lock);
+    }
+    free(pdf);
 }
 
 ArchiveHandle* pdf_open(const char *path, int *total_images, ProgressCallback progress_cb) {
     if (progress_cb) {
         progress_cb(0.0f, "Opening PDF document...");
-    }    
-   
-    if (progress_cb) {
-        progress_cb(0.1f, "Reading PDF document info...");
-    }
-    
-    // Create temp directory for images
-    char temp_dir[256];
-    snprintf(temp_dir, sizeof(temp_dir), "/tmp/ic_viewer_pdf_XXXXXX");
-    if (mkdtemp(temp_dir) == NULL) {
-        fprintf(stderr, "Failed to create temporary directory\n");
+    }
+
+    PdfDocument *pdf = (PdfDocument*)calloc(1, sizeof(PdfDocument));
+    if (!pdf) {
         if (progress_cb) {
-            progress_cb(1.0f, "Failed to create temporary directory");
+            progress_cb(1.0f, "Memory allocation failed");
         }
         return NULL;
     }
-    
+
+    bool locks_created = true;
+    for (int i = 0; i < FZ_LOCK_MAX; i++) {
+        pdf->fz_locks[i] = SDL_CreateMutex();
+        locks_created = locks_created && pdf->fz_locks[i];
+    }
+    pdf->session_lock = SDL_CreateMutex();
+    pdf->session_available = SDL_CreateCondition();
+    if (!locks_created || !pdf->session_lock || !pdf->session_available) {
+        fprintf(stderr, "Failed to create PDF locks: %s\n", SDL_GetError());
+        free_pdf_document(pdf);
+        return NULL;
+    }
+
+    fz_locks_context locks = { pdf, pdf_lock, pdf_unlock };
+    pdf->ctx = fz_new_context(NULL, &locks, FZ_STORE_DEFAULT);
+    if (!pdf->ctx) {
+        fprintf(stderr, "Failed to create MuPDF context\n");
+        free_pdf_document(pdf);
+        return NULL;
+    }
+    fz_register_document_handlers(pdf->ctx);
+
+    // Every session reads a URL through the same block cache
+    if (http_source_is_url(path)) {
+        pdf->remote = http_source_open(path);
+        if (!pdf->remote) {
+            free_pdf_document(pdf);
+            return NULL;
+        }
+    }
+
     if (progress_cb) {
         progress_cb(0.2f, "Getting page count from the PDF...");
     }
-    // Get number of pages using pdfinfo
-    int n_pages = get_pdf_page_count(path);
-    
+
+    // The first session is opened right away, it also gives us the page count
+    int n_pages = 0;
+    if (open_session(pdf, path, &pdf->sessions[0])) {
+        pdf->session_count = 1;
+        PdfSession *session = &pdf->sessions[0];
+        fz_try(session->ctx) {
+            n_pages = fz_count_pages(session->ctx, session->doc);
+        }
+        fz_catch(session->ctx) {
+            n_pages = 0;
+        }
+    }
+
     if (n_pages <= 0) {
         fprintf(stderr, "PDF document has no pages or could not determine page count\n");
         if (progress_cb) {
             progress_cb(1.0f, "PDF document has no pages or could not determine page count");
         }
+        free_pdf_document(pdf);
         return NULL;
     }
-    
+
     if (progress_cb) {
         progress_cb(0.6f, "Allocating memory for page indices...");
     }
@@ -125,70 +316,191 @@ ArchiveHandle* pdf_open(const char *path, int *total_images, ProgressCallback pr
         if (progress_cb) {
             progress_cb(1.0f, "Memory allocation failed");
         }
+        free_pdf_document(pdf);
         return NULL;
     }
-    
+
     // Initialize handle
     handle->type = ARCHIVE_TYPE_PDF;
     handle->path = strdup(path);
-    handle->archive_ptr = NULL;
-    handle->temp_dir = strdup(temp_dir);
+    handle->archive_ptr = pdf;
+    handle->temp_dir = NULL;  // Only created if a page is requested as a file
     handle->total_images = n_pages;
     handle->entry_names = NULL;
-    
+    handle->lock = NULL;
+    handle->source = NULL;
+    handle->remote = NULL;
+    handle->page_spans = NULL;
+    handle->page_entries = NULL;
+
     // Set up page indices (1 to 1 mapping for PDF)
     handle->page_indices = (int*)malloc(n_pages * sizeof(int));
     for (int i = 0; i < n_pages; i++) {
         handle->page_indices[i] = i;
     }
-    
+
     *total_images = n_pages;
-    
+
     if (progress_cb) {
         char msg[256];
         snprintf(msg, sizeof(msg), "PDF loaded with %d pages", n_pages);
         progress_cb(1.0f, msg);
     }
-    
+
     return handle;
 }
 
+bool pdf_render_page(ArchiveHandle *handle, int index, int target_height, SDL_Surface **out_surface) {
+    if (!handle || !out_surface || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+
+    if (target_height <= 0) {
+        target_height = PDF_FALLBACK_HEIGHT;
+    }
+    if (target_height > PDF_MAX_RENDER_HEIGHT) {
+        target_height = PDF_MAX_RENDER_HEIGHT;
+    }
+
+    PdfSession *session = acquire_session(handle);
+    if (!session) {
+        return false;
+    }
+
+    fz_context *ctx = session->ctx;
+    fz_page *page = NULL;
+    fz_pixmap *pixmap = NULL;
+    fz_device *device = NULL;
+    SDL_Surface *surface = NULL;
+    bool success = false;
+
+    fz_var(page);
+    fz_var(pixmap);
+    fz_var(device);
+    fz_var(surface);
+    fz_var(success);
+
+    fz_try(ctx) {
+        page = fz_load_page(ctx, session->doc, handle->page_indices[index]);
+        fz_rect bounds = fz_bound_page(ctx, page);
+        float page_width = bounds.x1 - bounds.x0;
+        float page_height = bounds.y1 - bounds.y0;
+
+        if (page_width > 0 && page_height > 0) {
+            // Scale the page to the display height instead of a fixed DPI
+            float scale = (float)target_height / page_height;
+            int width = (int)(page_width * scale + 0.5f);
+            int height = target_height;
+            if (width < 1) width = 1;
+
+            surface = page_pool_acquire_surface(width, height, SDL_PIXELFORMAT_RGBA32);
+            if (surface) {
+                // MuPDF draws directly into the surface pixels
+                pixmap = fz_new_pixmap_with_data(ctx, fz_device_rgb(ctx), width, height, NULL, 1,
+                                                 surface->pitch, (unsigned char*)surface->pixels);
+                fz_clear_pixmap_with_value(ctx, pixmap, 0xff);
+
+                fz_matrix transform = fz_pre_translate(fz_scale(scale, scale), -bounds.x0, -bounds.y0);
+                device = fz_new_draw_device(ctx, fz_identity, pixmap);
+                fz_run_page(ctx, page, device, transform, NULL);
+                fz_close_device(ctx, device);
+                success = true;
+            }
+        }
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, device);
+        fz_drop_pixmap(ctx, pixmap);
+        fz_drop_page(ctx, page);
+    }
+    fz_catch(ctx) {
+        fprintf(stderr, "Failed to render PDF page %d: %s\n", index + 1, fz_caught_message(ctx));
+        success = false;
+    }
+
+    release_session(handle, session);
+
+    if (!success) {
+        page_pool_release_surface(surface);
+        return false;
+    }
+
+    *out_surface = surface;
+    return true;
+}
+
+bool pdf_get_page_size(ArchiveHandle *handle, int index, int *width, int *height) {
+    if (!handle || !width || !height || index < 0 || index >= handle->total_images) {
+        return false;
+    }
+
+    PdfSession *session = acquire_session(handle);
+    if (!session) {
+        return false;
+    }
+
+    fz_context *ctx = session->ctx;
+    fz_page *page = NULL;
+    fz_rect bounds = {0, 0, 0, 0};
+
+    fz_var(page);
+
+    // Only the page box is needed, in points; the aspect ratio is what layout uses
+    fz_try(ctx) {
+        page = fz_load_page(ctx, session->doc, handle->page_indices[index]);
+        bounds = fz_bound_page(ctx, page);
+    }
+    fz_always(ctx) {
+        fz_drop_page(ctx, page);
+    }
+    fz_catch(ctx) {
+        bounds = (fz_rect){0, 0, 0, 0};
+    }
+
+    release_session(handle, session);
+
+    *width = (int)(bounds.x1 - bounds.x0 + 0.5f);
+    *height = (int)(bounds.y1 - bounds.y0 + 0.5f);
+    return *width > 0 && *height > 0;
+}
+
 bool pdf_get_image(ArchiveHandle *handle, int index, char **out_path) {
     if (!handle || !out_path || index < 0 || index >= handle->total_images) {
         return false;
     }
-    
+
     int page_index = handle->page_indices[index];
-    
-    // Check for existing rendered file for this page
-    char output_prefix[512];
-    snprintf(output_prefix, sizeof(output_prefix), "%s/page", handle->temp_dir);
-    
-    char expected_path[512];
-
-    snprintf(expected_path, sizeof(expected_path), handle->total_images > 99 ? "%s-%03d.jpg" : "%s-%02d.jpg", output_prefix, page_index + 1);
-    
+
+    char entry_name[64];
+    snprintf(entry_name, sizeof(entry_name), "page-%04d.bmp", page_index + 1);
+
+    char output_path[512];
+    if (!temp_file_path(handle, entry_name, output_path, sizeof(output_path))) {
+        return false;
+    }
+
     // Check if the file already exists
-    if (access(expected_path, F_OK) == 0) {
-        *out_path = strdup(expected_path);        
+    if (access(output_path, F_OK) == 0) {
+        *out_path = strdup(output_path);
         return true;
     }
-    
-    // Render the page
-    bool success = false;
-    char *result_path = extract_pdf_page(handle->path, page_index, output_prefix, expected_path, &success);
-    
-    if (!success || result_path == NULL) {
+
+    // Render the page, BMP keeps it lossless
+    SDL_Surface *surface = NULL;
+    if (!pdf_render_page(handle, index, PDF_FALLBACK_HEIGHT, &surface)) {
         fprintf(stderr, "Failed to render page %d\n", page_index + 1);
-        if (result_path) {
-            free(result_path);
-        }
-        
         return false;
     }
-    
-    *out_path = result_path;
-    
+
+    bool saved = SDL_SaveBMP(surface, output_path);
+    page_pool_release_surface(surface);
+    if (!saved) {
+        fprintf(stderr, "Failed to save page %d: %s\n", page_index + 1, SDL_GetError());
+        return false;
+    }
+
+    *out_path = strdup(output_path);
+
     return true;
 }
 
@@ -196,19 +508,18 @@ void pdf_close(ArchiveHandle *handle) {
     if (!handle) {
         return;
     }
-    
+
+    free_pdf_document((PdfDocument*)handle->archive_ptr);
+
     // Free page indices
     free(handle->page_indices);
-    
-    // Clean up temporary directory (if needed)
+
+    // Remove any pages that were rendered to disk
     if (handle->temp_dir) {
-        // Optionally remove temp files
-        // char cmd[512];
-        // snprintf(cmd, sizeof(cmd), "rm -rf \"%s\"", handle->temp_dir);
-        // system(cmd);
+        remove_directory(handle->temp_dir);
         free(handle->temp_dir);
     }
-    
+
     free(handle->path);
     free(handle);
-}
\ No newline at end of file
+}
@@ -5,6 +5,8 @@
 
 #define _GNU_SOURCE // Required for strverscmp
 #include <stdio.h>
+#include <errno.h>
+#include <ftw.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -62,4 +64,95 @@ bool is_image_file(const char *filename) {
             strcasecmp(ext, "GIF") == 0 ||
             strcasecmp(ext, "BMP") == 0 ||
             strcasecmp(ext, "WEBP") == 0);
-}
\ No newline at end of file
+}
+
+bool make_directories(const char *path) {
+    if (!path || !*path) return false;
+    
+    char *dir = strdup(path);
+    if (!dir) return false;
+    
+    // Create each parent in turn, ignoring the ones that already exist
+    for (char *p = dir + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+                free(dir);
+                return false;
+            }
+            *p = '/';
+        }
+    }
+    
+    bool result = mkdir(dir, 0700) == 0 || errno == EEXIST;
+    free(dir);
+    return result;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int typeflag, struct FTW *ftwbuf) {
+    (void)sb;
+    (void)typeflag;
+    (void)ftwbuf;
+    return remove(path);
+}
+
+bool remove_directory(const char *path) {
+    if (!path) return false;
+    
+    // Depth-first so directories are empty by the time they are removed
+    return nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
+bool temp_file_path(ArchiveHandle *handle, const char *entry_name, char *out_path, size_t out_size) {
+    if (!handle || !entry_name || !out_path) return false;
+    
+    // Create the temporary directory lazily, most pages never touch the disk
+    if (!handle->temp_dir) {
+        char temp_dir[256];
+        snprintf(temp_dir, sizeof(temp_dir), "/tmp/ic_viewer_XXXXXX");
+        if (mkdtemp(temp_dir) == NULL) {
+            fprintf(stderr, "Failed to create temporary directory\n");
+            return false;
+        }
+        handle->temp_dir = strdup(temp_dir);
+    }
+    
+    snprintf(out_path, out_size, "%s/%s", handle->temp_dir, entry_name);
+    
+    // Create subdirectories if needed
+    char *dir_part = strdup(out_path);
+    char *last_slash = dir_part ? strrchr(dir_part, '/') : NULL;
+    if (last_slash) {
+        *last_slash = '\0';
+        make_directories(dir_part);
+    }
+    free(dir_part);
+    
+    return true;
+}
+
+bool write_temp_file(ArchiveHandle *handle, const char *entry_name, const void *data, size_t size, char **out_path) {
+    if (!handle || !entry_name || !out_path) return false;
+    
+    char output_path[512];
+    if (!temp_file_path(handle, entry_name, output_path, sizeof(output_path))) {
+        return false;
+    }
+    
+    FILE *out_file = fopen(output_path, "wb");
+    if (!out_file) {
+        fprintf(stderr, "Failed to create output file: %s\n", output_path);
+        return false;
+    }
+    
+    bool written = fwrite(data, 1, size, out_file) == size;
+    fclose(out_file);
+    
+    if (!written) {
+        fprintf(stderr, "Failed to write output file: %s\n", output_path);
+        return false;
+    }
+    
+    *out_path = strdup(output_path);
+    return *out_path != NULL;
+}
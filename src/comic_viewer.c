@@ -21,6 +21,23 @@
 #include "progress_bar.h"
 #include "progress_indicator.h" // Moved here
 #include "image_loader.h" // Add FreeImage loader
+#include "decode_pool.h"
+#include "page_cache.h"
+#include "crop_detect.h"
+#include "tile_cache.h"
+#include "disk_cache.h"
+#include "image_probe.h"
+#include "image_codecs.h"
+#include "view_list.h"
+#include "bench.h"
+#include "trace.h"
+#include "page_pool.h"
+#include "source_io.h"
+#include "http_source.h"
+#include "series.h"
+#include "directory_index.h"
+#include "thumbnail_grid.h"
+#include "memory_governor.h"
 
 SDL_Color white = {255, 255, 255, 255}; // White
 
@@ -29,37 +46,60 @@ struct ViewerState viewer; // Define the global viewer variable
 // Global state for image enhancement options
 ImageProcessingOptions* options;
 
+// Held by workers copying a directory page's path and while the entries are replaced and
+// the jobs renumbered, so a worker finds the page its job has now
+static SDL_SpinLock images_lock;
+
 // Forward declarations for internal functions
 static void free_resources(void);
 static void handle_events(void);
 static void render_current_view(void);
 static void display_info();
-static bool load_image(int index);
+static void display_perf_overlay(void);
+static bool load_image(int index, int priority);
 static void unload_image(int index);
+static bool decode_page(int index, DecodeResult *result);
+static bool decode_tile_source(int index, const TileEnhancement *enhancement, SDL_Surface **out_surface);
+static void collect_decoded_pages(void);
+static bool install_decoded_page(ImageEntry *image, DecodeResult *result);
+static void schedule_prefetch(void);
+static bool image_in_prefetch_window(int index);
 static void toggle_fullscreen(void);
 static SDL_Color get_dominant_color(SDL_Surface *surface, int x, int y, int width, int height);
-static void analyze_image_left_edge(int index, SDL_Color *left_color);
-static void analyze_image_right_edge(int index, SDL_Color *right_color);
+static SDL_Color analyze_left_edge(SDL_Surface *surface);
+static SDL_Color analyze_right_edge(SDL_Surface *surface);
 static SDL_Texture* render_text(const char *text, SDL_Color color);
 static bool select_monitor(int monitor_index, int *x, int *y);
-static void create_texture(SDL_Renderer *renderer, ImageEntry *image);
+static void create_texture(ImageEntry *image);
+static void reapply_enhancement(void);
 static void update_progress(float progress, const char *message);
+static void start_page_probe(void);
+static void poll_page_probe(void);
+static void stop_page_probe(void);
 static void generate_default_views(void);
 static void previous_view(void);
 static void next_view(void);
+static void navigate_to(int view_index, int direction);
+static void apply_pending_view(void);
+static void poll_scrubbing(void);
+static void view_changed(ImageView *old_view_node, ImageView *new_view_node);
+static void switch_to_next_volume(void);
+static int view_index_of_image(int image_index);
+static void poll_series(void);
+static void poll_memory_governor(void);
+static void poll_directory_index(void);
+
+static ImageView* get_view_by_index(int index) {
+    return view_list_get(&viewer.views, index);
+}
 
-// Linked list helper functions
-static ImageView* create_view_node(ImageView *prev_view);
-static void append_view(ImageView *view);
-static void free_all_views(void);
-static ImageView* get_view_by_index(int index);
-static int get_current_view_index(void);
+// The displayed view, NULL before a comic is loaded
+static ImageView* current_view(void) {
+    return view_list_get(&viewer.views, viewer.current_view_index);
+}
 
-// Compatibility functions for the linked list implementation
 static void set_current_view(int index) {
-    ImageView *view = get_view_by_index(index);
-    if (view) {
-        viewer.current_view_node = view;
+    if (get_view_by_index(index)) {
         viewer.current_view_index = index;
     }
 }
@@ -69,66 +109,37 @@ static int get_current_view(void) {
 }
 
 static int get_view_count(void) {
-    return viewer.view_count;
+    return view_list_count(&viewer.views);
 }
 
 static void remove_current_view(void) {
-    if (!viewer.current_view_node || viewer.view_count <= 1) {
+    ImageView *view_to_remove = current_view();
+    if (!view_to_remove || get_view_count() <= 1) {
         // Can't remove if no current view or only one view left
         return;
     }
     
-    ImageView *view_to_remove = viewer.current_view_node;
-    ImageView *next_view = view_to_remove->next;
-    ImageView *prev_view = view_to_remove->prev;
-    
     // Unload any images from the view being removed
     for (int i = 0; i < view_to_remove->count; i++) {
         int image_index = view_to_remove->image_indices[i];
         if (image_index >= 0 && image_index < viewer.image_count) {
-            if (viewer.images[image_index].texture) {
-                SDL_DestroyTexture(viewer.images[image_index].texture);
-                viewer.images[image_index].texture = NULL;
-            }
+            page_cache_drop_texture(&viewer.images[image_index]);
         }
     }
     
-    // Update linked list connections
-    if (prev_view) {
-        prev_view->next = next_view;
-    } else {
-        // Removing the first view
-        viewer.first_view = next_view;
-    }
-    
-    if (next_view) {
-        next_view->prev = prev_view;
-    }
-    
-    // Move to the next view, or previous if no next
-    if (next_view) {
-        viewer.current_view_node = next_view;
-        // current_view_index stays the same since we removed the current view
-    } else if (prev_view) {
-        viewer.current_view_node = prev_view;
+    // The next view takes its index, or we step back when removing the last one
+    view_list_remove(&viewer.views, viewer.current_view_index);
+    if (viewer.current_view_index >= get_view_count()) {
         viewer.current_view_index--;
     }
     
-    // Free the removed view
-    free(view_to_remove);
-    viewer.view_count--;
-    
-    // Load images for the new current view
-    if (viewer.current_view_node) {
-        for (int i = 0; i < viewer.current_view_node->count; i++) {
-            int image_index = viewer.current_view_node->image_indices[i];
-            if (image_index >= 0 && image_index < viewer.image_count) {
-                load_image(image_index);
-            }
-        }
+    // Queue the images for the new current view and its neighbours
+    if (current_view()) {
+        schedule_prefetch();
         
         // Update page change time for progress indicator
         viewer.last_page_change_time = SDL_GetTicks();
+        viewer.show_progress_indicator = true;
     }
 }
 
@@ -182,42 +193,80 @@ static void hsl_to_rgb(float h, float s, float l, float *r, float *g, float *b)
     }
 }
 
-// Function to render a horizontal gradient using HSL interpolation
-static void render_horizontal_gradient_hsl(SDL_Renderer *renderer, SDL_FRect rect, SDL_Color edge_color_rgb, bool edge_color_is_on_left_of_fill) {
-    if (rect.w <= 0) return; // Do not render if width is zero or negative
+// Number of color steps in a cached side gradient, stretched to the fill width
+#define GRADIENT_RAMP_WIDTH 256
 
-    float r_edge = edge_color_rgb.r / 255.0f;
-    float g_edge = edge_color_rgb.g / 255.0f;
-    float b_edge = edge_color_rgb.b / 255.0f;
+// One side fill gradient, rebuilt only when the edge color changes
+typedef struct {
+    SDL_Texture *texture;
+    SDL_Color color;
+} GradientCache;
 
-    float h_edge, s_edge, l_edge;
-    rgb_to_hsl(r_edge, g_edge, b_edge, &h_edge, &s_edge, &l_edge);
+static GradientCache side_gradients[2];  // Indexed by edge_color_is_on_left_of_fill
 
-    for (int col = 0; col < (int)rect.w; ++col) {
-        float t; // Interpolation factor: 0 for edge_color, 1 for black
-        if (edge_color_is_on_left_of_fill) { // Gradient from left (edge_color) to right (black)
-            t = (float)col / (float)(rect.w > 1 ? rect.w -1 : 1); // Avoid division by zero if rect.w is 1
-        } else { // Gradient from right (edge_color) to left (black)
-            t = 1.0f - ((float)col / (float)(rect.w > 1 ? rect.w -1 : 1));
+// Build a 1 pixel tall ramp from the edge color to black, interpolating in HSL
+static SDL_Texture* create_gradient_texture(SDL_Renderer *renderer, SDL_Color edge_color_rgb, bool edge_color_is_on_left_of_fill) {
+    float h_edge, s_edge, l_edge;
+    rgb_to_hsl(edge_color_rgb.r / 255.0f, edge_color_rgb.g / 255.0f, edge_color_rgb.b / 255.0f,
+               &h_edge, &s_edge, &l_edge);
+
+    Uint8 ramp[GRADIENT_RAMP_WIDTH * 4];
+    for (int col = 0; col < GRADIENT_RAMP_WIDTH; ++col) {
+        // Interpolation factor: 0 for edge_color, 1 for black
+        float t = (float)col / (float)(GRADIENT_RAMP_WIDTH - 1);
+        if (!edge_color_is_on_left_of_fill) {
+            t = 1.0f - t;
         }
-        // Clamp t to [0, 1] just in case
-        t = fmaxf(0.0f, fminf(1.0f, t));
-
 
         // Interpolate S and L towards 0 (black), keep H constant
-        float s_interp = s_edge * (1.0f - t);
-        float l_interp = l_edge * (1.0f - t);
-
         float r_interp, g_interp, b_interp;
-        hsl_to_rgb(h_edge, s_interp, l_interp, &r_interp, &g_interp, &b_interp);
+        hsl_to_rgb(h_edge, s_edge * (1.0f - t), l_edge * (1.0f - t), &r_interp, &g_interp, &b_interp);
+
+        ramp[col * 4 + 0] = (Uint8)(r_interp * 255.0f);
+        ramp[col * 4 + 1] = (Uint8)(g_interp * 255.0f);
+        ramp[col * 4 + 2] = (Uint8)(b_interp * 255.0f);
+        ramp[col * 4 + 3] = 255;
+    }
+
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC,
+                                             GRADIENT_RAMP_WIDTH, 1);
+    if (!texture) {
+        fprintf(stderr, "Failed to create gradient texture: %s\n", SDL_GetError());
+        return NULL;
+    }
+    SDL_UpdateTexture(texture, NULL, ramp, sizeof(ramp));
+    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_LINEAR);
+
+    return texture;
+}
+
+static void free_gradient_cache(void) {
+    for (int i = 0; i < 2; i++) {
+        if (side_gradients[i].texture) {
+            SDL_DestroyTexture(side_gradients[i].texture);
+            side_gradients[i].texture = NULL;
+        }
+    }
+}
+
+// Stretch the cached gradient over rect, a single draw call per side
+static void render_horizontal_gradient_hsl(SDL_Renderer *renderer, SDL_FRect rect, SDL_Color edge_color_rgb, bool edge_color_is_on_left_of_fill) {
+    if (rect.w <= 0) return; // Do not render if width is zero or negative
+
+    GradientCache *cache = &side_gradients[edge_color_is_on_left_of_fill ? 1 : 0];
+    bool same_color = cache->color.r == edge_color_rgb.r && cache->color.g == edge_color_rgb.g &&
+                      cache->color.b == edge_color_rgb.b;
 
-        SDL_SetRenderDrawColor(renderer,
-                               (Uint8)(r_interp * 255.0f),
-                               (Uint8)(g_interp * 255.0f),
-                               (Uint8)(b_interp * 255.0f),
-                               255);
-        SDL_RenderLine(renderer, rect.x + col, rect.y, rect.x + col, rect.y + rect.h -1.0f);
+    if (!cache->texture || !same_color) {
+        if (cache->texture) {
+            SDL_DestroyTexture(cache->texture);
+        }
+        cache->texture = create_gradient_texture(renderer, edge_color_rgb, edge_color_is_on_left_of_fill);
+        cache->color = edge_color_rgb;
+        if (!cache->texture) return;
     }
+
+    SDL_RenderTexture(renderer, cache->texture, NULL, &rect);
 }
 
 
@@ -305,6 +354,17 @@ bool comic_viewer_init(int monitor_index) {
         return false;
     }
     
+    // Page surfaces and textures are recycled between pages of the same size
+    if (!page_pool_init(viewer.renderer)) {
+        fprintf(stderr, "Pages will be allocated without pooling\n");
+    }
+    
+    // Animations are paced by the display instead of a fixed delay
+    viewer.vsync = SDL_SetRenderVSync(viewer.renderer, 1);
+    if (!viewer.vsync) {
+        fprintf(stderr, "Warning: VSync unavailable: %s\n", SDL_GetError());
+    }
+    
     // Initialize the progress bar
     if (!progress_bar_init(viewer.renderer)) {
         fprintf(stderr, "Warning: Failed to initialize progress bar. Loading will proceed without visual feedback.\n");
@@ -345,9 +405,9 @@ bool comic_viewer_init(int monitor_index) {
     viewer.type = SOURCE_UNKNOWN;
     viewer.source_path = NULL;
     viewer.image_count = 0;
+    viewer.images = NULL;
     viewer.current_view_index = 0;
-    viewer.first_view = NULL;
-    viewer.current_view_node = NULL;
+    view_list_init(&viewer.views);
     viewer.running = false;
     viewer.fullscreen = false;
     viewer.archive = NULL;
@@ -362,18 +422,100 @@ bool comic_viewer_init(int monitor_index) {
     viewer.zoom_center_x = 0;
     viewer.zoom_center_y = 0;
     viewer.max_zoom = 3.0f;
+    
+    // Pair portrait pages into spreads when laying out views
+    viewer.multiple_images_mode = true;
+
+    // Initialize background decoding settings (leave one core for rendering)
+    int cores = SDL_GetNumLogicalCPUCores();
+    viewer.decode_threads = cores > 2 ? cores - 1 : 1;
+    if (viewer.decode_threads > 4) viewer.decode_threads = 4;
+    viewer.prefetch_ahead = DEFAULT_PREFETCH_AHEAD;
+    viewer.prefetch_behind = DEFAULT_PREFETCH_BEHIND;
+    viewer.decode_generation = 0;
+    viewer.direction = 1;
+    viewer.pending_view_index = -1;
+    viewer.scrubbing = false;
+    viewer.right_to_left = false;
+    viewer.surface_cache_mb = DEFAULT_SURFACE_CACHE_MB;
+    viewer.texture_cache_mb = DEFAULT_TEXTURE_CACHE_MB;
+    viewer.disk_cache_mb = DEFAULT_DISK_CACHE_MB;
+    viewer.crop_options.threshold = CROP_DEFAULT_THRESHOLD;
+    viewer.crop_options.min_count = CROP_DEFAULT_MIN_COUNT;
+    viewer.series_mode = false;
+    viewer.series_preopen_pages = DEFAULT_SERIES_PREOPEN_PAGES;
+    viewer.series_switch_pending = false;
 
-    for (int i = 0; i < MAX_IMAGES; i++) {
-        viewer.images[i].path = NULL;
-        viewer.images[i].surface = NULL;
-        viewer.images[i].texture = NULL;
-        viewer.images[i].width = 0;
-        viewer.images[i].height = 0;
-    }
+    return true;
+}
 
+// Allocate the image entries of an archive once its page count is known
+static bool allocate_images(void) {
+    viewer.images = calloc(viewer.image_count, sizeof(ImageEntry));
+    if (!viewer.images) {
+        fprintf(stderr, "Failed to allocate memory for %d images\n", viewer.image_count);
+        return false;
+    }
     return true;
 }
 
+// Defaults the loaders do not set
+static void reset_image_entries(void) {
+    for (int i = 0; i < viewer.image_count; i++) {
+        viewer.images[i].left_color = (SDL_Color){0, 0, 0, 255};
+        viewer.images[i].right_color = (SDL_Color){0, 0, 0, 255};
+    }
+}
+
+static SourceType source_type_of_archive(ArchiveType type) {
+    switch (type) {
+        case ARCHIVE_TYPE_CBZ: return SOURCE_CBZ;
+        case ARCHIVE_TYPE_CBR: return SOURCE_CBR;
+        case ARCHIVE_TYPE_PDF: return SOURCE_PDF;
+        default: return SOURCE_UNKNOWN;
+    }
+}
+
+// Set by the open thread once the source is enumerated
+static SDL_AtomicInt open_finished;
+static bool open_result;
+
+// Runs on the open thread: list the pages of the source, in reading order
+// Only directories hand back part of their pages (what the index read in its first
+// DIRECTORY_INDEX_FIRST_MS, the rest is inserted later); archives are listed whole, as the
+// first page in name order is only known from the full listing: the central directory of a
+// CBZ, every entry header of a CBR. A PDF is opened and its pages counted, nothing more
+static int open_worker(void *data) {
+    (void)data;
+    
+    const char *path = viewer.source_path;
+    bool result = false;
+    
+    switch (viewer.type) {
+        case SOURCE_DIRECTORY:
+            result = load_directory(path, &viewer.images, &viewer.image_count, update_progress);
+            break;
+        case SOURCE_CBZ:
+            viewer.archive = archive_open(path, ARCHIVE_TYPE_CBZ, &viewer.image_count, update_progress);
+            break;
+        case SOURCE_CBR:
+            viewer.archive = archive_open(path, ARCHIVE_TYPE_CBR, &viewer.image_count, update_progress);
+            break;
+        case SOURCE_PDF:
+            viewer.archive = archive_open(path, ARCHIVE_TYPE_PDF, &viewer.image_count, update_progress);
+            break;
+        default:
+            break;
+    }
+    if (viewer.archive) {
+        result = viewer.image_count > 0;
+    }
+    
+    open_result = result;
+    SDL_SetAtomicInt(&open_finished, 1);
+    return 0;
+}
+
 bool comic_viewer_load(const char *path) {
     if (path == NULL) return false;
 
@@ -384,41 +526,55 @@ bool comic_viewer_load(const char *path) {
     // Initial progress update
     update_progress(0.0f, "Detecting file type...");
 
+    // URLs are opened with range requests, nothing to stat
+    bool remote = http_source_is_url(path);
+
     // Check if path is a directory
     struct stat path_stat;
-    if (stat(path, &path_stat) != 0) {
+    if (!remote && stat(path, &path_stat) != 0) {
         fprintf(stderr, "Cannot access path: %s\n", path);
         return false;
     }
 
-    bool result = false;
-
     // Determine source type
-    if (S_ISDIR(path_stat.st_mode)) {
+    if (!remote && S_ISDIR(path_stat.st_mode)) {
         viewer.type = SOURCE_DIRECTORY;
-        result = load_directory(path, viewer.images, &viewer.image_count, MAX_IMAGES, update_progress);
     } else {
-        // Check file extension to determine type
-        size_t len = strlen(path);
-        if (len > 4) {
-            const char *ext = path + len - 4;
-            if (strcasecmp(ext, ".cbz") == 0 || strcasecmp(ext, ".zip") == 0) {
-                viewer.type = SOURCE_CBZ;
-                viewer.archive = archive_open(path, ARCHIVE_TYPE_CBZ, &viewer.image_count, update_progress);
-            } else if (strcasecmp(ext, ".cbr") == 0 || strcasecmp(ext, ".rar") == 0) {
-                viewer.type = SOURCE_CBR;
-                viewer.archive = archive_open(path, ARCHIVE_TYPE_CBR, &viewer.image_count, update_progress);
-            } else if (strcasecmp(ext, ".pdf") == 0) {
-                viewer.type = SOURCE_PDF;
-                viewer.archive = archive_open(path, ARCHIVE_TYPE_PDF, &viewer.image_count, update_progress);
+        // Check file extension to determine type, ignoring a URL's query and fragment
+        size_t len = remote ? strcspn(path, "?#") : strlen(path);
+        viewer.type = source_type_of_archive(archive_type_from_name(path, len));
+    }
+
+    // RAR entries can only be read in order, which would mean downloading the whole file
+    if (remote && viewer.type == SOURCE_CBR) {
+        fprintf(stderr, "CBR archives cannot be opened from a URL: %s\n", path);
+        viewer.type = SOURCE_UNKNOWN;
+    }
+
+    bool result = false;
+    if (viewer.type != SOURCE_UNKNOWN) {
+        // Enumerate on a thread so the progress bar keeps drawing (and the window responding)
+        SDL_SetAtomicInt(&open_finished, 0);
+        SDL_Thread *thread = SDL_CreateThread(open_worker, "ic_open", NULL);
+        if (thread) {
+            while (!SDL_GetAtomicInt(&open_finished)) {
+                progress_bar_refresh();
+                SDL_Delay(OPEN_WAIT_MS);
             }
-            result = viewer.archive != NULL;
+            SDL_WaitThread(thread, NULL);
+        } else {
+            open_worker(NULL);
         }
+        result = open_result && (viewer.type == SOURCE_DIRECTORY || allocate_images());
     }
 
     if (result) {
-        // generate default views
+        reset_image_entries();
+        
+        // Every page starts out alone; spreads are laid out once the background probe has
+        // measured the pages, which only starts after the first page is on screen
         generate_default_views();
+        update_progress(1.0f, "Opening first page...");
     } else {
         update_progress(1.0f, "Could not load input");
         // If we couldn't load the archive, check if it's a directory
@@ -431,28 +587,12 @@ bool comic_viewer_load(const char *path) {
     return result;
 }
 
-void unload_images_for_view(int view_index) {
-    ImageView *view = get_view_by_index(view_index);
-    if (!view) return;
-
-    // Unload images for the specified view
-    for (int i = 0; i < view->count; i++) {
-        int img_index = view->image_indices[i];
-        unload_image(img_index);
-    }
-}
-
-void load_images_for_view(int view_index) {
-    ImageView *view = get_view_by_index(view_index);
+// Queue the images of a view for decoding, lower priority values are decoded first
+static void load_images_for_view(ImageView *view, int priority) {
     if (!view) return;
 
-    // Load images for the current view
     for (int i = 0; i < view->count; i++) {
-        int img_index = view->image_indices[i];
-        if (!load_image(img_index)) {
-            fprintf(stderr, "Failed to load image %d\n", img_index);
-            return;
-        }
+        load_image(view->image_indices[i], priority);
     }
 }
 
@@ -465,28 +605,337 @@ void comic_viewer_run(void) {
     // get default image processing options
     options = get_default_processing_options();
 
-    // Load images for the current view
-    load_images_for_view(get_current_view());
-    // Preload images for the next view if available
-    if (get_view_count() > 1) {
-        load_images_for_view(get_current_view() + 1);
+    // Pages decoded in earlier sessions are read back instead of decoded
+    disk_cache_init((size_t)viewer.disk_cache_mb << 20);
+    
+    // Pages are hinted to the kernel as they are queued
+    if (!source_io_init()) {
+        fprintf(stderr, "Page files will not be read ahead\n");
+    }
+    
+    // Start the decode workers and queue the first views
+    if (!decode_pool_init(viewer.decode_threads, decode_page)) {
+        fprintf(stderr, "Failed to start decode workers\n");
+        source_io_shutdown();
+        free(options);
+        return;
+    }
+    page_cache_init((size_t)viewer.surface_cache_mb << 20, (size_t)viewer.texture_cache_mb << 20,
+                    image_in_prefetch_window);
+    if (!tile_cache_init(viewer.renderer, (size_t)DEFAULT_TILE_CACHE_MB << 20, decode_tile_source)) {
+        fprintf(stderr, "Zoomed pages will not be sharpened\n");
     }
+    if (thumbnail_grid_init(viewer.renderer)) {
+        thumbnail_grid_reset(viewer.image_count, viewer.decode_generation);
+    }
+    
+    // The configured budgets are the most the governor hands out, a memory limit may lower them now
+    MemoryBudgets configured = {(size_t)viewer.surface_cache_mb << 20, (size_t)viewer.texture_cache_mb << 20,
+                                viewer.prefetch_ahead, viewer.prefetch_behind, viewer.decode_threads};
+    memory_governor_init(&configured);
+    poll_memory_governor();
+    schedule_prefetch();
     viewer.running = true;
 
-    // Main loop
+    viewer.needs_redraw = true;
+
+    // Main loop, only renders when something changed on screen
     while (viewer.running) {
-        // Handle events
+        // Hide the page indicator once its time is up
+        Sint32 timeout = IDLE_WAIT_MS;
+        if (viewer.show_progress_indicator) {
+            Uint64 elapsed = SDL_GetTicks() - viewer.last_page_change_time;
+            if (elapsed >= PROGRESS_INDICATOR_DURATION_MS) {
+                viewer.show_progress_indicator = false;
+                viewer.needs_redraw = true;
+            } else if (PROGRESS_INDICATOR_DURATION_MS - elapsed < (Uint64)timeout) {
+                timeout = (Sint32)(PROGRESS_INDICATOR_DURATION_MS - elapsed);
+            }
+        }
+
+        // Wake up to decode the pages around the view landed on once scrubbing stops
+        if (viewer.scrubbing) {
+            Uint64 elapsed = SDL_GetTicks() - viewer.last_page_change_time;
+            Sint32 remaining = elapsed >= SCRUB_INTERVAL_MS ? 0 : (Sint32)(SCRUB_INTERVAL_MS - elapsed);
+            if (remaining < timeout) {
+                timeout = remaining;
+            }
+        }
+
+        // The overlay refreshes a few times a second even when nothing else changes
+        if (viewer.show_perf_overlay && timeout > PERF_OVERLAY_REFRESH_MS) {
+            timeout = PERF_OVERLAY_REFRESH_MS;
+        }
+
+        // Sleep until input, a finished decode (the pool pushes an event) or the timeout
+        if (!viewer.needs_redraw && !viewer.page_turning_in_progress) {
+            SDL_WaitEventTimeout(NULL, timeout);
+            if (viewer.show_perf_overlay) {
+                viewer.needs_redraw = true;
+            }
+        }
+
+        // Handle events, then turn to the view they lead to
         handle_events();
+        apply_pending_view();
+        poll_scrubbing();
+
+        // Upload pages finished by the decode workers
+        collect_decoded_pages();
 
         // Render the current image
+        if (viewer.needs_redraw || viewer.page_turning_in_progress) {
+            viewer.needs_redraw = false;
+            render_current_view();
+
+            // Without vsync the animation would spin as fast as it can present
+            if (!viewer.vsync && viewer.page_turning_in_progress) {
+                SDL_Delay(10);
+            }
+        }
+
+        // Measure the other pages once the first view is up, then lay out the spreads
+        poll_page_probe();
+        
+        // Continue into the next volume once it is open
+        poll_series();
+        
+        // Insert pages added to the directory
+        poll_directory_index();
+        
+        // Follow memory pressure
+        poll_memory_governor();
+    }
+
+    // Stop the workers before the archive and options go away
+    stop_page_probe();
+    series_shutdown();
+    decode_pool_shutdown();
+    source_io_shutdown();
+    tile_cache_shutdown();
+    thumbnail_grid_shutdown();
+    disk_cache_shutdown();
+    
+    PageCacheStats stats = page_cache_get_stats();
+    printf("Page cache: %llu texture hits, %llu surface hits, %llu misses, %llu evictions\n",
+           (unsigned long long)stats.texture_hits, (unsigned long long)stats.surface_hits,
+           (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+
+    // Cleanup resources
+    free(options);
+}
+
+// Decode, upload and draw one page synchronously, then drop it so the next visit starts cold
+static bool bench_page(int index) {
+    ImageEntry *image = &viewer.images[index];
+    page_cache_drop_texture(image);
+    page_cache_drop_surface(image);
+    
+    DecodeResult result = {0};
+    result.index = index;
+    result.tile = DECODE_WHOLE_PAGE;
+    result.generation = viewer.decode_generation;
+    if (!decode_page(index, &result) || !result.surface) {
+        fprintf(stderr, "Failed to load image %d\n", index);
+        free(result.path);
+        return false;
+    }
+    
+    bool shown = install_decoded_page(image, &result);
+    if (shown) {
+        // Views stay single pages since the benchmark never runs the probe
+        set_current_view(index);
+        
+        BenchTimer timer = bench_start();
         render_current_view();
+        bench_stop(&timer, BENCH_PRESENT);
+    }
+    
+    page_cache_drop_texture(image);
+    page_cache_drop_surface(image);
+    return shown;
+}
+
+// Open the overview grid and draw frames, decoding on the workers like the viewer does, until
+// its first screen of thumbnails is in; returns the pages still missing after
+// BENCH_GRID_TIMEOUT_MS (-1 if the grid could not run), out_ms the time to fill the screen
+static int bench_thumbnail_grid(double *out_ms) {
+    *out_ms = -1;
+    if (!decode_pool_init(viewer.decode_threads, decode_page)) {
+        fprintf(stderr, "Failed to start decode workers\n");
+        return -1;
+    }
+    tile_cache_init(viewer.renderer, (size_t)DEFAULT_TILE_CACHE_MB << 20, decode_tile_source);
+    
+    int missing = -1;
+    if (thumbnail_grid_init(viewer.renderer)) {
+        thumbnail_grid_reset(viewer.image_count, viewer.decode_generation);
+        thumbnail_grid_open(0);
+        
+        // Every frame ends with tile_cache_end_frame, which must leave thumbnail jobs alone
+        Uint64 start = SDL_GetTicksNS();
+        Uint64 deadline = SDL_GetTicks() + BENCH_GRID_TIMEOUT_MS;
+        while (true) {
+            collect_decoded_pages();
+            render_current_view();
+            missing = thumbnail_grid_missing();
+            if (missing == 0 || SDL_GetTicks() >= deadline) break;
+            SDL_Delay(1);
+        }
+        if (missing == 0) {
+            *out_ms = (SDL_GetTicksNS() - start) / 1e6;
+        }
+        thumbnail_grid_close();
+    }
+    
+    decode_pool_shutdown();
+    tile_cache_shutdown();
+    thumbnail_grid_shutdown();
+    return missing;
+}
 
-        // Delay to reduce CPU usage
-        SDL_Delay(10);
+static const char* source_type_name(SourceType type) {
+    switch (type) {
+        case SOURCE_CBZ: return "cbz";
+        case SOURCE_CBR: return "cbr";
+        case SOURCE_PDF: return "pdf";
+        case SOURCE_DIRECTORY: return "directory";
+        default: return "unknown";
     }
+}
 
-    // Cleanup resources
+bool comic_viewer_bench(const char *path, const char *output_path) {
+    if (!bench_init()) return false;
+    
+    Uint64 open_start = SDL_GetTicksNS();
+    BenchTimer timer = bench_start();
+    if (!comic_viewer_load(path)) {
+        bench_shutdown();
+        return false;
+    }
+    // Every page of a directory is timed, not only the ones listed before the first page
+    // (views stay single pages, see bench_page)
+    if (viewer.type == SOURCE_DIRECTORY) {
+        bool spreads = viewer.multiple_images_mode;
+        viewer.multiple_images_mode = false;
+        directory_index_wait_scan();
+        poll_directory_index();
+        viewer.multiple_images_mode = spreads;
+    }
+    bench_stop(&timer, BENCH_OPEN);
+    
+    // Pages are decoded on this thread one at a time, and the disk cache stays off so every
+    // visit decodes; without vsync the present stage measures drawing, not the refresh wait
+    options = get_default_processing_options();
+    page_cache_init((size_t)viewer.surface_cache_mb << 20, (size_t)viewer.texture_cache_mb << 20,
+                    image_in_prefetch_window);
+    SDL_SetRenderVSync(viewer.renderer, 0);
+    
+    static const char *order_names[BENCH_ORDER_COUNT] = {"sequential", "reverse", "random"};
+    double order_ms[BENCH_ORDER_COUNT] = {0};
+    int order_pages[BENCH_ORDER_COUNT] = {0};
+    double first_present_ms = -1;
+    int failed = 0;
+    bool interrupted = false;
+    
+    int *order = malloc(viewer.image_count * sizeof(int));
+    if (!order) {
+        fprintf(stderr, "Failed to allocate memory for the page order\n");
+        free(options);
+        bench_shutdown();
+        return false;
+    }
+    
+    srand(BENCH_RANDOM_SEED);
+    for (int o = 0; o < BENCH_ORDER_COUNT && !interrupted; o++) {
+        for (int i = 0; i < viewer.image_count; i++) {
+            order[i] = o == 1 ? viewer.image_count - 1 - i : i;
+        }
+        if (o == 2) {
+            // Fisher-Yates with a fixed seed, so runs are comparable
+            for (int i = viewer.image_count - 1; i > 0; i--) {
+                int j = rand() % (i + 1);
+                int swap = order[i];
+                order[i] = order[j];
+                order[j] = swap;
+            }
+        }
+        
+        Uint64 order_start = SDL_GetTicksNS();
+        for (int i = 0; i < viewer.image_count; i++) {
+            if (bench_page(order[i])) {
+                if (first_present_ms < 0) {
+                    first_present_ms = (SDL_GetTicksNS() - open_start) / 1e6;
+                }
+            } else {
+                failed++;
+            }
+            order_pages[o]++;
+            
+            // Closing the window ends the run early, the summary covers what was measured
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                if (event.type == SDL_EVENT_QUIT) {
+                    interrupted = true;
+                }
+            }
+            if (interrupted) break;
+        }
+        order_ms[o] = (SDL_GetTicksNS() - order_start) / 1e6;
+    }
+    free(order);
+    
+    // A screen of thumbnails that never fills in fails the run
+    double grid_ms = -1;
+    int grid_missing = interrupted ? -1 : bench_thumbnail_grid(&grid_ms);
+    if (grid_missing > 0) {
+        fprintf(stderr, "Overview grid: %d thumbnails on screen still missing after %d ms\n",
+                grid_missing, BENCH_GRID_TIMEOUT_MS);
+    }
     free(options);
+    options = NULL;
+    
+    FILE *file = strcmp(output_path, "-") == 0 ? stdout : fopen(output_path, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write benchmark results to %s\n", output_path);
+        bench_shutdown();
+        return false;
+    }
+    
+    fprintf(file, "{\n  \"source\": ");
+    bench_write_string(file, path);
+    fprintf(file, ",\n  \"type\": \"%s\",\n", source_type_name(viewer.type));
+    // Formats missing here went through FreeImage
+    const ImageCodec *codecs[IMAGE_FORMAT_COUNT];
+    int codec_count = image_codecs_active(codecs, IMAGE_FORMAT_COUNT);
+    fprintf(file, "  \"decoders\": {");
+    for (int c = 0; c < codec_count; c++) {
+        fprintf(file, "%s\"%s\": \"%s\"", c > 0 ? ", " : "", image_format_name(codecs[c]->format), codecs[c]->name);
+    }
+    fprintf(file, "},\n");
+    fprintf(file, "  \"pages\": %d,\n", viewer.image_count);
+    fprintf(file, "  \"display\": [%d, %d],\n", viewer.drawable_width, viewer.drawable_height);
+    fprintf(file, "  \"failed_pages\": %d,\n", failed);
+    fprintf(file, "  \"interrupted\": %s,\n", interrupted ? "true" : "false");
+    fprintf(file, "  \"first_present_ms\": %.3f,\n", first_present_ms);
+    fprintf(file, "  \"orders\": {\n");
+    for (int o = 0; o < BENCH_ORDER_COUNT; o++) {
+        fprintf(file, "    \"%s\": {\"pages\": %d, \"total_ms\": %.3f}%s\n",
+                order_names[o], order_pages[o], order_ms[o], o + 1 < BENCH_ORDER_COUNT ? "," : "");
+    }
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"grid\": {\"fill_ms\": %.3f, \"missing\": %d},\n", grid_ms, grid_missing);
+    fprintf(file, "  \"stages\": ");
+    bench_write_stages(file, "  ");
+    fprintf(file, ",\n  \"peak_rss_kb\": %ld\n}\n", bench_peak_rss_kb());
+    
+    if (file != stdout) {
+        fclose(file);
+        printf("Benchmark results written to %s\n", output_path);
+    }
+    
+    bench_shutdown();
+    return grid_missing <= 0;
 }
 
 void comic_viewer_cleanup(void) {
@@ -501,60 +950,93 @@ void comic_viewer_cleanup(void) {
         archive_close(viewer.archive);
         viewer.archive = NULL;
     }
+    directory_index_close();
     
     free_resources();
+    
+    // Every recording thread has stopped by now
+    trace_shutdown();
     SDL_Quit();
 }
 
 // Internal helper functions
-static bool load_image(int index) {
+
+// Height pages are decoded for, zooming past it is served by the tile cache
+static int decode_target_height(void) {
+    return viewer.drawable_height;
+}
+
+// Whether the page was decoded reduced for a display smaller than the current one
+static bool image_needs_sharper_decode(const ImageEntry *image) {
+    return image->reduced_height > 0 && decode_target_height() > image->reduced_height;
+}
+
+// Hint the source of an image, archives by byte range and directories by file
+static void readahead_image(int index) {
+    if (viewer.archive) {
+        archive_readahead(viewer.archive, index);
+    } else {
+        source_readahead_path(viewer.images[index].path);
+    }
+}
+
+// Queue an image for background decoding, returns true if it is already available
+static bool queue_image(int index, int priority) {
     if (index < 0 || index >= viewer.image_count) return false;
     
+    ImageEntry *image = &viewer.images[index];
+    
+    // Only lookups for the view on screen count towards the hit rate
+    bool on_screen = priority == 0;
+    
+    // A page decoded for a smaller display is shown as is while a sharper one is decoded
+    if (image_needs_sharper_decode(image) && !image->decode_pending) {
+        image->decode_pending = true;
+        decode_pool_submit(index, DECODE_WHOLE_PAGE, priority, viewer.decode_generation);
+    }
+    
     // If the texture is already loaded, do nothing
-    if (viewer.images[index].texture != NULL) return true;
+    if (image->texture != NULL) {
+        if (on_screen) page_cache_record_texture_hit();
+        page_cache_touch(image);
+        return true;
+    }
     
-    if (viewer.archive) {
-        char *image_path = NULL;
-        if (archive_get_image(viewer.archive, index, &image_path)) {
-            // Store the path in our image entry
-            viewer.images[index].path = image_path;
-            
-            // Load the image using our high-quality scaling function
-            create_texture(viewer.renderer, &viewer.images[index]);
-            if (!viewer.images[index].texture) {
-                fprintf(stderr, "Failed to load image %s: %s\n", image_path, SDL_GetError());
-                return false;
-            }
-            
-            // Store original dimensions
-            SDL_GetTextureSize(viewer.images[index].texture, &viewer.images[index].width, &viewer.images[index].height);
-            
+    // A cached surface only needs to be uploaded again
+    if (image->surface != NULL) {
+        create_texture(image);
+        if (image->texture) {
+            if (on_screen) page_cache_record_surface_hit();
+            page_cache_add_texture(image);
             return true;
         }
-        return false;
-    } else {
-        // Standard loading mode
-        create_texture(viewer.renderer, &viewer.images[index]);
-        if (!viewer.images[index].texture) {
-            fprintf(stderr, "Failed to load image %s: %s\n", 
-                    viewer.images[index].path, SDL_GetError());
-            return false;
-        }
-        
-        // Store original dimensions
-        SDL_GetTextureSize(viewer.images[index].texture, &viewer.images[index].width, &viewer.images[index].height);
-        
-        return true;
     }
+    
+    if (on_screen) page_cache_record_miss();
+    
+    // Start fetching the page's bytes while the job waits for a worker
+    if (!image->decode_pending) {
+        readahead_image(index);
+    }
+    
+    // Re-submitting a queued image only updates its priority
+    image->decode_pending = true;
+    decode_pool_submit(index, DECODE_WHOLE_PAGE, priority, viewer.decode_generation);
+    return false;
+}
+
+static bool load_image(int index, int priority) {
+    TraceZone zone = trace_begin("load_image");
+    bool available = queue_image(index, priority);
+    trace_end(&zone);
+    return available;
 }
 
 static void unload_image(int index) {
     if (index < 0 || index >= viewer.image_count) return;
     
-    if (viewer.images[index].texture) {
-        SDL_DestroyTexture(viewer.images[index].texture);
-        viewer.images[index].texture = NULL;
-    }
+    page_cache_drop_texture(&viewer.images[index]);
+    page_cache_drop_surface(&viewer.images[index]);
     
     // In on-demand mode, we can also free the path to save memory
     // (it will be re-extracted if needed)
@@ -564,141 +1046,642 @@ static void unload_image(int index) {
     }
 }
 
-static void handle_events(void) {
-    SDL_Event event;
+// Page metadata reused by every frame, computed once while still on the worker
+static void analyze_page(DecodeResult *result) {
+    BenchTimer timer = bench_start();
+    result->crop_rect = crop_detect_rect(result->surface, &viewer.crop_options);
+    bench_stop(&timer, BENCH_CROP);
+    result->left_color = analyze_left_edge(result->surface);
+    result->right_color = analyze_right_edge(result->surface);
     
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_EVENT_QUIT:
-                viewer.running = false;
-                break;
-
-            case SDL_EVENT_MOUSE_WHEEL:
-                // Mouse wheel for page navigation
-                if (event.wheel.y > 0) {  // Scroll up
-                    previous_view();
-                } else if (event.wheel.y < 0) {  // Scroll down
-                    next_view();
-                }
-                break;
-                
-            case SDL_EVENT_MOUSE_BUTTON_DOWN:
-                if (event.button.button == SDL_BUTTON_LEFT) {
-                    // Left mouse button pressed - toggle zoom
-                    if (viewer.zoomed) {
-                        // If already zoomed, return to normal view
-                        viewer.zoomed = false;
-                    } else {
-                        // Zoom in with center at click location
-                        viewer.zoomed = true;
-                        viewer.zoom_center_x = event.button.x;
-                        viewer.zoom_center_y = event.button.y;
-                        viewer.zoom_level = 2.0f; // Set zoom level to 200%
-                    }
-                }
-                break;
-                
-            case SDL_EVENT_KEY_DOWN:
-                switch (event.key.key) {
-                    case SDLK_ESCAPE:
-                        viewer.running = false;
-                        break;
-
-                    case SDLK_1:
-                        if (viewer.current_view_node->count == 1) {
-                            // This view is already in single image mode
-                            break;
-                        }
-                        // the current view now has 1 image
-                        viewer.current_view_node->count = 1;
-
-                        // save link to the next view node
-                        ImageView *backup_next_view = viewer.current_view_node->next;
-                        // insert a new view node after the current one
-                        viewer.current_view_node->next = create_view_node(viewer.current_view_node);
-                        viewer.current_view_node->next->image_indices[0] = viewer.current_view_node->image_indices[1];
-                        viewer.current_view_node->next->next = backup_next_view;
-                        if (backup_next_view) {
-                            backup_next_view->prev = viewer.current_view_node->next;
-                        }
+    // The enhancement itself is applied at upload, with the options current then
+    timer = bench_start();
+    enhance_analyze(result->surface, &result->enhance);
+    bench_stop(&timer, BENCH_ENHANCE);
+}
 
-                        break;
+// Runs on a worker: a copy of the path of a directory page (NULL if there is none), the
+// directory index replaces the entries as it finds more pages
+static char* copy_image_path(int index) {
+    SDL_LockSpinlock(&images_lock);
+    index = decode_pool_job_index(index);
+    const char *path = index < viewer.image_count ? viewer.images[index].path : NULL;
+    char *copy = path ? strdup(path) : NULL;
+    SDL_UnlockSpinlock(&images_lock);
+    return copy;
+}
 
-                    case SDLK_2:
-                        if (viewer.current_view_node->count == 2) {
-                            // This view is already in double image mode
-                            break;
-                        }
-                        // check if we are not already displaying the last image
-                        if (viewer.current_view_node->next) {
-                            // the current view now has 2 images
-                            viewer.current_view_node->count = 2;
+// Extract and decode a page of archive (NULL for the directory being read) for target_height,
+// 0 decodes images at full resolution and documents at the maximum zoom; archives extracted
+// to disk hand back the file in out_path
+// Pages are returned unenhanced, see create_texture
+static SDL_Surface* decode_surface(ArchiveHandle *archive, int index, int target_height, bool *out_reduced, char **out_path) {
+    char *image_path = NULL;
+    SDL_Surface *surface = NULL;
+    *out_reduced = false;
+    
+    // Documents are rasterized at the display height, sharp on HiDPI without over-rendering
+    int render_height = target_height > 0 ? target_height : (int)(viewer.drawable_height * viewer.max_zoom);
+    BenchTimer timer = bench_start();
+    if (archive && archive_render_page(archive, index, render_height, &surface)) {
+        // Black and white documents are kept at one byte per pixel
+        surface = image_compact_surface(surface);
+        bench_stop(&timer, BENCH_DECODE);
+        *out_reduced = true;
+        return surface;
+    }
+    
+    // Archives that support it are decoded straight from memory, without a temp file
+    void *data = NULL;
+    size_t size = 0;
+    bool owned = true;
+    timer = bench_start();
+    if (archive && archive_get_image_data(archive, index, &data, &size, &owned)) {
+        bench_stop(&timer, BENCH_EXTRACT);
+        const char *name = archive->entry_names ? archive->entry_names[index] : NULL;
+        timer = bench_start();
+        surface = image_load_surface_from_memory(data, size, name, NULL, target_height, out_reduced);
+        bench_stop(&timer, BENCH_DECODE);
+        if (owned) {
+            free(data);
+        }
+        return surface;
+    }
+    
+    if (archive) {
+        timer = bench_start();
+        if (!archive_get_image(archive, index, &image_path)) {
+            fprintf(stderr, "Failed to extract image %d\n", index);
+            return NULL;
+        }
+        bench_stop(&timer, BENCH_EXTRACT);
+    } else {
+        // Directory entries move when the index inserts pages, so the path is copied
+        image_path = copy_image_path(index);
+        if (!image_path) {
+            return NULL;
+        }
+        
+        // Files are mapped (or read in large blocks) and decoded from memory
+        SourceMap source;
+        timer = bench_start();
+        if (source_load(image_path, &source)) {
+            bench_stop(&timer, BENCH_EXTRACT);
+            timer = bench_start();
+            surface = image_load_surface_from_memory(source.data, source.size, image_path, NULL, target_height, out_reduced);
+            bench_stop(&timer, BENCH_DECODE);
+            source_close(&source);
+            if (!surface) {
+                fprintf(stderr, "Failed to load image %s with FreeImage\n", image_path);
+            }
+            free(image_path);
+            return surface;
+        }
+    }
+    
+    timer = bench_start();
+    surface = image_load_surface(image_path, NULL, target_height, out_reduced);
+    bench_stop(&timer, BENCH_DECODE);
+    if (!surface) {
+        fprintf(stderr, "Failed to load image %s with FreeImage\n", image_path);
+    }
+    
+    if (archive && out_path) {
+        *out_path = image_path;
+    } else {
+        free(image_path);
+    }
+    return surface;
+}
+
+// Disk cache key of a page decoded for target_height with the current settings
+static Uint64 page_disk_cache_key(ArchiveHandle *archive, int index, int target_height) {
+    // Everything that changes the page metadata, the pixels are stored unenhanced
+    double settings[2] = {0};
+    settings[0] = viewer.crop_options.threshold;
+    settings[1] = viewer.crop_options.min_count;
+    
+    if (archive) {
+        const char *entry_name = archive->entry_names ? archive->entry_names[index] : NULL;
+        return disk_cache_key(archive->path, entry_name, index, target_height, settings, sizeof(settings));
+    }
+    char *path = copy_image_path(index);
+    Uint64 key = disk_cache_key(path, NULL, -1, target_height, settings, sizeof(settings));
+    free(path);
+    return key;
+}
+
+// Extract, decode and scan a whole page without touching the renderer
+static bool decode_volume_page(ArchiveHandle *archive, int index, int target_height, DecodeResult *result) {
+    Uint64 key = page_disk_cache_key(archive, index, target_height);
+    if (disk_cache_load(key, result)) {
+        return true;
+    }
+    
+    bool reduced = false;
+    result->surface = decode_surface(archive, index, target_height, &reduced, &result->path);
+    if (!result->surface) {
+        return false;
+    }
+    
+    result->reduced_height = reduced ? target_height : 0;
+    analyze_page(result);
+    disk_cache_store(key, result);
+    return true;
+}
+
+// Height of the previews shown while scrubbing
+static int preview_target_height(void) {
+    int height = decode_target_height() / SCRUB_PREVIEW_DIVISOR;
+    return height > 0 ? height : 1;
+}
+
+// Quick decode of a page at preview height, JPEGs and WebPs are scaled by the decoder; a page
+// cached on disk is read back at full quality instead, previews themselves are not stored
+static bool decode_page_preview(int index, DecodeResult *result) {
+    if (disk_cache_load(page_disk_cache_key(viewer.archive, index, decode_target_height()), result)) {
+        return true;
+    }
+    
+    int target_height = preview_target_height();
+    bool reduced = false;
+    result->surface = decode_surface(viewer.archive, index, target_height, &reduced, &result->path);
+    if (!result->surface) {
+        return false;
+    }
+    
+    // Reduced previews are replaced by a sharper decode like pages decoded for a smaller display
+    result->reduced_height = reduced ? target_height : 0;
+    analyze_page(result);
+    return true;
+}
+
+// Page fitted into a thumbnail cell, kept in the disk cache next to the display-sized pages
+static bool decode_page_thumbnail(int index, DecodeResult *result) {
+    // Negative heights never collide with the key of a page decoded for a display
+    Uint64 key = page_disk_cache_key(viewer.archive, index, -THUMBNAIL_HEIGHT);
+    if (disk_cache_load(key, result)) {
+        return true;
+    }
+    
+    bool reduced = false;
+    SDL_Surface *page = decode_surface(viewer.archive, index, THUMBNAIL_HEIGHT, &reduced, NULL);
+    if (!page) {
+        return false;
+    }
+    result->surface = thumbnail_grid_scale(page);
+    page_pool_release_surface(page);
+    if (!result->surface) {
+        return false;
+    }
+    
+    disk_cache_store(key, result);
+    return true;
+}
+
+// Runs on a decode worker
+static bool decode_page(int index, DecodeResult *result) {
+    if (result->tile == DECODE_PAGE_PREVIEW) {
+        return decode_page_preview(index, result);
+    }
+    if (result->tile == DECODE_THUMBNAIL) {
+        return decode_page_thumbnail(index, result);
+    }
+    if (result->tile != DECODE_WHOLE_PAGE) {
+        return tile_cache_decode(index, result->tile, &result->surface);
+    }
+    return decode_volume_page(viewer.archive, index, decode_target_height(), result);
+}
+
+// Runs on a decode worker: full resolution page the zoom tiles are cut from, tiles are
+// uploaded as they are so the source is enhanced here, with the options and page statistics
+// captured when it was queued (the same tables as the page's upload)
+static bool decode_tile_source(int index, const TileEnhancement *enhancement, SDL_Surface **out_surface) {
+    bool reduced = false;
+    *out_surface = decode_surface(viewer.archive, index, 0, &reduced, NULL);
+    if (*out_surface && enhancement->options.enhancement_enabled) {
+        SDL_Surface *surface = *out_surface;
+        enhance_copy(surface, surface->pixels, surface->pitch, &enhancement->stats, &enhancement->options);
+    }
+    return *out_surface != NULL;
+}
+
+// Install finished decodes, the texture upload is the only part done on the main thread
+static void collect_decoded_pages(void) {
+    DecodeResult result;
+    
+    while (decode_pool_poll(&result)) {
+        if (result.tile == DECODE_THUMBNAIL) {
+            thumbnail_grid_install(result.index, result.surface, result.generation);
+            viewer.needs_redraw = true;
+            continue;
+        }
+        
+        // Tiles of zoomed pages belong to the tile cache
+        if (result.tile != DECODE_WHOLE_PAGE && result.tile != DECODE_PAGE_PREVIEW) {
+            if (result.generation != viewer.decode_generation) {
+                SDL_DestroySurface(result.surface);
+                result.surface = NULL;
+            }
+            tile_cache_install(result.index, result.tile, result.surface);
+            viewer.needs_redraw = true;
+            continue;
+        }
+        
+        ImageEntry *image = &viewer.images[result.index];
+        if (result.tile == DECODE_WHOLE_PAGE) {
+            image->decode_pending = false;
+        }
+        
+        // Drop results of a previous volume (the only thing that bumps the generation; an
+        // enhancement toggle re-uploads cached surfaces instead) or already uploaded, unless sharper
+        bool sharper = image->reduced_height > 0 &&
+                       (result.reduced_height == 0 || result.reduced_height > image->reduced_height);
+        if (result.generation != viewer.decode_generation || (image->texture && !sharper)) {
+            page_pool_release_surface(result.surface);
+            free(result.path);
+            if (result.generation != viewer.decode_generation) {
+                schedule_prefetch();
+            }
+            continue;
+        }
+        
+        if (!result.surface) {
+            fprintf(stderr, "Failed to load image %d\n", result.index);
+            free(result.path);
+            continue;
+        }
+        
+        Uint64 upload_start = SDL_GetTicksNS();
+        if (install_decoded_page(image, &result)) {
+            viewer.needs_redraw = true;
+            
+            // The page the reader is waiting for
+            PageTurnTiming *turn = &viewer.last_turn;
+            if (turn->pending && turn->image_index == result.index) {
+                turn->queue_ns = result.queue_ns;
+                turn->decode_ns = result.decode_ns;
+                turn->upload_ns = SDL_GetTicksNS() - upload_start;
+            }
+        }
+    }
+    
+    page_cache_trim(viewer.images, viewer.image_count);
+}
+
+// Replace an image's surface and texture with a decoded page, takes ownership of the result
+static bool install_decoded_page(ImageEntry *image, DecodeResult *result) {
+    if (result->path) {
+        free(image->path);
+        image->path = result->path;
+    }
+    page_cache_drop_texture(image);
+    page_cache_drop_surface(image);
+    image->surface = result->surface;
+    image->reduced_height = result->reduced_height;
+    image->crop_rect = result->crop_rect;
+    image->left_color = result->left_color;
+    image->right_color = result->right_color;
+    image->enhance = result->enhance;
+    image->width = result->surface->w;
+    image->height = result->surface->h;
+    page_cache_add_surface(image);
+    
+    create_texture(image);
+    if (!image->texture) {
+        fprintf(stderr, "Failed to load image %d: %s\n", result->index, SDL_GetError());
+        return false;
+    }
+    page_cache_add_texture(image);
+    return true;
+}
+
+// Walk from the current view node by offset views, NULL past either end
+static ImageView* view_at_offset(int offset) {
+    return get_view_by_index(viewer.current_view_index + offset);
+}
+
+// Whether an image belongs to one of the views kept decoded around the current one
+static bool image_in_prefetch_window(int index) {
+    int forward = viewer.direction >= 0 ? 1 : -1;
+    
+    for (int offset = -viewer.prefetch_behind; offset <= viewer.prefetch_ahead; offset++) {
+        ImageView *view = view_at_offset(offset * forward);
+        if (!view) continue;
+        
+        for (int i = 0; i < view->count; i++) {
+            if (view->image_indices[i] == index) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool image_in_current_view(int index) {
+    ImageView *view = current_view();
+    for (int i = 0; view && i < view->count; i++) {
+        if (view->image_indices[i] == index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Previews are only wanted for the view on screen, pages for the prefetch window, or only
+// for the view on screen while scrubbing
+static bool page_job_outside_window(int index, int tile) {
+    if (tile == DECODE_PAGE_PREVIEW) {
+        return !image_in_current_view(index);
+    }
+    if (tile != DECODE_WHOLE_PAGE) {
+        return false;
+    }
+    return viewer.scrubbing ? !image_in_current_view(index) : !image_in_prefetch_window(index);
+}
+
+static void clear_decode_pending(int index, int tile) {
+    if (tile == DECODE_WHOLE_PAGE) {
+        viewer.images[index].decode_pending = false;
+    }
+}
+
+// Scrubbing: show what is cached of the view, queue previews of the rest ahead of anything else
+static void schedule_preview(void) {
+    ImageView *view = current_view();
+    
+    for (int i = 0; i < view->count; i++) {
+        int index = view->image_indices[i];
+        if (index < 0 || index >= viewer.image_count) continue;
+        
+        ImageEntry *image = &viewer.images[index];
+        if (image->texture) {
+            page_cache_touch(image);
+            continue;
+        }
+        if (image->surface) {
+            create_texture(image);
+            if (image->texture) {
+                page_cache_add_texture(image);
+                continue;
+            }
+        }
+        decode_pool_submit(index, DECODE_PAGE_PREVIEW, -1, viewer.decode_generation);
+    }
+}
+
+// Queue the views around the current one, the reading direction gets the larger budget
+static void schedule_prefetch(void) {
+    if (!current_view()) return;
+    
+    // Forget queued work for views we moved away from
+    decode_pool_cancel(page_job_outside_window, clear_decode_pending);
+    
+    // Pages flipped past are not decoded, the window is queued once input stops
+    if (viewer.scrubbing) {
+        schedule_preview();
+        return;
+    }
+    
+    // Current view first, then alternate between the two sides nearest first
+    int forward = viewer.direction >= 0 ? 1 : -1;
+    int reach = viewer.prefetch_ahead > viewer.prefetch_behind ? viewer.prefetch_ahead : viewer.prefetch_behind;
+    
+    load_images_for_view(current_view(), 0);
+    for (int distance = 1; distance <= reach; distance++) {
+        if (distance <= viewer.prefetch_ahead) {
+            load_images_for_view(view_at_offset(distance * forward), 2 * distance - 1);
+        }
+        if (distance <= viewer.prefetch_behind) {
+            load_images_for_view(view_at_offset(-distance * forward), 2 * distance);
+        }
+    }
+    
+    // Pages that left the window stay cached until the budgets are exceeded
+    page_cache_trim(viewer.images, viewer.image_count);
+}
+
+// Jump from the overview to the view showing a page, whose decode then goes first
+static void jump_to_image(int image_index) {
+    thumbnail_grid_close();
+    int view_index = view_index_of_image(image_index);
+    navigate_to(view_index, view_index >= viewer.current_view_index ? 1 : -1);
+}
+
+// Input while the overview is shown, returns false for what the page view still handles
+static bool handle_grid_event(const SDL_Event *event) {
+    switch (event->type) {
+        case SDL_EVENT_MOUSE_WHEEL:
+            thumbnail_grid_scroll(-event->wheel.y);
+            return true;
+            
+        case SDL_EVENT_MOUSE_BUTTON_DOWN:
+            if (event->button.button == SDL_BUTTON_LEFT) {
+                int index = thumbnail_grid_hit(event->button.x, event->button.y);
+                if (index >= 0) {
+                    jump_to_image(index);
+                }
+            }
+            return true;
+            
+        case SDL_EVENT_KEY_DOWN:
+            switch (event->key.key) {
+                case SDLK_ESCAPE:
+                case SDLK_G:
+                    thumbnail_grid_close();
+                    return true;
+                    
+                case SDLK_RETURN:
+                case SDLK_KP_ENTER:
+                case SDLK_SPACE:
+                    jump_to_image(thumbnail_grid_selected());
+                    return true;
+                    
+                case SDLK_LEFT:
+                    thumbnail_grid_move(-1, 0);
+                    return true;
+                    
+                case SDLK_RIGHT:
+                    thumbnail_grid_move(1, 0);
+                    return true;
+                    
+                case SDLK_UP:
+                    thumbnail_grid_move(0, -1);
+                    return true;
+                    
+                case SDLK_DOWN:
+                    thumbnail_grid_move(0, 1);
+                    return true;
+                    
+                case SDLK_PAGEUP:
+                    thumbnail_grid_move(0, -viewer.window_height / (THUMBNAIL_HEIGHT + THUMBNAIL_GAP));
+                    return true;
+                    
+                case SDLK_PAGEDOWN:
+                    thumbnail_grid_move(0, viewer.window_height / (THUMBNAIL_HEIGHT + THUMBNAIL_GAP));
+                    return true;
+                    
+                case SDLK_HOME:
+                    thumbnail_grid_select(0);
+                    return true;
+                    
+                case SDLK_END:
+                    thumbnail_grid_select(viewer.image_count - 1);
+                    return true;
+                    
+                // Fullscreen, the overlay and help work in both
+                case SDLK_F:
+                case SDLK_F12:
+                case SDLK_F3:
+                case SDLK_H:
+                    return false;
+                    
+                default:
+                    return true;
+            }
+            
+        default:
+            return false;
+    }
+}
+
+static void handle_events(void) {
+    SDL_Event event;
+    
+    while (SDL_PollEvent(&event)) {
+        // Pointer motion alone never changes what is drawn
+        if (event.type != SDL_EVENT_MOUSE_MOTION) {
+            viewer.needs_redraw = true;
+        }
+        
+        // The overview takes the navigation input while it is shown
+        if (thumbnail_grid_is_open() && handle_grid_event(&event)) {
+            continue;
+        }
+        
+        switch (event.type) {
+            case SDL_EVENT_QUIT:
+                viewer.running = false;
+                break;
+                
+            case SDL_EVENT_LOW_MEMORY:
+                memory_governor_low_memory();
+                break;
+
+            case SDL_EVENT_MOUSE_WHEEL:
+                // Mouse wheel for page navigation
+                if (event.wheel.y > 0) {  // Scroll up
+                    previous_view();
+                } else if (event.wheel.y < 0) {  // Scroll down
+                    next_view();
+                }
+                break;
+                
+            case SDL_EVENT_MOUSE_BUTTON_DOWN:
+                if (event.button.button == SDL_BUTTON_LEFT) {
+                    // Left mouse button pressed - toggle zoom
+                    if (viewer.zoomed) {
+                        // If already zoomed, return to normal view
+                        viewer.zoomed = false;
+                        tile_cache_release_sources();
+                    } else {
+                        // Zoom in with center at click location
+                        viewer.zoomed = true;
+                        viewer.zoom_center_x = event.button.x;
+                        viewer.zoom_center_y = event.button.y;
+                        viewer.zoom_level = 2.0f; // Set zoom level to 200%
+                    }
+                }
+                break;
+                
+            case SDL_EVENT_MOUSE_MOTION:
+                // Dragging with the right button pans a zoomed page
+                if (viewer.zoomed && (event.motion.state & SDL_BUTTON_RMASK)) {
+                    viewer.zoom_center_x += (int)event.motion.xrel;
+                    viewer.zoom_center_y += (int)event.motion.yrel;
+                    viewer.needs_redraw = true;
+                }
+                break;
+                
+            case SDL_EVENT_KEY_DOWN:
+                switch (event.key.key) {
+                    case SDLK_ESCAPE:
+                        viewer.running = false;
+                        break;
+
+                    case SDLK_1: {
+                        ImageView *view = current_view();
+                        if (!view || view->count == 1) {
+                            // This view is already in single image mode
+                            break;
+                        }
+                        // the current view now has 1 image, the second moves to a view of its own after it
+                        ImageView second = view_make_single(view->image_indices[1]);
+                        view->count = 1;
+                        view->image_indices[1] = -1;
+                        view_list_insert(&viewer.views, viewer.current_view_index + 1, &second);
+                        schedule_prefetch();
+
+                        break;
+                    }
+
+                    case SDLK_2: {
+                        ImageView *view = current_view();
+                        ImageView *following = view_at_offset(1);
+                        if (!view || view->count == 2) {
+                            // This view is already in double image mode
+                            break;
+                        }
+                        // check if we are not already displaying the last image
+                        if (following) {
+                            // the current view now has 2 images
+                            view->count = 2;
                             // the second image of the current view is the first image of the next view
-                            viewer.current_view_node->image_indices[1] = viewer.current_view_node->next->image_indices[0];
+                            view->image_indices[1] = following->image_indices[0];
                             // ensure the image is loaded
-                            if (viewer.images[viewer.current_view_node->image_indices[1]].texture == NULL) {
-                                load_image(viewer.current_view_node->image_indices[1]);
-                            }
-                            // remove the next view from the linked list
-                            ImageView *next_view = viewer.current_view_node->next;
-                            if (next_view) {
-                                viewer.current_view_node->next = next_view->next;
-                                if (next_view->next) {
-                                    next_view->next->prev = viewer.current_view_node;
-                                    viewer.current_view_node->next = next_view->next;
-                                }
-                            }
+                            load_image(view->image_indices[1], 0);
+                            // the next view is now part of this one
+                            view_list_remove(&viewer.views, viewer.current_view_index + 1);
+                            schedule_prefetch();
                         }
                         break;
+                    }
                         
                     case SDLK_RIGHT:
+                        // In right-to-left (manga) mode the left arrow turns forward
+                        if (viewer.right_to_left) {
+                            previous_view();
+                        } else {
+                            next_view();
+                        }
+                        break;
+                        
                     case SDLK_SPACE:
                     case SDLK_DOWN:
                         next_view();
                         break;
                         
                     case SDLK_LEFT:
+                        if (viewer.right_to_left) {
+                            next_view();
+                        } else {
+                            previous_view();
+                        }
+                        break;
+                        
                     case SDLK_UP:
                     case SDLK_BACKSPACE:
                         previous_view();
                         break;
                         
                     case SDLK_HOME:
-                        // First image
-                        if (get_current_view() != 0) {
-                            // Clean up any loaded textures except the first one
-                            int view_count = get_view_count();
-                            for (int i = 1; i < view_count; i++) {
-                                unload_images_for_view(i);
-                            }
-                            set_current_view(0);
-                            load_images_for_view(get_current_view());
-
-                            // Preload the next image
-                            if (view_count > 1) {
-                                load_images_for_view(get_current_view() + 1);
-                            }
-                        }
+                        // First image, prefetch forward from there
+                        navigate_to(0, 1);
                         break;
                         
                     case SDLK_END:
-                        // Last image
-                        {
-                            int view_count = get_view_count();
-                            if (get_current_view() != view_count - 1) {
-                                // Clean up any loaded textures except the last one
-                                for (int i = 0; i < view_count - 1; i++) {
-                                    unload_images_for_view(i);
-                                }
-                                set_current_view(view_count - 1);
-                                load_images_for_view(get_current_view());
-
-                                // Preload the previous image
-                                if (view_count > 1) {
-                                    load_images_for_view(get_current_view() - 1);
-                                }
-                            }
-                        }
+                        // Last image, prefetch backward from there
+                        navigate_to(get_view_count() - 1, -1);
                         break;
 
                     case SDLK_F:
@@ -711,6 +1694,17 @@ static void handle_events(void) {
                         toggle_fullscreen();
                         break;
                         
+                    case SDLK_F3:
+                        viewer.show_perf_overlay = !viewer.show_perf_overlay;
+                        break;
+                        
+                    case SDLK_G: {
+                        // Overview of every page, starting at the current one
+                        ImageView *view = current_view();
+                        thumbnail_grid_open(view ? view->image_indices[0] : 0);
+                        break;
+                    }
+                        
                     // Zoom controls
                     case SDLK_EQUALS: // Plus key (often requires shift)
                     case SDLK_KP_PLUS: // Numpad plus
@@ -731,6 +1725,7 @@ static void handle_events(void) {
                                 // Exit zoom mode if we go below 100%
                                 viewer.zoomed = false;
                                 viewer.zoom_level = 1.0f;
+                                tile_cache_release_sources();
                             }
                         }
                         break;
@@ -742,15 +1737,15 @@ static void handle_events(void) {
                             viewer.zoom_center_x = viewer.window_width / 2;
                             viewer.zoom_center_y = viewer.window_height / 2;
                             viewer.zoom_level = 2.0f;
+                        } else {
+                            tile_cache_release_sources();
                         }
                         break;
                         
                     case SDLK_E: // Toggle image enhancements
                         {
                             options->enhancement_enabled = !options->enhancement_enabled;
-                            // Force reload of only the currently visible images to apply/remove enhancements
-                            unload_images_for_view(get_current_view());
-                            load_images_for_view(get_current_view());
+                            reapply_enhancement();
                         }
                         break;
                         
@@ -762,7 +1757,10 @@ static void handle_events(void) {
                         printf("F / F12                       : Toggle fullscreen\n");
                         printf("Z                             : Toggle zoom mode\n");
                         printf("+/- (or numpad)               : Zoom in/out\n");
+                        printf("Right drag                    : Pan while zoomed\n");
                         printf("E                             : Toggle image enhancements\n");
+                        printf("F3                            : Toggle performance overlay\n");
+                        printf("G                             : Page overview (Enter or click to jump)\n");
                         printf("H                             : Show this help\n");
                         printf("Delete                        : Remove current view from list\n");
                         printf("Escape                        : Exit\n");
@@ -790,22 +1788,29 @@ static void handle_events(void) {
                                                     viewer.window_height,
                                                     SDL_LOGICAL_PRESENTATION_LETTERBOX);
                 }
+                
+                // Pages decoded for a smaller window are decoded again at the new size
+                schedule_prefetch();
                 break;
                 
             case SDL_EVENT_WINDOW_EXPOSED:
-                // Window needs to be redrawn
-                render_current_view();
+                // Window needs to be redrawn, already flagged above
                 break;
         }
     }
 }
 
 static void render_current_view(void) {
+    TraceZone zone = trace_begin("render_current_view");
+    Uint64 frame_start = SDL_GetTicksNS();
+    
     // Clear the screen with black background
     SDL_SetRenderDrawColor(viewer.renderer, 0, 0, 0, 255);
     SDL_RenderClear(viewer.renderer);
 
-    if (viewer.page_turning_in_progress) {
+    if (thumbnail_grid_is_open()) {
+        thumbnail_grid_render(viewer.window_width, viewer.window_height);
+    } else if (viewer.page_turning_in_progress) {
         ImageEntry *current_img = &viewer.images[get_current_view()];
         ImageEntry *next_img = &viewer.images[viewer.target_view];
 
@@ -861,7 +1866,7 @@ static void render_current_view(void) {
         }
     } else {
         // Normal rendering
-        ImageView *current_display_view = viewer.current_view_node;
+        ImageView *current_display_view = current_view();
         if (!current_display_view) return;
         
         int num_images_in_this_view = current_display_view->count;
@@ -997,17 +2002,25 @@ static void render_current_view(void) {
                 }
 
                 if (i == 0) {
-                    // Analyze the left edge of the first image
-                    analyze_image_left_edge(image_idx, &left_gradient_color);
+                    // Left edge of the first image, computed at decode time
+                    left_gradient_color = img->left_color;
                 }
                 
                 if (i == (num_images_in_this_view - 1)) {
-                    // Analyze the right edge of the last image
-                    analyze_image_right_edge(image_idx, &right_gradient_color);
+                    // Right edge of the last image, computed at decode time
+                    right_gradient_color = img->right_color;
                 }
 
                 SDL_FRect dest_rect = {x_pos_render, y_pos_render, (float)scaled_width, (float)scaled_height};
                 SDL_RenderTexture(viewer.renderer, img->texture, &img->crop_rect, &dest_rect);
+                
+                // Pages magnified past their decoded size are drawn over with full resolution tiles
+                if (viewer.zoomed && img->reduced_height > 0 && dest_rect.h > img->crop_rect.h) {
+                    SDL_FRect viewport = {0, 0, display_area_width, display_area_height};
+                    TileEnhancement enhancement = {*options, img->enhance};
+                    tile_cache_render(image_idx, img->width, img->crop_rect, dest_rect, viewport,
+                                      viewer.decode_generation, &enhancement);
+                }
             }
         }
 
@@ -1027,9 +2040,22 @@ static void render_current_view(void) {
     }
     
     display_info();
+    display_perf_overlay();
+    tile_cache_end_frame();
 
     // Update screen
     SDL_RenderPresent(viewer.renderer);
+    
+    viewer.frame_ns = SDL_GetTicksNS() - frame_start;
+    viewer.frame_ns_avg = viewer.frame_ns_avg > 0 ? viewer.frame_ns_avg * 0.9 + viewer.frame_ns * 0.1 : viewer.frame_ns;
+    trace_end(&zone);
+    
+    // A page turn ends when its view is on screen
+    PageTurnTiming *turn = &viewer.last_turn;
+    if (turn->pending && turn->image_index >= 0 && viewer.images[turn->image_index].texture) {
+        turn->total_ns = SDL_GetTicksNS() - turn->start_ns;
+        turn->pending = false;
+    }
 }
 
 void display_info()
@@ -1041,8 +2067,8 @@ void display_info()
     Uint64 current_time = SDL_GetTicks();
     Uint64 elapsed_time = current_time - viewer.last_page_change_time;
     
-    // Only show progress indicator for 2 seconds (2000 ms) after a page change
-    if (elapsed_time <= 2000) {
+    // Only show progress indicator for a short while after a page change
+    if (elapsed_time <= PROGRESS_INDICATOR_DURATION_MS) {
         // Calculate progress as a value between 0.0 and 1.0
         int view_count = get_view_count();
         float progress = (float)get_current_view() / (float)(view_count - 1);
@@ -1086,26 +2112,25 @@ void display_info()
 }
 
 static void free_resources(void) {
+    free_gradient_cache();
+    
     // Free image resources
     for (int i = 0; i < viewer.image_count; i++) {
-        if (viewer.images[i].surface) {
-            SDL_DestroySurface(viewer.images[i].surface);
-            viewer.images[i].surface = NULL;
-        }
-        if (viewer.images[i].texture) {
-            SDL_DestroyTexture(viewer.images[i].texture);
-            viewer.images[i].texture = NULL;
-        }
+        page_cache_drop_surface(&viewer.images[i]);
+        page_cache_drop_texture(&viewer.images[i]);
         free(viewer.images[i].path);
         viewer.images[i].path = NULL;
     }
+    free(viewer.images);
+    viewer.images = NULL;
+    viewer.image_count = 0;
     
     // Free source path
     free(viewer.source_path);
     viewer.source_path = NULL;
     
-    // Free views linked list
-    free_all_views();
+    // Free the views
+    view_list_free(&viewer.views);
     
     // Free font resources
     if (viewer.font) {
@@ -1113,6 +2138,9 @@ static void free_resources(void) {
         viewer.font = NULL;
     }
     
+    // Pooled textures belong to the renderer
+    page_pool_shutdown();
+    
     // Destroy renderer and window
     if (viewer.renderer) {
         SDL_DestroyRenderer(viewer.renderer);
@@ -1262,66 +2290,24 @@ static SDL_Color get_dominant_color(SDL_Surface *surface, int x, int y, int widt
     return dominant;
 }
 
-// This function analyzes the image and extracts the dominant color from the left edge
-static void analyze_image_left_edge(int index, SDL_Color *left_color) {
-    // Default to black if something goes wrong
-    *left_color = (SDL_Color){0, 0, 0, 255};
-    
-    // Basic validation
-    if (index < 0 || index >= viewer.image_count || !viewer.images[index].path) return;
-    
-    SDL_Surface *surface = viewer.images[index].surface;
-    if (!surface) {
-        // Attempt to load surface if not already loaded (e.g., if only texture was created directly)
-        // This might happen if create_high_quality_texture was called but surface was freed or not kept.
-        // For robust edge analysis, the surface is needed.
-        // However, typically, create_high_quality_texture should keep the surface if analysis is needed.
-        // If it's critical and surface is often NULL here, load_image might need to ensure surface is populated.
-        // For now, assume surface should be available if image is loaded.
-        fprintf(stderr, "Failed to get surface for left edge analysis (image %d): Surface is NULL.\n", index);
-        // We could try IMG_Load here again if viewer.images[index].path is valid,
-        // but that implies a design issue if it's not kept.
-        return;
-    }
-    
-    // Get image dimensions
-    int width = surface->w;
-    int height = surface->h;
-    
+// Dominant color of the left edge (8% of width), runs on the decode workers
+static SDL_Color analyze_left_edge(SDL_Surface *surface) {
     // Sample pixels from the left edge (8% of width)
-    int edge_width = width * 0.08;
+    int edge_width = surface->w * 0.08;
     if (edge_width < 1) edge_width = 1;
-    if (edge_width > width) edge_width = width; // Cap at image width
+    if (edge_width > surface->w) edge_width = surface->w; // Cap at image width
 
-    // Get dominant color from left edge
-    *left_color = get_dominant_color(surface, 0, 0, edge_width, height);
+    return get_dominant_color(surface, 0, 0, edge_width, surface->h);
 }
 
-// This function analyzes the image and extracts the dominant color from the right edge
-static void analyze_image_right_edge(int index, SDL_Color *right_color) {
-    // Default to black if something goes wrong
-    *right_color = (SDL_Color){0, 0, 0, 255};
-
-    // Basic validation
-    if (index < 0 || index >= viewer.image_count || !viewer.images[index].path) return;
-
-    SDL_Surface *surface = viewer.images[index].surface;
-    if (!surface) {
-        fprintf(stderr, "Failed to get surface for right edge analysis (image %d): Surface is NULL.\n", index);
-        return;
-    }
-
-    // Get image dimensions
-    int width = surface->w;
-    int height = surface->h;
-
+// Dominant color of the right edge (8% of width), runs on the decode workers
+static SDL_Color analyze_right_edge(SDL_Surface *surface) {
     // Sample pixels from the right edge (8% of width)
-    int edge_width = width * 0.08;
+    int edge_width = surface->w * 0.08;
     if (edge_width < 1) edge_width = 1;
-    if (edge_width > width) edge_width = width; // Cap at image width
-    
-    // Get dominant color from right edge
-    *right_color = get_dominant_color(surface, width - edge_width, 0, edge_width, height);
+    if (edge_width > surface->w) edge_width = surface->w; // Cap at image width
+
+    return get_dominant_color(surface, surface->w - edge_width, 0, edge_width, surface->h);
 }
 
 // Function to render text as a texture
@@ -1344,6 +2330,80 @@ static SDL_Texture* render_text(const char *text, SDL_Color color) {
     return texture;
 }
 
+// Frame time, cache hit rate, decode queue and the last page turn, top right
+static void display_perf_overlay(void) {
+    if (!viewer.show_perf_overlay) return;
+    
+    PageCacheStats stats = page_cache_get_stats();
+    Uint64 hits = stats.texture_hits + stats.surface_hits;
+    Uint64 lookups = hits + stats.misses;
+    const PageTurnTiming *turn = &viewer.last_turn;
+    
+    char lines[8][128];
+    int line_count = 0;
+    snprintf(lines[line_count++], sizeof(lines[0]), "Frame %.2f ms (avg %.2f)",
+             viewer.frame_ns / 1e6, viewer.frame_ns_avg / 1e6);
+    snprintf(lines[line_count++], sizeof(lines[0]), "Cache %.0f%% hits (%llu tex, %llu surf, %llu miss)",
+             lookups ? 100.0 * hits / lookups : 0.0, (unsigned long long)stats.texture_hits,
+             (unsigned long long)stats.surface_hits, (unsigned long long)stats.misses);
+    snprintf(lines[line_count++], sizeof(lines[0]), "Decode queue %d, surfaces %zu MB, textures %zu MB",
+             decode_pool_queue_depth(), stats.surface_bytes >> 20, stats.texture_bytes >> 20);
+    PagePoolStats pool = page_pool_get_stats();
+    snprintf(lines[line_count++], sizeof(lines[0]), "Pool reuse: %llu/%llu surfaces, %llu/%llu textures",
+             (unsigned long long)pool.surface_reuses,
+             (unsigned long long)(pool.surface_reuses + pool.surface_allocations),
+             (unsigned long long)pool.texture_reuses,
+             (unsigned long long)(pool.texture_reuses + pool.texture_allocations));
+    MemoryGovernorStats memory = memory_governor_get_stats();
+    snprintf(lines[line_count++], sizeof(lines[0]), "Memory %s: %zu/%zu MB%s, PSI %.1f%%",
+             memory_pressure_name(memory.level), memory.usage >> 20, memory.limit >> 20,
+             memory.cgroup ? " (cgroup)" : "", memory.psi_some > 0 ? memory.psi_some : 0.0);
+    snprintf(lines[line_count++], sizeof(lines[0]), "Budgets %zu/%zu MB, prefetch +%d/-%d, %d threads, %llu evictions",
+             stats.surface_budget >> 20, stats.texture_budget >> 20, viewer.prefetch_ahead, viewer.prefetch_behind,
+             decode_pool_active_threads(), (unsigned long long)stats.evictions);
+    if (turn->start_ns == 0) {
+        snprintf(lines[line_count++], sizeof(lines[0]), "Last turn: none yet");
+    } else if (turn->pending) {
+        snprintf(lines[line_count++], sizeof(lines[0]), "Last turn: waiting %.1f ms",
+                 (SDL_GetTicksNS() - turn->start_ns) / 1e6);
+    } else if (turn->cached || turn->decode_ns == 0) {
+        snprintf(lines[line_count++], sizeof(lines[0]), "Last turn %.1f ms (already decoded)", turn->total_ns / 1e6);
+    } else {
+        snprintf(lines[line_count++], sizeof(lines[0]), "Last turn %.1f ms", turn->total_ns / 1e6);
+        snprintf(lines[line_count++], sizeof(lines[0]), "  queue %.1f, decode %.1f, upload %.1f ms",
+                 turn->queue_ns / 1e6, turn->decode_ns / 1e6, turn->upload_ns / 1e6);
+    }
+    
+    SDL_Texture *textures[8];
+    float width = 0, height = 0;
+    for (int i = 0; i < line_count; i++) {
+        textures[i] = render_text(lines[i], white);
+        if (textures[i]) {
+            float w, h;
+            SDL_GetTextureSize(textures[i], &w, &h);
+            if (w > width) width = w;
+            height += h;
+        }
+    }
+    
+    const float margin = 10;
+    SDL_FRect box = {viewer.drawable_width - width - 3 * margin, margin, width + 2 * margin, height + 2 * margin};
+    SDL_SetRenderDrawBlendMode(viewer.renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(viewer.renderer, 0, 0, 0, 180);
+    SDL_RenderFillRect(viewer.renderer, &box);
+    
+    float y = box.y + margin;
+    for (int i = 0; i < line_count; i++) {
+        if (!textures[i]) continue;
+        float w, h;
+        SDL_GetTextureSize(textures[i], &w, &h);
+        SDL_FRect rect = {box.x + margin, y, w, h};
+        SDL_RenderTexture(viewer.renderer, textures[i], NULL, &rect);
+        SDL_DestroyTexture(textures[i]);
+        y += h;
+    }
+}
+
 // Function to select monitor and get its position
 static bool select_monitor(int monitor_index, int *x, int *y) {
     int num_displays;
@@ -1370,197 +2430,74 @@ static bool select_monitor(int monitor_index, int *x, int *y) {
     return true;
 }
 
-// Helper function for high-quality image scaling with border detection and removal
-static void create_texture(SDL_Renderer *renderer, ImageEntry *image) {
-    // Load the image as a surface using FreeImage
-    image->surface = image_load_surface(image->path, options);
-    if (!image->surface) {
-        fprintf(stderr, "Failed to load image %s with FreeImage\n", image->path);
-        return;
+// Write the enhanced page straight into a locked streaming texture, the copy an upload makes anyway
+// Gray pages are written into the Y plane of an IYUV texture
+static SDL_Texture* upload_enhanced(ImageEntry *image) {
+    SDL_Surface *surface = image->surface;
+    bool gray = page_pool_is_gray(surface);
+    SDL_Texture *texture = page_pool_acquire_texture(surface->w, surface->h,
+                                                     gray ? SDL_PIXELFORMAT_IYUV : surface->format);
+    void *pixels;
+    int pitch;
+    if (!texture || !SDL_LockTexture(texture, NULL, &pixels, &pitch)) {
+        page_pool_release_texture(texture);
+        return NULL;
     }
-
-    // Detect and crop white borders
-    int left = 0, right = image->surface->w - 1;
-    int top = 0, bottom = image->surface->h - 1;
-    int threshold = 240; // Threshold for considering a pixel "white" (0-255)
-    int required_non_white = 3; // Number of non-white pixels required to stop scanning
     
-    // Analyze pixels to detect borders
-    uint8_t *pixels = (uint8_t*)image->surface->pixels;
-    int pitch = image->surface->pitch;
-    const SDL_PixelFormatDetails *details = SDL_GetPixelFormatDetails(image->surface->format);
-    int bpp = details->bytes_per_pixel;
-
-    SDL_Palette *palette = SDL_GetSurfacePalette(image->surface);
+    BenchTimer timer = bench_start();
+    TraceZone zone = trace_begin("enhance_copy");
+    bool enhanced = enhance_copy(surface, pixels, pitch, &image->enhance, options);
+    trace_end(&zone);
+    bench_stop(&timer, BENCH_ENHANCE);
+    if (gray) {
+        page_pool_neutral_chroma(pixels, pitch, surface->h);
+    }
+    SDL_UnlockTexture(texture);
     
-    // Scan from left edge inward
-    for (left = 0; left < image->surface->w / 2; left++) {
-        int non_white_count = 0;
-        
-        for (int y = 0; y < image->surface->h; y += 2) { // Sample every other pixel for speed
-            uint32_t pixel = 0;
-            uint8_t *p = pixels + y * pitch + left * bpp;
-            
-            switch (bpp) {
-                case 1: pixel = *p; break;
-                case 2: pixel = *(uint16_t*)p; break;
-                case 3: 
-                    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                        pixel = p[0] << 16 | p[1] << 8 | p[2]; 
-                    #else
-                        pixel = p[0] | p[1] << 8 | p[2] << 16; 
-                    #endif
-                    break;
-                case 4: pixel = *(uint32_t*)p; break;
-            }
-            
-            uint8_t r, g, b, a;
-            SDL_GetRGBA(pixel, details, palette, &r, &g, &b, &a);
-            
-            // If pixel is not "white" (using average of RGB values)
-            int avg = (r + g + b) / 3;
-            if (avg < threshold) {
-                non_white_count++;
-                if (non_white_count >= required_non_white) {
-                    break;
-                }
-            }
-        }
-        
-        if (non_white_count >= required_non_white) {
-            break; // Found non-white content
-        }
+    if (!enhanced) {
+        page_pool_release_texture(texture);
+        return NULL;
     }
-    
-    // Scan from right edge inward
-    for (right = image->surface->w - 1; right > left + 100; right--) { // Ensure min width
-        int non_white_count = 0;
-        
-        for (int y = 0; y < image->surface->h; y += 2) {
-            uint32_t pixel = 0;
-            uint8_t *p = pixels + y * pitch + right * bpp;
-            
-            switch (bpp) {
-                case 1: pixel = *p; break;
-                case 2: pixel = *(uint16_t*)p; break;
-                case 3: 
-                    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                        pixel = p[0] << 16 | p[1] << 8 | p[2]; 
-                    #else
-                        pixel = p[0] | p[1] << 8 | p[2] << 16; 
-                    #endif
-                    break;
-                case 4: pixel = *(uint32_t*)p; break;
-            }
-            
-            uint8_t r, g, b, a;
-            SDL_GetRGBA(pixel, SDL_GetPixelFormatDetails(image->surface->format), palette, &r, &g, &b, &a);
-            
-            int avg = (r + g + b) / 3;
-            if (avg < threshold) {
-                non_white_count++;
-                if (non_white_count >= required_non_white) {
-                    break;
-                }
-            }
-        }
-        
-        if (non_white_count >= required_non_white) {
-            break; // Found non-white content
-        }
+    return texture;
+}
+
+// Upload a decoded surface into a pooled texture, must be called from the main thread
+// Enhancement happens here so changing the options only re-uploads the cached surfaces
+static void create_texture(ImageEntry *image) {
+    BenchTimer timer = bench_start();
+    TraceZone zone = trace_begin("create_texture");
+    image->texture = options && options->enhancement_enabled ? upload_enhanced(image) : NULL;
+    if (!image->texture) {
+        image->texture = page_pool_upload(image->surface);
     }
-    
-    // Scan from top edge down
-    for (top = 0; top < image->surface->h / 2; top++) {
-        int non_white_count = 0;
-        
-        for (int x = left; x <= right; x += 2) {
-            uint32_t pixel = 0;
-            uint8_t *p = pixels + top * pitch + x * bpp;
-            
-            switch (bpp) {
-                case 1: pixel = *p; break;
-                case 2: pixel = *(uint16_t*)p; break;
-                case 3: 
-                    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                        pixel = p[0] << 16 | p[1] << 8 | p[2]; 
-                    #else
-                        pixel = p[0] | p[1] << 8 | p[2] << 16; 
-                    #endif
-                    break;
-                case 4: pixel = *(uint32_t*)p; break;
-            }
-            
-            uint8_t r, g, b, a;
-            SDL_GetRGBA(pixel, SDL_GetPixelFormatDetails(image->surface->format), palette, &r, &g, &b, &a);
-            
-            int avg = (r + g + b) / 3;
-            if (avg < threshold) {
-                non_white_count++;
-                if (non_white_count >= required_non_white) {
-                    break;
-                }
-            }
-        }
+    trace_end(&zone);
+    bench_stop(&timer, BENCH_UPLOAD);
+    if (!image->texture) {
+        fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
         
-        if (non_white_count >= required_non_white) {
-            break; // Found non-white content
-        }
+        // Most often the driver is out of video memory, the governor lowers the texture budget
+        memory_governor_texture_failed(page_cache_get_stats().texture_bytes);
     }
-    
-    // Scan from bottom edge up
-    for (bottom = image->surface->h - 1; bottom > top + 100; bottom--) { // Ensure min height
-        int non_white_count = 0;
-        
-        for (int x = left; x <= right; x += 2) {
-            uint32_t pixel = 0;
-            uint8_t *p = pixels + bottom * pitch + x * bpp;
-            
-            switch (bpp) {
-                case 1: pixel = *p; break;
-                case 2: pixel = *(uint16_t*)p; break;
-                case 3: 
-                    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-                        pixel = p[0] << 16 | p[1] << 8 | p[2]; 
-                    #else
-                        pixel = p[0] | p[1] << 8 | p[2] << 16; 
-                    #endif
-                        break;
-                case 4: pixel = *(uint32_t*)p; break;
-            }
-            
-            uint8_t r, g, b, a;
-            SDL_GetRGBA(pixel, SDL_GetPixelFormatDetails(image->surface->format), palette, &r, &g, &b, &a);
-            
-            int avg = (r + g + b) / 3;
-            if (avg < threshold) {
-                non_white_count++;
-                if (non_white_count >= required_non_white) {
-                    break;
-                }
-            }
-        }
+}
+
+// Re-upload the pages after an options change, cached surfaces are unenhanced so nothing is decoded again
+static void reapply_enhancement(void) {
+    for (int i = 0; i < viewer.image_count; i++) {
+        ImageEntry *image = &viewer.images[i];
+        if (!image->texture) continue;
         
-        if (non_white_count >= required_non_white) {
-            break; // Found non-white content
+        // Pages kept only as textures are decoded again, the others re-upload on their next use
+        page_cache_drop_texture(image);
+        if (image->surface && image_in_prefetch_window(i)) {
+            create_texture(image);
+            if (image->texture) page_cache_add_texture(image);
         }
     }
-
-    SDL_FRect crop_rect = {left, top, right - left + 1, bottom - top + 1};
-    if (crop_rect.w <= 0 || crop_rect.h <= 0) {
-        // reset crop rect to full image size
-        crop_rect.x = 0;
-        crop_rect.y = 0;
-        crop_rect.w = image->surface->w;
-        crop_rect.h = image->surface->h;
-    }
-    image->crop_rect = crop_rect;
-
-    // Create a texture from the surface
-    image->texture = SDL_CreateTextureFromSurface(renderer, image->surface);
-    if (!image->texture) {
-        fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
-    }
+    
+    // Zoom tiles are cut from enhanced sources
+    tile_cache_clear();
+    schedule_prefetch();
+    viewer.needs_redraw = true;
 }
 
 // Helper function for progress callback
@@ -1569,155 +2506,569 @@ static void update_progress(float progress, const char *message) {
 }
 
 void view_changed(ImageView *old_view_node, ImageView *new_view_node) {
+    (void)old_view_node;
+    
+    // Start timing the turn before the prefetch is queued
+    if (new_view_node) {
+        int image_index = new_view_node->image_indices[0];
+        viewer.last_turn = (PageTurnTiming){0};
+        viewer.last_turn.start_ns = SDL_GetTicksNS();
+        viewer.last_turn.image_index = image_index;
+        viewer.last_turn.pending = true;
+        viewer.last_turn.cached = image_index >= 0 && viewer.images[image_index].texture != NULL;
+    }
+    
     // Update the page change timer
     viewer.last_page_change_time = SDL_GetTicks();
     viewer.show_progress_indicator = true;
     
-    // Unload old view images
-    if (old_view_node) {
-        for (int i = 0; i < old_view_node->count; i++) {
-            int img_idx = old_view_node->image_indices[i];
-            unload_image(img_idx);
-        }
-    }
-
-    // Load new view images
+    // Move the prefetch window; images that fall out of it are unloaded
     if (new_view_node) {
-        for (int i = 0; i < new_view_node->count; i++) {
-            int img_idx = new_view_node->image_indices[i];
-            load_image(img_idx);
-        }
+        schedule_prefetch();
+    }
+    
+    // Open the next volume while the last pages of this one are read
+    if (viewer.series_mode && new_view_node && viewer.direction > 0 &&
+        new_view_node->image_indices[0] >= viewer.image_count - viewer.series_preopen_pages &&
+        series_state() == SERIES_IDLE) {
+        series_preopen(viewer.source_path, decode_volume_page, decode_target_height());
     }
 }
 
+// View the navigation of this frame has reached so far
+static int navigation_base(void) {
+    return viewer.pending_view_index >= 0 ? viewer.pending_view_index : viewer.current_view_index;
+}
+
+// Move the target of this frame, the view itself changes in apply_pending_view
+static void navigate_to(int view_index, int direction) {
+    if (!get_view_by_index(view_index)) return;
+    
+    viewer.pending_view_index = view_index;
+    viewer.direction = direction;
+}
+
 void previous_view() {
-    if (!viewer.current_view_node || !viewer.current_view_node->prev || viewer.page_turning_in_progress) {
+    navigate_to(navigation_base() - 1, -1);
+}
+
+
+void next_view() {
+    int base = navigation_base();
+    
+    // Past the last view, series mode moves on to the next volume
+    if (!get_view_by_index(base + 1)) {
+        apply_pending_view();
+        if (viewer.series_mode) {
+            SeriesState state = series_state();
+            if (state == SERIES_READY) {
+                switch_to_next_volume();
+            } else if (state == SERIES_OPENING) {
+                viewer.series_switch_pending = true;
+            }
+        }
         return;
     }
 
-    ImageView *old_view_node = viewer.current_view_node;
-    viewer.current_view_node = viewer.current_view_node->prev;
-    viewer.current_view_index--;
-    view_changed(old_view_node, viewer.current_view_node);
+    navigate_to(base + 1, 1);
 }
 
+// Main loop: turn to the view the events of this frame lead to, however many there were;
+// turns in quick succession only decode a preview of the view landed on
+static void apply_pending_view(void) {
+    int target = viewer.pending_view_index;
+    if (target < 0 || viewer.page_turning_in_progress) return;
+    
+    viewer.pending_view_index = -1;
+    if (target == viewer.current_view_index) return;
+    
+    viewer.scrubbing = SDL_GetTicks() - viewer.last_page_change_time < SCRUB_INTERVAL_MS;
+    ImageView *old_view_node = current_view();
+    set_current_view(target);
+    view_changed(old_view_node, current_view());
+}
 
-void next_view() {
-    if (!viewer.current_view_node || !viewer.current_view_node->next || viewer.page_turning_in_progress) {
+// Main loop: once input has stopped, queue the full decodes around the view landed on
+static void poll_scrubbing(void) {
+    if (!viewer.scrubbing || SDL_GetTicks() - viewer.last_page_change_time < SCRUB_INTERVAL_MS) {
         return;
     }
-
-    ImageView *old_view_node = viewer.current_view_node;
-    viewer.current_view_node = viewer.current_view_node->next;
-    viewer.current_view_index++;
-    view_changed(old_view_node, viewer.current_view_node);
+    
+    viewer.scrubbing = false;
+    schedule_prefetch();
+    viewer.needs_redraw = true;
 }
 
-static void generate_default_views() {
-    // Clear any existing views
-    free_all_views();
+// Page sizes measured in the background, applied on the main thread when all are in
+typedef struct {
+    int width;
+    int height;
+} ProbedSize;
+
+typedef enum {
+    PROBE_WAITING,    // Waiting for the first view to be decoded
+    PROBE_RUNNING,
+    PROBE_DONE
+} ProbeState;
+
+static struct {
+    ProbeState state;
+    ProbedSize *sizes;
+    SDL_Thread *threads[MAX_DECODE_THREADS];
+    int thread_count;
+    Uint32 event_type;       // Pushed by the last worker to wake the main loop
+    Uint64 start;
+    SDL_AtomicInt next;      // Next image index for the probe threads to claim
+    SDL_AtomicInt done;      // Images finished so far
+} probe;
+
+// Runs on a probe thread: read page sizes from their headers until every page is claimed
+static int probe_worker(void *data) {
+    (void)data;
     
-    viewer.view_count = 0;
-    int i = 0;
+    // Page decodes for the screen go first
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
     
-    ImageView *prev_view = NULL;
-    while (i < viewer.image_count) {
-        ImageView *view = create_view_node(prev_view);
-        if (!view) {
-            fprintf(stderr, "Failed to create view node\n");
-            return;
+    int index;
+    while ((index = SDL_AddAtomicInt(&probe.next, 1)) < viewer.image_count) {
+        int width = 0, height = 0;
+        bool found;
+        if (viewer.archive) {
+            found = archive_get_page_size(viewer.archive, index, &width, &height);
+        } else {
+            char *path = copy_image_path(index);
+            found = path && (image_probe_file(path, &width, &height) || image_load_size(path, &width, &height));
+            free(path);
         }
         
-        // Single image view by default
-        view->image_indices[0] = i;
+        // Unknown sizes stay 0, those pages are never paired
+        if (found) {
+            probe.sizes[index].width = width;
+            probe.sizes[index].height = height;
+        }
+        if (SDL_AddAtomicInt(&probe.done, 1) + 1 == viewer.image_count && probe.event_type) {
+            SDL_Event event = {0};
+            event.type = probe.event_type;
+            SDL_PushEvent(&event);
+        }
+    }
+    
+    return 0;
+}
 
-        prev_view = view;
-        
-        append_view(view);
-        i++;
+static void start_page_probe(void) {
+    probe.start = SDL_GetTicks();
+    SDL_SetAtomicInt(&probe.next, 0);
+    SDL_SetAtomicInt(&probe.done, 0);
+    
+    probe.sizes = calloc(viewer.image_count, sizeof(ProbedSize));
+    if (!probe.sizes) {
+        fprintf(stderr, "Failed to allocate memory for page sizes, spreads are not laid out\n");
+        probe.state = PROBE_DONE;
+        return;
+    }
+    if (!probe.event_type) {
+        probe.event_type = SDL_RegisterEvents(1);
+    }
+    
+    // Probing mostly waits on I/O, so use more threads than there are decode workers
+    int thread_count = viewer.decode_threads * 2;
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MAX_DECODE_THREADS) thread_count = MAX_DECODE_THREADS;
+    
+    probe.thread_count = 0;
+    for (int i = 0; i < thread_count; i++) {
+        probe.threads[probe.thread_count] = SDL_CreateThread(probe_worker, "ic_probe", NULL);
+        if (!probe.threads[probe.thread_count]) {
+            fprintf(stderr, "Failed to create probe thread: %s\n", SDL_GetError());
+            break;
+        }
+        probe.thread_count++;
     }
     
-    // Set the current view to the first view
-    if (viewer.first_view) {
-        viewer.current_view_node = viewer.first_view;
-        viewer.current_view_index = 0;
+    if (probe.thread_count == 0) {
+        probe_worker(NULL);
     }
+    probe.state = PROBE_RUNNING;
 }
 
-// Internal helper functions
+// Index of the view showing an image, 0 if none does
+static int view_index_of_image(int image_index) {
+    int count = get_view_count();
+    for (int v = 0; v < count; v++) {
+        ImageView *view = get_view_by_index(v);
+        for (int i = 0; i < view->count; i++) {
+            if (view->image_indices[i] == image_index) {
+                return v;
+            }
+        }
+    }
+    return 0;
+}
 
-// Linked list helper functions
-static ImageView* create_view_node(ImageView* prev_view) {
-    ImageView *view = malloc(sizeof(ImageView));
-    if (!view) {
-        fprintf(stderr, "Failed to allocate memory for view node\n");
-        return NULL;
+static void finish_page_probe(void) {
+    for (int i = 0; i < probe.thread_count; i++) {
+        SDL_WaitThread(probe.threads[i], NULL);
+    }
+    probe.thread_count = 0;
+    
+    // Pages decoded meanwhile already have their size, with the same aspect ratio
+    for (int i = 0; i < viewer.image_count; i++) {
+        if (viewer.images[i].width == 0 && probe.sizes[i].width > 0) {
+            viewer.images[i].width = probe.sizes[i].width;
+            viewer.images[i].height = probe.sizes[i].height;
+        }
     }
+    free(probe.sizes);
+    probe.sizes = NULL;
+    probe.state = PROBE_DONE;
+    
+    printf("Measured %d pages in %llu ms\n", viewer.image_count, (unsigned long long)(SDL_GetTicks() - probe.start));
     
-    // Initialize the view
-    view->count = 1; // Default to one image per view
-    view->total_width = 0;
-    view->max_height = 0;
-    view->crop_rect = (SDL_FRect){0, 0, 0, 0};
-    view->next = NULL;
-    view->prev = prev_view;
+    // Lay out the spreads, staying on the page being read
+    ImageView *view = current_view();
+    int image_index = view ? view->image_indices[0] : 0;
+    generate_default_views();
+    set_current_view(view_index_of_image(image_index));
+    schedule_prefetch();
+    viewer.needs_redraw = true;
+}
 
-    for (int i = 0; i < MAX_IMAGES_PER_VIEW; i++) {
-        view->image_indices[i] = -1;
+// Main loop: start the probe once the first view has been decoded, finish it when all pages are in
+static void poll_page_probe(void) {
+    if (probe.state == PROBE_WAITING) {
+        ImageView *view = current_view();
+        if (!view) return;
+        for (int i = 0; i < view->count; i++) {
+            if (viewer.images[view->image_indices[i]].decode_pending) {
+                return;
+            }
+        }
+        start_page_probe();
     }
     
-    return view;
+    if (probe.state == PROBE_RUNNING && SDL_GetAtomicInt(&probe.done) >= viewer.image_count) {
+        finish_page_probe();
+    }
 }
 
-static void append_view(ImageView *view) {
-    if (!view) return;
+// Quitting while pages are still measured: let the threads stop before the archive closes
+static void stop_page_probe(void) {
+    if (probe.state != PROBE_RUNNING) return;
+    
+    SDL_SetAtomicInt(&probe.next, viewer.image_count);
+    for (int i = 0; i < probe.thread_count; i++) {
+        SDL_WaitThread(probe.threads[i], NULL);
+    }
+    probe.thread_count = 0;
+    free(probe.sizes);
+    probe.sizes = NULL;
+    probe.state = PROBE_DONE;
+}
+
+static bool any_decode_job(int index, int tile) {
+    (void)index;
+    (void)tile;
+    return true;
+}
+
+// Wait for the running decodes of the current volume and drop everything the workers return
+static void drain_decode_pool(void) {
+    decode_pool_cancel(any_decode_job, clear_decode_pending);
+    decode_pool_wait_idle();
+    
+    DecodeResult result;
+    while (decode_pool_poll(&result)) {
+        if (result.tile != DECODE_WHOLE_PAGE && result.tile != DECODE_PAGE_PREVIEW) {
+            SDL_DestroySurface(result.surface);
+        } else {
+            clear_decode_pending(result.index, result.tile);
+            page_pool_release_surface(result.surface);
+        }
+        free(result.path);
+    }
+}
+
+// Replace the volume being read with the one opened by series mode, from its first view
+static void switch_to_next_volume(void) {
+    viewer.series_switch_pending = false;
+    SeriesVolume *volume = series_take();
+    if (!volume) return;
+    
+    ImageEntry *images = calloc(volume->image_count, sizeof(ImageEntry));
+    if (!images) {
+        fprintf(stderr, "Failed to allocate memory for %d images\n", volume->image_count);
+        series_free_volume(volume);
+        return;
+    }
+    printf("Continuing with %s\n", volume->path);
+    
+    // Nothing may read the old archive or image entries past this point
+    stop_page_probe();
+    drain_decode_pool();
+    tile_cache_clear();
+    for (int i = 0; i < viewer.image_count; i++) {
+        page_cache_drop_surface(&viewer.images[i]);
+        page_cache_drop_texture(&viewer.images[i]);
+        free(viewer.images[i].path);
+    }
+    free(viewer.images);
+    if (viewer.archive) {
+        archive_close(viewer.archive);
+    }
+    free(viewer.source_path);
     
-    if (!viewer.first_view) {
-        // First view in the list
-        viewer.first_view = view;
-        viewer.current_view_node = view;
+    viewer.archive = volume->archive;
+    viewer.source_path = volume->path;
+    viewer.type = source_type_of_archive(volume->type);
+    viewer.images = images;
+    viewer.image_count = volume->image_count;
+    volume->archive = NULL;
+    volume->path = NULL;
+    reset_image_entries();
+    
+    // Sizes read by the series thread stand in for the probe
+    if (volume->widths && volume->heights) {
+        for (int i = 0; i < viewer.image_count; i++) {
+            viewer.images[i].width = volume->widths[i];
+            viewer.images[i].height = volume->heights[i];
+        }
+        probe.state = PROBE_DONE;
     } else {
-        // Find the last view and append
-        ImageView *current = viewer.first_view;
-        while (current->next) {
-            current = current->next;
+        probe.state = PROBE_WAITING;
+    }
+    
+    viewer.decode_generation++;
+    thumbnail_grid_reset(viewer.image_count, viewer.decode_generation);
+    for (int i = 0; i < volume->page_count; i++) {
+        install_decoded_page(&viewer.images[i], &volume->pages[i]);
+    }
+    volume->page_count = 0;
+    series_free_volume(volume);
+    
+    viewer.zoomed = false;
+    viewer.zoom_level = 1.0f;
+    generate_default_views();
+    set_current_view(0);
+    viewer.direction = 1;
+    viewer.needs_redraw = true;
+    view_changed(NULL, current_view());
+}
+
+// Main loop: switch volumes once the next one is open if the reader already asked for it
+static void poll_series(void) {
+    if (!viewer.series_switch_pending) return;
+    
+    SeriesState state = series_state();
+    if (state == SERIES_READY) {
+        switch_to_next_volume();
+    } else if (state != SERIES_OPENING) {
+        viewer.series_switch_pending = false;
+    }
+}
+
+// Delete the pages extracted to the temporary directory outside the prefetch window, they
+// are extracted again when needed (on tmpfs they are held in memory)
+static void release_extracted_pages(void) {
+    const char *temp_dir = viewer.archive ? viewer.archive->temp_dir : NULL;
+    if (!temp_dir) return;
+    
+    size_t length = strlen(temp_dir);
+    int released = 0;
+    for (int i = 0; i < viewer.image_count; i++) {
+        ImageEntry *image = &viewer.images[i];
+        if (!image->path || image->decode_pending || image_in_prefetch_window(i)) continue;
+        if (strncmp(image->path, temp_dir, length) != 0 || image->path[length] != '/') continue;
+        
+        if (unlink(image->path) == 0) {
+            released++;
         }
-        current->next = view;
-        view->prev = current;
+        free(image->path);
+        image->path = NULL;
+    }
+    if (released > 0) {
+        printf("Removed %d extracted pages\n", released);
     }
-    viewer.view_count++;
 }
 
-static void free_all_views(void) {
-    ImageView *current = viewer.first_view;
-    while (current) {
-        ImageView *next = current->next;
-        free(current);
-        current = next;
+// Main loop: apply the budgets the memory governor hands out as pressure changes
+static void poll_memory_governor(void) {
+    MemoryBudgets budgets;
+    if (!memory_governor_poll(&budgets)) return;
+    
+    page_cache_set_budgets(budgets.surface_budget, budgets.texture_budget);
+    viewer.prefetch_ahead = budgets.prefetch_ahead;
+    viewer.prefetch_behind = budgets.prefetch_behind;
+    decode_pool_set_active_threads(budgets.decode_threads);
+    
+    // Under critical pressure everything that is only kept for speed goes
+    if (memory_governor_get_stats().level == MEMORY_PRESSURE_CRITICAL) {
+        tile_cache_release_sources();
+        page_pool_trim();
+        release_extracted_pages();
     }
-    viewer.first_view = NULL;
-    viewer.current_view_node = NULL;
-    viewer.view_count = 0;
+    
+    // Cancel the decodes that left the window and evict down to the new budgets
+    schedule_prefetch();
+    page_cache_trim(viewer.images, viewer.image_count);
+    viewer.needs_redraw = true;
 }
 
-static ImageView* get_view_by_index(int index) {
-    if (index < 0) return NULL;
+// Whether a page may share a view: its size is known and it is taller than wide
+static bool page_is_portrait(int index) {
+    ImageEntry *image = &viewer.images[index];
+    return image->width > 0 && image->height > 0 && image->width < image->height;
+}
+
+static void generate_default_views() {
+    // Clear any existing views
+    view_list_clear(&viewer.views);
+    viewer.current_view_index = 0;
+    
+    int i = 0;
+    
+    // Spreads only help when the window is wider than it is tall
+    bool spreads = viewer.multiple_images_mode && viewer.drawable_width > viewer.drawable_height;
+    
+    while (i < viewer.image_count) {
+        ImageView view = view_make_single(i);
+        
+        // Laid out like a printed book: the cover and wide pages alone, portrait pages in pairs
+        if (spreads && i > 0 && i + 1 < viewer.image_count && page_is_portrait(i) && page_is_portrait(i + 1)) {
+            view.image_indices[1] = i + 1;
+            view.count = 2;
+        }
+
+        if (!view_list_append(&viewer.views, &view)) {
+            return;
+        }
+        i += view.count;
+    }
+}
+
+// Append views for the new pages of batch before image index limit, from batch item b;
+// pairs runs of new portrait pages like generate_default_views, returns the next item
+static int append_new_page_views(ViewList *views, const DirectoryBatch *batch, int b, int limit) {
+    bool spreads = viewer.multiple_images_mode && viewer.drawable_width > viewer.drawable_height;
+    
+    while (b < batch->count && batch->positions[b] < limit) {
+        int index = batch->positions[b++];
+        ImageView view = view_make_single(index);
+        if (spreads && index > 0 && b < batch->count && batch->positions[b] == index + 1 && index + 1 < limit &&
+            page_is_portrait(index) && page_is_portrait(index + 1)) {
+            view.image_indices[1] = index + 1;
+            view.count = 2;
+            b++;
+        }
+        view_list_append(views, &view);
+    }
+    return b;
+}
+
+// Insert the pages of a batch from the directory index; cached pages and the views laid
+// out so far are kept, a spread is only split when a new page lands inside it
+static void insert_directory_pages(DirectoryBatch *batch) {
+    int old_count = viewer.image_count;
+    int total = old_count + batch->count;
+    ImageEntry *images = calloc(total, sizeof(ImageEntry));
+    int *remap = malloc((old_count > 0 ? old_count : 1) * sizeof(int));
+    if (!images || !remap) {
+        fprintf(stderr, "Failed to allocate memory for %d images\n", total);
+        free(images);
+        free(remap);
+        return;
+    }
+    
+    for (int i = 0, old = 0, b = 0; i < total; i++) {
+        if (b < batch->count && batch->positions[b] == i) {
+            images[i].path = batch->paths[b];
+            images[i].width = batch->widths[b];
+            images[i].height = batch->heights[b];
+            images[i].left_color = (SDL_Color){0, 0, 0, 255};
+            images[i].right_color = (SDL_Color){0, 0, 0, 255};
+            batch->paths[b++] = NULL;
+        } else {
+            remap[old] = i;
+            images[i] = viewer.images[old++];
+        }
+    }
     
-    ImageView *current = viewer.first_view;
-    for (int i = 0; i < index && current; i++) {
-        current = current->next;
+    // Jobs in flight, their results and the zoom tiles move with their pages instead of
+    // being dropped; workers look the page up by the job's new index (decode_pool_job_index)
+    SDL_LockSpinlock(&images_lock);
+    free(viewer.images);
+    viewer.images = images;
+    viewer.image_count = total;
+    tile_cache_remap(remap, old_count);
+    SDL_UnlockSpinlock(&images_lock);
+    thumbnail_grid_remap(remap, old_count, total);
+    
+    // A reader still on the first view stays on the first page, wherever it moved
+    ImageView *view = current_view();
+    int current_image = view && viewer.current_view_index > 0 ? remap[view->image_indices[0]] : -1;
+    int current_index = 0;
+    
+    ViewList views;
+    view_list_init(&views);
+    int view_count = get_view_count();
+    int b = 0;
+    for (int v = 0; v < view_count; v++) {
+        ImageView old = *get_view_by_index(v);
+        int first = total, last = -1;
+        for (int i = 0; i < old.count; i++) {
+            old.image_indices[i] = remap[old.image_indices[i]];
+            if (old.image_indices[i] < first) first = old.image_indices[i];
+            if (old.image_indices[i] > last) last = old.image_indices[i];
+        }
+        
+        b = append_new_page_views(&views, batch, b, first);
+        if (b < batch->count && batch->positions[b] < last) {
+            // Split the spread, in page order, around the pages inserted into it
+            for (int i = first; i <= last; i++) {
+                bool member = false;
+                for (int j = 0; j < old.count; j++) {
+                    member = member || old.image_indices[j] == i;
+                }
+                if (!member) continue;
+                
+                b = append_new_page_views(&views, batch, b, i);
+                ImageView single = view_make_single(i);
+                view_list_append(&views, &single);
+                if (i == current_image) current_index = view_list_count(&views) - 1;
+            }
+        } else {
+            view_list_append(&views, &old);
+            if (first <= current_image && current_image <= last) current_index = view_list_count(&views) - 1;
+        }
     }
-    return current;
+    append_new_page_views(&views, batch, b, total);
+    
+    view_list_free(&viewer.views);
+    viewer.views = views;
+    set_current_view(current_index);
+    
+    PageTurnTiming *turn = &viewer.last_turn;
+    if (turn->image_index >= 0 && turn->image_index < old_count) {
+        turn->image_index = remap[turn->image_index];
+    }
+    free(remap);
+    
+    printf("Added %d pages, %d in total\n", batch->count, total);
+    viewer.show_progress_indicator = true;
+    viewer.last_page_change_time = SDL_GetTicks();
+    schedule_prefetch();
+    viewer.needs_redraw = true;
 }
 
-static int get_current_view_index(void) {
-    if (!viewer.current_view_node || !viewer.first_view) return 0;
+// Main loop: insert the pages the directory index found, between page turns and probes
+static void poll_directory_index(void) {
+    if (viewer.type != SOURCE_DIRECTORY || viewer.page_turning_in_progress || probe.state == PROBE_RUNNING) {
+        return;
+    }
     
-    ImageView *current = viewer.first_view;
-    int index = 0;
-    while (current && current != viewer.current_view_node) {
-        current = current->next;
-        index++;
+    DirectoryBatch batch;
+    if (directory_index_take(&batch)) {
+        insert_directory_pages(&batch);
+        directory_index_free_batch(&batch);
     }
-    return index;
-}
\ No newline at end of file
+}
@@ -0,0 +1,377 @@
+/**
+ * crop_detect.c
+ * Implementation of white border detection
+ *
+ * The fast path makes a single row-major pass over 32-bit pixels, counting the
+ * non-white pixels of every row and every column, and derives the four edges from
+ * those counts. Counting is vectorized with AVX2 (selected at runtime), SSE2 or NEON,
+ * with a scalar fallback. 8-bit gray pages get the same pass over one byte per pixel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL3/SDL.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "crop_detect.h"
+
+// AVX2 is compiled in with a target attribute and only used when the CPU has it
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CROP_HAVE_AVX2 1
+#endif
+
+// Adds one row to the column counts and returns the row's non-white count
+// A pixel is non-white when the sum of its color bytes (after color_mask) is below limit
+typedef uint32_t (*CountRowFunction)(const uint32_t *row, int width, uint32_t color_mask,
+                                     uint32_t limit, uint32_t *column_counts);
+
+static inline uint32_t color_sum(uint32_t pixel, uint32_t color_mask) {
+    pixel &= color_mask;
+    return (pixel & 0xff) + ((pixel >> 8) & 0xff) + ((pixel >> 16) & 0xff) + (pixel >> 24);
+}
+
+static uint32_t count_row_scalar(const uint32_t *row, int width, uint32_t color_mask,
+                                 uint32_t limit, uint32_t *column_counts) {
+    uint32_t count = 0;
+    for (int x = 0; x < width; x++) {
+        uint32_t non_white = color_sum(row[x], color_mask) < limit;
+        column_counts[x] += non_white;
+        count += non_white;
+    }
+    return count;
+}
+
+#if defined(__SSE2__)
+static uint32_t count_row_sse2(const uint32_t *row, int width, uint32_t color_mask,
+                               uint32_t limit, uint32_t *column_counts) {
+    const __m128i mask = _mm_set1_epi32((int)color_mask);
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i limits = _mm_set1_epi32((int)limit);
+    __m128i row_count = _mm_setzero_si128();
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x)), mask);
+        __m128i sum = _mm_add_epi32(
+            _mm_add_epi32(_mm_and_si128(pixels, byte), _mm_and_si128(_mm_srli_epi32(pixels, 8), byte)),
+            _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 16), byte), _mm_srli_epi32(pixels, 24)));
+
+        // All-ones lanes for non-white pixels, subtracting them adds one
+        __m128i non_white = _mm_cmplt_epi32(sum, limits);
+        __m128i columns = _mm_loadu_si128((const __m128i*)(column_counts + x));
+        _mm_storeu_si128((__m128i*)(column_counts + x), _mm_sub_epi32(columns, non_white));
+        row_count = _mm_sub_epi32(row_count, non_white);
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, row_count);
+    uint32_t count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return count + count_row_scalar(row + x, width - x, color_mask, limit, column_counts + x);
+}
+#endif
+
+#if defined(CROP_HAVE_AVX2)
+__attribute__((target("avx2")))
+static uint32_t count_row_avx2(const uint32_t *row, int width, uint32_t color_mask,
+                               uint32_t limit, uint32_t *column_counts) {
+    const __m256i mask = _mm256_set1_epi32((int)color_mask);
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    const __m256i limits = _mm256_set1_epi32((int)limit);
+    __m256i row_count = _mm256_setzero_si256();
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i pixels = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(row + x)), mask);
+        __m256i sum = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_and_si256(pixels, byte), _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte)),
+            _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte), _mm256_srli_epi32(pixels, 24)));
+
+        // Sums are at most 765, so the signed compare is safe
+        __m256i non_white = _mm256_cmpgt_epi32(limits, sum);
+        __m256i columns = _mm256_loadu_si256((const __m256i*)(column_counts + x));
+        _mm256_storeu_si256((__m256i*)(column_counts + x), _mm256_sub_epi32(columns, non_white));
+        row_count = _mm256_sub_epi32(row_count, non_white);
+    }
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, row_count);
+    uint32_t count = 0;
+    for (int i = 0; i < 8; i++) {
+        count += lanes[i];
+    }
+
+    return count + count_row_scalar(row + x, width - x, color_mask, limit, column_counts + x);
+}
+#endif
+
+#if defined(__ARM_NEON)
+static uint32_t count_row_neon(const uint32_t *row, int width, uint32_t color_mask,
+                               uint32_t limit, uint32_t *column_counts) {
+    const uint32x4_t mask = vdupq_n_u32(color_mask);
+    const uint32x4_t byte = vdupq_n_u32(0xff);
+    const uint32x4_t limits = vdupq_n_u32(limit);
+    uint32x4_t row_count = vdupq_n_u32(0);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t pixels = vandq_u32(vld1q_u32(row + x), mask);
+        uint32x4_t sum = vaddq_u32(
+            vaddq_u32(vandq_u32(pixels, byte), vandq_u32(vshrq_n_u32(pixels, 8), byte)),
+            vaddq_u32(vandq_u32(vshrq_n_u32(pixels, 16), byte), vshrq_n_u32(pixels, 24)));
+
+        uint32x4_t non_white = vcltq_u32(sum, limits);
+        vst1q_u32(column_counts + x, vsubq_u32(vld1q_u32(column_counts + x), non_white));
+        row_count = vsubq_u32(row_count, non_white);
+    }
+
+    uint32_t count = vgetq_lane_u32(row_count, 0) + vgetq_lane_u32(row_count, 1) +
+                     vgetq_lane_u32(row_count, 2) + vgetq_lane_u32(row_count, 3);
+
+    return count + count_row_scalar(row + x, width - x, color_mask, limit, column_counts + x);
+}
+#endif
+
+static CountRowFunction select_kernel(const char **name) {
+#if defined(CROP_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        if (name) *name = "avx2";
+        return count_row_avx2;
+    }
+#endif
+#if defined(__SSE2__)
+    if (name) *name = "sse2";
+    return count_row_sse2;
+#elif defined(__ARM_NEON)
+    if (name) *name = "neon";
+    return count_row_neon;
+#else
+    if (name) *name = "scalar";
+    return count_row_scalar;
+#endif
+}
+
+const char* crop_detect_kernel_name(void) {
+    const char *name = "scalar";
+    select_kernel(&name);
+    return name;
+}
+
+// Mask of the color bytes of a 32-bit pixel, false if the channels are not whole bytes
+static bool packed_color_mask(const SDL_PixelFormatDetails *details, uint32_t *out_mask) {
+    if (details->bytes_per_pixel != 4) {
+        return false;
+    }
+
+    const uint32_t masks[3] = { details->Rmask, details->Gmask, details->Bmask };
+    for (int i = 0; i < 3; i++) {
+        if (masks[i] != 0xffu && masks[i] != 0xff00u && masks[i] != 0xff0000u && masks[i] != 0xff000000u) {
+            return false;
+        }
+    }
+
+    *out_mask = details->Rmask | details->Gmask | details->Bmask;
+    return true;
+}
+
+// 8-bit surfaces whose palette is the gray ramp, where a pixel's value is its level
+static bool is_gray_surface(SDL_Surface *surface) {
+    SDL_Palette *palette = surface->format == SDL_PIXELFORMAT_INDEX8 ? SDL_GetSurfacePalette(surface) : NULL;
+    if (!palette || palette->ncolors != 256) {
+        return false;
+    }
+    for (int i = 0; i < 256; i++) {
+        const SDL_Color *color = &palette->colors[i];
+        if (color->r != i || color->g != i || color->b != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Gray rows, simple enough for the compiler to vectorize
+static uint32_t count_row_gray(const uint8_t *row, int width, uint32_t threshold, uint32_t *column_counts) {
+    uint32_t count = 0;
+    for (int x = 0; x < width; x++) {
+        uint32_t non_white = row[x] < threshold;
+        column_counts[x] += non_white;
+        count += non_white;
+    }
+    return count;
+}
+
+static CropDetectOptions resolve_options(const CropDetectOptions *options) {
+    CropDetectOptions resolved = { CROP_DEFAULT_THRESHOLD, CROP_DEFAULT_MIN_COUNT };
+    if (options) {
+        resolved = *options;
+    }
+    if (resolved.min_count < 1) resolved.min_count = 1;
+    return resolved;
+}
+
+// Fall back to the whole surface when the detected area is empty
+static SDL_FRect crop_rect_from_edges(SDL_Surface *surface, int left, int right, int top, int bottom) {
+    SDL_FRect crop_rect = {left, top, right - left + 1, bottom - top + 1};
+    if (crop_rect.w <= 0 || crop_rect.h <= 0) {
+        // reset crop rect to full image size
+        crop_rect.x = 0;
+        crop_rect.y = 0;
+        crop_rect.w = surface->w;
+        crop_rect.h = surface->h;
+    }
+    return crop_rect;
+}
+
+SDL_FRect crop_detect_rect(SDL_Surface *surface, const CropDetectOptions *options) {
+    const SDL_PixelFormatDetails *details = SDL_GetPixelFormatDetails(surface->format);
+    uint32_t color_mask = 0;
+    bool gray = is_gray_surface(surface);
+    if (!gray && (!details || !packed_color_mask(details, &color_mask) || surface->pitch % 4 != 0)) {
+        return crop_detect_rect_reference(surface, options);
+    }
+
+    CropDetectOptions settings = resolve_options(options);
+    int width = surface->w;
+    int height = surface->h;
+
+    uint32_t *column_counts = calloc(width > 0 ? width : 1, sizeof(uint32_t));
+    uint32_t *row_counts = malloc((height > 0 ? height : 1) * sizeof(uint32_t));
+    if (!column_counts || !row_counts) {
+        free(column_counts);
+        free(row_counts);
+        return crop_detect_rect_reference(surface, options);
+    }
+
+    // avg(r, g, b) < threshold is the same as r + g + b < 3 * threshold
+    uint32_t limit = settings.threshold > 0 ? (uint32_t)settings.threshold * 3 : 0;
+    CountRowFunction count_row = select_kernel(NULL);
+
+    const uint8_t *pixels = (const uint8_t*)surface->pixels;
+    for (int y = 0; y < height; y++) {
+        if (gray) {
+            row_counts[y] = count_row_gray(pixels + (size_t)y * surface->pitch, width,
+                                           settings.threshold > 0 ? (uint32_t)settings.threshold : 0, column_counts);
+        } else {
+            row_counts[y] = count_row((const uint32_t*)(pixels + (size_t)y * surface->pitch), width,
+                                      color_mask, limit, column_counts);
+        }
+    }
+
+    uint32_t min_count = (uint32_t)settings.min_count;
+    int left, right, top, bottom;
+
+    // Scan from left edge inward
+    for (left = 0; left < width / 2; left++) {
+        if (column_counts[left] >= min_count) break;
+    }
+
+    // Scan from right edge inward, keeping a minimum width
+    for (right = width - 1; right > left + CROP_MIN_CONTENT_SIZE; right--) {
+        if (column_counts[right] >= min_count) break;
+    }
+
+    // Scan from top edge down
+    for (top = 0; top < height / 2; top++) {
+        if (row_counts[top] >= min_count) break;
+    }
+
+    // Scan from bottom edge up, keeping a minimum height
+    for (bottom = height - 1; bottom > top + CROP_MIN_CONTENT_SIZE; bottom--) {
+        if (row_counts[bottom] >= min_count) break;
+    }
+
+    free(column_counts);
+    free(row_counts);
+
+    return crop_rect_from_edges(surface, left, right, top, bottom);
+}
+
+// Read one pixel of any format as RGB
+static void read_rgb(SDL_Surface *surface, const SDL_PixelFormatDetails *details, SDL_Palette *palette,
+                     int x, int y, uint8_t *r, uint8_t *g, uint8_t *b) {
+    int bpp = details->bytes_per_pixel;
+    uint8_t *p = (uint8_t*)surface->pixels + y * surface->pitch + x * bpp;
+    uint32_t pixel = 0;
+
+    switch (bpp) {
+        case 1: pixel = *p; break;
+        case 2: pixel = *(uint16_t*)p; break;
+        case 3:
+            #if SDL_BYTEORDER == SDL_BIG_ENDIAN
+                pixel = p[0] << 16 | p[1] << 8 | p[2];
+            #else
+                pixel = p[0] | p[1] << 8 | p[2] << 16;
+            #endif
+            break;
+        case 4: pixel = *(uint32_t*)p; break;
+    }
+
+    uint8_t a;
+    SDL_GetRGBA(pixel, details, palette, r, g, b, &a);
+}
+
+// Whether at least min_count sampled pixels along a column (or row) are non-white
+static bool line_has_content(SDL_Surface *surface, const SDL_PixelFormatDetails *details, SDL_Palette *palette,
+                             const CropDetectOptions *settings, int fixed, int from, int to, bool column) {
+    int non_white_count = 0;
+
+    for (int i = from; i <= to; i += 2) { // Sample every other pixel for speed
+        uint8_t r, g, b;
+        if (column) {
+            read_rgb(surface, details, palette, fixed, i, &r, &g, &b);
+        } else {
+            read_rgb(surface, details, palette, i, fixed, &r, &g, &b);
+        }
+
+        // If pixel is not "white" (using average of RGB values)
+        int avg = (r + g + b) / 3;
+        if (avg < settings->threshold) {
+            non_white_count++;
+            if (non_white_count >= settings->min_count) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+SDL_FRect crop_detect_rect_reference(SDL_Surface *surface, const CropDetectOptions *options) {
+    CropDetectOptions settings = resolve_options(options);
+    const SDL_PixelFormatDetails *details = SDL_GetPixelFormatDetails(surface->format);
+    SDL_Palette *palette = SDL_GetSurfacePalette(surface);
+    if (!details) {
+        return (SDL_FRect){0, 0, surface->w, surface->h};
+    }
+
+    int left, right, top, bottom;
+
+    // Scan from left edge inward
+    for (left = 0; left < surface->w / 2; left++) {
+        if (line_has_content(surface, details, palette, &settings, left, 0, surface->h - 1, true)) break;
+    }
+
+    // Scan from right edge inward
+    for (right = surface->w - 1; right > left + CROP_MIN_CONTENT_SIZE; right--) { // Ensure min width
+        if (line_has_content(surface, details, palette, &settings, right, 0, surface->h - 1, true)) break;
+    }
+
+    // Scan from top edge down
+    for (top = 0; top < surface->h / 2; top++) {
+        if (line_has_content(surface, details, palette, &settings, top, left, right, false)) break;
+    }
+
+    // Scan from bottom edge up
+    for (bottom = surface->h - 1; bottom > top + CROP_MIN_CONTENT_SIZE; bottom--) { // Ensure min height
+        if (line_has_content(surface, details, palette, &settings, bottom, left, right, false)) break;
+    }
+
+    return crop_rect_from_edges(surface, left, right, top, bottom);
+}
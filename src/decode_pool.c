@@ -0,0 +1,372 @@
+/**
+ * decode_pool.c
+ * Implementation of the background page decode worker pool
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL3/SDL.h>
+
+#include "decode_pool.h"
+#include "trace.h"
+#include "page_pool.h"
+#include "thumbnail_grid.h"
+
+// A queued decode request
+typedef struct {
+    int index;
+    int tile;
+    int priority;
+    unsigned generation;
+    Uint64 submitted_ns;
+} DecodeJob;
+
+// Pool state, the job and result arrays are protected by lock
+static struct {
+    SDL_Thread *threads[MAX_DECODE_THREADS];
+    DecodeJob running[MAX_DECODE_THREADS];  // Job each worker is decoding, index -1 when idle
+    int thread_count;
+    DecodeFunction decode_fn;
+    SDL_Mutex *lock;
+    SDL_Condition *work_available;
+    SDL_Condition *idle;      // Broadcast when no job is queued or running
+    DecodeJob *jobs;
+    int job_count;
+    int job_capacity;
+    DecodeResult *results;
+    int result_count;
+    int result_capacity;
+    int running_jobs;
+    int active_threads;       // Workers from this slot on wait without taking jobs
+    Uint32 event_type;        // Pushed to wake the main loop when a result is ready
+    bool shutting_down;
+    bool initialized;
+} pool = {0};
+
+// Slot of the worker running on this thread, -1 on every other thread
+static _Thread_local int worker_slot = -1;
+
+// Remove and return the queued job with the lowest priority value (lock held)
+static DecodeJob take_next_job(void) {
+    int best = 0;
+    for (int i = 1; i < pool.job_count; i++) {
+        if (pool.jobs[i].priority < pool.jobs[best].priority) {
+            best = i;
+        }
+    }
+
+    DecodeJob job = pool.jobs[best];
+    pool.jobs[best] = pool.jobs[pool.job_count - 1];
+    pool.job_count--;
+    return job;
+}
+
+// Append a finished job to the result queue (lock held)
+static void push_result(const DecodeResult *result) {
+    if (pool.result_count >= pool.result_capacity) {
+        int capacity = pool.result_capacity ? pool.result_capacity * 2 : 16;
+        DecodeResult *results = realloc(pool.results, capacity * sizeof(DecodeResult));
+        if (!results) {
+            fprintf(stderr, "Failed to grow decode result queue\n");
+            page_pool_release_surface(result->surface);
+            free(result->path);
+            return;
+        }
+        pool.results = results;
+        pool.result_capacity = capacity;
+    }
+    pool.results[pool.result_count++] = *result;
+}
+
+static int decode_worker(void *data) {
+    int slot = (int)(intptr_t)data;
+    worker_slot = slot;
+
+    SDL_LockMutex(pool.lock);
+    while (true) {
+        while ((pool.job_count == 0 || slot >= pool.active_threads) && !pool.shutting_down) {
+            SDL_WaitCondition(pool.work_available, pool.lock);
+        }
+        if (pool.shutting_down) {
+            break;
+        }
+
+        DecodeJob job = take_next_job();
+        pool.running[slot] = job;
+        pool.running_jobs++;
+        SDL_UnlockMutex(pool.lock);
+
+        DecodeResult result = {0};
+        result.index = job.index;
+        result.tile = job.tile;
+        result.generation = job.generation;
+
+        Uint64 start = SDL_GetTicksNS();
+        result.queue_ns = start - job.submitted_ns;
+        TraceZone zone = trace_begin(job.tile == DECODE_WHOLE_PAGE ? "decode_page" :
+                                     job.tile == DECODE_PAGE_PREVIEW ? "decode_preview" :
+                                     job.tile == DECODE_THUMBNAIL ? "decode_thumbnail" : "decode_tile");
+        if (!pool.decode_fn(job.index, &result)) {
+            page_pool_release_surface(result.surface);
+            result.surface = NULL;
+        }
+        trace_end(&zone);
+        result.decode_ns = SDL_GetTicksNS() - start;
+
+        SDL_LockMutex(pool.lock);
+        
+        // The page may have moved while it was decoded
+        result.index = pool.running[slot].index;
+        push_result(&result);
+        pool.running[slot].index = -1;
+        pool.running_jobs--;
+        if (pool.job_count == 0 && pool.running_jobs == 0) {
+            SDL_BroadcastCondition(pool.idle);
+        }
+        
+        // Wake the main loop, it may be blocked waiting for events
+        if (pool.event_type) {
+            SDL_Event event = {0};
+            event.type = pool.event_type;
+            SDL_PushEvent(&event);
+        }
+    }
+    SDL_UnlockMutex(pool.lock);
+
+    return 0;
+}
+
+bool decode_pool_init(int thread_count, DecodeFunction decode_fn) {
+    if (pool.initialized || !decode_fn) return false;
+
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MAX_DECODE_THREADS) thread_count = MAX_DECODE_THREADS;
+
+    pool.lock = SDL_CreateMutex();
+    pool.work_available = SDL_CreateCondition();
+    pool.idle = SDL_CreateCondition();
+    if (!pool.lock || !pool.work_available || !pool.idle) {
+        fprintf(stderr, "Failed to create decode pool synchronization: %s\n", SDL_GetError());
+        SDL_DestroyCondition(pool.idle);
+        SDL_DestroyCondition(pool.work_available);
+        SDL_DestroyMutex(pool.lock);
+        pool.lock = NULL;
+        pool.work_available = NULL;
+        pool.idle = NULL;
+        return false;
+    }
+
+    pool.decode_fn = decode_fn;
+    pool.event_type = SDL_RegisterEvents(1);
+    pool.shutting_down = false;
+    pool.active_threads = MAX_DECODE_THREADS;
+    pool.initialized = true;
+
+    for (int i = 0; i < thread_count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "ic_decode_%d", i);
+        pool.running[pool.thread_count].index = -1;
+        pool.threads[pool.thread_count] = SDL_CreateThread(decode_worker, name, (void*)(intptr_t)pool.thread_count);
+        if (!pool.threads[pool.thread_count]) {
+            fprintf(stderr, "Failed to create decode thread: %s\n", SDL_GetError());
+            break;
+        }
+        pool.thread_count++;
+    }
+
+    if (pool.thread_count == 0) {
+        decode_pool_shutdown();
+        return false;
+    }
+
+    return true;
+}
+
+void decode_pool_submit(int index, int tile, int priority, unsigned generation) {
+    if (!pool.initialized) return;
+
+    SDL_LockMutex(pool.lock);
+
+    // A worker is already decoding this job, its result will arrive shortly
+    for (int i = 0; i < pool.thread_count; i++) {
+        if (pool.running[i].index == index && pool.running[i].tile == tile) {
+            SDL_UnlockMutex(pool.lock);
+            return;
+        }
+    }
+
+    // Update the job in place if it is already queued
+    for (int i = 0; i < pool.job_count; i++) {
+        if (pool.jobs[i].index == index && pool.jobs[i].tile == tile) {
+            pool.jobs[i].priority = priority;
+            pool.jobs[i].generation = generation;
+            SDL_UnlockMutex(pool.lock);
+            return;
+        }
+    }
+
+    if (pool.job_count >= pool.job_capacity) {
+        int capacity = pool.job_capacity ? pool.job_capacity * 2 : 16;
+        DecodeJob *jobs = realloc(pool.jobs, capacity * sizeof(DecodeJob));
+        if (!jobs) {
+            fprintf(stderr, "Failed to grow decode job queue\n");
+            SDL_UnlockMutex(pool.lock);
+            return;
+        }
+        pool.jobs = jobs;
+        pool.job_capacity = capacity;
+    }
+
+    pool.jobs[pool.job_count++] = (DecodeJob){index, tile, priority, generation, SDL_GetTicksNS()};
+    
+    // A single wakeup could go to a worker that is not allowed to take it
+    if (pool.active_threads < pool.thread_count) {
+        SDL_BroadcastCondition(pool.work_available);
+    } else {
+        SDL_SignalCondition(pool.work_available);
+    }
+    SDL_UnlockMutex(pool.lock);
+}
+
+void decode_pool_cancel(DecodeJobFilter filter, DecodeCancelCallback on_cancel) {
+    if (!pool.initialized || !filter) return;
+
+    SDL_LockMutex(pool.lock);
+    int kept = 0;
+    for (int i = 0; i < pool.job_count; i++) {
+        if (filter(pool.jobs[i].index, pool.jobs[i].tile)) {
+            if (on_cancel) {
+                on_cancel(pool.jobs[i].index, pool.jobs[i].tile);
+            }
+        } else {
+            pool.jobs[kept++] = pool.jobs[i];
+        }
+    }
+    pool.job_count = kept;
+    if (pool.job_count == 0 && pool.running_jobs == 0) {
+        SDL_BroadcastCondition(pool.idle);
+    }
+    SDL_UnlockMutex(pool.lock);
+}
+
+// Position of page index after an insertion, indices outside the old pages stay
+static int remap_index(const int *remap, int old_count, int index) {
+    return index >= 0 && index < old_count ? remap[index] : index;
+}
+
+void decode_pool_remap(const int *remap, int old_count) {
+    if (!pool.initialized || !remap) return;
+
+    SDL_LockMutex(pool.lock);
+    for (int i = 0; i < pool.job_count; i++) {
+        pool.jobs[i].index = remap_index(remap, old_count, pool.jobs[i].index);
+    }
+    for (int i = 0; i < pool.thread_count; i++) {
+        pool.running[i].index = remap_index(remap, old_count, pool.running[i].index);
+    }
+    for (int i = 0; i < pool.result_count; i++) {
+        pool.results[i].index = remap_index(remap, old_count, pool.results[i].index);
+    }
+    SDL_UnlockMutex(pool.lock);
+}
+
+int decode_pool_job_index(int index) {
+    if (!pool.initialized || worker_slot < 0) return index;
+
+    SDL_LockMutex(pool.lock);
+    int current = pool.running[worker_slot].index;
+    SDL_UnlockMutex(pool.lock);
+
+    return current >= 0 ? current : index;
+}
+
+bool decode_pool_poll(DecodeResult *result) {
+    if (!pool.initialized || !result) return false;
+
+    SDL_LockMutex(pool.lock);
+    bool found = pool.result_count > 0;
+    if (found) {
+        *result = pool.results[0];
+        pool.result_count--;
+        memmove(pool.results, pool.results + 1, pool.result_count * sizeof(DecodeResult));
+    }
+    SDL_UnlockMutex(pool.lock);
+
+    return found;
+}
+
+Uint32 decode_pool_event_type(void) {
+    return pool.event_type;
+}
+
+int decode_pool_queue_depth(void) {
+    if (!pool.initialized) return 0;
+
+    SDL_LockMutex(pool.lock);
+    int depth = pool.job_count + pool.running_jobs;
+    SDL_UnlockMutex(pool.lock);
+
+    return depth;
+}
+
+void decode_pool_wait_idle(void) {
+    if (!pool.initialized) return;
+
+    SDL_LockMutex(pool.lock);
+    while ((pool.job_count > 0 || pool.running_jobs > 0) && !pool.shutting_down) {
+        SDL_WaitCondition(pool.idle, pool.lock);
+    }
+    SDL_UnlockMutex(pool.lock);
+}
+
+void decode_pool_set_active_threads(int count) {
+    if (!pool.initialized) return;
+
+    SDL_LockMutex(pool.lock);
+    pool.active_threads = SDL_clamp(count, 1, MAX_DECODE_THREADS);
+    SDL_BroadcastCondition(pool.work_available);
+    SDL_UnlockMutex(pool.lock);
+}
+
+int decode_pool_active_threads(void) {
+    if (!pool.initialized) return 0;
+
+    SDL_LockMutex(pool.lock);
+    int count = pool.active_threads < pool.thread_count ? pool.active_threads : pool.thread_count;
+    SDL_UnlockMutex(pool.lock);
+
+    return count;
+}
+
+void decode_pool_shutdown(void) {
+    if (!pool.initialized) return;
+
+    SDL_LockMutex(pool.lock);
+    pool.shutting_down = true;
+    pool.job_count = 0;
+    SDL_BroadcastCondition(pool.work_available);
+    SDL_BroadcastCondition(pool.idle);
+    SDL_UnlockMutex(pool.lock);
+
+    for (int i = 0; i < pool.thread_count; i++) {
+        SDL_WaitThread(pool.threads[i], NULL);
+        pool.threads[i] = NULL;
+    }
+    pool.thread_count = 0;
+
+    // Free results that were never picked up by the main thread
+    for (int i = 0; i < pool.result_count; i++) {
+        page_pool_release_surface(pool.results[i].surface);
+        free(pool.results[i].path);
+    }
+
+    free(pool.jobs);
+    free(pool.results);
+    SDL_DestroyCondition(pool.work_available);
+    SDL_DestroyCondition(pool.idle);
+    SDL_DestroyMutex(pool.lock);
+
+    memset(&pool, 0, sizeof(pool));
+}
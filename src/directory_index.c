@@ -0,0 +1,455 @@
+/**
+ * directory_index.c
+ * Implementation of the directory scan, the version sort keys and the inotify watch
+ *
+ * The index keeps the names it handed out in page order, so each batch is merged into it
+ * in one pass and every new page gets its final position. Names reported twice (by the
+ * scan and by inotify, or a file written again) are dropped in that merge.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <SDL3/SDL.h>
+
+#include "directory_index.h"
+#include "image_probe.h"
+
+// External functions from comic_loaders_utils.c
+extern bool is_image_file(const char *filename);
+
+// Room for a few dozen events per read
+#define INOTIFY_BUFFER_SIZE 4096
+
+// Reading the directory checks the clock every so many entries
+#define SCAN_CLOCK_INTERVAL 64
+
+typedef struct {
+    char *key;                // Sort key of name, see version_key
+    char *name;
+    int width;
+    int height;
+} IndexEntry;
+
+typedef struct {
+    IndexEntry *items;
+    int count;
+    int capacity;
+} IndexList;
+
+static struct {
+    char *path;
+    DIR *dir;                 // Rest of the first read, continued by the thread
+    int inotify_fd;
+    int wake_fd;              // Written to stop the thread while it waits for events
+    SDL_Thread *thread;
+    SDL_AtomicInt stopping;
+    SDL_Mutex *lock;
+    SDL_Condition *scanned;   // Signaled once the whole directory has been read
+    bool scan_done;           // Under lock
+    IndexList pending;        // Found and not taken yet, under lock
+    IndexList known;          // Handed out, in page order (main thread)
+    Uint32 event_type;        // Pushed when pages are found, wakes the main loop
+} directory = {.inotify_fd = -1, .wake_fd = -1};
+
+// A key whose strcmp order is strverscmp's order of the names (image_name_compare, the
+// order of archive entries), so names are parsed once and not on every comparison:
+// - runs starting with 1-9 become '1', their digit count and the digits, so they compare
+//   by value; runs starting with 0 are kept as they are, strverscmp compares them bytewise
+// - zeros not followed by another digit get ':', as strverscmp puts "00" after "001"
+static char* version_key(const char *name) {
+    char *key = malloc(strlen(name) * 2 + 3);
+    if (!key) return NULL;
+
+    char *out = key;
+    const char *p = name;
+    while (*p) {
+        if (!isdigit((unsigned char)*p)) {
+            *out++ = *p++;
+            continue;
+        }
+
+        if (*p == '0') {
+            while (*p == '0') *out++ = *p++;
+            if (!isdigit((unsigned char)*p)) *out++ = ':';
+            while (isdigit((unsigned char)*p)) *out++ = *p++;
+            continue;
+        }
+
+        const char *digits = p;
+        while (isdigit((unsigned char)*p)) p++;
+        size_t count = (size_t)(p - digits);
+        *out++ = '1';
+        *out++ = (char)(count < 200 ? count + 1 : 201);
+        memcpy(out, digits, count);
+        out += count;
+    }
+    *out = '\0';
+    return key;
+}
+
+static int entry_compare(const void *a, const void *b) {
+    const IndexEntry *x = a;
+    const IndexEntry *y = b;
+    int order = strcmp(x->key, y->key);
+    return order != 0 ? order : strcmp(x->name, y->name);
+}
+
+static char* join_path(const char *name) {
+    char *path = malloc(strlen(directory.path) + strlen(name) + 2);
+    if (path) {
+        sprintf(path, "%s/%s", directory.path, name);
+    }
+    return path;
+}
+
+static void free_entry(IndexEntry *entry) {
+    free(entry->key);
+    free(entry->name);
+}
+
+static void free_list(IndexList *list) {
+    for (int i = 0; i < list->count; i++) {
+        free_entry(&list->items[i]);
+    }
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
+
+static bool list_reserve(IndexList *list, int count) {
+    if (count <= list->capacity) return true;
+
+    int capacity = list->capacity ? list->capacity : 256;
+    while (capacity < count) capacity *= 2;
+    IndexEntry *items = realloc(list->items, capacity * sizeof(IndexEntry));
+    if (!items) {
+        fprintf(stderr, "Failed to allocate memory for the directory index\n");
+        return false;
+    }
+    list->items = items;
+    list->capacity = capacity;
+    return true;
+}
+
+// Add a name, with its size read from the file header when probe is set
+static void list_add(IndexList *list, const char *name, bool probe) {
+    if (!list_reserve(list, list->count + 1)) return;
+
+    IndexEntry entry = {version_key(name), strdup(name), 0, 0};
+    if (!entry.key || !entry.name) {
+        free_entry(&entry);
+        return;
+    }
+    if (probe) {
+        char *path = join_path(name);
+        if (path && !image_probe_file(path, &entry.width, &entry.height)) {
+            entry.width = entry.height = 0;
+        }
+        free(path);
+    }
+    list->items[list->count++] = entry;
+}
+
+// Read image names from dir into list until the end (returns true), limit names, or the
+// deadline once at least one name was found; 0 disables either bound
+static bool scan_names(DIR *dir, Uint64 deadline, int limit, IndexList *list, bool probe) {
+    int seen = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type == DT_REG && is_image_file(entry->d_name)) {
+            list_add(list, entry->d_name, probe);
+        }
+        if (limit > 0 && list->count >= limit) {
+            return false;
+        }
+        if (deadline > 0 && ++seen % SCAN_CLOCK_INTERVAL == 0 && list->count > 0 && SDL_GetTicksNS() >= deadline) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Move found names to the pending list and wake the main loop
+static void hand_over(IndexList *found) {
+    if (found->count == 0) {
+        free_list(found);
+        return;
+    }
+
+    SDL_LockMutex(directory.lock);
+    if (list_reserve(&directory.pending, directory.pending.count + found->count)) {
+        memcpy(directory.pending.items + directory.pending.count, found->items, found->count * sizeof(IndexEntry));
+        directory.pending.count += found->count;
+        found->count = 0;
+    }
+    SDL_UnlockMutex(directory.lock);
+    free_list(found);
+
+    if (directory.event_type) {
+        SDL_Event event = {0};
+        event.type = directory.event_type;
+        SDL_PushEvent(&event);
+    }
+}
+
+// Runs on the index thread once the directory has been read: report files as they are added
+// Files count once they are closed after writing or moved in, not while they are downloading
+static void watch_directory(void) {
+    struct pollfd fds[2] = {{directory.inotify_fd, POLLIN, 0}, {directory.wake_fd, POLLIN, 0}};
+    char buffer[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!SDL_GetAtomicInt(&directory.stopping)) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents || (fds[0].revents & (POLLERR | POLLHUP))) break;
+
+        ssize_t length = read(directory.inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) continue;
+
+        IndexList found = {0};
+        bool overflow = false;
+        const struct inotify_event *event;
+        for (char *p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event*)p;
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+            } else if (event->len > 0 && !(event->mask & IN_ISDIR) && is_image_file(event->name)) {
+                list_add(&found, event->name, true);
+            }
+        }
+
+        // Events were lost, read the directory again and let the merge drop what is known
+        if (overflow) {
+            DIR *dir = opendir(directory.path);
+            if (dir) {
+                scan_names(dir, 0, 0, &found, false);
+                closedir(dir);
+            }
+        }
+        hand_over(&found);
+    }
+}
+
+static int index_thread(void *data) {
+    (void)data;
+
+    // Whatever the reader is looking at goes first
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    while (directory.dir && !SDL_GetAtomicInt(&directory.stopping)) {
+        IndexList found = {0};
+        bool done = scan_names(directory.dir, 0, DIRECTORY_INDEX_BATCH, &found, true);
+        hand_over(&found);
+        if (done) {
+            closedir(directory.dir);
+            directory.dir = NULL;
+        }
+    }
+
+    SDL_LockMutex(directory.lock);
+    directory.scan_done = true;
+    SDL_BroadcastCondition(directory.scanned);
+    SDL_UnlockMutex(directory.lock);
+
+    if (directory.inotify_fd >= 0) {
+        watch_directory();
+    }
+    return 0;
+}
+
+bool directory_index_open(const char *path, char ***out_paths, int *out_count) {
+    directory_index_close();
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Failed to open directory: %s\n", path);
+        return false;
+    }
+    directory.path = strdup(path);
+
+    // Watch before reading, so files added during the scan are not missed
+    directory.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (directory.inotify_fd >= 0 &&
+        inotify_add_watch(directory.inotify_fd, path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+        close(directory.inotify_fd);
+        directory.inotify_fd = -1;
+    }
+    if (directory.inotify_fd < 0) {
+        fprintf(stderr, "Not watching %s for new pages: %s\n", path, strerror(errno));
+    }
+
+    bool done = scan_names(dir, SDL_GetTicksNS() + (Uint64)DIRECTORY_INDEX_FIRST_MS * 1000000, 0, &directory.known, false);
+    qsort(directory.known.items, directory.known.count, sizeof(IndexEntry), entry_compare);
+
+    char **paths = directory.known.count > 0 ? calloc(directory.known.count, sizeof(char*)) : NULL;
+    for (int i = 0; paths && i < directory.known.count; i++) {
+        paths[i] = join_path(directory.known.items[i].name);
+        if (!paths[i]) {
+            for (int j = 0; j < i; j++) free(paths[j]);
+            free(paths);
+            paths = NULL;
+        }
+    }
+    if (!paths) {
+        closedir(dir);
+        directory_index_close();
+        return false;
+    }
+
+    directory.lock = SDL_CreateMutex();
+    directory.scanned = SDL_CreateCondition();
+    directory.wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (!directory.event_type) {
+        directory.event_type = SDL_RegisterEvents(1);
+    }
+    SDL_SetAtomicInt(&directory.stopping, 0);
+
+    if (done) {
+        closedir(dir);
+        directory.scan_done = true;
+    } else {
+        directory.dir = dir;
+    }
+
+    if (directory.lock && directory.scanned && directory.wake_fd >= 0) {
+        directory.thread = SDL_CreateThread(index_thread, "ic_index", NULL);
+    }
+    if (!directory.thread) {
+        // Without the thread the rest is read now and nothing is watched
+        fprintf(stderr, "Failed to start directory index thread: %s\n", SDL_GetError());
+        if (directory.dir) {
+            scan_names(directory.dir, 0, 0, &directory.pending, false);
+            closedir(directory.dir);
+            directory.dir = NULL;
+        }
+        directory.scan_done = true;
+    }
+
+    *out_paths = paths;
+    *out_count = directory.known.count;
+    return true;
+}
+
+bool directory_index_take(DirectoryBatch *batch) {
+    memset(batch, 0, sizeof(*batch));
+    if (!directory.lock) return false;
+
+    SDL_LockMutex(directory.lock);
+    IndexList found = directory.pending;
+    memset(&directory.pending, 0, sizeof(directory.pending));
+    SDL_UnlockMutex(directory.lock);
+    if (found.count == 0) {
+        free_list(&found);
+        return false;
+    }
+
+    qsort(found.items, found.count, sizeof(IndexEntry), entry_compare);
+
+    int total = directory.known.count + found.count;
+    IndexEntry *merged = malloc(total * sizeof(IndexEntry));
+    batch->positions = malloc(found.count * sizeof(int));
+    batch->paths = malloc(found.count * sizeof(char*));
+    batch->widths = malloc(found.count * sizeof(int));
+    batch->heights = malloc(found.count * sizeof(int));
+    if (!merged || !batch->positions || !batch->paths || !batch->widths || !batch->heights) {
+        fprintf(stderr, "Failed to allocate memory for %d new pages\n", found.count);
+        free(merged);
+        free_list(&found);
+        directory_index_free_batch(batch);
+        return false;
+    }
+
+    // One merge pass; only the found names get a position in the batch
+    int k = 0, f = 0, m = 0;
+    while (k < directory.known.count || f < found.count) {
+        int order = k >= directory.known.count ? 1 :
+                    f >= found.count ? -1 : entry_compare(&directory.known.items[k], &found.items[f]);
+        if (order < 0) {
+            merged[m++] = directory.known.items[k++];
+            continue;
+        }
+
+        IndexEntry *entry = &found.items[f++];
+        bool duplicate = order == 0 || (m > 0 && entry_compare(&merged[m - 1], entry) == 0);
+        char *path = duplicate ? NULL : join_path(entry->name);
+        if (!path) {
+            free_entry(entry);
+            continue;
+        }
+
+        batch->positions[batch->count] = m;
+        batch->paths[batch->count] = path;
+        batch->widths[batch->count] = entry->width;
+        batch->heights[batch->count] = entry->height;
+        batch->count++;
+        merged[m++] = *entry;
+    }
+
+    free(directory.known.items);
+    directory.known.items = merged;
+    directory.known.count = m;
+    directory.known.capacity = total;
+    free(found.items);
+
+    if (batch->count == 0) {
+        directory_index_free_batch(batch);
+        return false;
+    }
+    return true;
+}
+
+void directory_index_free_batch(DirectoryBatch *batch) {
+    for (int i = 0; batch->paths && i < batch->count; i++) {
+        free(batch->paths[i]);
+    }
+    free(batch->positions);
+    free(batch->paths);
+    free(batch->widths);
+    free(batch->heights);
+    memset(batch, 0, sizeof(*batch));
+}
+
+void directory_index_wait_scan(void) {
+    if (!directory.lock) return;
+
+    SDL_LockMutex(directory.lock);
+    while (!directory.scan_done) {
+        SDL_WaitCondition(directory.scanned, directory.lock);
+    }
+    SDL_UnlockMutex(directory.lock);
+}
+
+void directory_index_close(void) {
+    if (directory.thread) {
+        SDL_SetAtomicInt(&directory.stopping, 1);
+        Uint64 wake = 1;
+        if (write(directory.wake_fd, &wake, sizeof(wake)) < 0) {
+            fprintf(stderr, "Failed to wake the directory index thread: %s\n", strerror(errno));
+        }
+        SDL_WaitThread(directory.thread, NULL);
+    }
+
+    if (directory.dir) closedir(directory.dir);
+    if (directory.inotify_fd >= 0) close(directory.inotify_fd);
+    if (directory.wake_fd >= 0) close(directory.wake_fd);
+    if (directory.scanned) SDL_DestroyCondition(directory.scanned);
+    if (directory.lock) SDL_DestroyMutex(directory.lock);
+    free_list(&directory.pending);
+    free_list(&directory.known);
+    free(directory.path);
+
+    Uint32 event_type = directory.event_type;
+    memset(&directory, 0, sizeof(directory));
+    directory.inotify_fd = -1;
+    directory.wake_fd = -1;
+    directory.event_type = event_type;
+}
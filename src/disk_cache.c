@@ -0,0 +1,332 @@
+/**
+ * disk_cache.c
+ * Implementation of the persistent page cache
+ *
+ * Each page is one file named after its 64-bit FNV-1a key, holding a small header (crop
+ * rectangle, edge colors, pixel format) followed by the raw rows of the display-sized
+ * surface, so a hit is a single read with no decode and no crop scan. A page's mtime is
+ * bumped on every hit and the oldest pages are deleted when the directory outgrows its cap.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <SDL3/SDL.h>
+
+#include "disk_cache.h"
+#include "comic_loaders.h"
+#include "page_pool.h"
+
+#define DISK_CACHE_MAGIC "ICPG"
+#define DISK_CACHE_VERSION 3
+#define DISK_CACHE_SUFFIX ".page"
+
+// Pruning goes a little below the cap so it is not run again on the next store
+#define DISK_CACHE_PRUNE_PERCENT 90
+
+// Age after which a temporary file can no longer belong to a store in progress
+#define DISK_CACHE_STALE_TEMP_SECONDS 3600
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// On-disk header, followed by height rows of width * 4 bytes
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint64 key;
+    Sint32 width;
+    Sint32 height;
+    Uint32 format;
+    Sint32 reduced_height;
+    float crop[4];
+    Uint8 left_color[4];
+    Uint8 right_color[4];
+    float balance[3];
+    Uint8 levels[2];
+    Uint8 padding[2];
+} DiskCacheHeader;
+
+// A page file seen while pruning
+typedef struct {
+    char name[32];
+    off_t size;
+    time_t mtime;
+} CacheFile;
+
+static struct {
+    char dir[1024];
+    size_t budget;
+    size_t bytes;            // Approximate size of the directory, updated on store
+    SDL_Mutex *lock;         // Serializes pruning and the byte count
+    bool enabled;
+} cache = {0};
+
+// 32-bit color pages, and gray ones (8-bit, restored with the page pool's gray palette)
+static bool stored_format(SDL_PixelFormat format) {
+    return SDL_BYTESPERPIXEL(format) == 4 || format == SDL_PIXELFORMAT_INDEX8;
+}
+
+static Uint64 fnv1a(Uint64 hash, const void *data, size_t size) {
+    const Uint8 *bytes = (const Uint8*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static void page_path(Uint64 key, char *out_path, size_t out_size) {
+    snprintf(out_path, out_size, "%s/%016llx" DISK_CACHE_SUFFIX, cache.dir, (unsigned long long)key);
+}
+
+static int compare_oldest_first(const void *a, const void *b) {
+    const CacheFile *fa = (const CacheFile*)a;
+    const CacheFile *fb = (const CacheFile*)b;
+    return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+// Delete the least recently used pages until the directory fits the budget (lock held)
+static void prune(void) {
+    DIR *dir = opendir(cache.dir);
+    if (!dir) return;
+
+    CacheFile *files = NULL;
+    int count = 0, capacity = 0;
+    size_t total = 0;
+    struct dirent *entry;
+    char path[1280];
+
+    while ((entry = readdir(dir)) != NULL) {
+        // Temporary files left behind by an interrupted store
+        if (strncmp(entry->d_name, "tmp-", 4) == 0) {
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", cache.dir, entry->d_name);
+            if (stat(path, &st) == 0 && time(NULL) - st.st_mtime > DISK_CACHE_STALE_TEMP_SECONDS) {
+                unlink(path);
+            }
+            continue;
+        }
+
+        size_t length = strlen(entry->d_name);
+        size_t suffix = strlen(DISK_CACHE_SUFFIX);
+        if (length <= suffix || length >= sizeof(files[0].name) ||
+            strcmp(entry->d_name + length - suffix, DISK_CACHE_SUFFIX) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", cache.dir, entry->d_name);
+        if (stat(path, &st) != 0) continue;
+
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            CacheFile *grown = realloc(files, capacity * sizeof(CacheFile));
+            if (!grown) break;
+            files = grown;
+        }
+        snprintf(files[count].name, sizeof(files[count].name), "%s", entry->d_name);
+        files[count].size = st.st_size;
+        files[count].mtime = st.st_mtime;
+        total += st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    size_t target = cache.budget / 100 * DISK_CACHE_PRUNE_PERCENT;
+    if (total > cache.budget) {
+        qsort(files, count, sizeof(CacheFile), compare_oldest_first);
+        for (int i = 0; i < count && total > target; i++) {
+            snprintf(path, sizeof(path), "%s/%s", cache.dir, files[i].name);
+            if (unlink(path) == 0) {
+                total -= files[i].size;
+            }
+        }
+    }
+
+    cache.bytes = total;
+    free(files);
+}
+
+bool disk_cache_init(size_t budget) {
+    if (budget == 0) return false;
+
+    const char *xdg_cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg_cache && *xdg_cache) {
+        snprintf(cache.dir, sizeof(cache.dir), "%s/ic", xdg_cache);
+    } else if (home && *home) {
+        snprintf(cache.dir, sizeof(cache.dir), "%s/.cache/ic", home);
+    } else {
+        return false;
+    }
+
+    if (!make_directories(cache.dir)) {
+        fprintf(stderr, "Failed to create page cache directory %s\n", cache.dir);
+        return false;
+    }
+
+    cache.lock = SDL_CreateMutex();
+    if (!cache.lock) {
+        fprintf(stderr, "Failed to create page cache lock: %s\n", SDL_GetError());
+        return false;
+    }
+
+    cache.budget = budget;
+    prune();
+    cache.enabled = true;
+    return true;
+}
+
+Uint64 disk_cache_key(const char *source_path, const char *entry_name, int page, int target_height,
+                      const void *settings, size_t settings_size) {
+    struct stat st;
+    if (!cache.enabled || !source_path || stat(source_path, &st) != 0) {
+        return 0;
+    }
+
+    Uint64 size = (Uint64)st.st_size;
+    Sint64 mtime_sec = (Sint64)st.st_mtim.tv_sec;
+    Sint64 mtime_nsec = (Sint64)st.st_mtim.tv_nsec;
+
+    Uint64 hash = FNV_OFFSET_BASIS;
+    hash = fnv1a(hash, source_path, strlen(source_path) + 1);
+    hash = fnv1a(hash, &size, sizeof(size));
+    hash = fnv1a(hash, &mtime_sec, sizeof(mtime_sec));
+    hash = fnv1a(hash, &mtime_nsec, sizeof(mtime_nsec));
+    if (entry_name) {
+        hash = fnv1a(hash, entry_name, strlen(entry_name) + 1);
+    }
+    hash = fnv1a(hash, &page, sizeof(page));
+    hash = fnv1a(hash, &target_height, sizeof(target_height));
+    if (settings) {
+        hash = fnv1a(hash, settings, settings_size);
+    }
+
+    // 0 means "no key"
+    return hash ? hash : 1;
+}
+
+bool disk_cache_load(Uint64 key, DecodeResult *result) {
+    if (!cache.enabled || key == 0 || !result) return false;
+
+    char path[1280];
+    page_path(key, path, sizeof(path));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    DiskCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, DISK_CACHE_MAGIC, 4) == 0 &&
+                 header.version == DISK_CACHE_VERSION && header.key == key &&
+                 header.width > 0 && header.height > 0 &&
+                 stored_format((SDL_PixelFormat)header.format);
+
+    SDL_Surface *surface = NULL;
+    if (valid) {
+        surface = page_pool_acquire_surface(header.width, header.height, (SDL_PixelFormat)header.format);
+        valid = surface != NULL;
+    }
+
+    size_t row_bytes = valid ? (size_t)header.width * SDL_BYTESPERPIXEL((SDL_PixelFormat)header.format) : 0;
+    for (int y = 0; valid && y < header.height; y++) {
+        valid = fread((Uint8*)surface->pixels + (size_t)y * surface->pitch, row_bytes, 1, file) == 1;
+    }
+    fclose(file);
+
+    if (!valid) {
+        // Truncated or from another version, it is rewritten by the next store
+        page_pool_release_surface(surface);
+        unlink(path);
+        return false;
+    }
+
+    // Hits count as uses for the LRU pruning
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    result->surface = surface;
+    result->crop_rect = (SDL_FRect){header.crop[0], header.crop[1], header.crop[2], header.crop[3]};
+    result->left_color = (SDL_Color){header.left_color[0], header.left_color[1], header.left_color[2], header.left_color[3]};
+    result->right_color = (SDL_Color){header.right_color[0], header.right_color[1], header.right_color[2], header.right_color[3]};
+    result->reduced_height = header.reduced_height;
+    memcpy(result->enhance.balance, header.balance, sizeof(header.balance));
+    result->enhance.black = header.levels[0];
+    result->enhance.white = header.levels[1];
+    return true;
+}
+
+bool disk_cache_store(Uint64 key, const DecodeResult *result) {
+    if (!cache.enabled || key == 0 || !result || !result->surface) return false;
+
+    SDL_Surface *surface = result->surface;
+    if (!stored_format(surface->format)) return false;
+
+    DiskCacheHeader header = {0};
+    memcpy(header.magic, DISK_CACHE_MAGIC, 4);
+    header.version = DISK_CACHE_VERSION;
+    header.key = key;
+    header.width = surface->w;
+    header.height = surface->h;
+    header.format = (Uint32)surface->format;
+    header.reduced_height = result->reduced_height;
+    header.crop[0] = result->crop_rect.x;
+    header.crop[1] = result->crop_rect.y;
+    header.crop[2] = result->crop_rect.w;
+    header.crop[3] = result->crop_rect.h;
+    memcpy(header.left_color, &result->left_color, 4);
+    memcpy(header.right_color, &result->right_color, 4);
+    memcpy(header.balance, result->enhance.balance, sizeof(header.balance));
+    header.levels[0] = result->enhance.black;
+    header.levels[1] = result->enhance.white;
+
+    // Write under a temporary name so readers never see a partial page
+    char temp_path[1280];
+    snprintf(temp_path, sizeof(temp_path), "%s/tmp-XXXXXX", cache.dir);
+    int fd = mkstemp(temp_path);
+    if (fd < 0) return false;
+
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(temp_path);
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t row_bytes = (size_t)surface->w * SDL_BYTESPERPIXEL(surface->format);
+    for (int y = 0; written && y < surface->h; y++) {
+        written = fwrite((const Uint8*)surface->pixels + (size_t)y * surface->pitch, row_bytes, 1, file) == 1;
+    }
+    written = fclose(file) == 0 && written;
+
+    char path[1280];
+    page_path(key, path, sizeof(path));
+    if (!written || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+        return false;
+    }
+
+    SDL_LockMutex(cache.lock);
+    cache.bytes += sizeof(header) + row_bytes * surface->h;
+    if (cache.bytes > cache.budget) {
+        prune();
+    }
+    SDL_UnlockMutex(cache.lock);
+
+    return true;
+}
+
+void disk_cache_shutdown(void) {
+    if (cache.lock) {
+        SDL_DestroyMutex(cache.lock);
+    }
+    memset(&cache, 0, sizeof(cache));
+}
@@ -0,0 +1,516 @@
+/**
+ * http_source.c
+ * Implementation of the HTTP range reader, its block cache and readahead thread
+ *
+ * A read first looks for its blocks in the cache. The first missing run of blocks is then
+ * claimed as in flight and fetched with one range request outside the lock. Readers that
+ * need a block another thread is fetching wait for that fetch instead of requesting it again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "http_source.h"
+
+bool http_source_is_url(const char *path) {
+    return path && (strncasecmp(path, "http://", 7) == 0 || strncasecmp(path, "https://", 8) == 0);
+}
+
+#ifdef HAVE_CURL
+
+#include <curl/curl.h>
+
+#include "trace.h"
+
+// Runs being fetched at once, the decode workers plus the readahead thread
+#define HTTP_MAX_IN_FLIGHT 32
+
+// Reads larger than this skip the cache, they would evict their own blocks
+#define HTTP_CACHE_BYPASS ((size_t)HTTP_CACHE_BLOCKS * HTTP_BLOCK_SIZE / 4)
+
+#define HTTP_CONNECT_TIMEOUT_S 10
+
+// Transfers slower than a byte per second for this long are abandoned
+#define HTTP_STALL_TIMEOUT_S 30
+
+typedef struct {
+    Uint64 index;             // Block number, offset / HTTP_BLOCK_SIZE
+    Uint8 *data;              // HTTP_BLOCK_SIZE bytes, NULL for an unused slot
+    size_t length;            // Shorter than a block only at the end of the resource
+    Uint64 last_used;
+} HttpBlock;
+
+typedef struct {
+    Uint64 first;
+    Uint64 last;
+} BlockRun;
+
+struct HttpSource {
+    char *url;                // Where redirects ended up, later requests go there directly
+    Uint64 size;
+    SDL_Mutex *lock;          // Guards everything below
+    SDL_Condition *fetched;   // Signaled whenever an in-flight run completes
+    HttpBlock blocks[HTTP_CACHE_BLOCKS];
+    Uint64 clock;             // Incremented on every block use, for LRU eviction
+    BlockRun in_flight[HTTP_MAX_IN_FLIGHT];
+    int in_flight_count;
+    CURL *idle[HTTP_MAX_CONNECTIONS];
+    int idle_count;
+
+    // Readahead
+    SDL_Thread *thread;
+    SDL_Condition *wake;
+    SourceSpan queue[HTTP_READAHEAD_QUEUE];
+    int queue_head;
+    int queue_count;
+    bool running;
+};
+
+typedef struct {
+    Uint8 *data;
+    size_t capacity;
+    size_t written;
+} HttpBuffer;
+
+static SDL_AtomicInt curl_users;
+
+static size_t write_body(char *ptr, size_t size, size_t nmemb, void *user) {
+    HttpBuffer *buffer = (HttpBuffer*)user;
+    size_t bytes = size * nmemb;
+
+    // A server that ignores the range sends the whole file, stop it there
+    if (bytes > buffer->capacity - buffer->written) {
+        return 0;
+    }
+    memcpy(buffer->data + buffer->written, ptr, bytes);
+    buffer->written += bytes;
+    return bytes;
+}
+
+// An idle connection, or a new handle; callers must not hold the lock
+static CURL* acquire_handle(HttpSource *source) {
+    CURL *curl = NULL;
+    SDL_LockMutex(source->lock);
+    if (source->idle_count > 0) {
+        curl = source->idle[--source->idle_count];
+    }
+    SDL_UnlockMutex(source->lock);
+    if (curl) {
+        return curl;
+    }
+
+    curl = curl_easy_init();
+    if (!curl) {
+        fprintf(stderr, "Failed to create HTTP handle\n");
+        return NULL;
+    }
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)HTTP_CONNECT_TIMEOUT_S);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)HTTP_STALL_TIMEOUT_S);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "ic");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_body);
+    return curl;
+}
+
+// Keep the connection open for the next request
+static void release_handle(HttpSource *source, CURL *curl) {
+    SDL_LockMutex(source->lock);
+    if (source->idle_count < HTTP_MAX_CONNECTIONS) {
+        source->idle[source->idle_count++] = curl;
+        curl = NULL;
+    }
+    SDL_UnlockMutex(source->lock);
+
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+}
+
+// Fetch length bytes at offset into data with one range request
+static bool fetch_range(HttpSource *source, Uint64 offset, void *data, size_t length) {
+    CURL *curl = acquire_handle(source);
+    if (!curl) {
+        return false;
+    }
+
+    char range[64];
+    snprintf(range, sizeof(range), "%llu-%llu", (unsigned long long)offset,
+             (unsigned long long)(offset + length - 1));
+    HttpBuffer buffer = {data, length, 0};
+
+    curl_easy_setopt(curl, CURLOPT_URL, source->url);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
+
+    TraceZone zone = trace_begin("http_fetch");
+    CURLcode code = curl_easy_perform(curl);
+    trace_end(&zone);
+
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+    // A 200 is only the range when the range is the whole resource
+    bool whole = offset == 0 && length == source->size;
+    bool ok = code == CURLE_OK && (status == 206 || (status == 200 && whole)) && buffer.written == length;
+    if (!ok) {
+        if (code == CURLE_WRITE_ERROR || status == 200) {
+            fprintf(stderr, "Server does not support range requests: %s\n", source->url);
+        } else {
+            fprintf(stderr, "HTTP range %s of %s failed: %s (status %ld)\n", range, source->url,
+                    curl_easy_strerror(code), status);
+        }
+    }
+
+    release_handle(source, curl);
+    return ok;
+}
+
+static HttpBlock* find_block(HttpSource *source, Uint64 index) {
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        if (source->blocks[i].data && source->blocks[i].index == index) {
+            return &source->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+static bool block_in_flight(HttpSource *source, Uint64 index) {
+    for (int i = 0; i < source->in_flight_count; i++) {
+        if (index >= source->in_flight[i].first && index <= source->in_flight[i].last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// An unused slot, or the least recently used block
+static HttpBlock* free_block(HttpSource *source) {
+    HttpBlock *oldest = &source->blocks[0];
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        HttpBlock *block = &source->blocks[i];
+        if (!block->data) {
+            block->data = malloc(HTTP_BLOCK_SIZE);
+            return block->data ? block : NULL;
+        }
+        if (block->last_used < oldest->last_used) {
+            oldest = block;
+        }
+    }
+    return oldest;
+}
+
+static size_t block_length(const HttpSource *source, Uint64 index) {
+    Uint64 start = index * HTTP_BLOCK_SIZE;
+    return source->size - start < HTTP_BLOCK_SIZE ? (size_t)(source->size - start) : HTTP_BLOCK_SIZE;
+}
+
+// Fetch a run of blocks and add them to the cache; called and returns with the lock held
+static bool fetch_run(HttpSource *source, BlockRun run) {
+    Uint64 offset = run.first * HTTP_BLOCK_SIZE;
+    Uint64 end = (run.last + 1) * HTTP_BLOCK_SIZE;
+    if (end > source->size) end = source->size;
+    size_t length = (size_t)(end - offset);
+
+    source->in_flight[source->in_flight_count++] = run;
+    SDL_UnlockMutex(source->lock);
+
+    Uint8 *data = malloc(length);
+    bool ok = data && fetch_range(source, offset, data, length);
+
+    SDL_LockMutex(source->lock);
+    for (int i = 0; i < source->in_flight_count; i++) {
+        if (source->in_flight[i].first == run.first && source->in_flight[i].last == run.last) {
+            source->in_flight[i] = source->in_flight[--source->in_flight_count];
+            break;
+        }
+    }
+
+    for (Uint64 index = run.first; ok && index <= run.last; index++) {
+        HttpBlock *block = find_block(source, index);
+        if (!block) block = free_block(source);
+        if (!block) break;
+        block->index = index;
+        block->length = block_length(source, index);
+        block->last_used = ++source->clock;
+        memcpy(block->data, data + (index - run.first) * HTTP_BLOCK_SIZE, block->length);
+    }
+    SDL_BroadcastCondition(source->fetched);
+
+    free(data);
+    return ok;
+}
+
+// Make blocks first to last resident, fetching what nobody else is fetching; called and
+// returns with the lock held; the range must fit in the cache
+static bool load_blocks(HttpSource *source, Uint64 first, Uint64 last) {
+    for (;;) {
+        Uint64 missing = first;
+        while (missing <= last && find_block(source, missing)) {
+            missing++;
+        }
+        if (missing > last) {
+            return true;
+        }
+
+        if (block_in_flight(source, missing) || source->in_flight_count >= HTTP_MAX_IN_FLIGHT) {
+            SDL_WaitCondition(source->fetched, source->lock);
+            continue;
+        }
+
+        // Claim the missing blocks up to the first one that is cached or in flight
+        BlockRun run = {missing, missing};
+        while (run.last < last && !find_block(source, run.last + 1) && !block_in_flight(source, run.last + 1)) {
+            run.last++;
+        }
+        if (!fetch_run(source, run)) {
+            return false;
+        }
+    }
+}
+
+bool http_source_read(HttpSource *source, Uint64 offset, void *buffer, size_t length) {
+    if (!source || !buffer || offset > source->size || length > source->size - offset) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+
+    if (length > HTTP_CACHE_BYPASS) {
+        return fetch_range(source, offset, buffer, length);
+    }
+
+    Uint64 first = offset / HTTP_BLOCK_SIZE;
+    Uint64 last = (offset + length - 1) / HTTP_BLOCK_SIZE;
+
+    SDL_LockMutex(source->lock);
+    bool ok = load_blocks(source, first, last);
+
+    // Blocks are only evicted under the lock, so they are all still there
+    for (Uint64 index = first; ok && index <= last; index++) {
+        HttpBlock *block = find_block(source, index);
+        if (!block) {
+            ok = false;
+            break;
+        }
+        block->last_used = ++source->clock;
+
+        Uint64 block_start = index * HTTP_BLOCK_SIZE;
+        Uint64 start = offset > block_start ? offset : block_start;
+        Uint64 end = offset + length < block_start + block->length ? offset + length : block_start + block->length;
+        memcpy((Uint8*)buffer + (start - offset), block->data + (start - block_start), (size_t)(end - start));
+    }
+    SDL_UnlockMutex(source->lock);
+
+    return ok;
+}
+
+// Blocks of a span, clipped to the resource; only the start of spans too large for the
+// cache is kept
+static bool span_blocks(const HttpSource *source, SourceSpan span, BlockRun *run) {
+    if (span.length == 0 || span.offset >= source->size) {
+        return false;
+    }
+    Uint64 length = span.length < source->size - span.offset ? span.length : source->size - span.offset;
+    if (length > HTTP_CACHE_BYPASS) length = HTTP_CACHE_BYPASS;
+
+    run->first = span.offset / HTTP_BLOCK_SIZE;
+    run->last = (span.offset + length - 1) / HTTP_BLOCK_SIZE;
+    return true;
+}
+
+bool http_source_load(HttpSource *source, SourceSpan span) {
+    BlockRun run;
+    if (!source || !span_blocks(source, span, &run)) {
+        return false;
+    }
+
+    SDL_LockMutex(source->lock);
+    bool ok = load_blocks(source, run.first, run.last);
+    SDL_UnlockMutex(source->lock);
+    return ok;
+}
+
+static int readahead_thread(void *data) {
+    HttpSource *source = (HttpSource*)data;
+
+    SDL_LockMutex(source->lock);
+    while (source->running) {
+        if (source->queue_count == 0) {
+            SDL_WaitCondition(source->wake, source->lock);
+            continue;
+        }
+
+        SourceSpan span = source->queue[source->queue_head];
+        source->queue_head = (source->queue_head + 1) % HTTP_READAHEAD_QUEUE;
+        source->queue_count--;
+
+        BlockRun run;
+        if (span_blocks(source, span, &run)) {
+            load_blocks(source, run.first, run.last);
+        }
+    }
+    SDL_UnlockMutex(source->lock);
+
+    return 0;
+}
+
+void http_source_readahead(HttpSource *source, SourceSpan span) {
+    if (!source || span.length == 0) return;
+
+    SDL_LockMutex(source->lock);
+    if (source->running && source->queue_count < HTTP_READAHEAD_QUEUE) {
+        source->queue[(source->queue_head + source->queue_count) % HTTP_READAHEAD_QUEUE] = span;
+        source->queue_count++;
+        SDL_SignalCondition(source->wake);
+    }
+    SDL_UnlockMutex(source->lock);
+}
+
+// Size of the resource and the URL redirects lead to, over a connection that is kept
+static bool probe_resource(HttpSource *source) {
+    CURL *curl = acquire_handle(source);
+    if (!curl) {
+        return false;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, source->url);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    CURLcode code = curl_easy_perform(curl);
+
+    long status = 0;
+    curl_off_t size = -1;
+    char *effective_url = NULL;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+
+    bool ok = code == CURLE_OK && status == 200 && size > 0;
+    if (!ok) {
+        fprintf(stderr, "Cannot open %s: %s (status %ld)\n", source->url, curl_easy_strerror(code), status);
+    } else {
+        source->size = (Uint64)size;
+        if (effective_url && strcmp(effective_url, source->url) != 0) {
+            char *url = strdup(effective_url);
+            if (url) {
+                free(source->url);
+                source->url = url;
+            }
+        }
+    }
+
+    release_handle(source, curl);
+    return ok;
+}
+
+HttpSource* http_source_open(const char *url) {
+    if (!http_source_is_url(url)) {
+        return NULL;
+    }
+
+    if (SDL_AddAtomicInt(&curl_users, 1) == 0 && curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        fprintf(stderr, "Failed to initialize libcurl\n");
+        SDL_AddAtomicInt(&curl_users, -1);
+        return NULL;
+    }
+
+    HttpSource *source = calloc(1, sizeof(HttpSource));
+    if (!source) {
+        SDL_AddAtomicInt(&curl_users, -1);
+        return NULL;
+    }
+    source->url = strdup(url);
+    source->lock = SDL_CreateMutex();
+    source->fetched = SDL_CreateCondition();
+    source->wake = SDL_CreateCondition();
+    if (!source->url || !source->lock || !source->fetched || !source->wake || !probe_resource(source)) {
+        http_source_close(source);
+        return NULL;
+    }
+
+    source->running = true;
+    source->thread = SDL_CreateThread(readahead_thread, "http_readahead", source);
+    if (!source->thread) {
+        // Pages are still fetched when they are read
+        fprintf(stderr, "Failed to start HTTP readahead: %s\n", SDL_GetError());
+        source->running = false;
+    }
+
+    return source;
+}
+
+Uint64 http_source_size(const HttpSource *source) {
+    return source ? source->size : 0;
+}
+
+void http_source_close(HttpSource *source) {
+    if (!source) return;
+
+    if (source->thread) {
+        SDL_LockMutex(source->lock);
+        source->running = false;
+        source->queue_count = 0;
+        SDL_SignalCondition(source->wake);
+        SDL_UnlockMutex(source->lock);
+        SDL_WaitThread(source->thread, NULL);
+    }
+
+    for (int i = 0; i < source->idle_count; i++) {
+        curl_easy_cleanup(source->idle[i]);
+    }
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        free(source->blocks[i].data);
+    }
+    if (source->wake) SDL_DestroyCondition(source->wake);
+    if (source->fetched) SDL_DestroyCondition(source->fetched);
+    if (source->lock) SDL_DestroyMutex(source->lock);
+    free(source->url);
+    free(source);
+
+    if (SDL_AddAtomicInt(&curl_users, -1) == 1) {
+        curl_global_cleanup();
+    }
+}
+
+#else
+
+HttpSource* http_source_open(const char *url) {
+    fprintf(stderr, "Cannot open %s: ic was built without libcurl (make CURL=1)\n", url ? url : "");
+    return NULL;
+}
+
+Uint64 http_source_size(const HttpSource *source) {
+    (void)source;
+    return 0;
+}
+
+bool http_source_read(HttpSource *source, Uint64 offset, void *buffer, size_t length) {
+    (void)source;
+    (void)offset;
+    (void)buffer;
+    (void)length;
+    return false;
+}
+
+bool http_source_load(HttpSource *source, SourceSpan span) {
+    (void)source;
+    (void)span;
+    return false;
+}
+
+void http_source_readahead(HttpSource *source, SourceSpan span) {
+    (void)source;
+    (void)span;
+}
+
+void http_source_close(HttpSource *source) {
+    (void)source;
+}
+
+#endif // HAVE_CURL
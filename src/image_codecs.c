@@ -0,0 +1,270 @@
+/**
+ * image_codecs.c
+ * Implementation of the direct JPEG, PNG and WebP backends
+ *
+ * JPEGs are scaled in the DCT like FreeImage did, WebP pages are scaled by the decoder;
+ * PNGs are decoded at full size and reduced by the caller. Color pages come out in the byte
+ * orders the libraries write natively, gray JPEGs and PNGs straight into 8-bit surfaces.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image_codecs.h"
+#include "page_pool.h"
+
+#ifdef HAVE_LIBJPEG_TURBO
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+#ifdef HAVE_SPNG
+#include <spng.h>
+#endif
+#ifdef HAVE_WEBP
+#include <webp/decode.h>
+#endif
+
+// Rows handed to libjpeg per call
+#define JPEG_ROW_BATCH 16
+
+// Set before the decode workers start, read by them
+static bool codecs_enabled = true;
+
+int image_codec_reduction(int height, int target_height) {
+    int denom = 1;
+    while (target_height > 0 && denom < 8 && height / (denom * 2) >= target_height) {
+        denom *= 2;
+    }
+    return denom;
+}
+
+#ifdef HAVE_LIBJPEG_TURBO
+typedef struct {
+    struct jpeg_error_mgr base;
+    jmp_buf jump;
+} JpegError;
+
+static void jpeg_error_exit(j_common_ptr info) {
+    char message[JMSG_LENGTH_MAX];
+    info->err->format_message(info, message);
+    fprintf(stderr, "libjpeg-turbo: %s\n", message);
+    longjmp(((JpegError*)info->err)->jump, 1);
+}
+
+static SDL_Surface* decode_jpeg(const void *data, size_t size, int target_height, bool *out_reduced) {
+    struct jpeg_decompress_struct info;
+    JpegError error;
+    SDL_Surface *volatile surface = NULL;
+
+    info.err = jpeg_std_error(&error.base);
+    error.base.error_exit = jpeg_error_exit;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        page_pool_release_surface(surface);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, (const unsigned char*)data, (unsigned long)size);
+    jpeg_read_header(&info, TRUE);
+
+    // CMYK and YCCK scans are left to FreeImage, which converts them
+    if (info.num_components != 1 && info.num_components != 3) {
+        jpeg_destroy_decompress(&info);
+        return NULL;
+    }
+
+    bool gray = info.num_components == 1;
+    int denom = image_codec_reduction((int)info.image_height, target_height);
+    info.out_color_space = gray ? JCS_GRAYSCALE : JCS_EXT_BGRX;
+    info.dct_method = JDCT_ISLOW;
+    info.scale_num = 1;
+    info.scale_denom = denom;
+    jpeg_start_decompress(&info);
+
+    int width = (int)info.output_width;
+    int height = (int)info.output_height;
+    surface = gray ? page_pool_acquire_gray_surface(width, height)
+                   : page_pool_acquire_surface(width, height, SDL_PIXELFORMAT_BGRX32);
+    if (!surface) {
+        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
+        jpeg_destroy_decompress(&info);
+        return NULL;
+    }
+
+    // Rows are written top-down in place, nothing is copied afterwards
+    JSAMPROW rows[JPEG_ROW_BATCH];
+    while (info.output_scanline < info.output_height) {
+        JDIMENSION count = info.output_height - info.output_scanline;
+        if (count > JPEG_ROW_BATCH) count = JPEG_ROW_BATCH;
+        for (JDIMENSION i = 0; i < count; i++) {
+            rows[i] = (JSAMPROW)surface->pixels + (size_t)(info.output_scanline + i) * surface->pitch;
+        }
+        jpeg_read_scanlines(&info, rows, count);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    *out_reduced = denom > 1;
+    return surface;
+}
+#endif
+
+#ifdef HAVE_SPNG
+// Decode the rows of an opened PNG in the order the encoder wrote them (Adam7 passes included)
+static SDL_Surface* decode_png_rows(spng_ctx *ctx) {
+    struct spng_ihdr ihdr;
+    if (spng_get_ihdr(ctx, &ihdr) != 0) {
+        return NULL;
+    }
+
+    // Gray pages without transparency take one byte per pixel, everything else 8-bit RGBA
+    struct spng_trns trns;
+    bool has_trns = spng_get_trns(ctx, &trns) == 0;
+    bool gray = ihdr.color_type == SPNG_COLOR_TYPE_GRAYSCALE && ihdr.bit_depth <= 8 && !has_trns;
+    bool alpha = has_trns || ihdr.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA ||
+                 ihdr.color_type == SPNG_COLOR_TYPE_TRUECOLOR_ALPHA;
+    int format = gray ? SPNG_FMT_G8 : SPNG_FMT_RGBA8;
+
+    int width = (int)ihdr.width;
+    int height = (int)ihdr.height;
+    SDL_Surface *surface = gray ? page_pool_acquire_gray_surface(width, height)
+                                : page_pool_acquire_surface(width, height,
+                                                            alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGBX32);
+    if (!surface) {
+        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    int result = spng_decode_image(ctx, NULL, 0, format, SPNG_DECODE_TRNS | SPNG_DECODE_PROGRESSIVE);
+    size_t row_bytes = (size_t)width * (gray ? 1 : 4);
+    while (result == 0) {
+        struct spng_row_info row;
+        result = spng_get_row_info(ctx, &row);
+        if (result == 0) {
+            result = spng_decode_row(ctx, (uint8_t*)surface->pixels + (size_t)row.row_num * surface->pitch, row_bytes);
+        }
+    }
+
+    if (result != SPNG_EOI) {
+        fprintf(stderr, "libspng: %s\n", spng_strerror(result));
+        page_pool_release_surface(surface);
+        return NULL;
+    }
+    return surface;
+}
+
+static SDL_Surface* decode_png(const void *data, size_t size, int target_height, bool *out_reduced) {
+    (void)target_height;
+    *out_reduced = false;
+
+    spng_ctx *ctx = spng_ctx_new(0);
+    if (!ctx) {
+        return NULL;
+    }
+
+    SDL_Surface *surface = NULL;
+    if (spng_set_png_buffer(ctx, data, size) == 0) {
+        surface = decode_png_rows(ctx);
+    }
+    spng_ctx_free(ctx);
+    return surface;
+}
+#endif
+
+#ifdef HAVE_WEBP
+static SDL_Surface* decode_webp(const void *data, size_t size, int target_height, bool *out_reduced) {
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config) ||
+        WebPGetFeatures((const uint8_t*)data, size, &config.input) != VP8_STATUS_OK) {
+        return NULL;
+    }
+
+    // Animations are left to FreeImage
+    if (config.input.has_animation) {
+        return NULL;
+    }
+
+    int width = config.input.width;
+    int height = config.input.height;
+    int denom = image_codec_reduction(height, target_height);
+    if (denom > 1) {
+        width /= denom;
+        height /= denom;
+        config.options.use_scaling = 1;
+        config.options.scaled_width = width;
+        config.options.scaled_height = height;
+    }
+
+    // Lossy pages run the in-loop filter on a second thread
+    config.options.use_threads = 1;
+
+    SDL_Surface *surface = page_pool_acquire_surface(width, height, config.input.has_alpha ? SDL_PIXELFORMAT_BGRA32
+                                                                                           : SDL_PIXELFORMAT_BGRX32);
+    if (!surface) {
+        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    // Decoded straight into the surface, alpha is 255 on opaque pages
+    config.output.colorspace = MODE_BGRA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = (uint8_t*)surface->pixels;
+    config.output.u.RGBA.stride = surface->pitch;
+    config.output.u.RGBA.size = (size_t)surface->pitch * height;
+
+    VP8StatusCode status = WebPDecode((const uint8_t*)data, size, &config);
+    WebPFreeDecBuffer(&config.output);
+    if (status != VP8_STATUS_OK) {
+        fprintf(stderr, "libwebp: decoding failed with status %d\n", (int)status);
+        page_pool_release_surface(surface);
+        return NULL;
+    }
+
+    *out_reduced = denom > 1;
+    return surface;
+}
+#endif
+
+static const ImageCodec codecs[] = {
+#ifdef HAVE_LIBJPEG_TURBO
+    {"libjpeg-turbo", IMAGE_FORMAT_JPEG, decode_jpeg},
+#endif
+#ifdef HAVE_SPNG
+    {"libspng", IMAGE_FORMAT_PNG, decode_png},
+#endif
+#ifdef HAVE_WEBP
+    {"libwebp", IMAGE_FORMAT_WEBP, decode_webp},
+#endif
+    {NULL, IMAGE_FORMAT_UNKNOWN, NULL}
+};
+
+const ImageCodec* image_codec_find(ImageFormat format) {
+    if (!codecs_enabled || format == IMAGE_FORMAT_UNKNOWN) {
+        return NULL;
+    }
+
+    for (const ImageCodec *codec = codecs; codec->name; codec++) {
+        if (codec->format == format) {
+            return codec;
+        }
+    }
+    return NULL;
+}
+
+void image_codecs_set_enabled(bool enabled) {
+    codecs_enabled = enabled;
+}
+
+bool image_codecs_enabled(void) {
+    return codecs_enabled;
+}
+
+int image_codecs_active(const ImageCodec **out, int max) {
+    int count = 0;
+    for (const ImageCodec *codec = codecs; codecs_enabled && codec->name && count < max; codec++) {
+        out[count++] = codec;
+    }
+    return count;
+}
@@ -1,5 +1,10 @@
 #include "image_loader.h"
 #include "image_processor.h"
+#include "bench.h"
+#include "trace.h"
+#include "page_pool.h"
+#include "image_codecs.h"
+#include "source_io.h"
 #include <FreeImage.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -123,11 +128,350 @@ Image* image_load(const char *filename) {
     return image;
 }
 
-SDL_Surface* image_load_surface(const char *filename, ImageProcessingOptions *options) {
+// FreeImage keeps pixels in memory as B, G, R(, A) on little endian hosts
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+#define FREEIMAGE_FORMAT_24 SDL_PIXELFORMAT_BGR24
+#define FREEIMAGE_FORMAT_32 SDL_PIXELFORMAT_BGRA32
+#define FREEIMAGE_FORMAT_32_OPAQUE SDL_PIXELFORMAT_BGRX32
+#else
+#define FREEIMAGE_FORMAT_24 SDL_PIXELFORMAT_RGB24
+#define FREEIMAGE_FORMAT_32 SDL_PIXELFORMAT_RGBA32
+#define FREEIMAGE_FORMAT_32_OPAQUE SDL_PIXELFORMAT_RGBX32
+#endif
+
+// JPEG load flags that let the codec scale the DCT down towards target_height
+// header is a pixel-less load of the same image, used to size the request
+static int jpeg_scaled_flags(FIBITMAP *header, int target_height) {
+    if (!header || target_height <= 0) {
+        return JPEG_ACCURATE;
+    }
+    
+    int width = FreeImage_GetWidth(header);
+    int height = FreeImage_GetHeight(header);
+    int denom = image_codec_reduction(height, target_height);
+    if (denom == 1) {
+        return JPEG_ACCURATE;
+    }
+    
+    // FreeImage takes the wanted size of the larger side in the high word
+    int requested_size = (width > height ? width : height) / denom;
+    return JPEG_ACCURATE | (requested_size << 16);
+}
+
+// How far apart the channels of a pixel may be for it to count as gray (JPEG chroma noise)
+#define GRAY_TOLERANCE 12
+
+// Storage classes of a page, from the smallest
+typedef enum {
+    PAGE_GRAY,       // One luma byte per pixel
+    PAGE_OPAQUE,     // 32-bit color, the alpha byte is padding and the texture is not blended
+    PAGE_ALPHA       // 32-bit color with transparency
+} PageLayout;
+
+// Whether every pixel of a 24 or 32-bit bitmap is gray, stopping at the first colored one
+static bool bitmap_is_gray(FIBITMAP *bitmap, unsigned bpp) {
+    int width = FreeImage_GetWidth(bitmap);
+    int height = FreeImage_GetHeight(bitmap);
+    int step = bpp / 8;
+
+    for (int y = 0; y < height; y++) {
+        const BYTE *pixel = FreeImage_GetScanLine(bitmap, y);
+        for (int x = 0; x < width; x++, pixel += step) {
+            int r = pixel[FI_RGBA_RED];
+            int g = pixel[FI_RGBA_GREEN];
+            int b = pixel[FI_RGBA_BLUE];
+            if (abs(r - g) > GRAY_TOLERANCE || abs(g - b) > GRAY_TOLERANCE || abs(r - b) > GRAY_TOLERANCE) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Classify a 24 or 32-bit bitmap, FreeImage reports 32-bit bitmaps whose alpha is all opaque as FIC_RGB
+static PageLayout classify_bitmap(FIBITMAP *bitmap, unsigned bpp) {
+    if (bpp == 32 && FreeImage_GetColorType(bitmap) == FIC_RGBALPHA) {
+        return PAGE_ALPHA;
+    }
+    return bitmap_is_gray(bitmap, bpp) ? PAGE_GRAY : PAGE_OPAQUE;
+}
+
+// Copy one bottom-up bitmap row into a surface row of the given layout
+static bool copy_row(const BYTE *src_line, unsigned bpp, int width, PageLayout layout, uint8_t *dst_line) {
+    if (layout == PAGE_GRAY) {
+        if (bpp == 8) {
+            memcpy(dst_line, src_line, width);
+            return true;
+        }
+        int step = bpp / 8;
+        for (int x = 0; x < width; x++, src_line += step) {
+            dst_line[x] = (uint8_t)((77 * src_line[FI_RGBA_RED] + 150 * src_line[FI_RGBA_GREEN] +
+                                     29 * src_line[FI_RGBA_BLUE]) >> 8);
+        }
+        return true;
+    }
+
+    SDL_PixelFormat format = layout == PAGE_OPAQUE ? FREEIMAGE_FORMAT_32_OPAQUE : FREEIMAGE_FORMAT_32;
+    if (bpp == 32) {
+        memcpy(dst_line, src_line, (size_t)width * 4);
+        return true;
+    }
+    return SDL_ConvertPixels(width, 1, FREEIMAGE_FORMAT_24, src_line, width * 3, format, dst_line, width * 4);
+}
+
+// Apply quality enhancements if enabled, in place on the surface
+static void enhance_loaded_surface(SDL_Surface *surface, ImageProcessingOptions *options) {
+    if (options && options->enhancement_enabled) {
+        BenchTimer timer = bench_start();
+        TraceZone zone = trace_begin("enhance_surface");
+        enhance_surface(surface, options);
+        trace_end(&zone);
+        bench_stop(&timer, BENCH_ENHANCE);
+    }
+}
+
+// Convert a decoded bitmap into an SDL surface, takes ownership of bitmap
+// Gray pages (including color files that only hold gray) get an 8-bit surface, color pages a
+// 32-bit one in FreeImage's own byte order, marked opaque unless some pixel is transparent.
+// Each row is copied once (flipped, since FreeImage is bottom-up) and 24-bit rows are expanded
+// on the way; enhancement then runs in place
+// Bitmaps that are still at least twice target_height are box-filtered down a mip level
+static SDL_Surface* bitmap_to_surface(FIBITMAP *bitmap, ImageProcessingOptions *options, const char *name,
+                                      int target_height, bool reduced, bool *out_reduced) {
+    // Black and white scans (1, 4 or 8-bit gray, either polarity) become 8-bit gray first
+    // The color type of 32-bit bitmaps is a scan of their alpha, left to classify_bitmap
+    bool low_depth = FreeImage_GetImageType(bitmap) == FIT_BITMAP && FreeImage_GetBPP(bitmap) <= 8;
+    FREE_IMAGE_COLOR_TYPE color_type = low_depth ? FreeImage_GetColorType(bitmap) : FIC_RGB;
+    if (low_depth && (color_type == FIC_MINISBLACK || color_type == FIC_MINISWHITE) &&
+        !(FreeImage_GetBPP(bitmap) == 8 && color_type == FIC_MINISBLACK)) {
+        FIBITMAP *gray = FreeImage_ConvertToGreyscale(bitmap);
+        if (gray) {
+            FreeImage_Unload(bitmap);
+            bitmap = gray;
+            color_type = FIC_MINISBLACK;
+        }
+    }
+    
+    int denom = image_codec_reduction(FreeImage_GetHeight(bitmap), target_height);
+    if (denom > 1) {
+        FIBITMAP *scaled = FreeImage_Rescale(bitmap, FreeImage_GetWidth(bitmap) / denom,
+                                             FreeImage_GetHeight(bitmap) / denom, FILTER_BOX);
+        if (scaled) {
+            FreeImage_Unload(bitmap);
+            bitmap = scaled;
+            reduced = true;
+        }
+    }
+    if (out_reduced) {
+        *out_reduced = reduced;
+    }
+    
+    unsigned bpp = FreeImage_GetBPP(bitmap);
+    bool bitmap_type = FreeImage_GetImageType(bitmap) == FIT_BITMAP;
+    bool gray8 = bitmap_type && bpp == 8 && color_type == FIC_MINISBLACK;
+    bool direct = bitmap_type && (bpp == 24 || bpp == 32);
+    
+    // Palettized, 16-bit and high dynamic range layouts go through FreeImage
+    if (!direct && !gray8) {
+        FIBITMAP *bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
+        FreeImage_Unload(bitmap);
+        
+        if (!bitmap32) {
+            fprintf(stderr, "Failed to convert image to 32-bit: %s\n", name);
+            return NULL;
+        }
+        bitmap = bitmap32;
+        bpp = 32;
+    }
+    PageLayout layout = gray8 ? PAGE_GRAY : classify_bitmap(bitmap, bpp);
+    
+    // Get image properties
+    int width = FreeImage_GetWidth(bitmap);
+    int height = FreeImage_GetHeight(bitmap);
+    
+    // Reuse the surface of an earlier page of the same size, every row is overwritten
+    SDL_Surface *surface;
+    if (layout == PAGE_GRAY) {
+        surface = page_pool_acquire_gray_surface(width, height);
+    } else {
+        surface = page_pool_acquire_surface(width, height,
+                                            layout == PAGE_OPAQUE ? FREEIMAGE_FORMAT_32_OPAQUE : FREEIMAGE_FORMAT_32);
+    }
+    if (!surface) {
+        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
+        FreeImage_Unload(bitmap);
+        return NULL;
+    }
+    
+    uint8_t *dst_pixels = (uint8_t*)surface->pixels;
+    for (int y = 0; y < height; y++) {
+        BYTE *src_line = FreeImage_GetScanLine(bitmap, height - 1 - y); // FreeImage is upside down
+        if (!copy_row(src_line, bpp, width, layout, dst_pixels + (size_t)y * surface->pitch)) {
+            fprintf(stderr, "Failed to convert image rows: %s (%s)\n", name, SDL_GetError());
+            page_pool_release_surface(surface);
+            FreeImage_Unload(bitmap);
+            return NULL;
+        }
+    }
+    
+    FreeImage_Unload(bitmap);
+    
+    enhance_loaded_surface(surface, options);
+    return surface;
+}
+
+SDL_Surface* image_compact_surface(SDL_Surface *surface) {
+    const SDL_PixelFormatDetails *details = surface ? SDL_GetPixelFormatDetails(surface->format) : NULL;
+    if (!details || details->bytes_per_pixel != 4) {
+        return surface;
+    }
+    
+    // Byte holding alpha (or padding), the other three are color
+    int alpha = -1;
+    for (int i = 0; i < 4; i++) {
+        Uint32 mask = SDL_BYTEORDER == SDL_BIG_ENDIAN ? 0xff000000u >> (8 * i) : 0xffu << (8 * i);
+        if ((details->Amask ? details->Amask : ~(details->Rmask | details->Gmask | details->Bmask)) == mask) {
+            alpha = i;
+        }
+    }
+    if (alpha < 0) {
+        return surface;
+    }
+    int c0 = alpha == 0 ? 1 : 0;
+    int c1 = alpha <= 1 ? 2 : 1;
+    int c2 = alpha <= 2 ? 3 : 2;
+    
+    // Stops at the first colored or transparent pixel, which comes early on color pages
+    for (int y = 0; y < surface->h; y++) {
+        const uint8_t *pixel = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        for (int x = 0; x < surface->w; x++, pixel += 4) {
+            if ((details->Amask && pixel[alpha] != 255) ||
+                abs(pixel[c0] - pixel[c1]) > GRAY_TOLERANCE || abs(pixel[c1] - pixel[c2]) > GRAY_TOLERANCE ||
+                abs(pixel[c0] - pixel[c2]) > GRAY_TOLERANCE) {
+                return surface;
+            }
+        }
+    }
+    
+    SDL_Surface *gray = page_pool_acquire_gray_surface(surface->w, surface->h);
+    if (!gray) {
+        return surface;
+    }
+    for (int y = 0; y < surface->h; y++) {
+        const uint8_t *pixel = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        uint8_t *out = (uint8_t*)gray->pixels + (size_t)y * gray->pitch;
+        for (int x = 0; x < surface->w; x++, pixel += 4) {
+            out[x] = (uint8_t)((pixel[c0] + pixel[c1] + pixel[c2] + 1) / 3);
+        }
+    }
+    page_pool_release_surface(surface);
+    return gray;
+}
+
+// Box filter a gray or 32-bit surface down by denom, releasing the original
+static SDL_Surface* reduce_surface(SDL_Surface *surface, int denom) {
+    int width = surface->w / denom;
+    int height = surface->h / denom;
+    bool gray = page_pool_is_gray(surface);
+    SDL_Surface *reduced = gray ? page_pool_acquire_gray_surface(width, height)
+                                : page_pool_acquire_surface(width, height, surface->format);
+    if (!reduced) {
+        return surface;
+    }
+    
+    int channels = gray ? 1 : 4;
+    int area = denom * denom;
+    for (int y = 0; y < height; y++) {
+        uint8_t *out = (uint8_t*)reduced->pixels + (size_t)y * reduced->pitch;
+        const uint8_t *in = (const uint8_t*)surface->pixels + (size_t)y * denom * surface->pitch;
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < channels; c++) {
+                int sum = 0;
+                for (int dy = 0; dy < denom; dy++) {
+                    const uint8_t *pixel = in + (size_t)dy * surface->pitch + (size_t)x * denom * channels + c;
+                    for (int dx = 0; dx < denom; dx++) {
+                        sum += pixel[dx * channels];
+                    }
+                }
+                out[x * channels + c] = (uint8_t)((sum + area / 2) / area);
+            }
+        }
+    }
+    page_pool_release_surface(surface);
+    return reduced;
+}
+
+// Decode with the backend registered for the file's magic bytes, NULL to fall back to FreeImage
+// Surfaces get the same treatment as FreeImage's: reduced a mip level when still twice
+// target_height, compacted to gray when there is no color, then enhanced
+static SDL_Surface* load_surface_direct(const void *data, size_t size, ImageProcessingOptions *options,
+                                        int target_height, bool *out_reduced) {
+    const ImageCodec *codec = image_codec_find(image_format_detect(data, size));
+    if (!codec) {
+        return NULL;
+    }
+    
+    TraceZone zone = trace_begin("image_decode_direct");
+    bool reduced = false;
+    SDL_Surface *surface = codec->decode(data, size, target_height, &reduced);
+    if (surface) {
+        int denom = image_codec_reduction(surface->h, target_height);
+        if (denom > 1) {
+            surface = reduce_surface(surface, denom);
+            reduced = true;
+        }
+        surface = image_compact_surface(surface);
+        enhance_loaded_surface(surface, options);
+        if (out_reduced) {
+            *out_reduced = reduced;
+        }
+    }
+    trace_end(&zone);
+    return surface;
+}
+
+bool image_load_size(const char *filename, int *width, int *height) {
+    if (!filename || !width || !height || !freeimage_initialized) {
+        return false;
+    }
+    
+    FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(filename, 0);
+    if (fif == FIF_UNKNOWN) {
+        fif = FreeImage_GetFIFFromFilename(filename);
+    }
+    if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsNoPixels(fif)) {
+        return false;
+    }
+    
+    FIBITMAP *header = FreeImage_Load(fif, filename, FIF_LOAD_NOPIXELS);
+    if (!header) {
+        return false;
+    }
+    
+    *width = (int)FreeImage_GetWidth(header);
+    *height = (int)FreeImage_GetHeight(header);
+    FreeImage_Unload(header);
+    
+    return *width > 0 && *height > 0;
+}
+
+SDL_Surface* image_load_surface(const char *filename, ImageProcessingOptions *options, int target_height, bool *out_reduced) {
     if (!filename || !freeimage_initialized) {
         return NULL;
     }
     
+    // The direct backends decode from memory, the file is mapped for them
+    const ImageCodec *codec;
+    if (image_codecs_active(&codec, 1) > 0) {
+        SourceMap source;
+        if (source_load(filename, &source)) {
+            SDL_Surface *surface = image_load_surface_from_memory(source.data, source.size, filename, options,
+                                                                  target_height, out_reduced);
+            source_close(&source);
+            return surface;
+        }
+    }
+    
     // Determine file format
     FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(filename, 0);
     if (fif == FIF_UNKNOWN) {
@@ -139,66 +483,81 @@ SDL_Surface* image_load_surface(const char *filename, ImageProcessingOptions *op
         return NULL;
     }
     
+    // JPEGs are decoded at reduced size by the codec itself
+    int flags = 0;
+    if (fif == FIF_JPEG && target_height > 0) {
+        FIBITMAP *header = FreeImage_Load(fif, filename, FIF_LOAD_NOPIXELS);
+        flags = jpeg_scaled_flags(header, target_height);
+        if (header) FreeImage_Unload(header);
+    }
+    
     // Load the image
-    FIBITMAP *bitmap = FreeImage_Load(fif, filename, 0);
+    TraceZone zone = trace_begin("image_load_surface");
+    FIBITMAP *bitmap = FreeImage_Load(fif, filename, flags);
     if (!bitmap) {
+        trace_end(&zone);
         fprintf(stderr, "Failed to load image: %s\n", filename);
         return NULL;
     }
     
-    // Convert to 32-bit RGBA
-    FIBITMAP *bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
-    FreeImage_Unload(bitmap);
-    
-    if (!bitmap32) {
-        fprintf(stderr, "Failed to convert image to 32-bit: %s\n", filename);
+    SDL_Surface *surface = bitmap_to_surface(bitmap, options, filename, target_height, flags >> 16 != 0, out_reduced);
+    trace_end(&zone);
+    return surface;
+}
+
+SDL_Surface* image_load_surface_from_memory(const void *data, size_t size, const char *name, ImageProcessingOptions *options,
+                                            int target_height, bool *out_reduced) {
+    if (!data || size == 0 || !freeimage_initialized) {
         return NULL;
     }
     
-    // Apply quality enhancements if enabled
-    FIBITMAP *enhanced = bitmap32;
-    if (options->enhancement_enabled) {
-        FIBITMAP *temp = auto_enhance_image(bitmap32, options);
-        if (temp) {
-            FreeImage_Unload(bitmap32);
-            enhanced = temp;
-        }
+    if (!name) name = "<memory>";
+    
+    SDL_Surface *direct = load_surface_direct(data, size, options, target_height, out_reduced);
+    if (direct) {
+        return direct;
     }
     
-    // Get image properties
-    int width = FreeImage_GetWidth(enhanced);
-    int height = FreeImage_GetHeight(enhanced);
-    int pitch = FreeImage_GetPitch(enhanced);
+    // FreeImage only reads from the buffer, it does not take ownership
+    FIMEMORY *memory = FreeImage_OpenMemory((BYTE*)data, (DWORD)size);
+    if (!memory) {
+        fprintf(stderr, "Failed to open memory stream: %s\n", name);
+        return NULL;
+    }
     
-    // Create SDL surface
-    SDL_Surface *surface = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
-    if (!surface) {
-        fprintf(stderr, "Failed to create SDL surface: %s\n", SDL_GetError());
-        FreeImage_Unload(enhanced);
+    // Determine format from the content, falling back to the entry name
+    FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(memory, 0);
+    if (fif == FIF_UNKNOWN) {
+        fif = FreeImage_GetFIFFromFilename(name);
+    }
+    
+    if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif)) {
+        fprintf(stderr, "Unsupported image format: %s\n", name);
+        FreeImage_CloseMemory(memory);
         return NULL;
     }
     
-    // Copy pixel data (FreeImage uses BGR, SDL expects RGB)
-    BYTE *src_bits = FreeImage_GetBits(enhanced);
-    uint8_t *dst_pixels = (uint8_t*)surface->pixels;
+    // JPEGs are decoded at reduced size by the codec itself
+    int flags = 0;
+    if (fif == FIF_JPEG && target_height > 0) {
+        FIBITMAP *header = FreeImage_LoadFromMemory(fif, memory, FIF_LOAD_NOPIXELS);
+        flags = jpeg_scaled_flags(header, target_height);
+        if (header) FreeImage_Unload(header);
+        FreeImage_SeekMemory(memory, 0, SEEK_SET);
+    }
     
-    for (int y = 0; y < height; y++) {
-        BYTE *src_line = src_bits + (height - 1 - y) * pitch; // FreeImage is upside down
-        uint8_t *dst_line = dst_pixels + y * surface->pitch;
-        
-        for (int x = 0; x < width; x++) {
-            int src_idx = x * 4;
-            int dst_idx = x * 4;
-            
-            // Convert BGRA to RGBA
-            dst_line[dst_idx + 0] = src_line[src_idx + 2]; // R
-            dst_line[dst_idx + 1] = src_line[src_idx + 1]; // G
-            dst_line[dst_idx + 2] = src_line[src_idx + 0]; // B
-            dst_line[dst_idx + 3] = src_line[src_idx + 3]; // A
-        }
+    TraceZone zone = trace_begin("image_load_surface");
+    FIBITMAP *bitmap = FreeImage_LoadFromMemory(fif, memory, flags);
+    FreeImage_CloseMemory(memory);
+    
+    if (!bitmap) {
+        trace_end(&zone);
+        fprintf(stderr, "Failed to load image: %s\n", name);
+        return NULL;
     }
     
-    FreeImage_Unload(enhanced);
+    SDL_Surface *surface = bitmap_to_surface(bitmap, options, name, target_height, flags >> 16 != 0, out_reduced);
+    trace_end(&zone);
     return surface;
 }
 
@@ -3,6 +3,7 @@
 
 #include <SDL3/SDL.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "image_processor.h"
 
 // Initialize FreeImage library
@@ -12,7 +13,21 @@ bool image_loader_init(void);
 void image_loader_cleanup(void);
 
 // Load image from file and return SDL_Surface (replacement for IMG_Load)
-SDL_Surface* image_load_surface(const char *filename, ImageProcessingOptions *options);
+// A target_height > 0 allows decoding at a power-of-two reduction that stays at least that tall;
+// out_reduced (optional) reports whether the surface is smaller than the image
+// options may be NULL to return the pixels as decoded
+SDL_Surface* image_load_surface(const char *filename, ImageProcessingOptions *options, int target_height, bool *out_reduced);
+
+// Decode an image held in memory (e.g. an archive entry), name is only used for format hints and errors
+SDL_Surface* image_load_surface_from_memory(const void *data, size_t size, const char *name, ImageProcessingOptions *options,
+                                            int target_height, bool *out_reduced);
+
+// Replace a 32-bit surface whose pixels are all opaque and gray (e.g. a rendered text page) by an
+// 8-bit gray one, releasing the original; other surfaces are returned as they are
+SDL_Surface* image_compact_surface(SDL_Surface *surface);
+
+// Image size from FreeImage's header-only load, for formats the header probes do not know
+bool image_load_size(const char *filename, int *width, int *height);
 
 // Check if file extension is supported
 bool image_is_supported(const char *filename);
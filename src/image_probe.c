@@ -0,0 +1,222 @@
+/**
+ * image_probe.c
+ * Implementation of the header-only dimension probes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "image_probe.h"
+
+static uint32_t read_be16(const uint8_t *p) {
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t read_le16(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t read_le24(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Walk the marker segments up to the first start-of-frame
+static bool probe_jpeg(const uint8_t *p, size_t size, int *width, int *height) {
+    size_t offset = 2;
+    while (offset + 4 <= size) {
+        if (p[offset] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = p[offset + 1];
+
+        // Fill bytes and markers without a length field
+        if (marker == 0xFF) {
+            offset++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            offset += 2;
+            continue;
+        }
+        // End of image or start of scan before any frame header
+        if (marker == 0xD9 || marker == 0xDA) {
+            return false;
+        }
+
+        uint32_t length = read_be16(p + offset + 2);
+        if (length < 2) {
+            return false;
+        }
+
+        // SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC) which share the range
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (offset + 9 > size) {
+                return false;
+            }
+            *height = (int)read_be16(p + offset + 5);
+            *width = (int)read_be16(p + offset + 7);
+            return true;
+        }
+
+        offset += 2 + length;
+    }
+    return false;
+}
+
+static bool probe_webp(const uint8_t *p, size_t size, int *width, int *height) {
+    if (size < 30) {
+        return false;
+    }
+
+    if (memcmp(p + 12, "VP8 ", 4) == 0) {
+        // Lossy: frame tag (3 bytes) and start code (9d 01 2a) precede the 14-bit sizes
+        if (p[23] != 0x9D || p[24] != 0x01 || p[25] != 0x2A) {
+            return false;
+        }
+        *width = (int)(read_le16(p + 26) & 0x3FFF);
+        *height = (int)(read_le16(p + 28) & 0x3FFF);
+        return true;
+    }
+    if (memcmp(p + 12, "VP8L", 4) == 0) {
+        // Lossless: signature byte then two 14-bit sizes minus one
+        if (p[20] != 0x2F) {
+            return false;
+        }
+        uint32_t bits = read_le32(p + 21);
+        *width = (int)(bits & 0x3FFF) + 1;
+        *height = (int)((bits >> 14) & 0x3FFF) + 1;
+        return true;
+    }
+    if (memcmp(p + 12, "VP8X", 4) == 0) {
+        // Extended: canvas size as 24-bit values minus one, after 4 bytes of flags
+        *width = (int)read_le24(p + 24) + 1;
+        *height = (int)read_le24(p + 27) + 1;
+        return true;
+    }
+    return false;
+}
+
+ImageFormat image_format_detect(const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t*)data;
+    if (!p) {
+        return IMAGE_FORMAT_UNKNOWN;
+    }
+
+    if (size >= 3 && p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF) {
+        return IMAGE_FORMAT_JPEG;
+    }
+    if (size >= 8 && memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        return IMAGE_FORMAT_PNG;
+    }
+    if (size >= 6 && (memcmp(p, "GIF87a", 6) == 0 || memcmp(p, "GIF89a", 6) == 0)) {
+        return IMAGE_FORMAT_GIF;
+    }
+    if (size >= 2 && p[0] == 'B' && p[1] == 'M') {
+        return IMAGE_FORMAT_BMP;
+    }
+    if (size >= 12 && memcmp(p, "RIFF", 4) == 0 && memcmp(p + 8, "WEBP", 4) == 0) {
+        return IMAGE_FORMAT_WEBP;
+    }
+    if (size >= 4 && (memcmp(p, "II*\0", 4) == 0 || memcmp(p, "MM\0*", 4) == 0)) {
+        return IMAGE_FORMAT_TIFF;
+    }
+    if (size >= 4 && memcmp(p, "8BPS", 4) == 0) {
+        return IMAGE_FORMAT_PSD;
+    }
+    if (size >= 4 && memcmp(p, "\0\0\1\0", 4) == 0) {
+        return IMAGE_FORMAT_ICO;
+    }
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+const char* image_format_name(ImageFormat format) {
+    static const char *names[IMAGE_FORMAT_COUNT] = {
+        "unknown", "jpeg", "png", "gif", "bmp", "webp", "tiff", "psd", "ico"
+    };
+    return format >= 0 && format < IMAGE_FORMAT_COUNT ? names[format] : names[IMAGE_FORMAT_UNKNOWN];
+}
+
+bool image_probe_size(const void *data, size_t size, int *width, int *height) {
+    if (!data || !width || !height) {
+        return false;
+    }
+
+    const uint8_t *p = (const uint8_t*)data;
+    bool found = false;
+
+    switch (image_format_detect(data, size)) {
+        case IMAGE_FORMAT_JPEG:
+            found = size >= 4 && probe_jpeg(p, size, width, height);
+            break;
+        case IMAGE_FORMAT_PNG:
+            if (size >= 24 && memcmp(p + 12, "IHDR", 4) == 0) {
+                *width = (int)read_be32(p + 16);
+                *height = (int)read_be32(p + 20);
+                found = true;
+            }
+            break;
+        case IMAGE_FORMAT_GIF:
+            if (size >= 10) {
+                *width = (int)read_le16(p + 6);
+                *height = (int)read_le16(p + 8);
+                found = true;
+            }
+            break;
+        case IMAGE_FORMAT_BMP:
+            if (size >= 26) {
+                uint32_t header_size = read_le32(p + 14);
+                if (header_size == 12) {
+                    // OS/2 BITMAPCOREHEADER has 16-bit sizes
+                    *width = (int)read_le16(p + 18);
+                    *height = (int)read_le16(p + 20);
+                } else {
+                    // Negative heights mark top-down bitmaps
+                    *width = abs((int32_t)read_le32(p + 18));
+                    *height = abs((int32_t)read_le32(p + 22));
+                }
+                found = true;
+            }
+            break;
+        case IMAGE_FORMAT_WEBP:
+            found = size >= 16 && probe_webp(p, size, width, height);
+            break;
+        default:
+            break;
+    }
+
+    return found && *width > 0 && *height > 0;
+}
+
+bool image_probe_file(const char *path, int *width, int *height) {
+    if (!path) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    uint8_t *buffer = malloc(IMAGE_PROBE_HEADER_SIZE);
+    if (!buffer) {
+        fclose(file);
+        return false;
+    }
+
+    size_t size = fread(buffer, 1, IMAGE_PROBE_HEADER_SIZE, file);
+    fclose(file);
+
+    bool found = image_probe_size(buffer, size, width, height);
+    free(buffer);
+    return found;
+}
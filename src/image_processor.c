@@ -1,179 +1,375 @@
 #include "image_processor.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 ImageProcessingOptions* get_default_processing_options(void) {
     ImageProcessingOptions* options = malloc(sizeof(ImageProcessingOptions));
     if (!options) return NULL;
 
-    options->enhancement_enabled = false;
+    // Cheap enough to leave on since the whole pipeline is a single pass
+    options->enhancement_enabled = true;
     options->gamma = 1.0;
     options->brightness = 0.0;
     options->contrast = 0.0;
     options->saturation = 1.0;
     options->auto_levels = true;
-    options->color_balance = false;
+    options->color_balance = true;
     options->sharpen = false;
+    options->sharpen_amount = 0.5;
 
     return options;
 }
 
-FIBITMAP* adjust_gamma_brightness_contrast(FIBITMAP* bitmap, double gamma, double brightness, double contrast) {
-    if (!bitmap || gamma <= 0) return NULL;
-    
-    FIBITMAP* result = FreeImage_Clone(bitmap);
-    if (!result) return NULL;
+// Rows and columns between the pixels sampled for the statistics
+#define ANALYZE_STEP 4
+
+// Share of the darkest and brightest samples auto levels ignores, in percent
+#define LEVELS_CLIP_PERCENT 0.5
+
+// Narrowest luma range auto levels stretches, flatter pages are left as they are
+#define LEVELS_MIN_RANGE 32
 
-    if (FreeImage_AdjustGamma(result, gamma) &&
-        FreeImage_AdjustBrightness(result, brightness) &&
-        FreeImage_AdjustContrast(result, contrast)) {
-        return result;
+// Byte offsets of the color channels inside a pixel; 8-bit surfaces are gray (a ramp
+// palette), their single byte is r, g and b at once
+typedef struct {
+    int r, g, b;
+    int bpp;
+} ChannelOffsets;
+
+static int mask_to_offset(Uint32 mask) {
+    int offset;
+    switch (mask) {
+        case 0x000000ffu: offset = 0; break;
+        case 0x0000ff00u: offset = 1; break;
+        case 0x00ff0000u: offset = 2; break;
+        case 0xff000000u: offset = 3; break;
+        default: return -1;
     }
-    
-    FreeImage_Unload(result);
-    return NULL;
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    offset = 3 - offset;
+#endif
+    return offset;
 }
 
-FIBITMAP* adjust_saturation(FIBITMAP* bitmap, double saturation) {
-    if (!bitmap) return NULL;
-    
-    FIBITMAP* result = FreeImage_Clone(bitmap);
-    if (!result) return NULL;
-    
-    // Convert saturation from 0.0-2.0 to -100 to 100 range
-    double sat_percent = (saturation - 1.0) * 100.0;
-    
-    if (FreeImage_AdjustColors(result, 0, 0, sat_percent, FALSE)) {
-        return result;
-    }
-    
-    FreeImage_Unload(result);
-    return NULL;
+static bool get_channel_offsets(SDL_Surface *surface, ChannelOffsets *offsets) {
+    if (surface->format == SDL_PIXELFORMAT_INDEX8) {
+        *offsets = (ChannelOffsets){0, 0, 0, 1};
+        return true;
+    }
+
+    offsets->bpp = 4;
+    const SDL_PixelFormatDetails *details = SDL_GetPixelFormatDetails(surface->format);
+    if (!details || details->bytes_per_pixel != 4) return false;
+
+    offsets->r = mask_to_offset(details->Rmask);
+    offsets->g = mask_to_offset(details->Gmask);
+    offsets->b = mask_to_offset(details->Bmask);
+    return offsets->r >= 0 && offsets->g >= 0 && offsets->b >= 0;
 }
 
-FIBITMAP* auto_color_balance(FIBITMAP* bitmap) {
-    if (!bitmap) return NULL;
-    
-    FIBITMAP* result = FreeImage_Clone(bitmap);
-    if (!result) return NULL;
-    
-    // Get image statistics for auto white balance
-    int width = FreeImage_GetWidth(result);
-    int height = FreeImage_GetHeight(result);
-    
-    if (width == 0 || height == 0) {
-        FreeImage_Unload(result);
-        return NULL;
-    }
-    
-    // Simple auto white balance using gray world assumption
-    unsigned long r_sum = 0, g_sum = 0, b_sum = 0;
-    unsigned long pixel_count = 0;
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            RGBQUAD color;
-            if (FreeImage_GetPixelColor(result, x, y, &color)) {
-                r_sum += color.rgbRed;
-                g_sum += color.rgbGreen;
-                b_sum += color.rgbBlue;
-                pixel_count++;
-            }
+// Per-byte-position sums of one row, position 0..3 of every pixel
+static void sum_row_bytes(const uint8_t *row, int width, uint64_t sums[4]) {
+    int x = 0;
+
+#if defined(__SSE2__)
+    // Isolate one byte position per pixel and let SAD add them up, eight bytes at a time
+    const __m128i zero = _mm_setzero_si128();
+    __m128i masks[4];
+    __m128i acc[4];
+    for (int i = 0; i < 4; i++) {
+        masks[i] = _mm_set1_epi32(0xff << (8 * i));
+        acc[i] = zero;
+    }
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x * 4));
+        for (int i = 0; i < 4; i++) {
+            acc[i] = _mm_add_epi64(acc[i], _mm_sad_epu8(_mm_and_si128(pixels, masks[i]), zero));
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*)lanes, acc[i]);
+        sums[i] += lanes[0] + lanes[1];
+    }
+#endif
+
+    for (; x < width; x++) {
+        for (int i = 0; i < 4; i++) {
+            sums[i] += row[x * 4 + i];
         }
     }
-    
-    if (pixel_count > 0) {
-        double r_avg = (double)r_sum / pixel_count;
-        double g_avg = (double)g_sum / pixel_count;
-        double b_avg = (double)b_sum / pixel_count;
-        double gray_avg = (r_avg + g_avg + b_avg) / 3.0;
-        
-        // Calculate correction factors
-        double r_factor = gray_avg / r_avg;
-        double g_factor = gray_avg / g_avg;
-        double b_factor = gray_avg / b_avg;
-        
-        // Limit correction to reasonable bounds
-        r_factor = fmax(0.5, fmin(2.0, r_factor));
-        g_factor = fmax(0.5, fmin(2.0, g_factor));
-        b_factor = fmax(0.5, fmin(2.0, b_factor));
-        
-        // Apply color correction
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                RGBQUAD color;
-                if (FreeImage_GetPixelColor(result, x, y, &color)) {
-                    color.rgbRed = (BYTE)fmin(255, color.rgbRed * r_factor);
-                    color.rgbGreen = (BYTE)fmin(255, color.rgbGreen * g_factor);
-                    color.rgbBlue = (BYTE)fmin(255, color.rgbBlue * b_factor);
-                    FreeImage_SetPixelColor(result, x, y, &color);
-                }
+}
+
+bool enhance_analyze(SDL_Surface *surface, EnhanceStats *stats) {
+    for (int c = 0; c < 3; c++) {
+        stats->balance[c] = 1.0f;
+    }
+    stats->black = 0;
+    stats->white = 255;
+
+    ChannelOffsets offsets;
+    if (!surface || surface->w <= 0 || surface->h <= 0 || !get_channel_offsets(surface, &offsets)) {
+        return false;
+    }
+
+    // Channel sums of every sampled row, luma histogram of every sampled pixel
+    uint64_t sums[4] = {0, 0, 0, 0};
+    uint64_t histogram[256] = {0};
+    uint64_t rows = 0;
+    uint64_t samples = 0;
+    for (int y = 0; y < surface->h; y += ANALYZE_STEP, rows++) {
+        const uint8_t *row = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        if (offsets.bpp == 1) {
+            for (int x = 0; x < surface->w; x += ANALYZE_STEP, samples++) {
+                histogram[row[x]]++;
             }
+            continue;
+        }
+        sum_row_bytes(row, surface->w, sums);
+        for (int x = 0; x < surface->w; x += ANALYZE_STEP, samples++) {
+            const uint8_t *pixel = row + x * 4;
+            histogram[(77 * pixel[offsets.r] + 150 * pixel[offsets.g] + 29 * pixel[offsets.b]) >> 8]++;
+        }
+    }
+
+    // Gray world color balance factors, limited to reasonable bounds (gray pages have none)
+    if (offsets.bpp == 4) {
+        double pixel_count = (double)surface->w * rows;
+        double averages[3] = {
+            sums[offsets.r] / pixel_count,
+            sums[offsets.g] / pixel_count,
+            sums[offsets.b] / pixel_count
+        };
+        double gray_avg = (averages[0] + averages[1] + averages[2]) / 3.0;
+        for (int c = 0; c < 3; c++) {
+            double factor = averages[c] > 0 ? gray_avg / averages[c] : 1.0;
+            stats->balance[c] = (float)fmax(0.5, fmin(2.0, factor));
         }
     }
-    
-    return result;
+
+    // Levels input range, ignoring specks of dust and single bright pixels
+    uint64_t clip = (uint64_t)(samples * LEVELS_CLIP_PERCENT / 100.0);
+    int black = 0;
+    uint64_t below = histogram[0];
+    while (black < 255 && below <= clip) {
+        below += histogram[++black];
+    }
+    int white = 255;
+    uint64_t above = histogram[255];
+    while (white > 0 && above <= clip) {
+        above += histogram[--white];
+    }
+    if (white - black >= LEVELS_MIN_RANGE) {
+        stats->black = (Uint8)black;
+        stats->white = (Uint8)white;
+    }
+
+    return true;
 }
 
-FIBITMAP* sharpen_image(FIBITMAP* bitmap, double amount) {
-    if (!bitmap) return NULL;
-    
-    // Use a simple convolution kernel for sharpening since UnsharpMask may not be available
-    FIBITMAP* result = FreeImage_Clone(bitmap);
-    if (!result) return NULL;
+static uint8_t clamp_round(double value) {
+    if (value < 0) value = 0;
+    if (value > 255) value = 255;
+    return (uint8_t)floor(value + 0.5);
+}
 
-    
-    // For now, return the clone - implement custom sharpening later if needed
-    return result;
+static int clamp_byte(int value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
 }
 
-FIBITMAP* auto_enhance_image(FIBITMAP* bitmap, ImageProcessingOptions* options) {
-    if (!options || !options->enhancement_enabled) {
-        return NULL;
-    }
-    
-    FIBITMAP* current = FreeImage_Clone(bitmap);
-    if (!current) return NULL;
-
-    if (options->auto_levels) {
-        // Step 1: Auto normalize - apply histogram stretching
-        // For now, skip auto normalize and use other enhancements
-    }
-    
-    // Step 2: Auto color balance
-    FIBITMAP* balanced = auto_color_balance(current);
-    if (balanced) {
-        FreeImage_Unload(current);
-        current = balanced;
-    }
-    
-    if (options->sharpen) {
-        // Step 2: Apply sharpening if enabled
-        FIBITMAP* sharpened = sharpen_image(current, 1.0); // Default amount of 1.0
-        if (sharpened) {
-            FreeImage_Unload(current);
-            current = sharpened;
+// Build the channel table: balance, levels, then gamma, brightness and contrast with FreeImage's formulas
+static void build_lut(uint8_t lut[256], double balance, const EnhanceStats *stats,
+                      const ImageProcessingOptions *options) {
+    double exponent = options->gamma > 0 ? 1.0 / options->gamma : 1.0;
+    double brightness_scale = (100.0 + options->brightness) / 100.0;
+    double contrast_scale = (100.0 + options->contrast) / 100.0;
+    bool levels = options->auto_levels && stats->white > stats->black && (stats->black > 0 || stats->white < 255);
+    double levels_scale = levels ? 255.0 / (stats->white - stats->black) : 1.0;
+
+    for (int i = 0; i < 256; i++) {
+        uint8_t value = (uint8_t)fmin(255, i * balance);
+
+        if (levels) {
+            value = clamp_round((value - stats->black) * levels_scale);
+        }
+        if (options->gamma != 1.0 && options->gamma > 0) {
+            value = clamp_round(pow(value / 255.0, exponent) * 255.0);
         }
+        if (options->brightness != 0.0) {
+            value = clamp_round(value * brightness_scale);
+        }
+        if (options->contrast != 0.0) {
+            value = clamp_round(128 + (value - 128) * contrast_scale);
+        }
+
+        lut[i] = value;
     }
+}
+
+// Everything the per-pixel pass needs, derived once per page from the statistics and options
+typedef struct {
+    ChannelOffsets offsets;
+    int channels;               // 3, or 1 for gray surfaces
+    int alpha;                  // Offset of the byte that is copied as is
+    uint8_t lut[3][256];
+    bool saturate;
+    int saturation;             // 8.8 fixed point
+    int sharpen;                // 8.8 fixed point, 0 when off
+} EnhanceCurve;
 
-    if (options->gamma != 1.0 || options->brightness != 0.0 || options->contrast != 0.0) {
-        // Step 3: Adjust gamma, brightness, and contrast
-        FIBITMAP* adjusted = adjust_gamma_brightness_contrast(current, options->gamma, options->brightness, options->contrast);
-        if (adjusted) {
-            FreeImage_Unload(current);
-            current = adjusted;
+static bool build_curve(SDL_Surface *surface, const EnhanceStats *stats, const ImageProcessingOptions *options,
+                        EnhanceCurve *curve) {
+    if (!get_channel_offsets(surface, &curve->offsets)) {
+        return false;
+    }
+    curve->channels = curve->offsets.bpp == 1 ? 1 : 3;
+    curve->alpha = 6 - curve->offsets.r - curve->offsets.g - curve->offsets.b;
+
+    for (int c = 0; c < curve->channels; c++) {
+        build_lut(curve->lut[c], options->color_balance ? stats->balance[c] : 1.0, stats, options);
+    }
+
+    // Saturation around Rec. 601 luma
+    curve->saturate = curve->channels == 3 && options->saturation != 1.0;
+    curve->saturation = (int)lround(options->saturation * 256.0);
+    curve->sharpen = options->sharpen ? (int)lround(fmax(0.0, fmin(2.0, options->sharpen_amount)) * 256.0) : 0;
+    return true;
+}
+
+static inline void write_pixel(uint8_t *out, int r, int g, int b, uint8_t alpha, const EnhanceCurve *curve) {
+    r = curve->lut[0][r];
+    g = curve->lut[1][g];
+    b = curve->lut[2][b];
+
+    if (curve->saturate) {
+        int luma = (77 * r + 150 * g + 29 * b) >> 8;
+        r = clamp_byte(luma + (((r - luma) * curve->saturation) >> 8));
+        g = clamp_byte(luma + (((g - luma) * curve->saturation) >> 8));
+        b = clamp_byte(luma + (((b - luma) * curve->saturation) >> 8));
+    }
+
+    out[curve->offsets.r] = (uint8_t)r;
+    out[curve->offsets.g] = (uint8_t)g;
+    out[curve->offsets.b] = (uint8_t)b;
+    out[curve->alpha] = alpha;
+}
+
+// Horizontal [1 2 1] pass of one row for the unsharp mask, edge pixels repeat
+static void blur_row(const uint8_t *row, int width, const EnhanceCurve *curve, uint16_t *out) {
+    const int channel[3] = { curve->offsets.r, curve->offsets.g, curve->offsets.b };
+    int bpp = curve->offsets.bpp;
+    for (int x = 0; x < width; x++) {
+        const uint8_t *left = row + (x > 0 ? x - 1 : x) * bpp;
+        const uint8_t *center = row + x * bpp;
+        const uint8_t *right = row + (x < width - 1 ? x + 1 : x) * bpp;
+        for (int c = 0; c < curve->channels; c++) {
+            out[x * curve->channels + c] = left[channel[c]] + 2 * center[channel[c]] + right[channel[c]];
+        }
+    }
+}
+
+// Unsharp mask against a separable 3x3 binomial blur, then the curve
+// Keeps three blurred rows; the row below is blurred before a row is written, so dst may be the source
+static bool sharpen_copy(SDL_Surface *surface, uint8_t *dst, int dst_pitch, const EnhanceCurve *curve) {
+    int width = surface->w;
+    int height = surface->h;
+    int channels = curve->channels;
+    int bpp = curve->offsets.bpp;
+    size_t row_values = (size_t)width * channels;
+    uint16_t *buffers = malloc(3 * row_values * sizeof(uint16_t));
+    if (!buffers) {
+        return false;
+    }
+
+    const uint8_t *src = (const uint8_t*)surface->pixels;
+    const int channel[3] = { curve->offsets.r, curve->offsets.g, curve->offsets.b };
+    uint16_t *above = buffers;
+    uint16_t *center = buffers + row_values;
+    uint16_t *below = buffers + 2 * row_values;
+    blur_row(src, width, curve, center);
+    memcpy(above, center, row_values * sizeof(uint16_t));
+
+    for (int y = 0; y < height; y++) {
+        if (y + 1 < height) {
+            blur_row(src + (size_t)(y + 1) * surface->pitch, width, curve, below);
+        } else {
+            memcpy(below, center, row_values * sizeof(uint16_t));
+        }
+
+        const uint8_t *in = src + (size_t)y * surface->pitch;
+        uint8_t *out = dst + (size_t)y * dst_pitch;
+        for (int x = 0; x < width; x++, in += bpp, out += bpp) {
+            int values[3];
+            for (int c = 0; c < channels; c++) {
+                size_t i = (size_t)x * channels + c;
+                int blurred = above[i] + 2 * center[i] + below[i];   // 16x the blurred value
+                int value = in[channel[c]];
+                values[c] = clamp_byte(value + ((curve->sharpen * (value * 16 - blurred)) >> 12));
+            }
+            if (channels == 1) {
+                out[0] = curve->lut[0][values[0]];
+            } else {
+                write_pixel(out, values[0], values[1], values[2], in[curve->alpha], curve);
+            }
         }
+
+        uint16_t *reused = above;
+        above = center;
+        center = below;
+        below = reused;
+    }
+
+    free(buffers);
+    return true;
+}
+
+bool enhance_copy(SDL_Surface *surface, void *dst, int dst_pitch, const EnhanceStats *stats,
+                  const ImageProcessingOptions *options) {
+    if (!surface || !dst || !stats || !options) return false;
+    if (surface->w <= 0 || surface->h <= 0) return false;
+
+    EnhanceCurve curve;
+    if (!build_curve(surface, stats, options, &curve)) {
+        return false;
+    }
+
+    if (curve.sharpen > 0 && sharpen_copy(surface, (uint8_t*)dst, dst_pitch, &curve)) {
+        return true;
     }
-    
-    if (options->saturation != 1.0) {
-        // Step 4: Adjust saturation
-        FIBITMAP* saturated = adjust_saturation(current, options->saturation);
-        if (saturated) {
-            FreeImage_Unload(current);
-            current = saturated;
+
+    // Single read and write of every pixel
+    for (int y = 0; y < surface->h; y++) {
+        const uint8_t *in = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+        uint8_t *out = (uint8_t*)dst + (size_t)y * dst_pitch;
+        if (curve.channels == 1) {
+            for (int x = 0; x < surface->w; x++) {
+                out[x] = curve.lut[0][in[x]];
+            }
+            continue;
         }
+        for (int x = 0; x < surface->w; x++, in += 4, out += 4) {
+            write_pixel(out, in[curve.offsets.r], in[curve.offsets.g], in[curve.offsets.b], in[curve.alpha], &curve);
+        }
+    }
+
+    return true;
+}
+
+bool enhance_surface(SDL_Surface *surface, const ImageProcessingOptions *options) {
+    if (!surface || !options || !options->enhancement_enabled) return false;
+
+    EnhanceStats stats;
+    if (!enhance_analyze(surface, &stats)) {
+        return false;
     }
-    
-    return current;
-}
\ No newline at end of file
+    return enhance_copy(surface, surface->pixels, surface->pitch, &stats, options);
+}
@@ -8,17 +8,31 @@
 #include <string.h>
 #include "comic_viewer.h"
 #include "comic_loaders.h"
+#include "trace.h"
+#include "image_codecs.h"
 
 void print_usage(const char *program_name) {
     printf("Usage: %s [options] <file_or_directory>\n", program_name);
     printf("Options:\n");
     printf("  -h, --help     Display this help message\n");
     printf("  -m, --monitor <index>  Specify which monitor to use (0 is primary)\n");
+    printf("  -t, --threads <count>  Number of background decode threads\n");
+    printf("  -p, --prefetch <ahead>[:<behind>]  Views kept decoded around the current one\n");
+    printf("  -b, --border <threshold>[:<count>]  White level (0-255) and non-white pixels for auto-crop\n");
+    printf("  -c, --cache-mb <surfaces>[:<textures>]  Memory budgets for decoded pages, in MB\n");
+    printf("  -d, --disk-cache-mb <mb>  Size cap of the decoded page cache in $XDG_CACHE_HOME/ic, 0 disables it\n");
+    printf("  -s, --single   One page per view, portrait pages are not paired into spreads\n");
+    printf("  -r, --rtl      Right-to-left reading (manga), the left arrow turns forward\n");
+    printf("  -S, --series   Continue into the next volume of the directory past the last page\n");
+    printf("  --decoder <direct|freeimage>  Decode JPEG, PNG and WebP with the libraries built in (default) or FreeImage\n");
+    printf("  --bench <file.json>  Time every stage over all pages without input, '-' prints to stdout\n");
+    printf("  --trace <file.json>  Record hot-path zones and write a Chrome trace on exit\n");
     printf("\n");
     printf("Supported formats:\n");
     printf("  - CBZ files (Comic ZIP archives)\n");
     printf("  - CBR files (Comic RAR archives)\n");
     printf("  - Directories containing images\n");
+    printf("  - http(s):// URLs of CBZ and PDF files, read with range requests (built with CURL=1)\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -34,6 +48,17 @@ int main(int argc, char *argv[]) {
     }
 
     int monitor_index = 0;  // Default to primary monitor
+    int decode_threads = 0;  // 0 keeps the default derived from the CPU count
+    int prefetch_ahead = -1, prefetch_behind = -1;
+    int surface_cache_mb = -1, texture_cache_mb = -1;
+    int disk_cache_mb = -1;
+    int crop_threshold = -1, crop_min_count = -1;
+    bool right_to_left = false;
+    bool single_pages = false;
+    bool series_mode = false;
+    const char *decoder = NULL;
+    const char *bench_output = NULL;
+    const char *trace_output = NULL;
     int i;
     
     // Parse command line options
@@ -41,6 +66,52 @@ int main(int argc, char *argv[]) {
         if ((strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--monitor") == 0) && i + 1 < argc) {
             monitor_index = atoi(argv[i + 1]);
             i++;  // Skip the next argument (the monitor index)
+        } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc - 1) {
+            decode_threads = atoi(argv[i + 1]);
+            i++;
+        } else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--prefetch") == 0) && i + 1 < argc - 1) {
+            // Either "ahead" or "ahead:behind"
+            if (sscanf(argv[i + 1], "%d:%d", &prefetch_ahead, &prefetch_behind) < 1) {
+                fprintf(stderr, "Invalid prefetch window: %s\n", argv[i + 1]);
+                return 1;
+            }
+            i++;
+        } else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--cache-mb") == 0) && i + 1 < argc - 1) {
+            // Either "surfaces" or "surfaces:textures"
+            if (sscanf(argv[i + 1], "%d:%d", &surface_cache_mb, &texture_cache_mb) < 1) {
+                fprintf(stderr, "Invalid cache budget: %s\n", argv[i + 1]);
+                return 1;
+            }
+            i++;
+        } else if ((strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--border") == 0) && i + 1 < argc - 1) {
+            // Either "threshold" or "threshold:count"
+            if (sscanf(argv[i + 1], "%d:%d", &crop_threshold, &crop_min_count) < 1) {
+                fprintf(stderr, "Invalid border detection setting: %s\n", argv[i + 1]);
+                return 1;
+            }
+            i++;
+        } else if ((strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--disk-cache-mb") == 0) && i + 1 < argc - 1) {
+            disk_cache_mb = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--single") == 0) {
+            single_pages = true;
+        } else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--rtl") == 0) {
+            right_to_left = true;
+        } else if (strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "--series") == 0) {
+            series_mode = true;
+        } else if (strcmp(argv[i], "--decoder") == 0 && i + 1 < argc - 1) {
+            decoder = argv[i + 1];
+            if (strcmp(decoder, "direct") != 0 && strcmp(decoder, "freeimage") != 0) {
+                fprintf(stderr, "Invalid decoder: %s\n", decoder);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc - 1) {
+            bench_output = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc - 1) {
+            trace_output = argv[i + 1];
+            i++;
         }
     }
 
@@ -52,9 +123,28 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    // Apply command line overrides on top of the defaults set by init
+    if (decode_threads > 0) viewer.decode_threads = decode_threads;
+    if (prefetch_ahead > 0) viewer.prefetch_ahead = prefetch_ahead;
+    if (prefetch_behind >= 0) viewer.prefetch_behind = prefetch_behind;
+    if (surface_cache_mb >= 0) viewer.surface_cache_mb = surface_cache_mb;
+    if (texture_cache_mb >= 0) viewer.texture_cache_mb = texture_cache_mb;
+    if (disk_cache_mb >= 0) viewer.disk_cache_mb = disk_cache_mb;
+    if (crop_threshold >= 0) viewer.crop_options.threshold = crop_threshold;
+    if (crop_min_count > 0) viewer.crop_options.min_count = crop_min_count;
+    viewer.right_to_left = right_to_left;
+    if (single_pages) viewer.multiple_images_mode = false;
+    viewer.series_mode = series_mode;
+    if (decoder) image_codecs_set_enabled(strcmp(decoder, "direct") == 0);
+    if (trace_output) trace_init(trace_output);
+
     int return_value = 0;
-    // Load the comic or directory
-    if (comic_viewer_load(path)) {
+    if (bench_output) {
+        if (!comic_viewer_bench(path, bench_output)) {
+            fprintf(stderr, "Benchmark failed: %s\n", path);
+            return_value = 1;
+        }
+    } else if (comic_viewer_load(path)) {
         // Run the main loop
         comic_viewer_run();
     } else {
@@ -0,0 +1,338 @@
+/**
+ * memory_governor.c
+ * Implementation of the memory pressure levels and the budgets they allow
+ *
+ * Usage is measured like the kernel would reclaim it: inactive file pages (page cache of
+ * archives read earlier) do not count. The tightest of memory.max and memory.high along
+ * the cgroup's ancestors is the one that matters, so each ancestor with a limit is read.
+ * Everything here runs on the main thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_governor.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+static struct {
+    bool initialized;
+    MemoryBudgets configured;
+    MemoryBudgets budgets;
+    MemoryGovernorStats stats;
+    char *cgroup_dir;         // Directory of our cgroup, NULL without cgroup v2
+    Uint64 last_poll;
+    Uint64 last_pressure;     // Last time the current level was still justified
+    Uint64 last_texture_failure;
+    bool changed;             // Budgets changed outside a poll
+} governor = {0};
+
+// First line of a file, false if it cannot be read
+static bool read_line(const char *path, char *line, size_t size) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    bool found = fgets(line, (int)size, file) != NULL;
+    fclose(file);
+    return found;
+}
+
+// A byte count file of the cgroup dir, false for "max" and missing files
+static bool read_bytes(const char *dir, const char *name, size_t *out) {
+    char path[512];
+    char line[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (!read_line(path, line, sizeof(line)) || strncmp(line, "max", 3) == 0) {
+        return false;
+    }
+
+    char *end;
+    unsigned long long value = strtoull(line, &end, 10);
+    if (end == line) return false;
+    *out = (size_t)value;
+    return true;
+}
+
+// A "key value" line of a file such as memory.stat or /proc/meminfo
+static bool read_field(const char *path, const char *key, size_t *out) {
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[256];
+    size_t key_length = strlen(key);
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, key_length) == 0 && (line[key_length] == ' ' || line[key_length] == ':')) {
+            *out = (size_t)strtoull(line + key_length + 1, NULL, 10);
+            found = true;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// Directory of the cgroup v2 this process is in, from the "0::/path" line of /proc/self/cgroup
+static char* find_cgroup_dir(void) {
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (!file) return NULL;
+
+    char line[512];
+    char *dir = NULL;
+    while (!dir && fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "0::", 3) != 0) continue;
+
+        line[strcspn(line, "\n")] = '\0';
+        dir = malloc(strlen(CGROUP_ROOT) + strlen(line + 3) + 1);
+        if (dir) {
+            sprintf(dir, "%s%s", CGROUP_ROOT, strcmp(line + 3, "/") == 0 ? "" : line + 3);
+        }
+    }
+    fclose(file);
+    return dir;
+}
+
+// Tightest limit of the cgroup and its ancestors, as the share of it in use; false without any
+static bool read_cgroup_usage(size_t *out_limit, size_t *out_usage) {
+    if (!governor.cgroup_dir) return false;
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", governor.cgroup_dir);
+    double worst = -1.0;
+    while (strlen(dir) > strlen(CGROUP_ROOT)) {
+        size_t limit = 0, high = 0, current = 0, inactive = 0;
+        bool has_max = read_bytes(dir, "memory.max", &limit);
+        bool has_high = read_bytes(dir, "memory.high", &high);
+        if (has_high && (!has_max || high < limit)) {
+            limit = high;
+        }
+
+        if ((has_max || has_high) && limit > 0 && read_bytes(dir, "memory.current", &current)) {
+            char stat_path[600];
+            snprintf(stat_path, sizeof(stat_path), "%s/memory.stat", dir);
+            read_field(stat_path, "inactive_file", &inactive);
+            size_t usage = current > inactive ? current - inactive : 0;
+            double ratio = (double)usage / (double)limit;
+            if (ratio > worst) {
+                worst = ratio;
+                *out_limit = limit;
+                *out_usage = usage;
+            }
+        }
+
+        char *slash = strrchr(dir, '/');
+        if (!slash) break;
+        *slash = '\0';
+    }
+    return worst >= 0.0;
+}
+
+// The machine's RAM when no cgroup limits us
+static bool read_system_usage(size_t *out_limit, size_t *out_usage) {
+    size_t total = 0, available = 0;
+    if (!read_field("/proc/meminfo", "MemTotal", &total) ||
+        !read_field("/proc/meminfo", "MemAvailable", &available) || total == 0) {
+        return false;
+    }
+
+    // meminfo counts in kB
+    *out_limit = total << 10;
+    *out_usage = (total > available ? total - available : 0) << 10;
+    return true;
+}
+
+// avg10 of the "some" line of a PSI file, negative when unavailable
+static double read_psi(const char *path) {
+    char line[256];
+    if (!read_line(path, line, sizeof(line)) || strncmp(line, "some", 4) != 0) {
+        return -1.0;
+    }
+
+    const char *avg10 = strstr(line, "avg10=");
+    return avg10 ? strtod(avg10 + 6, NULL) : -1.0;
+}
+
+// Level the readings call for, without hysteresis
+static MemoryPressure measure_pressure(void) {
+    MemoryGovernorStats *stats = &governor.stats;
+    stats->limit = 0;
+    stats->usage = 0;
+    stats->cgroup = read_cgroup_usage(&stats->limit, &stats->usage);
+    if (!stats->cgroup) {
+        read_system_usage(&stats->limit, &stats->usage);
+    }
+
+    stats->psi_some = -1.0;
+    if (governor.cgroup_dir) {
+        char path[600];
+        snprintf(path, sizeof(path), "%s/memory.pressure", governor.cgroup_dir);
+        stats->psi_some = read_psi(path);
+    }
+    if (stats->psi_some < 0.0) {
+        stats->psi_some = read_psi("/proc/pressure/memory");
+    }
+
+    double usage = stats->limit > 0 ? (double)stats->usage / (double)stats->limit : 0.0;
+    if (usage >= GOVERNOR_CRITICAL_USAGE || stats->psi_some >= GOVERNOR_CRITICAL_PSI) {
+        return MEMORY_PRESSURE_CRITICAL;
+    }
+    if (usage >= GOVERNOR_MODERATE_USAGE || stats->psi_some >= GOVERNOR_MODERATE_PSI) {
+        return MEMORY_PRESSURE_MODERATE;
+    }
+    return MEMORY_PRESSURE_NONE;
+}
+
+static size_t min_size(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+// Budgets of the current level and texture cap
+static MemoryBudgets compute_budgets(void) {
+    MemoryBudgets budgets = governor.configured;
+
+    // Cached pages never take more than a quarter of the memory we may use, textures an eighth
+    if (governor.stats.limit > 0) {
+        budgets.surface_budget = min_size(budgets.surface_budget, governor.stats.limit / 4);
+        budgets.texture_budget = min_size(budgets.texture_budget, governor.stats.limit / 8);
+    }
+
+    switch (governor.stats.level) {
+        case MEMORY_PRESSURE_MODERATE:
+            budgets.surface_budget /= 2;
+            budgets.texture_budget /= 2;
+            budgets.prefetch_ahead = SDL_max(1, budgets.prefetch_ahead / 2);
+            budgets.prefetch_behind /= 2;
+            budgets.decode_threads = SDL_max(1, budgets.decode_threads / 2);
+            break;
+
+        case MEMORY_PRESSURE_CRITICAL:
+            // Only the view on screen and the next one are kept
+            budgets.surface_budget /= 8;
+            budgets.texture_budget /= 4;
+            budgets.prefetch_ahead = SDL_min(1, budgets.prefetch_ahead);
+            budgets.prefetch_behind = 0;
+            budgets.decode_threads = 1;
+            break;
+
+        default:
+            break;
+    }
+
+    if (governor.stats.texture_cap > 0) {
+        budgets.texture_budget = min_size(budgets.texture_budget, governor.stats.texture_cap);
+    }
+    return budgets;
+}
+
+// Recompute the budgets, true when they differ from the ones in force
+static bool update_budgets(void) {
+    MemoryBudgets budgets = compute_budgets();
+    if (memcmp(&budgets, &governor.budgets, sizeof(budgets)) == 0) {
+        return false;
+    }
+
+    governor.budgets = budgets;
+    return true;
+}
+
+static void set_level(MemoryPressure level) {
+    if (level == governor.stats.level) return;
+
+    printf("Memory pressure %s -> %s\n", memory_pressure_name(governor.stats.level), memory_pressure_name(level));
+    governor.stats.level = level;
+}
+
+void memory_governor_init(const MemoryBudgets *configured) {
+    free(governor.cgroup_dir);
+    memset(&governor, 0, sizeof(governor));
+    governor.configured = *configured;
+    governor.budgets = *configured;
+    governor.cgroup_dir = find_cgroup_dir();
+    governor.initialized = true;
+
+    // Limits apply from the start, without waiting for the first poll
+    measure_pressure();
+    governor.last_poll = SDL_GetTicks();
+    governor.changed = update_budgets();
+    if (governor.stats.limit > 0) {
+        printf("Memory limit %zu MB (%s)\n", governor.stats.limit >> 20, governor.stats.cgroup ? "cgroup" : "RAM");
+    }
+}
+
+bool memory_governor_poll(MemoryBudgets *out) {
+    if (!governor.initialized) return false;
+
+    Uint64 now = SDL_GetTicks();
+    if (now - governor.last_poll >= GOVERNOR_POLL_MS) {
+        governor.last_poll = now;
+        MemoryPressure measured = measure_pressure();
+
+        // Pressure is acted on at once, relief only after a quiet period and a level at a time
+        if (measured >= governor.stats.level) {
+            governor.last_pressure = now;
+            set_level(measured);
+        } else if (now - governor.last_pressure >= GOVERNOR_RECOVER_MS) {
+            governor.last_pressure = now;
+            set_level(governor.stats.level - 1);
+        }
+
+        // The texture cap grows back by a quarter per quiet period until it is lifted
+        if (governor.stats.texture_cap > 0 && now - governor.last_texture_failure >= GOVERNOR_RECOVER_MS) {
+            governor.last_texture_failure = now;
+            governor.stats.texture_cap += governor.stats.texture_cap / 4;
+            if (governor.stats.texture_cap >= governor.configured.texture_budget) {
+                governor.stats.texture_cap = 0;
+            }
+        }
+
+        governor.changed = update_budgets() || governor.changed;
+    }
+
+    if (!governor.changed) return false;
+
+    governor.changed = false;
+    *out = governor.budgets;
+    return true;
+}
+
+void memory_governor_low_memory(void) {
+    if (!governor.initialized) return;
+
+    governor.stats.low_memory_events++;
+    governor.last_pressure = SDL_GetTicks();
+    set_level(MEMORY_PRESSURE_CRITICAL);
+    governor.changed = update_budgets() || governor.changed;
+}
+
+void memory_governor_texture_failed(size_t texture_bytes) {
+    if (!governor.initialized) return;
+
+    size_t cap = texture_bytes / 4 * 3;
+    size_t floor = (size_t)GOVERNOR_MIN_TEXTURE_MB << 20;
+    if (cap < floor) cap = floor;
+
+    governor.stats.texture_failures++;
+    governor.last_texture_failure = SDL_GetTicks();
+    if (governor.stats.texture_cap == 0 || cap < governor.stats.texture_cap) {
+        governor.stats.texture_cap = cap;
+        printf("Texture creation failed with %zu MB resident, texture budget capped at %zu MB\n",
+               texture_bytes >> 20, cap >> 20);
+    }
+    governor.changed = update_budgets() || governor.changed;
+}
+
+MemoryGovernorStats memory_governor_get_stats(void) {
+    return governor.stats;
+}
+
+MemoryBudgets memory_governor_budgets(void) {
+    return governor.budgets;
+}
+
+const char* memory_pressure_name(MemoryPressure level) {
+    switch (level) {
+        case MEMORY_PRESSURE_MODERATE: return "moderate";
+        case MEMORY_PRESSURE_CRITICAL: return "critical";
+        default: return "none";
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * page_cache.c
+ * Implementation of the surface and texture cache budgets
+ *
+ * The surfaces and textures themselves stay in ImageEntry; this module only keeps
+ * the byte counts and picks what to evict. Evicting a texture keeps its surface, so
+ * the page can be re-uploaded without decoding it again. Dropped surfaces and textures
+ * go back to the page pool for the next page of the same size.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "page_cache.h"
+#include "page_pool.h"
+
+static struct {
+    PageCacheStats stats;
+    PageCachePinned pinned;
+    Uint64 clock;            // Monotonic use counter, higher is more recent
+} cache = {0};
+
+static size_t surface_size(SDL_Surface *surface) {
+    return surface ? (size_t)surface->pitch * surface->h : 0;
+}
+
+// Textures are not readable back, estimate from their size and format (IYUV is 12 bits per pixel)
+static size_t texture_size(SDL_Texture *texture) {
+    float width = 0, height = 0;
+    if (!texture || !SDL_GetTextureSize(texture, &width, &height)) {
+        return 0;
+    }
+    size_t pixels = (size_t)width * (size_t)height;
+    return texture->format == SDL_PIXELFORMAT_IYUV ? pixels * 3 / 2 : pixels * 4;
+}
+
+void page_cache_init(size_t surface_budget, size_t texture_budget, PageCachePinned pinned) {
+    memset(&cache, 0, sizeof(cache));
+    cache.stats.surface_budget = surface_budget;
+    cache.stats.texture_budget = texture_budget;
+    cache.pinned = pinned;
+}
+
+void page_cache_set_budgets(size_t surface_budget, size_t texture_budget) {
+    cache.stats.surface_budget = surface_budget;
+    cache.stats.texture_budget = texture_budget;
+}
+
+void page_cache_touch(ImageEntry *image) {
+    image->last_used = ++cache.clock;
+}
+
+void page_cache_add_surface(ImageEntry *image) {
+    cache.stats.surface_bytes += surface_size(image->surface);
+    page_cache_touch(image);
+}
+
+void page_cache_add_texture(ImageEntry *image) {
+    cache.stats.texture_bytes += texture_size(image->texture);
+    page_cache_touch(image);
+}
+
+void page_cache_drop_surface(ImageEntry *image) {
+    if (!image->surface) return;
+
+    size_t bytes = surface_size(image->surface);
+    cache.stats.surface_bytes -= bytes < cache.stats.surface_bytes ? bytes : cache.stats.surface_bytes;
+    page_pool_release_surface(image->surface);
+    image->surface = NULL;
+}
+
+void page_cache_drop_texture(ImageEntry *image) {
+    if (!image->texture) return;
+
+    size_t bytes = texture_size(image->texture);
+    cache.stats.texture_bytes -= bytes < cache.stats.texture_bytes ? bytes : cache.stats.texture_bytes;
+    page_pool_release_texture(image->texture);
+    image->texture = NULL;
+}
+
+void page_cache_record_texture_hit(void) {
+    cache.stats.texture_hits++;
+}
+
+void page_cache_record_surface_hit(void) {
+    cache.stats.surface_hits++;
+}
+
+void page_cache_record_miss(void) {
+    cache.stats.misses++;
+}
+
+// Least recently used image holding a texture (or a surface), -1 if all are pinned
+static int find_victim(ImageEntry *images, int count, bool textures) {
+    int victim = -1;
+    for (int i = 0; i < count; i++) {
+        if (textures ? !images[i].texture : !images[i].surface) continue;
+        if (cache.pinned && cache.pinned(i)) continue;
+        if (victim < 0 || images[i].last_used < images[victim].last_used) {
+            victim = i;
+        }
+    }
+    return victim;
+}
+
+void page_cache_trim(ImageEntry *images, int count) {
+    while (cache.stats.texture_bytes > cache.stats.texture_budget) {
+        int victim = find_victim(images, count, true);
+        if (victim < 0) break;
+        page_cache_drop_texture(&images[victim]);
+        cache.stats.evictions++;
+    }
+
+    while (cache.stats.surface_bytes > cache.stats.surface_budget) {
+        int victim = find_victim(images, count, false);
+        if (victim < 0) break;
+        page_cache_drop_surface(&images[victim]);
+        cache.stats.evictions++;
+    }
+}
+
+PageCacheStats page_cache_get_stats(void) {
+    return cache.stats;
+}
@@ -0,0 +1,258 @@
+/**
+ * page_pool.c
+ * Implementation of the surface and texture pools
+ *
+ * Surfaces are decoded on the workers and freed on the main thread, so their pool is
+ * locked. Textures only ever live on the main thread. Both pools are small arrays
+ * searched linearly, ordered from oldest to newest release.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "page_pool.h"
+
+static struct {
+    SDL_Renderer *renderer;
+    SDL_Mutex *lock;                              // Guards the surface pool
+    SDL_Surface *surfaces[SURFACE_POOL_SIZE];
+    int surface_count;
+    SDL_Texture *textures[TEXTURE_POOL_SIZE];
+    int texture_count;
+    PagePoolStats stats;
+} pool = {0};
+
+bool page_pool_init(SDL_Renderer *renderer) {
+    pool.lock = SDL_CreateMutex();
+    if (!pool.lock) {
+        fprintf(stderr, "Failed to create page pool lock: %s\n", SDL_GetError());
+        return false;
+    }
+    pool.renderer = renderer;
+    return true;
+}
+
+// A pooled surface matching the request, or a new one
+static SDL_Surface* acquire_surface(int width, int height, SDL_PixelFormat format) {
+    SDL_Surface *surface = NULL;
+
+    if (pool.lock) {
+        SDL_LockMutex(pool.lock);
+        // Newest first, it is the most likely to still be in the CPU caches
+        for (int i = pool.surface_count - 1; i >= 0; i--) {
+            SDL_Surface *candidate = pool.surfaces[i];
+            if (candidate->w == width && candidate->h == height && candidate->format == format) {
+                surface = candidate;
+                memmove(&pool.surfaces[i], &pool.surfaces[i + 1], (pool.surface_count - i - 1) * sizeof(SDL_Surface*));
+                pool.surface_count--;
+                pool.stats.surface_reuses++;
+                break;
+            }
+        }
+        if (!surface) {
+            pool.stats.surface_allocations++;
+        }
+        SDL_UnlockMutex(pool.lock);
+    }
+
+    if (!surface) {
+        surface = SDL_CreateSurface(width, height, format);
+    }
+    return surface;
+}
+
+SDL_Surface* page_pool_acquire_gray_surface(int width, int height) {
+    SDL_Surface *surface = acquire_surface(width, height, SDL_PIXELFORMAT_INDEX8);
+    if (!surface || SDL_GetSurfacePalette(surface)) {
+        // Pooled gray surfaces keep their palette
+        return surface;
+    }
+
+    SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
+    if (!palette) {
+        fprintf(stderr, "Failed to create gray palette: %s\n", SDL_GetError());
+        SDL_DestroySurface(surface);
+        return NULL;
+    }
+    SDL_Color ramp[256];
+    for (int i = 0; i < 256; i++) {
+        ramp[i] = (SDL_Color){i, i, i, 255};
+    }
+    SDL_SetPaletteColors(palette, ramp, 0, 256);
+    return surface;
+}
+
+SDL_Surface* page_pool_acquire_surface(int width, int height, SDL_PixelFormat format) {
+    if (format == SDL_PIXELFORMAT_INDEX8) {
+        return page_pool_acquire_gray_surface(width, height);
+    }
+    return acquire_surface(width, height, format);
+}
+
+bool page_pool_is_gray(const SDL_Surface *surface) {
+    // The only 8-bit surfaces the decoders make are the gray ones
+    return surface && surface->format == SDL_PIXELFORMAT_INDEX8;
+}
+
+void page_pool_release_surface(SDL_Surface *surface) {
+    if (!surface) return;
+
+    // Surfaces still referenced elsewhere (tile sources) or wrapping foreign pixels are not ours to reuse
+    if (!pool.lock || surface->refcount > 1 || (surface->flags & SDL_SURFACE_PREALLOCATED)) {
+        SDL_DestroySurface(surface);
+        return;
+    }
+
+    SDL_Surface *evicted = NULL;
+    SDL_LockMutex(pool.lock);
+    if (pool.surface_count == SURFACE_POOL_SIZE) {
+        evicted = pool.surfaces[0];
+        memmove(&pool.surfaces[0], &pool.surfaces[1], (SURFACE_POOL_SIZE - 1) * sizeof(SDL_Surface*));
+        pool.surface_count--;
+    }
+    pool.surfaces[pool.surface_count++] = surface;
+    SDL_UnlockMutex(pool.lock);
+
+    SDL_DestroySurface(evicted);
+}
+
+SDL_Texture* page_pool_acquire_texture(int width, int height, SDL_PixelFormat format) {
+    if (!pool.renderer) return NULL;
+
+    for (int i = pool.texture_count - 1; i >= 0; i--) {
+        SDL_Texture *candidate = pool.textures[i];
+        if (candidate->w == width && candidate->h == height && candidate->format == format) {
+            memmove(&pool.textures[i], &pool.textures[i + 1], (pool.texture_count - i - 1) * sizeof(SDL_Texture*));
+            pool.texture_count--;
+            pool.stats.texture_reuses++;
+            return candidate;
+        }
+    }
+
+    SDL_PropertiesID props = SDL_CreateProperties();
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_FORMAT_NUMBER, format);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_ACCESS_NUMBER, SDL_TEXTUREACCESS_STREAMING);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_WIDTH_NUMBER, width);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_HEIGHT_NUMBER, height);
+    if (format == SDL_PIXELFORMAT_IYUV) {
+        // YUV textures default to limited range, gray values are full range
+        SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_COLORSPACE_NUMBER, SDL_COLORSPACE_JPEG);
+    }
+    SDL_Texture *texture = SDL_CreateTextureWithProperties(pool.renderer, props);
+    SDL_DestroyProperties(props);
+    if (!texture) {
+        return NULL;
+    }
+    pool.stats.texture_allocations++;
+
+    // Same blending SDL_CreateTextureFromSurface would pick
+    if (SDL_ISPIXELFORMAT_ALPHA(format)) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    return texture;
+}
+
+void page_pool_neutral_chroma(void *pixels, int pitch, int height) {
+    // U then V follow the Y plane, each subsampled by two in both directions
+    size_t plane = (size_t)((pitch + 1) / 2) * ((height + 1) / 2);
+    memset((Uint8*)pixels + (size_t)pitch * height, 128, 2 * plane);
+}
+
+// Copy a gray surface into the Y plane of an IYUV texture
+static SDL_Texture* upload_gray(SDL_Surface *surface) {
+    SDL_Texture *texture = page_pool_acquire_texture(surface->w, surface->h, SDL_PIXELFORMAT_IYUV);
+    void *pixels;
+    int pitch;
+    if (!texture || !SDL_LockTexture(texture, NULL, &pixels, &pitch)) {
+        page_pool_release_texture(texture);
+        return NULL;
+    }
+
+    for (int y = 0; y < surface->h; y++) {
+        memcpy((Uint8*)pixels + (size_t)y * pitch, (const Uint8*)surface->pixels + (size_t)y * surface->pitch, surface->w);
+    }
+    page_pool_neutral_chroma(pixels, pitch, surface->h);
+    SDL_UnlockTexture(texture);
+    return texture;
+}
+
+SDL_Texture* page_pool_upload(SDL_Surface *surface) {
+    if (!surface) return NULL;
+
+    if (page_pool_is_gray(surface)) {
+        SDL_Texture *texture = upload_gray(surface);
+        if (texture) {
+            return texture;
+        }
+    }
+
+    // Without a renderer or for formats it cannot stream, let SDL pick
+    SDL_Texture *texture = page_pool_acquire_texture(surface->w, surface->h, surface->format);
+    if (!texture) {
+        return SDL_CreateTextureFromSurface(pool.renderer, surface);
+    }
+
+    if (!SDL_UpdateTexture(texture, NULL, surface->pixels, surface->pitch)) {
+        fprintf(stderr, "Failed to update texture: %s\n", SDL_GetError());
+        SDL_DestroyTexture(texture);
+        return NULL;
+    }
+    return texture;
+}
+
+void page_pool_release_texture(SDL_Texture *texture) {
+    if (!texture) return;
+
+    // Static textures from the fallback path cannot be updated
+    SDL_PropertiesID props = SDL_GetTextureProperties(texture);
+    bool streaming = SDL_GetNumberProperty(props, SDL_PROP_TEXTURE_ACCESS_NUMBER, SDL_TEXTUREACCESS_STATIC) ==
+                     SDL_TEXTUREACCESS_STREAMING;
+    if (!pool.renderer || !streaming) {
+        SDL_DestroyTexture(texture);
+        return;
+    }
+
+    if (pool.texture_count == TEXTURE_POOL_SIZE) {
+        SDL_DestroyTexture(pool.textures[0]);
+        memmove(&pool.textures[0], &pool.textures[1], (TEXTURE_POOL_SIZE - 1) * sizeof(SDL_Texture*));
+        pool.texture_count--;
+    }
+    pool.textures[pool.texture_count++] = texture;
+}
+
+PagePoolStats page_pool_get_stats(void) {
+    return pool.stats;
+}
+
+void page_pool_trim(void) {
+    for (int i = 0; i < pool.texture_count; i++) {
+        SDL_DestroyTexture(pool.textures[i]);
+    }
+    pool.texture_count = 0;
+
+    SDL_Surface *surfaces[SURFACE_POOL_SIZE];
+    int surface_count = 0;
+    if (pool.lock) {
+        SDL_LockMutex(pool.lock);
+        surface_count = pool.surface_count;
+        memcpy(surfaces, pool.surfaces, surface_count * sizeof(SDL_Surface*));
+        pool.surface_count = 0;
+        SDL_UnlockMutex(pool.lock);
+    }
+    for (int i = 0; i < surface_count; i++) {
+        SDL_DestroySurface(surfaces[i]);
+    }
+}
+
+void page_pool_shutdown(void) {
+    for (int i = 0; i < pool.texture_count; i++) {
+        SDL_DestroyTexture(pool.textures[i]);
+    }
+    for (int i = 0; i < pool.surface_count; i++) {
+        SDL_DestroySurface(pool.surfaces[i]);
+    }
+    if (pool.lock) {
+        SDL_DestroyMutex(pool.lock);
+    }
+    memset(&pool, 0, sizeof(pool));
+}
@@ -17,17 +17,100 @@
 #define PROGRESS_BAR_PADDING 50
 #define TEXT_PADDING 10
 
+// Printable ASCII is rasterized once at init, labels are drawn glyph by glyph
+#define GLYPH_FIRST 32
+#define GLYPH_COUNT 95
+
+// Redraw rate when the display does not report one
+#define DEFAULT_REFRESH_RATE 60.0f
+
+typedef struct {
+    SDL_Texture *texture;
+    float w, h;
+    int advance;
+} CachedGlyph;
+
 // Progress bar state
 static struct {
     SDL_Renderer *renderer;
     TTF_Font *font;
+    CachedGlyph glyphs[GLYPH_COUNT];
+    int font_height;
+    SDL_Mutex *lock;          // Guards progress, message and dirty, updates come from the open thread
     float progress;
     char message[256];
+    bool dirty;               // Changed since the last present
+    Uint64 frame_interval_ns; // One display refresh, presents are never closer than this
+    Uint64 last_present_ns;
     int window_width;
     int window_height;
     bool initialized;
 } progress_bar = {0};
 
+static void cache_glyphs(void) {
+    SDL_Color white = {255, 255, 255, 255};
+    progress_bar.font_height = TTF_GetFontHeight(progress_bar.font);
+    
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        CachedGlyph *glyph = &progress_bar.glyphs[i];
+        Uint32 ch = GLYPH_FIRST + i;
+        
+        int minx, maxx, miny, maxy;
+        if (!TTF_GetGlyphMetrics(progress_bar.font, ch, &minx, &maxx, &miny, &maxy, &glyph->advance)) {
+            continue;
+        }
+        
+        // Blank glyphs (the space) only advance the pen
+        SDL_Surface *surface = TTF_RenderGlyph_Blended(progress_bar.font, ch, white);
+        if (!surface) continue;
+        
+        glyph->texture = SDL_CreateTextureFromSurface(progress_bar.renderer, surface);
+        glyph->w = (float)surface->w;
+        glyph->h = (float)surface->h;
+        SDL_DestroySurface(surface);
+    }
+}
+
+static const CachedGlyph* glyph_for(char c) {
+    unsigned char ch = (unsigned char)c;
+    if (ch < GLYPH_FIRST || ch >= GLYPH_FIRST + GLYPH_COUNT) {
+        ch = '?';
+    }
+    return &progress_bar.glyphs[ch - GLYPH_FIRST];
+}
+
+static int text_width(const char *text) {
+    int width = 0;
+    for (const char *c = text; *c; c++) {
+        width += glyph_for(*c)->advance;
+    }
+    return width;
+}
+
+// Draw a label horizontally centered in the window with its top at y
+static void draw_text(const char *text, float y) {
+    float x = (float)((progress_bar.window_width - text_width(text)) / 2);
+    
+    for (const char *c = text; *c; c++) {
+        const CachedGlyph *glyph = glyph_for(*c);
+        if (glyph->texture) {
+            SDL_FRect rect = {x, y, glyph->w, glyph->h};
+            SDL_RenderTexture(progress_bar.renderer, glyph->texture, NULL, &rect);
+        }
+        x += glyph->advance;
+    }
+}
+
+// Keep the window responsive while loading
+static void pump_events(void) {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_EVENT_QUIT) {
+            exit(0); // Allow user to exit during loading
+        }
+    }
+}
+
 bool progress_bar_init(SDL_Renderer *renderer) {
     if (!renderer) return false;
     
@@ -51,7 +134,22 @@ bool progress_bar_init(SDL_Renderer *renderer) {
         // Non-fatal, we'll just not show text
     }
     
+    progress_bar.lock = SDL_CreateMutex();
+    if (!progress_bar.lock) {
+        fprintf(stderr, "Failed to create progress bar lock: %s\n", SDL_GetError());
+        return false;
+    }
+    
     progress_bar.renderer = renderer;
+    if (progress_bar.font) {
+        cache_glyphs();
+    }
+    
+    const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(SDL_GetRenderWindow(renderer)));
+    float refresh_rate = mode && mode->refresh_rate > 0.0f ? mode->refresh_rate : DEFAULT_REFRESH_RATE;
+    progress_bar.frame_interval_ns = (Uint64)(SDL_NS_PER_SECOND / refresh_rate);
+    progress_bar.last_present_ns = 0;
+    
     progress_bar.progress = 0.0f;
     strcpy(progress_bar.message, "Loading...");
     progress_bar.initialized = true;
@@ -66,19 +164,45 @@ void progress_bar_update(float progress, const char *message) {
     if (progress < 0.0f) progress = 0.0f;
     if (progress > 1.0f) progress = 1.0f;
     
+    SDL_LockMutex(progress_bar.lock);
     progress_bar.progress = progress;
     if (message) {
         strncpy(progress_bar.message, message, sizeof(progress_bar.message) - 1);
         progress_bar.message[sizeof(progress_bar.message) - 1] = '\0';
     }
+    progress_bar.dirty = true;
+    SDL_UnlockMutex(progress_bar.lock);
+    
+    // Other threads only record the state, the main thread draws it
+    if (SDL_IsMainThread()) {
+        progress_bar_refresh();
+    }
+}
+
+void progress_bar_refresh(void) {
+    if (!progress_bar.initialized) return;
     
-    // Render the progress bar immediately
-    progress_bar_render();
+    SDL_LockMutex(progress_bar.lock);
+    bool dirty = progress_bar.dirty;
+    SDL_UnlockMutex(progress_bar.lock);
+    
+    if (dirty && SDL_GetTicksNS() - progress_bar.last_present_ns >= progress_bar.frame_interval_ns) {
+        progress_bar_render();
+    } else {
+        pump_events();
+    }
 }
 
 void progress_bar_render(void) {
     if (!progress_bar.initialized) return;
     
+    SDL_LockMutex(progress_bar.lock);
+    float progress = progress_bar.progress;
+    char message[sizeof(progress_bar.message)];
+    memcpy(message, progress_bar.message, sizeof(message));
+    progress_bar.dirty = false;
+    SDL_UnlockMutex(progress_bar.lock);
+    
     // Clear the screen
     SDL_SetRenderDrawColor(progress_bar.renderer, 0, 0, 0, 255);
     SDL_RenderClear(progress_bar.renderer);
@@ -98,81 +222,45 @@ void progress_bar_render(void) {
     SDL_FRect fill_rect = {
         PROGRESS_BAR_PADDING,
         progress_bar.window_height / 2 - PROGRESS_BAR_HEIGHT / 2,
-        (progress_bar.window_width - (2 * PROGRESS_BAR_PADDING)) * progress_bar.progress,
+        (progress_bar.window_width - (2 * PROGRESS_BAR_PADDING)) * progress,
         PROGRESS_BAR_HEIGHT
     };
     
     SDL_SetRenderDrawColor(progress_bar.renderer, 0, 150, 255, 255);
     SDL_RenderFillRect(progress_bar.renderer, &fill_rect);
     
-    // Draw message (above the progress bar)
-    if (progress_bar.font && progress_bar.message[0] != '\0') {
-        SDL_Color text_color = {255, 255, 255, 255};
-        SDL_Surface *text_surface = TTF_RenderText_Blended(
-            progress_bar.font, progress_bar.message, 0, text_color);
-        
-        if (text_surface) {
-            SDL_Texture *text_texture = SDL_CreateTextureFromSurface(
-                progress_bar.renderer, text_surface);
-            
-            if (text_texture) {
-                SDL_FRect text_rect = {
-                    (progress_bar.window_width - text_surface->w) / 2,
-                    progress_bar.window_height / 2 - PROGRESS_BAR_HEIGHT / 2 - text_surface->h - TEXT_PADDING,
-                    (float)text_surface->w,
-                    (float)text_surface->h
-                };
-                
-                SDL_RenderTexture(progress_bar.renderer, text_texture, NULL, &text_rect);
-                SDL_DestroyTexture(text_texture);
-            }
-            
-            SDL_DestroySurface(text_surface);
-        }
-    }
-    
-    // Draw percentage text (inside the progress bar)
-    char percentage[8];
-    snprintf(percentage, sizeof(percentage), "%d%%", (int)(progress_bar.progress * 100));
-    
     if (progress_bar.font) {
-        SDL_Color percentage_color = {255, 255, 255, 255};
-        SDL_Surface *percentage_surface = TTF_RenderText_Blended(
-            progress_bar.font, percentage, 0, percentage_color);
-        
-        if (percentage_surface) {
-            SDL_Texture *percentage_texture = SDL_CreateTextureFromSurface(
-                progress_bar.renderer, percentage_surface);
-            
-            if (percentage_texture) {
-                SDL_FRect percentage_rect = {
-                    (progress_bar.window_width - percentage_surface->w) / 2,
-                    progress_bar.window_height / 2 - percentage_surface->h / 2,
-                    (float)percentage_surface->w,
-                    (float)percentage_surface->h
-                };
-                
-                SDL_RenderTexture(progress_bar.renderer, percentage_texture, NULL, &percentage_rect);
-                SDL_DestroyTexture(percentage_texture);
-            }
-            
-            SDL_DestroySurface(percentage_surface);
+        // Message above the progress bar, percentage inside it
+        float bar_top = progress_bar.window_height / 2 - PROGRESS_BAR_HEIGHT / 2;
+        if (message[0] != '\0') {
+            draw_text(message, bar_top - progress_bar.font_height - TEXT_PADDING);
         }
+        
+        char percentage[8];
+        snprintf(percentage, sizeof(percentage), "%d%%", (int)(progress * 100));
+        draw_text(percentage, (float)(progress_bar.window_height / 2 - progress_bar.font_height / 2));
     }
     
     // Present the renderer
     SDL_RenderPresent(progress_bar.renderer);
+    progress_bar.last_present_ns = SDL_GetTicksNS();
     
-    // Process events during rendering to keep the UI responsive
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        if (event.type == SDL_EVENT_QUIT) {
-            exit(0); // Allow user to exit during loading
-        }
-    }
+    pump_events();
 }
 
 void progress_bar_cleanup(void) {
+    for (int i = 0; i < GLYPH_COUNT; i++) {
+        if (progress_bar.glyphs[i].texture) {
+            SDL_DestroyTexture(progress_bar.glyphs[i].texture);
+            progress_bar.glyphs[i].texture = NULL;
+        }
+    }
+    
+    if (progress_bar.lock) {
+        SDL_DestroyMutex(progress_bar.lock);
+        progress_bar.lock = NULL;
+    }
+    
     if (progress_bar.font) {
         TTF_CloseFont(progress_bar.font);
         progress_bar.font = NULL;
@@ -0,0 +1,224 @@
+/**
+ * series.c
+ * Implementation of the next volume lookup and its background pre-open
+ *
+ * The thread opens the archive, decodes the first pages and reads the size of the others
+ * from their headers, so the volume can be shown with its spreads laid out right away.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "series.h"
+#include "comic_loaders.h"
+#include "http_source.h"
+#include "page_pool.h"
+#include "trace.h"
+
+// External functions from comic_loaders_utils.c
+extern int image_name_compare(const void *a, const void *b);
+
+static struct {
+    SeriesState state;            // Main thread only
+    SDL_Thread *thread;
+    SDL_AtomicInt finished;       // Set by the thread once volume is filled in
+    SDL_AtomicInt cancelled;
+    Uint32 event_type;            // Pushed when the thread finishes, wakes the main loop
+    char *path;                   // Volume being opened
+    SeriesDecodeFunction decode_fn;
+    int target_height;
+    SeriesVolume *volume;         // Written by the thread, NULL when opening failed
+} series = {0};
+
+static int compare_names(const char *a, const char *b) {
+    return image_name_compare(&a, &b);
+}
+
+char* series_next_path(const char *path) {
+    if (!path || http_source_is_url(path)) {
+        return NULL;
+    }
+
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+    size_t directory_length = slash ? (size_t)(slash - path) : 0;
+    char *directory = slash ? strndup(path, directory_length > 0 ? directory_length : 1) : strdup(".");
+    if (!directory) {
+        return NULL;
+    }
+
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        free(directory);
+        return NULL;
+    }
+
+    // The smallest comic name that sorts after the current one
+    char *next = NULL;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) continue;
+        if (archive_type_from_name(entry->d_name, strlen(entry->d_name)) == ARCHIVE_TYPE_NONE) continue;
+        if (compare_names(entry->d_name, name) <= 0) continue;
+        if (next && compare_names(entry->d_name, next) >= 0) continue;
+
+        char *candidate = strdup(entry->d_name);
+        if (candidate) {
+            free(next);
+            next = candidate;
+        }
+    }
+    closedir(dir);
+
+    char *next_path = NULL;
+    if (next && slash) {
+        next_path = malloc(strlen(directory) + strlen(next) + 2);
+        if (next_path) {
+            sprintf(next_path, "%s/%s", directory_length > 0 ? directory : "", next);
+        }
+        free(next);
+    } else {
+        next_path = next;
+    }
+    free(directory);
+
+    return next_path;
+}
+
+// Runs on the series thread: open the volume, decode its first pages and measure the rest
+static int preopen_worker(void *data) {
+    (void)data;
+
+    // Whatever the reader is looking at goes first
+    SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    TraceZone zone = trace_begin("series_preopen");
+
+    SeriesVolume *volume = calloc(1, sizeof(SeriesVolume));
+    if (volume) {
+        volume->path = series.path;
+        series.path = NULL;
+        volume->type = archive_type_from_name(volume->path, strlen(volume->path));
+        volume->archive = archive_open(volume->path, volume->type, &volume->image_count, NULL);
+        if (!volume->archive || volume->image_count <= 0) {
+            series_free_volume(volume);
+            volume = NULL;
+        }
+    }
+
+    // archive_open may have fallen back to the other archive type
+    if (volume) {
+        volume->type = volume->archive->type;
+    }
+
+    for (int i = 0; volume && i < SERIES_PREDECODE_PAGES && i < volume->image_count; i++) {
+        if (SDL_GetAtomicInt(&series.cancelled)) break;
+
+        DecodeResult *result = &volume->pages[i];
+        result->index = i;
+        result->tile = DECODE_WHOLE_PAGE;
+        if (!series.decode_fn(volume->archive, i, series.target_height, result)) break;
+        volume->page_count = i + 1;
+    }
+
+    if (volume) {
+        volume->widths = calloc(volume->image_count, sizeof(int));
+        volume->heights = calloc(volume->image_count, sizeof(int));
+        for (int i = 0; volume->widths && volume->heights && i < volume->image_count; i++) {
+            if (SDL_GetAtomicInt(&series.cancelled)) break;
+            archive_get_page_size(volume->archive, i, &volume->widths[i], &volume->heights[i]);
+        }
+    }
+
+    trace_end(&zone);
+    series.volume = volume;
+    SDL_SetAtomicInt(&series.finished, 1);
+
+    if (series.event_type) {
+        SDL_Event event = {0};
+        event.type = series.event_type;
+        SDL_PushEvent(&event);
+    }
+    return 0;
+}
+
+void series_preopen(const char *path, SeriesDecodeFunction decode_fn, int target_height) {
+    if (series.state != SERIES_IDLE || !decode_fn) return;
+
+    series.path = series_next_path(path);
+    if (!series.path) {
+        series.state = SERIES_NONE;
+        return;
+    }
+
+    printf("Opening next volume %s\n", series.path);
+    if (!series.event_type) {
+        series.event_type = SDL_RegisterEvents(1);
+    }
+    series.decode_fn = decode_fn;
+    series.target_height = target_height;
+    series.volume = NULL;
+    SDL_SetAtomicInt(&series.finished, 0);
+    SDL_SetAtomicInt(&series.cancelled, 0);
+
+    series.thread = SDL_CreateThread(preopen_worker, "ic_series", NULL);
+    if (!series.thread) {
+        fprintf(stderr, "Failed to create series thread: %s\n", SDL_GetError());
+        free(series.path);
+        series.path = NULL;
+        series.state = SERIES_NONE;
+        return;
+    }
+    series.state = SERIES_OPENING;
+}
+
+SeriesState series_state(void) {
+    if (series.state == SERIES_OPENING && SDL_GetAtomicInt(&series.finished)) {
+        SDL_WaitThread(series.thread, NULL);
+        series.thread = NULL;
+        series.state = series.volume ? SERIES_READY : SERIES_NONE;
+    }
+    return series.state;
+}
+
+SeriesVolume* series_take(void) {
+    if (series_state() != SERIES_READY) {
+        return NULL;
+    }
+
+    SeriesVolume *volume = series.volume;
+    series.volume = NULL;
+    series.state = SERIES_IDLE;
+    return volume;
+}
+
+void series_free_volume(SeriesVolume *volume) {
+    if (!volume) return;
+
+    for (int i = 0; i < volume->page_count; i++) {
+        page_pool_release_surface(volume->pages[i].surface);
+        free(volume->pages[i].path);
+    }
+    if (volume->archive) {
+        archive_close(volume->archive);
+    }
+    free(volume->widths);
+    free(volume->heights);
+    free(volume->path);
+    free(volume);
+}
+
+void series_shutdown(void) {
+    if (series.thread) {
+        SDL_SetAtomicInt(&series.cancelled, 1);
+        SDL_WaitThread(series.thread, NULL);
+        series.thread = NULL;
+    }
+
+    series_free_volume(series.volume);
+    free(series.path);
+    Uint32 event_type = series.event_type;
+    memset(&series, 0, sizeof(series));
+    series.event_type = event_type;
+}
@@ -0,0 +1,231 @@
+/**
+ * source_io.c
+ * Implementation of the source mappings, block reads and readahead hints
+ *
+ * Hints on mapped sources are a madvise, cheap enough for the render thread. Hints for
+ * page files need an open, which is a round trip on a share, so they go through a small
+ * queue served by one thread that opens the file, calls posix_fadvise and closes it again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source_io.h"
+#include "trace.h"
+
+// Alignment of the fallback read buffer, a multiple of any file system block size
+#define SOURCE_BUFFER_ALIGN 4096
+
+static struct {
+    SDL_Thread *thread;
+    SDL_Mutex *lock;
+    SDL_Condition *wake;
+    char *paths[SOURCE_READAHEAD_QUEUE];  // Ring of queued page files
+    int head;
+    int count;
+    bool running;
+} readahead = {0};
+
+static void reset_map(SourceMap *map) {
+    map->data = NULL;
+    map->size = 0;
+    map->fd = -1;
+    map->mapped = false;
+}
+
+static void hint_file(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+static int readahead_thread(void *data) {
+    (void)data;
+
+    SDL_LockMutex(readahead.lock);
+    while (readahead.running) {
+        if (readahead.count == 0) {
+            SDL_WaitCondition(readahead.wake, readahead.lock);
+            continue;
+        }
+
+        char *path = readahead.paths[readahead.head];
+        readahead.head = (readahead.head + 1) % SOURCE_READAHEAD_QUEUE;
+        readahead.count--;
+        SDL_UnlockMutex(readahead.lock);
+
+        TraceZone zone = trace_begin("source_readahead");
+        hint_file(path);
+        trace_end(&zone);
+        free(path);
+
+        SDL_LockMutex(readahead.lock);
+    }
+    SDL_UnlockMutex(readahead.lock);
+
+    return 0;
+}
+
+bool source_io_init(void) {
+    readahead.lock = SDL_CreateMutex();
+    readahead.wake = SDL_CreateCondition();
+    if (!readahead.lock || !readahead.wake) {
+        fprintf(stderr, "Failed to create readahead queue: %s\n", SDL_GetError());
+        source_io_shutdown();
+        return false;
+    }
+
+    readahead.running = true;
+    readahead.thread = SDL_CreateThread(readahead_thread, "readahead", NULL);
+    if (!readahead.thread) {
+        fprintf(stderr, "Failed to start readahead thread: %s\n", SDL_GetError());
+        source_io_shutdown();
+        return false;
+    }
+    return true;
+}
+
+void source_io_shutdown(void) {
+    if (readahead.thread) {
+        SDL_LockMutex(readahead.lock);
+        readahead.running = false;
+        SDL_SignalCondition(readahead.wake);
+        SDL_UnlockMutex(readahead.lock);
+        SDL_WaitThread(readahead.thread, NULL);
+    }
+
+    for (int i = 0; i < readahead.count; i++) {
+        free(readahead.paths[(readahead.head + i) % SOURCE_READAHEAD_QUEUE]);
+    }
+    if (readahead.wake) SDL_DestroyCondition(readahead.wake);
+    if (readahead.lock) SDL_DestroyMutex(readahead.lock);
+    memset(&readahead, 0, sizeof(readahead));
+}
+
+bool source_map_open(const char *path, SourceMap *map) {
+    reset_map(map);
+    if (!path) return false;
+
+    map->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (map->fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(map->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        return false;
+    }
+    map->size = (size_t)st.st_size;
+
+    // Some FUSE and network file systems cannot map, the caller then reads instead
+    void *data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    map->data = data;
+    map->mapped = true;
+    return true;
+}
+
+// Read the whole file into an aligned buffer with large sequential reads
+static bool read_blocks(SourceMap *map) {
+    void *buffer = NULL;
+    size_t capacity = (map->size + SOURCE_BUFFER_ALIGN - 1) & ~(size_t)(SOURCE_BUFFER_ALIGN - 1);
+    if (posix_memalign(&buffer, SOURCE_BUFFER_ALIGN, capacity) != 0) {
+        fprintf(stderr, "Failed to allocate %zu bytes for reading\n", map->size);
+        return false;
+    }
+
+    posix_fadvise(map->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t total = 0;
+    while (total < map->size) {
+        size_t chunk = map->size - total < SOURCE_READ_BLOCK ? map->size - total : SOURCE_READ_BLOCK;
+        ssize_t bytes_read = pread(map->fd, (char*)buffer + total, chunk, (off_t)total);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) break;
+        total += (size_t)bytes_read;
+    }
+
+    if (total != map->size) {
+        free(buffer);
+        return false;
+    }
+
+    map->data = buffer;
+    return true;
+}
+
+bool source_load(const char *path, SourceMap *map) {
+    if (source_map_open(path, map)) {
+        // The whole file is about to be decoded
+        madvise(map->data, map->size, MADV_WILLNEED);
+        return true;
+    }
+
+    if (map->fd >= 0 && map->size > 0 && read_blocks(map)) {
+        return true;
+    }
+
+    source_close(map);
+    return false;
+}
+
+void source_close(SourceMap *map) {
+    if (!map) return;
+
+    if (map->data) {
+        if (map->mapped) {
+            munmap(map->data, map->size);
+        } else {
+            free(map->data);
+        }
+    }
+    if (map->fd >= 0) {
+        close(map->fd);
+    }
+    reset_map(map);
+}
+
+void source_readahead(const SourceMap *map, SourceSpan span) {
+    if (!map || span.length == 0 || span.offset >= map->size) return;
+
+    Uint64 end = span.offset + span.length;
+    if (end > map->size) end = map->size;
+
+    if (map->mapped) {
+        // madvise wants a page aligned start
+        Uint64 page = (Uint64)sysconf(_SC_PAGESIZE);
+        Uint64 start = span.offset & ~(page - 1);
+        madvise((char*)map->data + start, end - start, MADV_WILLNEED);
+    } else if (map->fd >= 0) {
+        posix_fadvise(map->fd, (off_t)span.offset, (off_t)(end - span.offset), POSIX_FADV_WILLNEED);
+    }
+}
+
+void source_readahead_path(const char *path) {
+    if (!path || !readahead.running) return;
+
+    char *copy = strdup(path);
+    if (!copy) return;
+
+    // Hints are queued nearest page first, so the ones past a full queue matter least
+    SDL_LockMutex(readahead.lock);
+    if (readahead.count < SOURCE_READAHEAD_QUEUE) {
+        readahead.paths[(readahead.head + readahead.count) % SOURCE_READAHEAD_QUEUE] = copy;
+        readahead.count++;
+        copy = NULL;
+        SDL_SignalCondition(readahead.wake);
+    }
+    SDL_UnlockMutex(readahead.lock);
+
+    free(copy);
+}
@@ -0,0 +1,530 @@
+/**
+ * thumbnail_grid.c
+ * Implementation of the thumbnail overview
+ *
+ * A thumbnail gets the next free atlas cell when it is uploaded and keeps it, also when
+ * pages inserted before it change its index, so nothing is uploaded twice; atlases are
+ * only created once one of their cells is used.
+ * Thumbnails are requested for the visible rows first, then for a few rows on each side;
+ * the ones that scroll out of that range are cancelled before a worker picks them up.
+ *
+ * Everything here runs on the main thread except thumbnail_grid_scale.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "thumbnail_grid.h"
+#include "decode_pool.h"
+
+#define ATLAS_COLUMNS (THUMBNAIL_ATLAS_SIZE / THUMBNAIL_WIDTH)
+#define ATLAS_ROWS (THUMBNAIL_ATLAS_SIZE / THUMBNAIL_HEIGHT)
+#define THUMBNAILS_PER_ATLAS (ATLAS_COLUMNS * ATLAS_ROWS)
+
+// Distance from the screen edge the cursor is kept at, in pixels
+#define CURSOR_MARGIN THUMBNAIL_GAP
+
+typedef enum {
+    THUMBNAIL_EMPTY,
+    THUMBNAIL_QUEUED,
+    THUMBNAIL_READY,
+    THUMBNAIL_FAILED
+} ThumbnailState;
+
+typedef struct {
+    ThumbnailState state;
+    int width;                // Size of the thumbnail inside its cell
+    int height;
+    int cell;                 // Atlas cell it is uploaded to, -1 until then
+} Thumbnail;
+
+static struct {
+    SDL_Renderer *renderer;
+    Thumbnail *thumbnails;
+    int count;
+    unsigned generation;
+    SDL_Texture **atlases;    // One per THUMBNAILS_PER_ATLAS cells, NULL until needed
+    int atlas_count;
+    int cell_count;           // Cells handed out, in upload order
+    bool open;
+    int selected;
+    bool follow_selection;    // Scroll the cursor into view on the next frame
+    float scroll;             // Pixels scrolled from the top of the grid
+    int wanted_first;         // Pages the last frame queued thumbnails for
+    int wanted_last;
+    int drawn_first;          // Pages the last frame drew, none when drawn_last < drawn_first
+    int drawn_last;
+
+    // Layout of the last frame
+    int columns;
+    float left;
+    int view_height;
+
+    // Geometry of a frame, grown as needed
+    SDL_Vertex *vertices;
+    int *indices;
+    SDL_FRect *placeholders;
+    int capacity;
+} grid = {0};
+
+static float row_pitch(void) {
+    return (float)(THUMBNAIL_HEIGHT + THUMBNAIL_GAP);
+}
+
+static float column_pitch(void) {
+    return (float)(THUMBNAIL_WIDTH + THUMBNAIL_GAP);
+}
+
+static int row_count(void) {
+    return grid.columns > 0 ? (grid.count + grid.columns - 1) / grid.columns : 0;
+}
+
+static void clamp_scroll(void) {
+    float content = row_count() * row_pitch() + THUMBNAIL_GAP;
+    float max_scroll = content > grid.view_height ? content - grid.view_height : 0.0f;
+    if (grid.scroll > max_scroll) grid.scroll = max_scroll;
+    if (grid.scroll < 0.0f) grid.scroll = 0.0f;
+}
+
+static bool thumbnail_not_wanted(int index, int tile) {
+    return tile == DECODE_THUMBNAIL && (!grid.open || index < grid.wanted_first || index > grid.wanted_last);
+}
+
+static void forget_thumbnail(int index, int tile) {
+    (void)tile;
+    if (index >= 0 && index < grid.count && grid.thumbnails[index].state == THUMBNAIL_QUEUED) {
+        grid.thumbnails[index].state = THUMBNAIL_EMPTY;
+    }
+}
+
+static void destroy_atlases(void) {
+    for (int i = 0; i < grid.atlas_count; i++) {
+        if (grid.atlases[i]) {
+            SDL_DestroyTexture(grid.atlases[i]);
+        }
+    }
+    free(grid.atlases);
+    grid.atlases = NULL;
+    grid.atlas_count = 0;
+}
+
+bool thumbnail_grid_init(SDL_Renderer *renderer) {
+    if (!renderer) return false;
+
+    memset(&grid, 0, sizeof(grid));
+    grid.renderer = renderer;
+    grid.columns = 1;
+    return true;
+}
+
+void thumbnail_grid_shutdown(void) {
+    if (!grid.renderer) return;
+
+    destroy_atlases();
+    free(grid.thumbnails);
+    free(grid.vertices);
+    free(grid.indices);
+    free(grid.placeholders);
+    memset(&grid, 0, sizeof(grid));
+}
+
+// Empty thumbnails for pages first to last
+static void clear_thumbnails(Thumbnail *thumbnails, int first, int last) {
+    for (int i = first; i <= last; i++) {
+        thumbnails[i] = (Thumbnail){THUMBNAIL_EMPTY, 0, 0, -1};
+    }
+}
+
+// Grow the atlas table to cover a cell per page, the atlases are created when used
+static void reserve_atlases(void) {
+    int needed = (grid.count + THUMBNAILS_PER_ATLAS - 1) / THUMBNAILS_PER_ATLAS;
+    if (needed <= grid.atlas_count) return;
+
+    SDL_Texture **atlases = realloc(grid.atlases, needed * sizeof(SDL_Texture*));
+    if (!atlases) {
+        fprintf(stderr, "Failed to grow thumbnail atlases\n");
+        return;
+    }
+    memset(atlases + grid.atlas_count, 0, (needed - grid.atlas_count) * sizeof(SDL_Texture*));
+    grid.atlases = atlases;
+    grid.atlas_count = needed;
+}
+
+// No frame has queued or drawn anything since the pages changed
+static void forget_frame(void) {
+    grid.wanted_first = 0;
+    grid.wanted_last = -1;
+    grid.drawn_first = 0;
+    grid.drawn_last = -1;
+}
+
+void thumbnail_grid_reset(int image_count, unsigned generation) {
+    if (!grid.renderer) return;
+
+    destroy_atlases();
+    free(grid.thumbnails);
+    grid.thumbnails = image_count > 0 ? malloc(image_count * sizeof(Thumbnail)) : NULL;
+    grid.count = grid.thumbnails ? image_count : 0;
+    clear_thumbnails(grid.thumbnails, 0, grid.count - 1);
+    grid.generation = generation;
+    grid.cell_count = 0;
+    forget_frame();
+    reserve_atlases();
+
+    if (grid.selected >= grid.count) {
+        grid.selected = grid.count > 0 ? grid.count - 1 : 0;
+    }
+    grid.follow_selection = true;
+}
+
+void thumbnail_grid_remap(const int *remap, int old_count, int image_count) {
+    if (!grid.renderer) return;
+
+    // Without the old thumbnails to move (or room for the new ones) the grid starts over
+    bool moved = old_count == grid.count && image_count > 0;
+    Thumbnail *thumbnails = moved ? malloc(image_count * sizeof(Thumbnail)) : NULL;
+    if (!thumbnails) {
+        thumbnail_grid_reset(image_count, grid.generation);
+        return;
+    }
+    clear_thumbnails(thumbnails, 0, image_count - 1);
+    for (int i = 0; i < old_count; i++) {
+        thumbnails[remap[i]] = grid.thumbnails[i];
+    }
+    free(grid.thumbnails);
+    grid.thumbnails = thumbnails;
+    grid.count = image_count;
+    forget_frame();
+    reserve_atlases();
+
+    if (grid.selected < old_count) {
+        grid.selected = remap[grid.selected];
+        grid.follow_selection = true;
+    }
+}
+
+void thumbnail_grid_open(int selected) {
+    if (!grid.renderer || grid.count == 0) return;
+
+    grid.open = true;
+    thumbnail_grid_select(selected);
+}
+
+void thumbnail_grid_close(void) {
+    if (!grid.open) return;
+
+    grid.open = false;
+    decode_pool_cancel(thumbnail_not_wanted, forget_thumbnail);
+}
+
+bool thumbnail_grid_is_open(void) {
+    return grid.open;
+}
+
+int thumbnail_grid_selected(void) {
+    return grid.selected;
+}
+
+void thumbnail_grid_select(int index) {
+    if (grid.count == 0) return;
+
+    grid.selected = SDL_clamp(index, 0, grid.count - 1);
+    grid.follow_selection = true;
+}
+
+void thumbnail_grid_move(int columns, int rows) {
+    thumbnail_grid_select(grid.selected + columns + rows * grid.columns);
+}
+
+void thumbnail_grid_scroll(float rows) {
+    grid.scroll += rows * row_pitch();
+    clamp_scroll();
+}
+
+int thumbnail_grid_hit(float x, float y) {
+    if (!grid.open || grid.columns <= 0) return -1;
+
+    float grid_x = x - grid.left;
+    float grid_y = y + grid.scroll - THUMBNAIL_GAP;
+    if (grid_x < 0 || grid_y < 0) return -1;
+
+    int column = (int)(grid_x / column_pitch());
+    int row = (int)(grid_y / row_pitch());
+    if (column >= grid.columns) return -1;
+
+    // The gaps between cells belong to no page
+    if (grid_x - column * column_pitch() > THUMBNAIL_WIDTH || grid_y - row * row_pitch() > THUMBNAIL_HEIGHT) {
+        return -1;
+    }
+
+    int index = row * grid.columns + column;
+    return index < grid.count ? index : -1;
+}
+
+SDL_Surface* thumbnail_grid_scale(SDL_Surface *page) {
+    if (!page || page->w <= 0 || page->h <= 0) return NULL;
+
+    float scale_x = (float)THUMBNAIL_WIDTH / page->w;
+    float scale_y = (float)THUMBNAIL_HEIGHT / page->h;
+    float scale = scale_x < scale_y ? scale_x : scale_y;
+    int width = SDL_max(1, (int)(page->w * scale + 0.5f));
+    int height = SDL_max(1, (int)(page->h * scale + 0.5f));
+
+    // Gray pages are expanded through their palette
+    SDL_Surface *surface = SDL_ConvertSurface(page, THUMBNAIL_FORMAT);
+    if (!surface) {
+        fprintf(stderr, "Failed to convert thumbnail: %s\n", SDL_GetError());
+        return NULL;
+    }
+
+    // Halving with a linear filter averages 2x2 blocks, a single large step would alias
+    while (surface && (surface->w >= width * 2 || surface->h >= height * 2)) {
+        SDL_Surface *half = SDL_ScaleSurface(surface, SDL_max(width, surface->w / 2),
+                                             SDL_max(height, surface->h / 2), SDL_SCALEMODE_LINEAR);
+        SDL_DestroySurface(surface);
+        surface = half;
+    }
+    if (surface && (surface->w != width || surface->h != height)) {
+        SDL_Surface *fitted = SDL_ScaleSurface(surface, width, height, SDL_SCALEMODE_LINEAR);
+        SDL_DestroySurface(surface);
+        surface = fitted;
+    }
+
+    if (!surface) {
+        fprintf(stderr, "Failed to scale thumbnail: %s\n", SDL_GetError());
+    }
+    return surface;
+}
+
+// Top left corner of a cell in its atlas
+static void atlas_cell(int cell, int *x, int *y) {
+    int slot = cell % THUMBNAILS_PER_ATLAS;
+    *x = (slot % ATLAS_COLUMNS) * THUMBNAIL_WIDTH;
+    *y = (slot / ATLAS_COLUMNS) * THUMBNAIL_HEIGHT;
+}
+
+static SDL_Texture* atlas_for(int cell) {
+    int atlas = cell / THUMBNAILS_PER_ATLAS;
+    if (atlas >= grid.atlas_count) return NULL;
+
+    if (!grid.atlases[atlas]) {
+        grid.atlases[atlas] = SDL_CreateTexture(grid.renderer, THUMBNAIL_FORMAT, SDL_TEXTUREACCESS_STATIC,
+                                                THUMBNAIL_ATLAS_SIZE, THUMBNAIL_ATLAS_SIZE);
+        if (!grid.atlases[atlas]) {
+            fprintf(stderr, "Failed to create thumbnail atlas: %s\n", SDL_GetError());
+        }
+    }
+    return grid.atlases[atlas];
+}
+
+void thumbnail_grid_install(int index, SDL_Surface *surface, unsigned generation) {
+    if (index < 0 || index >= grid.count) {
+        SDL_DestroySurface(surface);
+        return;
+    }
+
+    // A thumbnail of the previous volume, this page is requested again
+    Thumbnail *thumbnail = &grid.thumbnails[index];
+    if (generation != grid.generation) {
+        SDL_DestroySurface(surface);
+        forget_thumbnail(index, DECODE_THUMBNAIL);
+        return;
+    }
+
+    // A thumbnail decoded again (after a failure) reuses its cell
+    if (surface && thumbnail->cell < 0) {
+        thumbnail->cell = grid.cell_count++;
+    }
+    SDL_Texture *atlas = surface ? atlas_for(thumbnail->cell) : NULL;
+    bool fits = surface && surface->w <= THUMBNAIL_WIDTH && surface->h <= THUMBNAIL_HEIGHT;
+    if (atlas && fits && surface->format != THUMBNAIL_FORMAT) {
+        SDL_Surface *converted = SDL_ConvertSurface(surface, THUMBNAIL_FORMAT);
+        SDL_DestroySurface(surface);
+        surface = converted;
+    }
+
+    thumbnail->state = THUMBNAIL_FAILED;
+    if (atlas && fits && surface) {
+        SDL_Rect cell = {0, 0, surface->w, surface->h};
+        atlas_cell(thumbnail->cell, &cell.x, &cell.y);
+        if (SDL_UpdateTexture(atlas, &cell, surface->pixels, surface->pitch)) {
+            thumbnail->state = THUMBNAIL_READY;
+            thumbnail->width = surface->w;
+            thumbnail->height = surface->h;
+        } else {
+            fprintf(stderr, "Failed to upload thumbnail: %s\n", SDL_GetError());
+        }
+    }
+    SDL_DestroySurface(surface);
+}
+
+static bool reserve_geometry(int count) {
+    if (count <= grid.capacity) return true;
+
+    int capacity = grid.capacity ? grid.capacity : 64;
+    while (capacity < count) capacity *= 2;
+
+    SDL_Vertex *vertices = realloc(grid.vertices, capacity * 4 * sizeof(SDL_Vertex));
+    if (vertices) grid.vertices = vertices;
+    int *indices = realloc(grid.indices, capacity * 6 * sizeof(int));
+    if (indices) grid.indices = indices;
+    SDL_FRect *placeholders = realloc(grid.placeholders, capacity * sizeof(SDL_FRect));
+    if (placeholders) grid.placeholders = placeholders;
+
+    if (!vertices || !indices || !placeholders) {
+        fprintf(stderr, "Failed to grow thumbnail geometry\n");
+        return false;
+    }
+    grid.capacity = capacity;
+    return true;
+}
+
+// Screen rectangle of page index's cell
+static SDL_FRect cell_rect(int index) {
+    int row = index / grid.columns;
+    int column = index % grid.columns;
+    SDL_FRect rect = {grid.left + column * column_pitch(), THUMBNAIL_GAP + row * row_pitch() - grid.scroll,
+                      THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT};
+    return rect;
+}
+
+// Two textured triangles of a ready thumbnail, centered on the bottom of its cell
+static void add_quad(int n, int index) {
+    const Thumbnail *thumbnail = &grid.thumbnails[index];
+    SDL_FRect cell = cell_rect(index);
+    float x0 = cell.x + (THUMBNAIL_WIDTH - thumbnail->width) / 2.0f;
+    float y0 = cell.y + (THUMBNAIL_HEIGHT - thumbnail->height);
+    float x1 = x0 + thumbnail->width;
+    float y1 = y0 + thumbnail->height;
+
+    int ax, ay;
+    atlas_cell(thumbnail->cell, &ax, &ay);
+    float u0 = (float)ax / THUMBNAIL_ATLAS_SIZE;
+    float v0 = (float)ay / THUMBNAIL_ATLAS_SIZE;
+    float u1 = (float)(ax + thumbnail->width) / THUMBNAIL_ATLAS_SIZE;
+    float v1 = (float)(ay + thumbnail->height) / THUMBNAIL_ATLAS_SIZE;
+
+    SDL_FColor white = {1.0f, 1.0f, 1.0f, 1.0f};
+    SDL_Vertex *v = &grid.vertices[n * 4];
+    v[0] = (SDL_Vertex){{x0, y0}, white, {u0, v0}};
+    v[1] = (SDL_Vertex){{x1, y0}, white, {u1, v0}};
+    v[2] = (SDL_Vertex){{x1, y1}, white, {u1, v1}};
+    v[3] = (SDL_Vertex){{x0, y1}, white, {u0, v1}};
+
+    int *i = &grid.indices[n * 6];
+    int base = n * 4;
+    i[0] = base;
+    i[1] = base + 1;
+    i[2] = base + 2;
+    i[3] = base;
+    i[4] = base + 2;
+    i[5] = base + 3;
+}
+
+// Queue the thumbnails of rows first_row to last_row that were never requested
+static void queue_rows(int first_row, int last_row, int priority) {
+    int first = SDL_max(first_row, 0) * grid.columns;
+    int last = SDL_min((last_row + 1) * grid.columns, grid.count) - 1;
+    for (int index = first; index <= last; index++) {
+        Thumbnail *thumbnail = &grid.thumbnails[index];
+        if (thumbnail->state == THUMBNAIL_EMPTY) {
+            thumbnail->state = THUMBNAIL_QUEUED;
+            decode_pool_submit(index, DECODE_THUMBNAIL, priority, grid.generation);
+        }
+    }
+}
+
+void thumbnail_grid_render(int width, int height) {
+    if (!grid.open || grid.count == 0) return;
+
+    // Layout, centered horizontally
+    grid.columns = SDL_max(1, (width - THUMBNAIL_GAP) / (int)column_pitch());
+    grid.left = (width - (grid.columns * column_pitch() - THUMBNAIL_GAP)) / 2.0f;
+    grid.view_height = height;
+
+    if (grid.follow_selection) {
+        grid.follow_selection = false;
+        float top = THUMBNAIL_GAP + (grid.selected / grid.columns) * row_pitch();
+        if (top - CURSOR_MARGIN < grid.scroll) {
+            grid.scroll = top - CURSOR_MARGIN;
+        } else if (top + THUMBNAIL_HEIGHT + CURSOR_MARGIN > grid.scroll + height) {
+            grid.scroll = top + THUMBNAIL_HEIGHT + CURSOR_MARGIN - height;
+        }
+    }
+    clamp_scroll();
+
+    int first_row = (int)(grid.scroll / row_pitch());
+    int last_row = (int)((grid.scroll + height) / row_pitch());
+    int first = first_row * grid.columns;
+    int last = SDL_min((last_row + 1) * grid.columns, grid.count) - 1;
+    if (!reserve_geometry(last - first + 1)) return;
+    grid.drawn_first = first;
+    grid.drawn_last = last;
+
+    // Rows on screen first, then outwards; what scrolled out of range is cancelled
+    grid.wanted_first = SDL_max(first_row - THUMBNAIL_PREFETCH_ROWS, 0) * grid.columns;
+    grid.wanted_last = SDL_min((last_row + 1 + THUMBNAIL_PREFETCH_ROWS) * grid.columns, grid.count) - 1;
+    decode_pool_cancel(thumbnail_not_wanted, forget_thumbnail);
+    queue_rows(first_row, last_row, 0);
+    for (int distance = 1; distance <= THUMBNAIL_PREFETCH_ROWS; distance++) {
+        queue_rows(last_row + distance, last_row + distance, distance);
+        queue_rows(first_row - distance, first_row - distance, distance);
+    }
+
+    // Pages without a thumbnail yet are drawn as a single batch of rectangles
+    int placeholder_count = 0;
+    for (int index = first; index <= last; index++) {
+        if (grid.thumbnails[index].state != THUMBNAIL_READY) {
+            grid.placeholders[placeholder_count++] = cell_rect(index);
+        }
+    }
+    if (placeholder_count > 0) {
+        SDL_SetRenderDrawColor(grid.renderer, 48, 48, 48, 255);
+        SDL_RenderFillRects(grid.renderer, grid.placeholders, placeholder_count);
+    }
+
+    // One geometry call per atlas the visible thumbnails were uploaded to
+    for (int atlas = 0; atlas < grid.atlas_count; atlas++) {
+        if (!grid.atlases[atlas]) continue;
+
+        int quads = 0;
+        for (int index = first; index <= last; index++) {
+            const Thumbnail *thumbnail = &grid.thumbnails[index];
+            if (thumbnail->state == THUMBNAIL_READY && thumbnail->cell / THUMBNAILS_PER_ATLAS == atlas) {
+                add_quad(quads++, index);
+            }
+        }
+        if (quads > 0) {
+            SDL_RenderGeometry(grid.renderer, grid.atlases[atlas], grid.vertices, quads * 4,
+                               grid.indices, quads * 6);
+        }
+    }
+
+    // Cursor
+    SDL_FRect cursor = cell_rect(grid.selected);
+    cursor.x -= 3;
+    cursor.y -= 3;
+    cursor.w += 6;
+    cursor.h += 6;
+    SDL_SetRenderDrawColor(grid.renderer, 80, 160, 255, 255);
+    for (int i = 0; i < 2; i++) {
+        SDL_RenderRect(grid.renderer, &cursor);
+        cursor.x += 1;
+        cursor.y += 1;
+        cursor.w -= 2;
+        cursor.h -= 2;
+    }
+}
+
+int thumbnail_grid_missing(void) {
+    if (!grid.open) return 0;
+
+    int missing = 0;
+    for (int index = SDL_max(grid.drawn_first, 0); index <= grid.drawn_last && index < grid.count; index++) {
+        ThumbnailState state = grid.thumbnails[index].state;
+        if (state != THUMBNAIL_READY && state != THUMBNAIL_FAILED) missing++;
+    }
+    return missing;
+}
@@ -0,0 +1,517 @@
+/**
+ * tile_cache.c
+ * Implementation of the zoom tile cache
+ *
+ * Pages are normally decoded at display resolution. When a page is zoomed past that,
+ * its full resolution source is decoded once on a worker and only the tiles covering
+ * the viewport are cut from it, downscaled to the level of detail on screen and
+ * uploaded. No texture is larger than a tile and tile textures are LRU-evicted to a
+ * byte budget, so VRAM stays bounded however large the page is.
+ *
+ * Sources are shared with the workers and protected by cache.lock; tile entries and
+ * textures are only touched by the main thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "tile_cache.h"
+#include "decode_pool.h"
+
+// Tile coordinates packed into the job's tile value
+#define TILE_ID(level, tx, ty) (((level) << 24) | ((ty) << 12) | (tx))
+#define TILE_LEVEL(tile) ((tile) >> 24)
+#define TILE_Y(tile) (((tile) >> 12) & 0xfff)
+#define TILE_X(tile) ((tile) & 0xfff)
+#define TILE_MAX_COORD 0xfff
+
+// Tiles queue right behind the page on screen
+#define TILE_PRIORITY 0
+
+typedef enum {
+    SOURCE_EMPTY,
+    SOURCE_QUEUED,     // Waiting for a worker to decode it
+    SOURCE_LOADING,    // A worker is decoding it, others wait on source_ready
+    SOURCE_READY,
+    SOURCE_FAILED
+} SourceState;
+
+// Full resolution page tiles are cut from
+typedef struct {
+    int index;
+    SourceState state;
+    unsigned serial;          // Bumped when the slot is reused, invalidates loads in flight
+    SDL_Surface *surface;     // Reference counted, workers hold a reference while cutting
+    int width;
+    int height;
+    Uint64 last_frame;
+    TileEnhancement enhancement; // Snapshot the source is decoded with
+} TileSource;
+
+// An uploaded (or requested) tile
+typedef struct {
+    int index;
+    int tile;
+    SDL_Texture *texture;     // NULL while the job is pending
+    bool pending;
+    size_t bytes;
+    Uint64 last_frame;
+} TileEntry;
+
+static struct {
+    SDL_Renderer *renderer;
+    TileSourceFunction source_fn;
+    SDL_Mutex *lock;
+    SDL_Condition *source_ready;
+    TileSource sources[TILE_MAX_SOURCES];
+    TileEntry *tiles;
+    int tile_count;
+    int tile_capacity;
+    size_t texture_bytes;
+    size_t texture_budget;
+    Uint64 frame;
+} cache = {0};
+
+// Source slot holding page index (lock held)
+static TileSource* find_source(int index) {
+    for (int i = 0; i < TILE_MAX_SOURCES; i++) {
+        if (cache.sources[i].state != SOURCE_EMPTY && cache.sources[i].index == index) {
+            return &cache.sources[i];
+        }
+    }
+    return NULL;
+}
+
+// Empty a source slot, a load in flight discards its result (lock held)
+static void reset_source(TileSource *source) {
+    if (source->surface) {
+        SDL_DestroySurface(source->surface);
+        source->surface = NULL;
+    }
+    source->state = SOURCE_EMPTY;
+    source->index = -1;
+    source->serial++;
+}
+
+// Reuse the least recently drawn slot for page index, NULL if all are on screen (lock held)
+static TileSource* claim_source(int index) {
+    TileSource *victim = NULL;
+    for (int i = 0; i < TILE_MAX_SOURCES; i++) {
+        TileSource *source = &cache.sources[i];
+        if (source->state == SOURCE_EMPTY) {
+            victim = source;
+            break;
+        }
+        if (source->last_frame < cache.frame && (!victim || source->last_frame < victim->last_frame)) {
+            victim = source;
+        }
+    }
+    if (!victim) return NULL;
+
+    reset_source(victim);
+    SDL_BroadcastCondition(cache.source_ready);
+    victim->index = index;
+    victim->state = SOURCE_QUEUED;
+    victim->last_frame = cache.frame;
+    return victim;
+}
+
+// Take a reference on the source of page index, decoding it if nobody has yet (lock held)
+static SDL_Surface* acquire_source(int index) {
+    while (true) {
+        // The page may have moved while this worker waited (tile_cache_remap)
+        index = decode_pool_job_index(index);
+        TileSource *source = find_source(index);
+        if (!source || source->state == SOURCE_FAILED) {
+            return NULL;
+        }
+        if (source->state == SOURCE_READY) {
+            source->surface->refcount++;
+            return source->surface;
+        }
+        if (source->state == SOURCE_LOADING) {
+            SDL_WaitCondition(cache.source_ready, cache.lock);
+            continue;
+        }
+
+        // Queued: this worker decodes it without holding the lock
+        source->state = SOURCE_LOADING;
+        unsigned serial = source->serial;
+        TileEnhancement enhancement = source->enhancement;
+        SDL_UnlockMutex(cache.lock);
+
+        SDL_Surface *surface = NULL;
+        bool loaded = cache.source_fn(index, &enhancement, &surface) && surface;
+
+        SDL_LockMutex(cache.lock);
+        if (source->serial != serial) {
+            // The slot was reused or cleared meanwhile
+            SDL_DestroySurface(surface);
+        } else if (loaded) {
+            source->surface = surface;
+            source->width = surface->w;
+            source->height = surface->h;
+            source->state = SOURCE_READY;
+        } else {
+            SDL_DestroySurface(surface);
+            source->state = SOURCE_FAILED;
+        }
+        SDL_BroadcastCondition(cache.source_ready);
+    }
+}
+
+// Average 2^level x 2^level blocks of source into one tile, edge blocks are clipped
+// Sources are 32-bit color or 8-bit gray, tiles keep the source's format (and palette)
+static SDL_Surface* cut_tile(SDL_Surface *source, int level, int tx, int ty) {
+    int bpp = SDL_BYTESPERPIXEL(source->format);
+    int step = 1 << level;
+    int span = TILE_SIZE << level;
+    int x0 = tx * span;
+    int y0 = ty * span;
+    if (x0 >= source->w || y0 >= source->h) return NULL;
+
+    int width = (source->w - x0 + step - 1) / step;
+    int height = (source->h - y0 + step - 1) / step;
+    if (width > TILE_SIZE) width = TILE_SIZE;
+    if (height > TILE_SIZE) height = TILE_SIZE;
+
+    SDL_Surface *tile = SDL_CreateSurface(width, height, source->format);
+    if (!tile) {
+        fprintf(stderr, "Failed to create tile surface: %s\n", SDL_GetError());
+        return NULL;
+    }
+    SDL_Palette *palette = SDL_GetSurfacePalette(source);
+    if (palette) {
+        SDL_SetSurfacePalette(tile, palette);
+    }
+
+    const Uint8 *src = (const Uint8*)source->pixels;
+    for (int y = 0; y < height; y++) {
+        Uint8 *dst = (Uint8*)tile->pixels + (size_t)y * tile->pitch;
+        int sy0 = y0 + y * step;
+        int sy1 = sy0 + step < source->h ? sy0 + step : source->h;
+
+        if (level == 0) {
+            memcpy(dst, src + (size_t)sy0 * source->pitch + (size_t)x0 * bpp, (size_t)width * bpp);
+            continue;
+        }
+
+        for (int x = 0; x < width; x++) {
+            int sx0 = x0 + x * step;
+            int sx1 = sx0 + step < source->w ? sx0 + step : source->w;
+            Uint32 sum[4] = {0, 0, 0, 0};
+            for (int sy = sy0; sy < sy1; sy++) {
+                const Uint8 *p = src + (size_t)sy * source->pitch + (size_t)sx0 * bpp;
+                for (int sx = sx0; sx < sx1; sx++, p += bpp) {
+                    for (int c = 0; c < bpp; c++) {
+                        sum[c] += p[c];
+                    }
+                }
+            }
+            Uint32 count = (Uint32)((sx1 - sx0) * (sy1 - sy0));
+            for (int c = 0; c < bpp; c++) {
+                dst[x * bpp + c] = (Uint8)((sum[c] + count / 2) / count);
+            }
+        }
+    }
+
+    return tile;
+}
+
+static TileEntry* find_tile(int index, int tile) {
+    for (int i = 0; i < cache.tile_count; i++) {
+        if (cache.tiles[i].index == index && cache.tiles[i].tile == tile) {
+            return &cache.tiles[i];
+        }
+    }
+    return NULL;
+}
+
+static TileEntry* add_tile(int index, int tile) {
+    if (cache.tile_count >= cache.tile_capacity) {
+        int capacity = cache.tile_capacity ? cache.tile_capacity * 2 : 64;
+        TileEntry *tiles = realloc(cache.tiles, capacity * sizeof(TileEntry));
+        if (!tiles) {
+            fprintf(stderr, "Failed to grow tile cache\n");
+            return NULL;
+        }
+        cache.tiles = tiles;
+        cache.tile_capacity = capacity;
+    }
+
+    TileEntry *entry = &cache.tiles[cache.tile_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->index = index;
+    entry->tile = tile;
+    entry->last_frame = cache.frame;
+    return entry;
+}
+
+// Destroy a tile and swap the last entry into its place
+static void remove_tile(TileEntry *entry) {
+    if (entry->texture) {
+        SDL_DestroyTexture(entry->texture);
+        cache.texture_bytes -= entry->bytes < cache.texture_bytes ? entry->bytes : cache.texture_bytes;
+    }
+    *entry = cache.tiles[--cache.tile_count];
+}
+
+bool tile_cache_init(SDL_Renderer *renderer, size_t texture_budget, TileSourceFunction source_fn) {
+    if (!renderer || !source_fn) return false;
+
+    memset(&cache, 0, sizeof(cache));
+    cache.lock = SDL_CreateMutex();
+    cache.source_ready = SDL_CreateCondition();
+    if (!cache.lock || !cache.source_ready) {
+        fprintf(stderr, "Failed to create tile cache synchronization: %s\n", SDL_GetError());
+        SDL_DestroyCondition(cache.source_ready);
+        SDL_DestroyMutex(cache.lock);
+        memset(&cache, 0, sizeof(cache));
+        return false;
+    }
+
+    for (int i = 0; i < TILE_MAX_SOURCES; i++) {
+        cache.sources[i].index = -1;
+    }
+    cache.renderer = renderer;
+    cache.source_fn = source_fn;
+    cache.texture_budget = texture_budget;
+    return true;
+}
+
+void tile_cache_shutdown(void) {
+    if (!cache.renderer) return;
+
+    tile_cache_clear();
+    free(cache.tiles);
+    SDL_DestroyCondition(cache.source_ready);
+    SDL_DestroyMutex(cache.lock);
+    memset(&cache, 0, sizeof(cache));
+}
+
+void tile_cache_release_sources(void) {
+    if (!cache.renderer) return;
+
+    SDL_LockMutex(cache.lock);
+    for (int i = 0; i < TILE_MAX_SOURCES; i++) {
+        reset_source(&cache.sources[i]);
+    }
+    SDL_BroadcastCondition(cache.source_ready);
+    SDL_UnlockMutex(cache.lock);
+}
+
+void tile_cache_clear(void) {
+    if (!cache.renderer) return;
+
+    tile_cache_release_sources();
+    while (cache.tile_count > 0) {
+        remove_tile(&cache.tiles[cache.tile_count - 1]);
+    }
+}
+
+void tile_cache_remap(const int *remap, int old_count) {
+    if (!cache.renderer) {
+        decode_pool_remap(remap, old_count);
+        return;
+    }
+
+    SDL_LockMutex(cache.lock);
+    for (int i = 0; i < TILE_MAX_SOURCES; i++) {
+        TileSource *source = &cache.sources[i];
+        if (source->state != SOURCE_EMPTY && source->index >= 0 && source->index < old_count) {
+            source->index = remap[source->index];
+        }
+    }
+    decode_pool_remap(remap, old_count);
+    SDL_UnlockMutex(cache.lock);
+
+    for (int i = 0; i < cache.tile_count; i++) {
+        TileEntry *entry = &cache.tiles[i];
+        if (entry->index >= 0 && entry->index < old_count) {
+            entry->index = remap[entry->index];
+        }
+    }
+}
+
+bool tile_cache_decode(int index, int tile, SDL_Surface **out_surface) {
+    if (!cache.renderer || !out_surface) return false;
+
+    SDL_LockMutex(cache.lock);
+    SDL_Surface *source = acquire_source(index);
+    SDL_UnlockMutex(cache.lock);
+    if (!source) return false;
+
+    // A source job only has to make the source available
+    bool success = true;
+    if (tile != TILE_SOURCE_JOB) {
+        *out_surface = cut_tile(source, TILE_LEVEL(tile), TILE_X(tile), TILE_Y(tile));
+        success = *out_surface != NULL;
+    }
+
+    // Release the reference under the lock, the main thread may drop the slot's own
+    SDL_LockMutex(cache.lock);
+    SDL_DestroySurface(source);
+    SDL_UnlockMutex(cache.lock);
+
+    return success;
+}
+
+void tile_cache_install(int index, int tile, SDL_Surface *surface) {
+    if (tile == TILE_SOURCE_JOB) {
+        SDL_DestroySurface(surface);
+        return;
+    }
+
+    // The entry is gone if the tile was cancelled or the cache cleared
+    TileEntry *entry = find_tile(index, tile);
+    if (!entry || !surface) {
+        SDL_DestroySurface(surface);
+        if (entry) remove_tile(entry);
+        return;
+    }
+
+    entry->pending = false;
+    entry->texture = SDL_CreateTextureFromSurface(cache.renderer, surface);
+    if (entry->texture) {
+        entry->bytes = (size_t)surface->w * surface->h * 4;
+        cache.texture_bytes += entry->bytes;
+    } else {
+        fprintf(stderr, "Failed to create tile texture: %s\n", SDL_GetError());
+    }
+    SDL_DestroySurface(surface);
+}
+
+// Size of the source of page index, queueing its decode if it is not resident (main thread)
+static bool source_size(int index, unsigned generation, const TileEnhancement *enhancement,
+                        int *width, int *height) {
+    SDL_LockMutex(cache.lock);
+    TileSource *source = find_source(index);
+    if (!source) {
+        source = claim_source(index);
+        if (source) {
+            source->enhancement = *enhancement;
+            decode_pool_submit(index, TILE_SOURCE_JOB, TILE_PRIORITY, generation);
+        }
+    }
+
+    bool ready = source && source->state == SOURCE_READY;
+    if (source) {
+        source->last_frame = cache.frame;
+    }
+    if (ready) {
+        *width = source->width;
+        *height = source->height;
+    }
+    SDL_UnlockMutex(cache.lock);
+
+    return ready;
+}
+
+void tile_cache_render(int index, float image_width, SDL_FRect crop_rect, SDL_FRect dest_rect,
+                       SDL_FRect viewport, unsigned generation, const TileEnhancement *enhancement) {
+    if (!cache.renderer || !enhancement || image_width <= 0 || crop_rect.w <= 0 || crop_rect.h <= 0 || dest_rect.w <= 0) {
+        return;
+    }
+
+    int source_width = 0, source_height = 0;
+    if (!source_size(index, generation, enhancement, &source_width, &source_height)) {
+        return;
+    }
+
+    // Crop rectangle in source pixels and screen pixels per source pixel
+    float ratio = (float)source_width / image_width;
+    SDL_FRect crop = {crop_rect.x * ratio, crop_rect.y * ratio, crop_rect.w * ratio, crop_rect.h * ratio};
+    float scale = dest_rect.w / crop.w;
+
+    // Coarsest level whose pixels are still no larger than a screen pixel
+    int level = 0;
+    while (level < TILE_MAX_LEVEL && scale * (float)(2 << level) <= 1.0f) {
+        level++;
+    }
+    int step = 1 << level;
+    int span = TILE_SIZE << level;
+
+    // Visible part of the page, in source pixels
+    float vis_x0 = SDL_max(dest_rect.x, viewport.x);
+    float vis_y0 = SDL_max(dest_rect.y, viewport.y);
+    float vis_x1 = SDL_min(dest_rect.x + dest_rect.w, viewport.x + viewport.w);
+    float vis_y1 = SDL_min(dest_rect.y + dest_rect.h, viewport.y + viewport.h);
+    if (vis_x1 <= vis_x0 || vis_y1 <= vis_y0) return;
+
+    float src_x0 = crop.x + (vis_x0 - dest_rect.x) / scale;
+    float src_y0 = crop.y + (vis_y0 - dest_rect.y) / scale;
+    float src_x1 = crop.x + (vis_x1 - dest_rect.x) / scale;
+    float src_y1 = crop.y + (vis_y1 - dest_rect.y) / scale;
+
+    int last_tx = SDL_min((source_width - 1) / span, TILE_MAX_COORD);
+    int last_ty = SDL_min((source_height - 1) / span, TILE_MAX_COORD);
+    int tx0 = SDL_clamp((int)(src_x0 / span), 0, last_tx);
+    int ty0 = SDL_clamp((int)(src_y0 / span), 0, last_ty);
+    int tx1 = SDL_clamp((int)(src_x1 / span), 0, last_tx);
+    int ty1 = SDL_clamp((int)(src_y1 / span), 0, last_ty);
+
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            int tile = TILE_ID(level, tx, ty);
+            TileEntry *entry = find_tile(index, tile);
+            if (!entry) {
+                entry = add_tile(index, tile);
+                if (!entry) continue;
+                entry->pending = true;
+                decode_pool_submit(index, tile, TILE_PRIORITY, generation);
+            }
+            entry->last_frame = cache.frame;
+            if (!entry->texture) continue;
+
+            // Part of the tile inside the crop, in source pixels
+            float x0 = SDL_max((float)(tx * span), crop.x);
+            float y0 = SDL_max((float)(ty * span), crop.y);
+            float x1 = SDL_min((float)SDL_min((tx + 1) * span, source_width), crop.x + crop.w);
+            float y1 = SDL_min((float)SDL_min((ty + 1) * span, source_height), crop.y + crop.h);
+            if (x1 <= x0 || y1 <= y0) continue;
+
+            SDL_FRect src = {(x0 - tx * span) / step, (y0 - ty * span) / step, (x1 - x0) / step, (y1 - y0) / step};
+            SDL_FRect dst = {dest_rect.x + (x0 - crop.x) * scale, dest_rect.y + (y0 - crop.y) * scale,
+                             (x1 - x0) * scale, (y1 - y0) * scale};
+            SDL_RenderTexture(cache.renderer, entry->texture, &src, &dst);
+        }
+    }
+}
+
+// Queued tiles the last frame did not draw are no longer worth decoding; negative tile
+// values are page, preview and thumbnail jobs, which are not the cache's to cancel
+static bool tile_not_wanted(int index, int tile) {
+    if (tile < 0 || tile == TILE_SOURCE_JOB) return false;
+
+    TileEntry *entry = find_tile(index, tile);
+    return !entry || entry->last_frame < cache.frame;
+}
+
+static void forget_tile(int index, int tile) {
+    TileEntry *entry = find_tile(index, tile);
+    if (entry) remove_tile(entry);
+}
+
+void tile_cache_end_frame(void) {
+    if (!cache.renderer) return;
+
+    decode_pool_cancel(tile_not_wanted, forget_tile);
+
+    // Evict least recently drawn tiles, what is on screen now always stays
+    while (cache.texture_bytes > cache.texture_budget) {
+        TileEntry *victim = NULL;
+        for (int i = 0; i < cache.tile_count; i++) {
+            TileEntry *entry = &cache.tiles[i];
+            if (!entry->texture || entry->last_frame >= cache.frame) continue;
+            if (!victim || entry->last_frame < victim->last_frame) {
+                victim = entry;
+            }
+        }
+        if (!victim) break;
+        remove_tile(victim);
+    }
+
+    cache.frame++;
+}
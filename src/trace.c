@@ -0,0 +1,154 @@
+/**
+ * trace.c
+ * Implementation of the per-thread zone rings and the Chrome trace export
+ *
+ * Each thread appends to its own ring without locking; the lock is only taken when a
+ * thread records its first zone and registers its ring. Timestamps are SDL_GetTicksNS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+typedef struct {
+    const char *name;
+    Uint64 start;
+    Uint64 duration;
+} TraceEvent;
+
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    Uint64 written;               // Total zones recorded, the ring holds the last TRACE_RING_SIZE
+    SDL_ThreadID thread_id;
+    bool main_thread;
+    struct TraceRing *next;
+} TraceRing;
+
+static struct {
+    char *output_path;
+    SDL_Mutex *lock;              // Guards the ring list
+    TraceRing *rings;
+    bool enabled;
+} trace = {0};
+
+static _Thread_local TraceRing *thread_ring;
+
+// Allocate and register the calling thread's ring
+static TraceRing* register_ring(void) {
+    TraceRing *ring = calloc(1, sizeof(TraceRing));
+    if (!ring) {
+        return NULL;
+    }
+    ring->thread_id = SDL_GetCurrentThreadID();
+    ring->main_thread = SDL_IsMainThread();
+
+    SDL_LockMutex(trace.lock);
+    ring->next = trace.rings;
+    trace.rings = ring;
+    SDL_UnlockMutex(trace.lock);
+
+    return ring;
+}
+
+bool trace_init(const char *output_path) {
+    if (!output_path) return false;
+
+    trace.lock = SDL_CreateMutex();
+    trace.output_path = strdup(output_path);
+    if (!trace.lock || !trace.output_path) {
+        fprintf(stderr, "Failed to start tracing\n");
+        SDL_DestroyMutex(trace.lock);
+        free(trace.output_path);
+        memset(&trace, 0, sizeof(trace));
+        return false;
+    }
+
+    trace.enabled = true;
+    return true;
+}
+
+bool trace_enabled(void) {
+    return trace.enabled;
+}
+
+TraceZone trace_begin(const char *name) {
+    TraceZone zone = {name, 0};
+    if (trace.enabled) {
+        zone.start = SDL_GetTicksNS();
+    }
+    return zone;
+}
+
+void trace_end(TraceZone *zone) {
+    if (!trace.enabled || zone->start == 0) return;
+
+    Uint64 end = SDL_GetTicksNS();
+    TraceRing *ring = thread_ring;
+    if (!ring) {
+        ring = thread_ring = register_ring();
+        if (!ring) return;
+    }
+
+    TraceEvent *event = &ring->events[ring->written % TRACE_RING_SIZE];
+    event->name = zone->name;
+    event->start = zone->start;
+    event->duration = end - zone->start;
+    ring->written++;
+}
+
+// One complete ("X") event per zone, in microseconds, plus a name for each thread
+static void write_trace(FILE *file) {
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    bool first = true;
+    int worker = 0;
+    for (TraceRing *ring = trace.rings; ring; ring = ring->next) {
+        unsigned long long tid = (unsigned long long)ring->thread_id;
+        char thread_name[32];
+        if (ring->main_thread) {
+            snprintf(thread_name, sizeof(thread_name), "main");
+        } else {
+            snprintf(thread_name, sizeof(thread_name), "worker %d", worker++);
+        }
+        fprintf(file, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %llu, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",\n", tid, thread_name);
+        first = false;
+
+        Uint64 count = ring->written < TRACE_RING_SIZE ? ring->written : TRACE_RING_SIZE;
+        for (Uint64 i = ring->written - count; i < ring->written; i++) {
+            const TraceEvent *event = &ring->events[i % TRACE_RING_SIZE];
+            fprintf(file, ",\n{\"ph\": \"X\", \"name\": \"%s\", \"pid\": 1, \"tid\": %llu, \"ts\": %.3f, \"dur\": %.3f}",
+                    event->name, tid, event->start / 1000.0, event->duration / 1000.0);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+}
+
+void trace_shutdown(void) {
+    if (!trace.enabled) return;
+    trace.enabled = false;
+
+    FILE *file = fopen(trace.output_path, "w");
+    if (file) {
+        write_trace(file);
+        fclose(file);
+        printf("Trace written to %s\n", trace.output_path);
+    } else {
+        fprintf(stderr, "Cannot write trace to %s\n", trace.output_path);
+    }
+
+    TraceRing *ring = trace.rings;
+    while (ring) {
+        TraceRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    thread_ring = NULL;
+
+    SDL_DestroyMutex(trace.lock);
+    free(trace.output_path);
+    memset(&trace, 0, sizeof(trace));
+}
@@ -0,0 +1,115 @@
+/**
+ * view_list.c
+ * Implementation of the gap buffer holding the views
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "view_list.h"
+
+#define VIEW_LIST_MIN_CAPACITY 64
+
+static int gap_size(const ViewList *list) {
+    return list->gap_end - list->gap_start;
+}
+
+// Move the gap so that it starts at index
+static void move_gap(ViewList *list, int index) {
+    if (index < list->gap_start) {
+        int moved = list->gap_start - index;
+        memmove(&list->items[list->gap_end - moved], &list->items[index], moved * sizeof(ImageView));
+        list->gap_start -= moved;
+        list->gap_end -= moved;
+    } else if (index > list->gap_start) {
+        int moved = index - list->gap_start;
+        memmove(&list->items[list->gap_start], &list->items[list->gap_end], moved * sizeof(ImageView));
+        list->gap_start += moved;
+        list->gap_end += moved;
+    }
+}
+
+// Double the storage, the new slots go into the gap
+static bool grow(ViewList *list) {
+    int capacity = list->capacity ? list->capacity * 2 : VIEW_LIST_MIN_CAPACITY;
+    ImageView *items = malloc(capacity * sizeof(ImageView));
+    if (!items) {
+        fprintf(stderr, "Failed to allocate memory for %d views\n", capacity);
+        return false;
+    }
+
+    int after = list->capacity - list->gap_end;
+    if (list->items) {
+        memcpy(items, list->items, list->gap_start * sizeof(ImageView));
+        memcpy(&items[capacity - after], &list->items[list->gap_end], after * sizeof(ImageView));
+        free(list->items);
+    }
+
+    list->items = items;
+    list->gap_end = capacity - after;
+    list->capacity = capacity;
+    return true;
+}
+
+void view_list_init(ViewList *list) {
+    memset(list, 0, sizeof(*list));
+}
+
+void view_list_free(ViewList *list) {
+    free(list->items);
+    memset(list, 0, sizeof(*list));
+}
+
+void view_list_clear(ViewList *list) {
+    list->gap_start = 0;
+    list->gap_end = list->capacity;
+}
+
+int view_list_count(const ViewList *list) {
+    return list->capacity - gap_size(list);
+}
+
+ImageView* view_list_get(ViewList *list, int index) {
+    if (index < 0 || index >= view_list_count(list)) {
+        return NULL;
+    }
+    return index < list->gap_start ? &list->items[index] : &list->items[index + gap_size(list)];
+}
+
+bool view_list_insert(ViewList *list, int index, const ImageView *view) {
+    if (!view || index < 0 || index > view_list_count(list)) {
+        return false;
+    }
+    if (gap_size(list) == 0 && !grow(list)) {
+        return false;
+    }
+
+    move_gap(list, index);
+    list->items[list->gap_start++] = *view;
+    return true;
+}
+
+bool view_list_append(ViewList *list, const ImageView *view) {
+    return view_list_insert(list, view_list_count(list), view);
+}
+
+void view_list_remove(ViewList *list, int index) {
+    if (index < 0 || index >= view_list_count(list)) {
+        return;
+    }
+
+    // With the gap at index the removed view is the first one after it
+    move_gap(list, index);
+    list->gap_end++;
+}
+
+ImageView view_make_single(int image_index) {
+    ImageView view = {0};
+    view.count = 1;
+    for (int i = 0; i < MAX_IMAGES_PER_VIEW; i++) {
+        view.image_indices[i] = -1;
+    }
+    view.image_indices[0] = image_index;
+    return view;
+}